@@ -0,0 +1,39 @@
+#include "Benchmark.hpp"
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+GLFWwindow * createBenchmarkContext(const char * title)
+{
+  if (!glfwInit()) {
+    return nullptr;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+#else
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#endif
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow * window = glfwCreateWindow(64, 64, title, nullptr, nullptr);
+  if (!window) {
+    return nullptr;
+  }
+  glfwMakeContextCurrent(window);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    glfwDestroyWindow(window);
+    return nullptr;
+  }
+  glGetError(); // glewInit raises a GL_INVALID_ENUM with core profiles
+  return window;
+}
+
+void destroyBenchmarkContext(GLFWwindow * window)
+{
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+}
@@ -0,0 +1,15 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+struct GLFWwindow;
+
+/**
+ * @brief creates an invisible window, to get an OpenGL context for measurements
+ * @param title the title of the window
+ * @return the window owning the current context, null on failure
+ */
+GLFWwindow * createBenchmarkContext(const char * title);
+
+/// destroys a window created by createBenchmarkContext (does nothing if null)
+void destroyBenchmarkContext(GLFWwindow * window);
+
+#endif // !defined(__BENCHMARK_H__)
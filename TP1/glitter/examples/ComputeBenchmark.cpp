@@ -0,0 +1,118 @@
+#define GLM_FORCE_RADIANS
+#include "ComputeBenchmark.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "Benchmark.hpp"
+#include "glApi.hpp"
+
+namespace
+{
+const int nbRuns = 5;
+const float tolerance = 1e-3f; ///< largest difference between the CPU and the GPU points (the coordinates are below 100)
+
+/// best duration (in ms) of several runs
+double bestTime(const std::function<void()> & run)
+{
+  double best = 0;
+  for (int i = 0; i < nbRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    best = i == 0 ? duration : std::min(best, duration);
+  }
+  return best;
+}
+
+/// largest absolute difference between the coordinates of two sets of points
+float maxDifference(const std::vector<glm::vec4> & a, const std::vector<glm::vec4> & b)
+{
+  float difference = 0;
+  for (size_t k = 0; k < a.size(); k++) {
+    for (int c = 0; c < 4; c++) {
+      difference = std::max(difference, std::abs(a[k][c] - b[k][c]));
+    }
+  }
+  return difference;
+}
+} // namespace
+
+bool benchmarkCompute(size_t nbPoints)
+{
+  GLFWwindow * window = createBenchmarkContext("compute");
+  if (!window) {
+    std::cerr << "Could not create an OpenGL context" << std::endl;
+    return false;
+  }
+  bool valid = true;
+  std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+  {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> uniform(-10, 10);
+    std::vector<glm::vec4> points(nbPoints), transformed(nbPoints), gpuTransformed(nbPoints, glm::vec4(0));
+    for (auto & point : points) {
+      point = glm::vec4(uniform(random), uniform(random), uniform(random), 1);
+    }
+    const glm::mat4 matrix = glm::perspective(glm::radians(60.f), 16 / 9.f, 0.1f, 200.f) * glm::lookAt(glm::vec3(30, 20, 15), glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
+
+    ComputeProgram program("shaders/transform.c.glsl");
+    Buffer input(GL_SHADER_STORAGE_BUFFER), output(GL_SHADER_STORAGE_BUFFER), commands(GL_DISPATCH_INDIRECT_BUFFER);
+    input.setData(points);
+    output.allocate(nbPoints * sizeof(glm::vec4), GL_DYNAMIC_COPY);
+    const uint nbGroups = ComputeProgram::groupCount(nbPoints, program.workGroupSize().x);
+    commands.setData(std::vector<uint>{nbGroups, 1, 1});
+
+    program.bind();
+    program.setUniform("matrix", matrix);
+    program.setUniform("count", uint(nbPoints));
+    input.bindBase(0);
+    output.bindBase(1);
+
+    double cpuTime = bestTime([&]() {
+      for (size_t k = 0; k < nbPoints; k++) {
+        transformed[k] = matrix * points[k];
+      }
+    });
+    double dispatchTime = bestTime([&]() {
+      program.dispatch(nbGroups);
+      glFinish();
+    });
+    barrier::bufferUpdate();
+    output.read(gpuTransformed.data(), nbPoints * sizeof(glm::vec4));
+    float dispatchDifference = maxDifference(transformed, gpuTransformed);
+
+    std::fill(gpuTransformed.begin(), gpuTransformed.end(), glm::vec4(0));
+    output.allocate(nbPoints * sizeof(glm::vec4), GL_DYNAMIC_COPY); // new storage, not written by the first dispatches
+    double indirectTime = bestTime([&]() {
+      program.dispatchIndirect(commands);
+      glFinish();
+    });
+    barrier::bufferUpdate();
+    output.read(gpuTransformed.data(), nbPoints * sizeof(glm::vec4));
+    float indirectDifference = maxDifference(transformed, gpuTransformed);
+
+    Buffer::unbindBase(0);
+    Buffer::unbindBase(1);
+    program.unbind();
+
+    std::cout << nbPoints << " points (" << nbGroups << " work groups of " << program.workGroupSize().x << "):" << std::fixed << std::setprecision(3) << std::endl;
+    std::cout << "  glm, 1 thread    : " << cpuTime << " ms (reference)" << std::endl;
+    std::cout << "  dispatch         : " << dispatchTime << " ms (speedup " << cpuTime / dispatchTime << ")" << std::endl;
+    std::cout << "  dispatchIndirect : " << indirectTime << " ms (speedup " << cpuTime / indirectTime << ")" << std::endl;
+    std::cout << std::scientific << std::setprecision(1) << "  max difference   : " << dispatchDifference << " (dispatch), " << indirectDifference << " (indirect)"
+              << std::endl;
+    valid = dispatchDifference <= tolerance and indirectDifference <= tolerance;
+    if (not valid) {
+      std::cerr << "the GPU points differ from the CPU ones (tolerance " << tolerance << ")" << std::endl;
+    }
+  }
+  destroyBenchmarkContext(window);
+  return valid;
+}
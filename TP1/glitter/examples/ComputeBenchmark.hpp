@@ -0,0 +1,18 @@
+#ifndef __COMPUTE_BENCHMARK_H__
+#define __COMPUTE_BENCHMARK_H__
+#include <cstddef>
+
+/**
+ * @brief compares the transformation of an array of points on the CPU and by a compute shader
+ * @param nbPoints the number of points
+ *
+ * Prints the time (the best of several runs) of: glm on one thread; the compute shader (shaders/transform.c.glsl)
+ * launched by ComputeProgram::dispatch, then by ComputeProgram::dispatchIndirect with the work group counts
+ * read from a buffer. The GPU times include the wait for the results but not their read back. The largest
+ * difference between the CPU and the GPU points is printed too.
+ *
+ * @return false if there is no OpenGL context, or if a GPU point differs from the CPU one (beyond the rounding)
+ */
+bool benchmarkCompute(size_t nbPoints);
+
+#endif // !defined(__COMPUTE_BENCHMARK_H__)
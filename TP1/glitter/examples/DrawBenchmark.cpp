@@ -0,0 +1,300 @@
+#define GLM_FORCE_RADIANS
+#include "DrawBenchmark.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include "Benchmark.hpp"
+#include "Bounds.hpp"
+#include "GpuDrivenScene.hpp"
+#include "RenderQueue.hpp"
+#include "ThreadPool.hpp"
+#include "glApi.hpp"
+
+namespace
+{
+const unsigned int nbPrograms = 8;
+const unsigned int nbMaterials = 32;
+const unsigned int nbMeshes = 16;
+const unsigned int nbFrames = 100;
+const float sceneSize = 100;
+
+/// an object of the synthetic scene
+struct SyntheticObject {
+  glm::vec3 position; ///< position of the center (in world space)
+  glm::vec3 axis;     ///< rotation axis
+  float speed;        ///< rotation speed (in radians per second)
+  float scale;        ///< size of the cube
+  unsigned int program;
+  unsigned int material;
+  unsigned int mesh;
+};
+
+/// the GPU resources shared by the objects
+struct SyntheticResources {
+  std::vector<std::unique_ptr<Program>> programs;
+  std::vector<std::unique_ptr<Texture>> textures; ///< three textures per material
+  std::vector<std::unique_ptr<Sampler>> samplers; ///< one sampler per texture unit
+  std::vector<std::unique_ptr<VAO>> meshes;
+};
+
+/// the vertex attributes of the simplemat program
+struct CubeAttributes {
+  std::vector<glm::vec3> positions, normals, tangents;
+  std::vector<glm::vec2> uvs;
+  std::vector<uint> ibo;
+
+  /// appends a unit cube (36 IBO elements)
+  void addCube();
+
+  /// a VAO holding the cubes
+  std::unique_ptr<VAO> makeVAO() const;
+};
+
+void CubeAttributes::addCube()
+{
+  for (int axis = 0; axis < 3; axis++) {
+    for (int side = -1; side <= 1; side += 2) {
+      glm::vec3 normal(0), u(0), v(0);
+      normal[axis] = side;
+      u[(axis + 1) % 3] = 1;
+      v[(axis + 2) % 3] = side;
+      uint first = positions.size();
+      for (int corner = 0; corner < 4; corner++) {
+        glm::vec2 uv(corner & 1, corner >> 1);
+        positions.push_back(0.5f * normal + (uv.x - 0.5f) * u + (uv.y - 0.5f) * v);
+        normals.push_back(normal);
+        tangents.push_back(u);
+        uvs.push_back(uv);
+      }
+      ibo.insert(ibo.end(), {first, first + 1, first + 3, first, first + 3, first + 2});
+    }
+  }
+}
+
+std::unique_ptr<VAO> CubeAttributes::makeVAO() const
+{
+  std::unique_ptr<VAO> vao(new VAO(4));
+  vao->setVBO(0, positions);
+  vao->setVBO(1, uvs);
+  vao->setVBO(2, normals);
+  vao->setVBO(3, tangents);
+  vao->setIBO(ibo);
+  return vao;
+}
+
+SyntheticResources makeResources()
+{
+  SyntheticResources resources;
+  for (unsigned int k = 0; k < nbPrograms; k++) {
+    resources.programs.emplace_back(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
+  }
+  std::mt19937 random(1);
+  for (unsigned int k = 0; k < 3 * nbMaterials; k++) {
+    std::vector<GLubyte> texels(4 * 4 * 4);
+    for (auto & texel : texels) {
+      texel = random() & 0xff;
+    }
+    resources.textures.emplace_back(new Texture(GL_TEXTURE_2D));
+    resources.textures.back()->setData(Image<>(texels.data(), 4, 4, 4), true);
+  }
+  for (unsigned int unit = 0; unit < 3; unit++) {
+    resources.samplers.emplace_back(new Sampler(unit));
+    resources.samplers.back()->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  }
+  for (unsigned int k = 0; k < nbMeshes; k++) {
+    CubeAttributes cube;
+    cube.addCube();
+    resources.meshes.push_back(cube.makeVAO());
+  }
+  return resources;
+}
+
+std::vector<SyntheticObject> makeObjects(unsigned int nbObjects)
+{
+  std::mt19937 random(2);
+  std::uniform_real_distribution<float> uniform(0, 1);
+  std::vector<SyntheticObject> objects(nbObjects);
+  for (auto & object : objects) {
+    object.position = glm::vec3(sceneSize * (uniform(random) - 0.5f), sceneSize * (uniform(random) - 0.5f), 4 * uniform(random));
+    object.axis = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + 0.1f);
+    object.speed = 2 * uniform(random);
+    object.scale = 0.5f + uniform(random);
+    object.program = random() % nbPrograms;
+    object.material = random() % nbMaterials;
+    object.mesh = random() % nbMeshes;
+  }
+  return objects;
+}
+
+/// the model matrix of an object
+glm::mat4 modelWorld(const SyntheticObject & object, float time)
+{
+  return glm::scale(glm::rotate(glm::translate(glm::mat4(1), object.position), object.speed * time, object.axis), glm::vec3(object.scale));
+}
+
+/// culls, transforms and submits the objects, sorts the packets and records the command lists
+void recordFrame(const std::vector<SyntheticObject> & objects, const SyntheticResources & resources, float time, const glm::mat4 & proj, const glm::mat4 & view,
+                 RenderQueue & queue, ThreadPool & pool)
+{
+  Frustum frustum = Frustum::fromMatrix(proj * view);
+  const size_t nbSlots = std::min<size_t>(4 * (pool.size() + 1), objects.size());
+  const size_t slotSize = (objects.size() + nbSlots - 1) / nbSlots;
+  queue.clear(nbSlots);
+  pool.parallelFor(nbSlots, [&](size_t begin, size_t end) {
+    for (size_t slot = begin; slot < end; slot++) {
+      for (size_t k = slot * slotSize; k < std::min(objects.size(), (slot + 1) * slotSize); k++) {
+        const SyntheticObject & object = objects[k];
+        if (not frustum.intersects(BoundingSphere(object.position, 0.87f * object.scale))) {
+          continue;
+        }
+        DrawPacket packet;
+        packet.program = resources.programs[object.program].get();
+        packet.vao = resources.meshes[object.mesh].get();
+        for (unsigned int unit = 0; unit < 3; unit++) {
+          packet.textures[unit] = resources.textures[3 * object.material + unit].get();
+          packet.samplers[unit] = resources.samplers[unit].get();
+        }
+        packet.matrixName = "M";
+        packet.matrix = modelWorld(object, time);
+        packet.count = packet.vao->nbIndices();
+        queue.submit(packet, RenderPass::Opaque, -(view * glm::vec4(object.position, 1)).z, slot);
+      }
+    }
+  });
+  queue.sort();
+  queue.record(pool);
+}
+
+/**
+ * @brief measures the frames of scenes of increasing sizes culled and drawn by a GpuDrivenScene (the objects do not rotate)
+ * @return false if the visible instances or the drawn triangles of the last frame differ from the ones culled on the CPU
+ */
+bool benchmarkGpuDriven(unsigned int maxObjects)
+{
+  // the meshes are merged into a single VAO, the instance index being its fifth attribute
+  CubeAttributes cubes;
+  for (unsigned int k = 0; k < nbMeshes; k++) {
+    cubes.addCube();
+  }
+  std::unique_ptr<VAO> vao = cubes.makeVAO();
+  const uint cubeSize = cubes.ibo.size() / nbMeshes;
+  const BoundingSphere cubeBounds(glm::vec3(0), 0.87f);
+  Program program("shaders/indirect.v.glsl", "shaders/simplemat.f.glsl");
+  glm::mat4 proj = glm::perspective(glm::radians(60.f), 16 / 9.f, 0.1f, 2 * sceneSize);
+  std::cout << "GPU-driven culling and drawing (" << (GpuDrivenScene::drawCountSupported() ? "glMultiDrawElementsIndirectCount" : "glMultiDrawElementsIndirect, one command per mesh")
+            << "), CPU time per frame and time until the GPU is done:" << std::endl;
+  bool valid = true;
+  for (unsigned int nbObjects = 100; nbObjects <= std::max(maxObjects, 100u); nbObjects *= 10) {
+    GpuDrivenScene scene(*vao, 4);
+    for (unsigned int k = 0; k < nbMeshes; k++) {
+      scene.addMesh(k * cubeSize, cubeSize, cubeBounds);
+    }
+    const std::vector<SyntheticObject> objects = makeObjects(nbObjects);
+    for (const auto & object : objects) {
+      scene.addInstance(object.mesh, modelWorld(object, 0));
+    }
+    scene.cull(proj); // first upload
+    glFinish();
+    double cpuTime = 0, gpuTime = 0;
+    glm::mat4 view;
+    for (unsigned int frame = 0; frame < nbFrames; frame++) {
+      float time = frame / 60.f;
+      glm::vec3 eye(0.4f * sceneSize * std::cos(time), 0.4f * sceneSize * std::sin(time), 20);
+      view = glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
+      auto start = std::chrono::steady_clock::now();
+      scene.cull(proj * view);
+      program.bind();
+      program.setUniform("V", view);
+      program.setUniform("P", proj);
+      scene.draw();
+      program.unbind();
+      auto submitted = std::chrono::steady_clock::now();
+      glFinish();
+      cpuTime += std::chrono::duration<double, std::milli>(submitted - start).count();
+      gpuTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    // the last frame is checked against the CPU: the instances kept by the compute passes, then the triangles of the indirect draw
+    const Frustum frustum = Frustum::fromMatrix(proj * view);
+    const uint expected = std::count_if(objects.begin(), objects.end(), [&](const SyntheticObject & object) { return frustum.intersects(cubeBounds.transformed(modelWorld(object, 0))); });
+    const uint visible = scene.visibleCount();
+    Query primitives(GL_PRIMITIVES_GENERATED);
+    program.bind();
+    primitives.begin();
+    scene.draw();
+    primitives.end();
+    program.unbind();
+    const GLuint64 triangles = primitives.result();
+    std::cout << "  " << std::setw(7) << nbObjects << " objects : " << cpuTime / nbFrames << " ms, GPU done after " << gpuTime / nbFrames << " ms, " << visible << " visible";
+    if (visible != expected or triangles != GLuint64(expected) * cubeSize / 3) {
+      std::cout << " (FAILED: " << expected << " visible on the CPU, " << triangles << " triangles drawn instead of " << expected * cubeSize / 3 << ")";
+      valid = false;
+    }
+    std::cout << std::endl;
+  }
+  return valid;
+}
+} // namespace
+
+bool benchmarkDrawing(unsigned int nbObjects)
+{
+  GLFWwindow * window = createBenchmarkContext("drawing");
+  if (!window) {
+    std::cerr << "Could not create an OpenGL context" << std::endl;
+    return false;
+  }
+  bool valid = true;
+  std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+  {
+    SyntheticResources resources = makeResources();
+    std::vector<SyntheticObject> objects = makeObjects(nbObjects);
+    glm::mat4 proj = glm::perspective(glm::radians(60.f), 16 / 9.f, 0.1f, 2 * sceneSize);
+    RenderQueue queue;
+    queue.setDepthRange(0.1f, 2 * sceneSize);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << nbObjects << " objects, CPU time per frame (culling, transforms, packets, sort and recording) and replay time:" << std::endl;
+    unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    double singleThreadTime = 0;
+    for (unsigned int nbThreads = 1;; nbThreads = std::min(2 * nbThreads, maxThreads)) {
+      ThreadPool pool(nbThreads - 1);
+      double recordTime = 0, replayTime = 0;
+      for (unsigned int frame = 0; frame < nbFrames; frame++) {
+        float time = frame / 60.f;
+        glm::vec3 eye(0.4f * sceneSize * std::cos(time), 0.4f * sceneSize * std::sin(time), 20);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
+        auto start = std::chrono::steady_clock::now();
+        recordFrame(objects, resources, time, proj, view, queue, pool);
+        auto recorded = std::chrono::steady_clock::now();
+        for (const auto & program : resources.programs) {
+          program->bind();
+          program->setUniform("V", view);
+          program->setUniform("P", proj);
+        }
+        queue.replay();
+        glFinish();
+        recordTime += std::chrono::duration<double, std::milli>(recorded - start).count();
+        replayTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recorded).count();
+      }
+      recordTime /= nbFrames;
+      replayTime /= nbFrames;
+      if (nbThreads == 1) {
+        singleThreadTime = recordTime;
+      }
+      const RenderQueue::Statistics & stats = queue.statistics();
+      std::cout << "  " << std::setw(2) << nbThreads << " threads : " << recordTime << " ms (speedup " << singleThreadTime / recordTime << "), replay " << replayTime << " ms, "
+                << stats.nbDraws << " draws, " << stats.nbStateChanges() << " state changes" << std::endl;
+      if (nbThreads == maxThreads) {
+        break;
+      }
+    }
+    valid = benchmarkGpuDriven(10 * nbObjects);
+  }
+  destroyBenchmarkContext(window);
+  return valid;
+}
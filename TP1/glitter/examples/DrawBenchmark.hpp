@@ -0,0 +1,21 @@
+#ifndef __DRAW_BENCHMARK_H__
+#define __DRAW_BENCHMARK_H__
+
+/**
+ * @brief measures the CPU time of a frame of a synthetic scene, for increasing numbers of threads
+ * @param nbObjects the number of objects of the scene
+ *
+ * The objects (rotating cubes sharing a few programs, materials and VAOs) are culled, transformed and
+ * submitted to a RenderQueue concurrently, then sorted and recorded into command lists concurrently
+ * (see RenderQueue::record). For each number of threads, prints the time of these steps, and the time of
+ * the replay of the command lists by the thread owning the OpenGL context.
+ *
+ * Then, for scenes of 100 to 10 x @p nbObjects objects, prints the time of a frame culled and drawn by
+ * the GPU (see GpuDrivenScene), on the CPU side and until the GPU is done. The instances kept by the GPU
+ * and the triangles of the indirect draw (a GL_PRIMITIVES_GENERATED query) are checked against the CPU.
+ *
+ * @return false if there is no OpenGL context, or if the GPU-driven frame differs from the CPU one
+ */
+bool benchmarkDrawing(unsigned int nbObjects);
+
+#endif // !defined(__DRAW_BENCHMARK_H__)
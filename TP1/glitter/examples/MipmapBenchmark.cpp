@@ -0,0 +1,107 @@
+#include "MipmapBenchmark.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include "Benchmark.hpp"
+#include "ImageCache.hpp"
+#include "MipmapGenerator.hpp"
+#include "utils.hpp"
+
+namespace
+{
+const int nbRuns = 5;
+
+/// best duration (in ms) of several runs of a function
+double bestTime(const std::function<void()> & run)
+{
+  double best = 0;
+  for (int i = 0; i < nbRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    best = i == 0 ? duration : std::min(best, duration);
+  }
+  return best;
+}
+
+/// PSNR (in dB) of a mipmap chain against a reference one
+double psnr(const std::vector<Image<>> & levels, const std::vector<Image<>> & reference)
+{
+  double squaredError = 0;
+  size_t count = 0;
+  for (size_t k = 0; k < levels.size() and k < reference.size(); k++) {
+    for (size_t i = 0; i < levels[k].size(); i++) {
+      double d = double(levels[k].data[i]) - reference[k].data[i];
+      squaredError += d * d;
+    }
+    count += levels[k].size();
+  }
+  if (squaredError == 0) {
+    return INFINITY;
+  }
+  return 10 * std::log10(255. * 255. * count / squaredError);
+}
+
+/// mipmaps built by the driver (levels 1 and above), with the generation time
+std::vector<Image<>> driverMipmaps(const Image<> & image, double & time)
+{
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  GLenum format = formats[image.channels - 1];
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+  glFinish();
+  time = bestTime([]() {
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glFinish();
+  });
+  std::vector<Image<>> levels;
+  for (unsigned int k = 1; k < mipmapLevelCount(image.width, image.height); k++) {
+    levels.push_back(Image<>::allocate(std::max(1, image.width >> k), std::max(1, image.height >> k), image.channels));
+    glGetTexImage(GL_TEXTURE_2D, k, format, GL_UNSIGNED_BYTE, levels.back().data);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glDeleteTextures(1, &texture);
+  return levels;
+}
+} // namespace
+
+void benchmarkMipmaps(const std::vector<std::string> & filenames)
+{
+  GLFWwindow * window = createBenchmarkContext("mipmaps");
+  if (!window) {
+    std::cerr << "Could not create an OpenGL context, glGenerateMipmap will not be measured" << std::endl;
+  } else {
+    std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+  }
+  std::cout << std::fixed << std::setprecision(2);
+  for (const auto & filename : filenames) {
+    Image<> image = ImageCache::load(absolutename(filename));
+    if (!image.data) {
+      std::cerr << "Unable to load texture: " << filename << std::endl;
+      continue;
+    }
+    bool srgb = filename.find("_N") == std::string::npos and filename.find("nor") == std::string::npos;
+    std::cout << filename << " (" << image.width << "x" << image.height << "x" << image.channels << ", " << (srgb ? "sRGB" : "linear") << ")" << std::endl;
+
+    std::vector<Image<>> box, kaiser;
+    double boxTime = bestTime([&]() { box = generateMipmaps(image, srgb, MipmapFilter::Box); });
+    double kaiserTime = bestTime([&]() { kaiser = generateMipmaps(image, srgb, MipmapFilter::Kaiser); });
+    std::cout << "  CPU box          : " << boxTime << " ms (reference)" << std::endl;
+    std::cout << "  CPU Kaiser       : " << kaiserTime << " ms, PSNR " << psnr(kaiser, box) << " dB" << std::endl;
+    if (window) {
+      double driverTime;
+      std::vector<Image<>> driver = driverMipmaps(image, driverTime);
+      std::cout << "  glGenerateMipmap : " << driverTime << " ms, PSNR " << psnr(driver, box) << " dB" << std::endl;
+    }
+  }
+  destroyBenchmarkContext(window);
+}
@@ -0,0 +1,17 @@
+#ifndef __MIPMAP_BENCHMARK_H__
+#define __MIPMAP_BENCHMARK_H__
+#include <string>
+#include <vector>
+
+/**
+ * @brief compares the mipmaps built on the CPU (see generateMipmaps()) with the ones of glGenerateMipmap
+ * @param filenames the images to be processed (relative to RESOURCE_DIR)
+ *
+ * For each image, prints the generation time of each method (the best of several runs), and the PSNR of
+ * its levels against the gamma-correct box filtered levels (the exact average of the texels, in linear space).
+ * Images whose name denotes a normal map (containing "_N" or "nor") are processed as linear data, the other
+ * ones as sRGB colors.
+ */
+void benchmarkMipmaps(const std::vector<std::string> & filenames);
+
+#endif // !defined(__MIPMAP_BENCHMARK_H__)
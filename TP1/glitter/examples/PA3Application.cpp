@@ -9,8 +9,12 @@
 #include "utils.hpp"
 
 PA3Application::PA3Application(int windowWidth, int windowHeight)
-    : Application(windowWidth, windowHeight, "Application for PA3"), m_program("shaders/simple3d.v.glsl", "shaders/simple3d.f.glsl"), m_view(1), m_currentTime(0), m_deltaTime(0),
-      m_renderMode(GL_TRIANGLES)
+    : Application(windowWidth, windowHeight, "Application for PA3"), m_program("shaders/instanced3d.v.glsl", "shaders/simple3d.f.glsl"),
+      m_patchProgram({{GL_VERTEX_SHADER, "shaders/paramsurf.v.glsl"},
+                      {GL_TESS_CONTROL_SHADER, "shaders/paramsurf.tc.glsl"},
+                      {GL_TESS_EVALUATION_SHADER, "shaders/paramsurf.te.glsl"},
+                      {GL_FRAGMENT_SHADER, "shaders/simple3d.f.glsl"}}),
+      m_gpuTessellation(false), m_view(1), m_currentTime(0), m_deltaTime(0), m_renderMode(GL_FILL)
 {
   GLFWwindow * window = glfwGetCurrentContext();
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
@@ -19,46 +23,34 @@ PA3Application::PA3Application(int windowWidth, int windowHeight)
   makeASphere(40, 40);
   makeATorus(40, 40, 0.25);
   makeAShell(40, 40);
+  for (uint k = 0; k < m_vaos.size(); k++) {
+    m_transforms.add(m_vaos[k]->modelWorld());
+    m_vaos[k]->setInstance(m_instances, k);
+    m_patches[k]->setInstance(m_instances, k);
+  }
+  m_patchProgram.bind();
+  m_patchProgram.setUniform("pixelsPerEdge", 8.f);
+  m_patchProgram.unbind();
 }
 
 
-std::shared_ptr<VAO> PA3Application::makeParamSurf(DiscreteLinRange rgPhi, DiscreteLinRange rgTheta, const std::function<glm::vec3(float, float)> & posFunc, bool isCyclicInPhi, bool isCyclicInTheta)
-{
-  auto getIndex = [](uint i, uint j, uint col, uint row) { return (i % row) * col + (j % col); };
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> colors;
-  std::vector<uint> ibo;
-
-  float phi;
-  float theta;
-  for(uint k_phi = 0; k_phi < rgPhi.nbVals; k_phi++)
-  {
-      for(uint k_theta = 0; k_theta < rgTheta.nbVals; k_theta++)
-      {
-          phi = rgPhi.value(k_phi);
-          theta = rgTheta.value(k_theta);
-          positions.push_back(posFunc(phi, theta));
-          colors.push_back({1, 0, 1});
-
-          if( (k_phi <= rgPhi.nbVals - 2 || isCyclicInPhi) && (k_theta <= rgTheta.nbVals - 2 || isCyclicInTheta) )
-          {
-              //Traingle 1
-              ibo.push_back(getIndex(k_phi, k_theta, rgTheta.nbVals, rgPhi.nbVals));
-              ibo.push_back(getIndex(k_phi + 1, k_theta, rgTheta.nbVals, rgPhi.nbVals));
-              ibo.push_back(getIndex(k_phi, k_theta + 1, rgTheta.nbVals, rgPhi.nbVals));
-
-              //Traingle 2
-              ibo.push_back(getIndex(k_phi, k_theta + 1, rgTheta.nbVals, rgPhi.nbVals));
-              ibo.push_back(getIndex(k_phi + 1, k_theta, rgTheta.nbVals, rgPhi.nbVals));
-              ibo.push_back(getIndex(k_phi + 1, k_theta + 1, rgTheta.nbVals, rgPhi.nbVals));
-          }
-      }
-  }
+namespace
+{
+/// the surfaces are tessellated as triangle strips
+TessellationOptions stripOptions()
+{
+  TessellationOptions options;
+  options.strips = true;
+  return options;
+}
+} // namespace
 
+std::shared_ptr<VAO> PA3Application::makeParamSurf(const ParamSurfaceMesh & mesh)
+{
   std::shared_ptr<VAO> vao(new VAO(2));
-  vao->setVBO(0, positions);
-  vao->setVBO(1, colors);
-  vao->setIBO(ibo);
+  vao->setVBO(0, mesh.positions);
+  vao->setVBO(1, std::vector<glm::vec3>(mesh.positions.size(), glm::vec3(1, 0, 1)));
+  vao->setIBO(mesh.indices);
   return vao;
 }
 
@@ -67,10 +59,12 @@ void PA3Application::makeASphere(unsigned int nbPhi, unsigned int nbTheta)
   auto posFunc = [](float phi, float theta) { return glm::vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), 1 - cos(theta)); };
 
   const float pi = glm::pi<float>();
-  std::shared_ptr<VAO> vao = makeParamSurf(DiscreteLinRange(nbPhi, 0, 2 * pi), DiscreteLinRange(nbTheta, 0, pi), posFunc, true, false);
+  const DiscreteLinRange rgPhi(nbPhi, 0, 2 * pi), rgTheta(nbTheta, 0, pi);
+  ParamSurfaceMesh mesh = tessellate(rgPhi, rgTheta, posFunc, true, false, stripOptions());
   glm::mat4 mw(1);
   mw = glm::scale(mw, {0.2, 0.2, 0.2});
-  m_vaos.push_back(RenderObject::createInstance(vao, mw));
+  m_vaos.push_back(RenderObject::createInstance(makeParamSurf(mesh), mw, mesh.mode));
+  m_patches.push_back(RenderObject::createInstance(makeParamPatches(rgPhi, rgTheta, posFunc), mw, GL_PATCHES));
 }
 
 void PA3Application::makeATorus(unsigned int nbPhi, unsigned int nbTheta, float smallRadius)
@@ -79,12 +73,17 @@ void PA3Application::makeATorus(unsigned int nbPhi, unsigned int nbTheta, float
                                                                (4 * smallRadius + smallRadius * cos(phi)) * sin(theta),
                                                                smallRadius * sin(phi)); };
   const float pi = glm::pi<float>();
-  std::shared_ptr<VAO> vao = makeParamSurf(DiscreteLinRange(nbPhi, 0, 2 * pi), DiscreteLinRange(nbTheta, 0, 2 * pi), posFunc, true, false);
+  const DiscreteLinRange rgPhi(nbPhi, 0, 2 * pi), rgTheta(nbTheta, 0, 2 * pi);
+  ParamSurfaceMesh mesh = tessellate(rgPhi, rgTheta, posFunc, true, false, stripOptions());
   glm::mat4 mw(1);
   mw = glm::translate(mw, {0.5, 0, 0});
   mw = glm::rotate(mw, 3 * glm::pi<float>() / 4, {1, 0, 1});
   mw = glm::scale(mw, {0.2, 0.2, 0.2});
-  m_vaos.push_back(RenderObject::createInstance(vao, mw));
+  m_vaos.push_back(RenderObject::createInstance(makeParamSurf(mesh), mw, mesh.mode));
+  m_patches.push_back(RenderObject::createInstance(makeParamPatches(rgPhi, rgTheta, posFunc), mw, GL_PATCHES));
+  m_patchProgram.bind();
+  m_patchProgram.setUniform("smallRadius", smallRadius);
+  m_patchProgram.unbind();
 }
 
 void PA3Application::makeAShell(unsigned int nbPhi, unsigned int nbTheta)
@@ -92,12 +91,14 @@ void PA3Application::makeAShell(unsigned int nbPhi, unsigned int nbTheta)
   auto posFunc = [&](float theta, float phi) { return glm::vec3(-phi * sin(theta) * sin(theta) * sin(phi), phi * sin(theta) * sin(theta) * cos(phi), phi * sin(theta) * cos(theta)); };
 
   const float pi = glm::pi<float>();
-  std::shared_ptr<VAO> vao = makeParamSurf(DiscreteLinRange(nbPhi, 0, pi), DiscreteLinRange(nbTheta, -pi / 4, 5 * pi / 2), posFunc, false, false);
+  const DiscreteLinRange rgPhi(nbPhi, 0, pi), rgTheta(nbTheta, -pi / 4, 5 * pi / 2);
+  ParamSurfaceMesh mesh = tessellate(rgPhi, rgTheta, posFunc, false, false, stripOptions());
   glm::mat4 mw(1);
   mw = glm::translate(mw, {-0.5, 0, 0});
   mw = glm::rotate(mw, 3 * glm::pi<float>() / 4, {1, 0, 1});
   mw = glm::scale(mw, {0.05, 0.05, 0.05});
-  m_vaos.push_back(RenderObject::createInstance(vao, mw));
+  m_vaos.push_back(RenderObject::createInstance(makeParamSurf(mesh), mw, mesh.mode));
+  m_patches.push_back(RenderObject::createInstance(makeParamPatches(rgPhi, rgTheta, posFunc), mw, GL_PATCHES));
 }
 
 void PA3Application::initGLState() const
@@ -109,16 +110,32 @@ void PA3Application::initGLState() const
 
   glEnable(GL_DEPTH_TEST);
 
+  // the surfaces are triangle strips
+  glEnable(GL_PRIMITIVE_RESTART);
+  glPrimitiveRestartIndex(primitiveRestartIndex);
+  // the patches tessellated on the GPU are quads
+  glPatchParameteri(GL_PATCH_VERTICES, 4);
 }
 
 void PA3Application::renderFrame()
 {
   std::cerr << __PRETTY_FUNCTION__ << ": You must complete the implementation here (look at the documentation in the header)" << std::endl;
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  m_transforms.upload(m_instances, m_proj, m_view);
+  glPolygonMode(GL_FRONT_AND_BACK, m_renderMode);
+  if (m_gpuTessellation) {
+    // the surface evaluated by the tessellation evaluation shader is the index of the patch grid
+    m_patchProgram.bind();
+    for (uint k = 0; k < m_patches.size(); k++) {
+      m_patchProgram.setUniform("surface", int(k));
+      m_patches[k]->draw();
+    }
+    m_patchProgram.unbind();
+    return;
+  }
   m_program.bind();
   for (const auto & vao : m_vaos) {
-    vao->updateProgram(m_program, m_proj, m_view);
-    vao->draw(m_renderMode);
+    vao->draw();
   }
   m_program.unbind();
 }
@@ -128,9 +145,11 @@ void PA3Application::update()
   float prevTime = m_currentTime;
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
-  m_program.bind();
-  m_program.setUniform("time", m_currentTime);
-  m_program.unbind();
+  for (Program * program : {&m_program, &m_patchProgram}) {
+    program->bind();
+    program->setUniform("time", m_currentTime);
+    program->unbind();
+  }
   continuousKey();
 }
 
@@ -172,6 +191,9 @@ void PA3Application::resize(GLFWwindow * window, int framebufferWidth, int frame
     app.m_proj = glm::ortho(-1 / aspect, 1 / aspect, -1.f, 1.f);
   }
   glViewport(0, 0, framebufferWidth, framebufferHeight);
+  app.m_patchProgram.bind();
+  app.m_patchProgram.setUniform("viewportSize", glm::vec2(framebufferWidth, framebufferHeight));
+  app.m_patchProgram.unbind();
 }
 
 void PA3Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/, int action, int /*mods*/)
@@ -180,12 +202,17 @@ void PA3Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
   switch (key) {
   case 'L':
     if (action == GLFW_PRESS) {
-      app.m_renderMode = (app.m_renderMode == GL_LINES) ? GL_TRIANGLES : GL_LINES;
+      app.m_renderMode = (app.m_renderMode == GL_LINE) ? GL_FILL : GL_LINE;
     }
     break;
   case 'R':
     app.m_view = glm::mat4(1);
     break;
+  case 'T':
+    if (action == GLFW_PRESS) {
+      app.m_gpuTessellation = not app.m_gpuTessellation;
+    }
+    break;
   }
 }
 
@@ -205,24 +232,27 @@ void PA3Application::usage(std::string & shortDescritpion, std::string & synopsi
                 "     L                toggle between solid and wireframe rendering\n"
                 "     <up> / <down>    rotate the view around the horizontal axis\n"
                 "     <left> / <right> rotate the view around the vertical axis\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     T                toggle between CPU and GPU (screen-space adaptive) tessellation\n";
 }
 
-PA3Application::RenderObject::RenderObject(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld) : m_vao(vao), m_mw(modelWorld) {}
+PA3Application::RenderObject::RenderObject(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld, GLenum mode) : m_vao(vao), m_mw(modelWorld), m_mode(mode) {}
 
-std::shared_ptr<PA3Application::RenderObject> PA3Application::RenderObject::createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelView)
+std::shared_ptr<PA3Application::RenderObject> PA3Application::RenderObject::createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelView, GLenum mode)
 {
-  return std::shared_ptr<RenderObject>(new RenderObject(vao, modelView));
+  return std::shared_ptr<RenderObject>(new RenderObject(vao, modelView, mode));
 }
 
-void PA3Application::RenderObject::draw(GLenum mode) const
+void PA3Application::RenderObject::draw() const
 {
   if (m_vao) {
-    m_vao->draw(mode);
+    m_vao->drawInstanced(m_mode, 1);
   }
 }
 
-void PA3Application::RenderObject::updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view) const
+void PA3Application::RenderObject::setInstance(const Buffer & instances, uint index) const
 {
-  prog.setUniform("MVP", proj * view * m_mw);
+  if (m_vao) {
+    m_vao->setInstanceMatrices(2, instances, 4, 4, index * sizeof(glm::mat4));
+  }
 }
@@ -3,6 +3,8 @@
 #include <memory>
 #include <functional>
 #include "Application.hpp"
+#include "ParamSurface.hpp"
+#include "TransformBatch.hpp"
 #include "glApi.hpp"
 
 // forward declarations
@@ -25,61 +27,59 @@ private:
      * @brief creates an instance from a vao and modelView matrix
      * @param vao  the VAO to be instanciated
      * @param modelWorld the matrix transform between the object (a.k.a model) space and the camera (a.k.a view) space
+     * @param mode the primitive type of the IBO of the VAO
      * @return the created InstancedVAO as a smart pointer
      */
-    static std::shared_ptr<RenderObject> createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld);
+    static std::shared_ptr<RenderObject> createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld, GLenum mode = GL_TRIANGLES);
 
     /**
      * @brief Draw this VAO
      */
-    void draw(GLenum mode = GL_TRIANGLES) const;
+    void draw() const;
 
     /**
-     * @brief update the program MVP uniform variable
-     * @param prog the target program
-     * @param proj the projection matrix
-     * @param view the worldView matrix
+     * @brief sets the source of the MVP matrix of this object
+     * @param instances the buffer filled by TransformBatch::upload
+     * @param index the index of this object in the TransformBatch
      */
-    void updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view = glm::mat4(1)) const;
+    void setInstance(const Buffer & instances, uint index) const;
+
+    /// the modelWorld matrix
+    const glm::mat4 & modelWorld() const { return m_mw; }
 
   private:
-    RenderObject(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelView);
+    RenderObject(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelView, GLenum mode);
 
   private:
     std::shared_ptr<VAO> m_vao; ///< VAO
     glm::mat4 m_mw;             ///< modelWorld matrix
+    GLenum m_mode;              ///< primitive type of the IBO
   };
 
 private:
-  /// a simple struct for discrete linear range of the form {minVal, minVal+delta,...,minVal+length}
-  struct DiscreteLinRange {
-    uint nbVals;  ///< the number of values in the range
-    float minVal; ///< the minimum value of the range
-    float length; ///< the lengh (max -min) of the range
-
-    /// Constructor
-    DiscreteLinRange(uint nbVals, float minVal, float length) : nbVals(nbVals), minVal(minVal), length(length) {}
-
-    /// Returns the k^{th} value of the range
-    float value(uint k) { return minVal + k * length / (nbVals - 1); }
-  };
-
   /**
-   * @brief Creates a VAO
-   * @param rgPhi the discrete range of values for phi
-   * @param rgTheta the discrete range of values for theta
-   * @param posFunc the parametric function for the 3d position
-   * @param isCyclicInPhi cyclic behavior in phi
-   * @param isCyclicInTheta cyclic behavior in theta
+   * @brief Creates the VAO of a tessellated parametric surface
+   * @param mesh the tessellated surface (see tessellate())
    * @return a smart pointer to the created VAO
    *
    * The VAO is composed of two VBOs corresponding to the
    * geometric 3d position and the color of the vertices.
+   */
+  static std::shared_ptr<VAO> makeParamSurf(const ParamSurfaceMesh & mesh);
+
+  /**
+   * @brief Creates the VAO of the coarse patch grid of a parametric surface, tessellated on the GPU
+   * @param rgPhi the discrete range of values for phi (only its bounds are used)
+   * @param rgTheta the discrete range of values for theta (only its bounds are used)
+   * @param posFunc the parametric function for the 3d position
+   * @return a smart pointer to the created VAO (drawn as GL_PATCHES)
    *
-   * @note PA3 this function is currently incomplete. You need to
-   * complete the creation of the VAO (VBOs and IBO).
+   * The VAO is composed of two VBOs corresponding to the parameters (phi, theta) of the
+   * vertices of the grid and to their 3d position. The positions of the tessellated
+   * vertices are computed by the tessellation evaluation shader (see paramsurf.te.glsl),
+   * the positions of the grid only drive the tessellation levels.
    */
-  static std::shared_ptr<VAO> makeParamSurf(DiscreteLinRange rgPhi, DiscreteLinRange rgTheta, const std::function<glm::vec3(float, float)> & posFunc, bool isCyclicInPhi, bool isCyclicInTheta);
+  template <typename P> static std::shared_ptr<VAO> makeParamPatches(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & posFunc);
 
   /**
    * @brief creates a VAO corresponding to a 3d sphere
@@ -149,13 +149,42 @@ private:
   void rotateView(const glm::vec3 & axis, float angleFactor);
 
 private:
-  std::vector<std::shared_ptr<RenderObject>> m_vaos; ///< List of instanced VAOs (VAO + modelView matrix)
-  Program m_program;                                 ///< A GLSL progam
-  glm::mat4 m_proj;                                  ///< Projection matrix
-  glm::mat4 m_view;                                  ///< worldView matrix
-  float m_currentTime;                               ///< elapsed time since first frame
-  float m_deltaTime;                                 ///< elapsed time since last frame
-  GLenum m_renderMode;                               ///< GL_LINES or GL_TRIANGLES
+  std::vector<std::shared_ptr<RenderObject>> m_vaos;    ///< List of instanced VAOs (VAO + modelView matrix)
+  std::vector<std::shared_ptr<RenderObject>> m_patches; ///< Coarse patch grids of the same surfaces, tessellated on the GPU
+  TransformBatch m_transforms;                          ///< modelWorld matrices of the instanced VAOs
+  Buffer m_instances;                                   ///< MVP matrices of the instanced VAOs
+  Program m_program;                                    ///< A GLSL progam
+  Program m_patchProgram;                               ///< A GLSL program with tessellation stages (for m_patches)
+  bool m_gpuTessellation;                               ///< draws m_patches instead of m_vaos
+  glm::mat4 m_proj;                                     ///< Projection matrix
+  glm::mat4 m_view;                                     ///< worldView matrix
+  float m_currentTime;                                  ///< elapsed time since first frame
+  float m_deltaTime;                                    ///< elapsed time since last frame
+  GLenum m_renderMode;                                  ///< polygon mode: GL_LINE or GL_FILL
 };
 
+/*
+ * Definition of method templates
+ */
+template <typename P> std::shared_ptr<VAO> PA3Application::makeParamPatches(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & posFunc)
+{
+  // the detail comes from the tessellation, a few patches per parameter keep the levels close to the curvature
+  const unsigned int nbGridVals = 9;
+  const DiscreteLinRange gridPhi(nbGridVals, rgPhi.minVal, rgPhi.length), gridTheta(nbGridVals, rgTheta.minVal, rgTheta.length);
+  std::vector<glm::vec2> parameters;
+  parameters.reserve(nbGridVals * nbGridVals);
+  for (unsigned int kPhi = 0; kPhi < nbGridVals; kPhi++) {
+    for (unsigned int kTheta = 0; kTheta < nbGridVals; kTheta++) {
+      parameters.push_back(glm::vec2(gridPhi.value(kPhi), gridTheta.value(kTheta)));
+    }
+  }
+  std::vector<unsigned int> ibo;
+  tessellatePatches(nbGridVals, nbGridVals, ibo);
+  std::shared_ptr<VAO> vao(new VAO(2));
+  vao->setVBO(0, parameters);
+  vao->setVBO(1, tessellate(gridPhi, gridTheta, posFunc, false, false).positions);
+  vao->setIBO(ibo);
+  return vao;
+}
+
 #endif // !defined(__PA3_APPLICATION_H__)
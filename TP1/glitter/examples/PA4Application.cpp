@@ -1,12 +1,13 @@
 #include "PA4Application.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include "ObjLoader.hpp"
 #include "utils.hpp"
 
-PA4Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld)
+PA4Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld), m_lod(0)
 {
   if (part >= 3) {
     m_colormap = std::unique_ptr<Sampler>(new Sampler(0));
@@ -19,7 +20,7 @@ std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::crea
   std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
   std::vector<GLubyte> checkerboard = makeCheckerBoard();
 
-  texture->setData(Image<>(checkerboard.data(), 20, 20, 4), true);
+  texture->setData(Image<>(checkerboard.data(), 20, 20, 4), true, true);
   if (part == 1) {
     texture->bind();
     // remove the need for mipmaps
@@ -34,6 +35,7 @@ std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::crea
   std::shared_ptr<Program> program(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl"));
   program->bind();
   program->setUniform("diffuseColor", glm::vec3(1));
+  program->setUniform("colorSampler", 0);
   program->unbind();
 
   std::shared_ptr<VAO> vao(new VAO(2));
@@ -66,23 +68,40 @@ std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::crea
   vao->setIBO(ibo);
 
   object->m_parts.emplace_back(vao, program, texture);
+  object->m_bounds = BoundingSphere::fromPoints(vextexPositions);
+  object->m_partBounds.push_back(BoundingBox::fromPoints(vextexPositions).transformed(modelWorld));
 
   return object;
 }
 
-void PA4Application::RenderObject::draw()
+void PA4Application::RenderObject::submit(RenderQueue & queue, const glm::mat4 & proj, const glm::mat4 & view) const
 {
-  if (m_colormap) {
-    m_colormap->bind();
-  }
-  for (auto & part : m_parts) {
-    part.draw(m_colormap.get());
-  }
-  if (m_colormap) {
-    m_colormap->unbind();
+  glm::mat4 mvp = proj * view * m_mw;
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (m_partsDrawn[k]) {
+      float depth = -(view * glm::vec4(m_partBounds[k].center(), 1)).z;
+      m_parts[k].submit(queue, m_colormap.get(), m_lod, mvp, depth);
+    }
   }
 }
 
+BoundingSphere PA4Application::RenderObject::worldBounds() const
+{
+  return m_bounds.transformed(m_mw);
+}
+
+unsigned int PA4Application::RenderObject::nbParts() const
+{
+  return m_parts.size();
+}
+
+unsigned int PA4Application::RenderObject::cull(const Frustum & frustum)
+{
+  m_partsDrawn.resize(m_partBounds.size());
+  frustum.intersects(m_partBounds.data(), m_partBounds.size(), m_partsDrawn.data());
+  return std::count(m_partsDrawn.begin(), m_partsDrawn.end(), 1);
+}
+
 std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
@@ -114,11 +133,12 @@ std::vector<GLubyte> PA4Application::RenderObject::makeCheckerBoard()
 
 void PA4Application::RenderObject::loadWavefront(const std::string & objname)
 {
-  ObjLoader objLoader(objname);
+  ObjLoader::Options options;
+  options.nbLODs = 4;
+  ObjLoader objLoader(objname, options);
   const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vextexPositions = objLoader.vertexPositions();
+  const std::vector<glm::vec3> & vextexPositions = objLoader.vertexPositions();
   const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
-  const std::vector<glm::vec4> & vertexColors = objLoader.vertexColors();
   // set up the VBOs of the master VAO
   std::shared_ptr<VAO> vao(new VAO(2));
   vao->setVBO(0, vextexPositions);
@@ -131,17 +151,21 @@ void PA4Application::RenderObject::loadWavefront(const std::string & objname)
     }
     std::shared_ptr<VAO> vaoSlave;
     vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
+    vaoSlave->setIBO(objLoader.lodIBO(k)); // the ranges of all the levels of detail
     std::shared_ptr<Program> program(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl"));
     const SimpleMaterial & material = materials[k];
     program->bind();
     program->setUniform("diffuseColor", material.diffuse);
     program->unbind();
+    m_colormap->attachToProgram(*program, "colorSampler", Sampler::BindUnbind);
     Image<> colorMap = objLoader.image(material.diffuseTexName);
     std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
     texture->setData(colorMap);
-    m_parts.push_back(RenderObjectPart(vaoSlave, program, texture));
+    m_parts.push_back(RenderObjectPart(vaoSlave, program, texture, objLoader.lods(k)));
+    m_partBounds.push_back(objLoader.partBoundingBox(k).transformed(m_mw));
   }
+  objLoader.release(); // the geometry now lives on the GPU only
+  m_bounds = objLoader.boundingSphere();
   m_colormap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   m_colormap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   m_colormap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -150,7 +174,8 @@ void PA4Application::RenderObject::loadWavefront(const std::string & objname)
 
 unsigned int PA4Application::part;
 
-PA4Application::PA4Application(int windowWidth, int windowHeight) : Application(windowWidth, windowHeight), m_currentTime(0), m_deltaTime(0)
+PA4Application::PA4Application(int windowWidth, int windowHeight)
+    : Application(windowWidth, windowHeight), m_currentTime(0), m_deltaTime(0), m_nbDrawnParts(0), m_nbCulledParts(0), m_lastReportTime(0)
 {
   GLFWwindow * window = glfwGetCurrentContext();
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
@@ -171,6 +196,11 @@ PA4Application::PA4Application(int windowWidth, int windowHeight) : Application(
     mw = glm::translate(mw, {0, -3, 0});
     m_objects.push_back(RenderObject::createWavefrontInstance("meshes/capsule.obj", mw));
   }
+  // the objects do not move, hence their bounds are computed once
+  for (auto & object : m_objects) {
+    m_objectBounds.push_back(object->worldBounds());
+  }
+  m_objectsDrawn.resize(m_objects.size());
 }
 
 void PA4Application::setCallbacks()
@@ -196,9 +226,14 @@ void PA4Application::renderFrame()
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
   glClear(GL_DEPTH_BUFFER_BIT);
-  for (auto & object : m_objects) {
-    object->draw();
+  m_renderQueue.clear();
+  for (size_t k = 0; k < m_objects.size(); k++) {
+    if (m_objectsDrawn[k]) {
+      m_objects[k]->submit(m_renderQueue, m_proj, m_view);
+    }
   }
+  m_renderQueue.sort();
+  m_renderQueue.execute();
 }
 
 void PA4Application::update()
@@ -207,16 +242,33 @@ void PA4Application::update()
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
   continuousKey();
-  for (auto & object : m_objects) {
-    object->update(m_proj, m_view);
+  // whole objects are culled first (all at once), then the parts of the remaining ones
+  Frustum frustum = Frustum::fromMatrix(m_proj * m_view);
+  frustum.intersects(m_objectBounds.data(), m_objectBounds.size(), m_objectsDrawn.data());
+  for (size_t k = 0; k < m_objects.size(); k++) {
+    unsigned int nbDrawn = m_objectsDrawn[k] ? m_objects[k]->cull(frustum) : 0;
+    m_nbDrawnParts += nbDrawn;
+    m_nbCulledParts += m_objects[k]->nbParts() - nbDrawn;
+    if (nbDrawn > 0) {
+      m_objects[k]->update(m_proj, m_view);
+    } else {
+      m_objectsDrawn[k] = 0;
+    }
+  }
+  if (m_currentTime - m_lastReportTime >= 1) {
+    std::cout << "Parts : " << m_nbDrawnParts << " drawn, " << m_nbCulledParts << " culled" << std::endl;
+    m_nbDrawnParts = m_nbCulledParts = 0;
+    m_lastReportTime = m_currentTime;
   }
 }
 
 void PA4Application::RenderObject::update(const glm::mat4 & proj, const glm::mat4 & view)
 {
-  for (auto & part : m_parts) {
-    part.update(proj * view * m_mw);
+  unsigned int nbLevels = 0;
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    nbLevels = std::max(nbLevels, m_parts[k].nbLODs());
   }
+  m_lod = selectLevelOfDetail(m_bounds.transformed(m_mw).projectedSize(proj, view), m_lod, nbLevels);
 }
 
 void PA4Application::computeView(bool reset)
@@ -253,7 +305,10 @@ void PA4Application::resize(GLFWwindow * window, int framebufferWidth, int frame
 {
   PA4Application & app = *static_cast<PA4Application *>(glfwGetWindowUserPointer(window));
   float aspect = framebufferWidth / float(framebufferHeight);
-  app.m_proj = glm::perspective(120.f, aspect, 0.1f, 100.f);
+  const float near = 0.1f;
+  const float far = 100.f;
+  app.m_proj = glm::perspective(120.f, aspect, near, far);
+  app.m_renderQueue.setDepthRange(near, far);
   glViewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
@@ -267,27 +322,32 @@ void PA4Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
   }
 }
 
-PA4Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture) : m_vao(vao), m_program(program), m_texture(texture) {}
+PA4Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, const std::vector<LevelOfDetail> & lods)
+    : m_lods(lods), m_vao(vao), m_program(program), m_texture(texture)
+{
+}
 
-void PA4Application::RenderObjectPart::draw(Sampler * colormap)
+unsigned int PA4Application::RenderObjectPart::nbLODs() const
 {
-  m_program->bind();
-  if (colormap) {
-    colormap->attachTexture(*m_texture);
-    colormap->attachToProgram(*m_program, "colorSampler", Sampler::DoNotBind);
-  } else {
-    const int unit = 0;
-    glActiveTexture(GL_TEXTURE0 + unit);
-    m_texture->bind();
-    m_program->setUniform("colorSampler", unit);
-  }
-  m_vao->draw();
-  m_program->unbind();
+  return m_lods.size();
 }
 
-void PA4Application::RenderObjectPart::update(const glm::mat4 & mvp)
+void PA4Application::RenderObjectPart::submit(RenderQueue & queue, const Sampler * colormap, unsigned int lod, const glm::mat4 & mvp, float depth) const
 {
-  m_program->bind();
-  m_program->setUniform("MVP", mvp);
-  m_program->unbind();
+  // the texture unit 0 is used with or without sampler (the colorSampler uniform is set at load time)
+  DrawPacket packet;
+  packet.program = m_program.get();
+  packet.vao = m_vao.get();
+  packet.textures[0] = m_texture.get();
+  packet.samplers[0] = colormap;
+  packet.matrixName = "MVP";
+  packet.matrix = mvp;
+  if (m_lods.empty()) {
+    packet.count = m_vao->nbIndices();
+  } else {
+    const LevelOfDetail & range = m_lods[std::min<size_t>(lod, m_lods.size() - 1)];
+    packet.offset = range.offset;
+    packet.count = range.count;
+  }
+  queue.submit(packet, RenderPass::Opaque, depth);
 }
@@ -3,6 +3,9 @@
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "Bounds.hpp"
+#include "MeshSimplifier.hpp"
+#include "RenderQueue.hpp"
 #include "glApi.hpp"
 
 class PA4Application : public Application {
@@ -29,11 +32,22 @@ private:
     RenderObjectPart(const RenderObjectPart &) = delete;
     RenderObjectPart(RenderObjectPart &&) = default;
 
-    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture);
-    void draw(Sampler * colormap);
-    void update(const glm::mat4 & mvp);
+    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, const std::vector<LevelOfDetail> & lods = std::vector<LevelOfDetail>());
+    /**
+     * @brief adds the draw call of this part to a render queue
+     * @param queue the render queue
+     * @param colormap the sampler of the texture (null if none)
+     * @param lod the level of detail to be drawn
+     * @param mvp the modelViewProjection matrix
+     * @param depth the distance between the camera and the part (in view space)
+     */
+    void submit(RenderQueue & queue, const Sampler * colormap, unsigned int lod, const glm::mat4 & mvp, float depth) const;
+
+    /// number of levels of detail available for this part
+    unsigned int nbLODs() const;
 
   private:
+    std::vector<LevelOfDetail> m_lods; ///< IBO ranges of the levels of detail (the whole IBO is drawn if empty)
     std::shared_ptr<VAO> m_vao;
     std::shared_ptr<Program> m_program;
     std::shared_ptr<Texture> m_texture;
@@ -59,9 +73,28 @@ private:
     static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld);
 
     /**
-     * @brief Draw this RenderObject
+     * @brief adds the draw calls of the parts of this RenderObject which survived the last culling to a render queue
+     * @param queue the render queue
+     * @param proj the projection matrix
+     * @param view the worldView matrix
+     */
+    void submit(RenderQueue & queue, const glm::mat4 & proj, const glm::mat4 & view) const;
+
+    /**
+     * @brief bounding sphere of this RenderObject
+     * @return a sphere enclosing the object (in world space)
      */
-    void draw();
+    BoundingSphere worldBounds() const;
+
+    /**
+     * @brief tests the parts of this RenderObject against the view frustum
+     * @param frustum the view frustum (in world space)
+     * @return the number of parts to be drawn
+     */
+    unsigned int cull(const Frustum & frustum);
+
+    /// number of parts of this RenderObject
+    unsigned int nbParts() const;
 
     /**
      * @brief update the program MVP uniform variable
@@ -71,6 +104,11 @@ private:
      */
     void updateProgram(Program & prog) const;
 
+    /**
+     * @brief select the level of detail
+     * @param proj the projection matrix
+     * @param view the worldView matrix
+     */
     void update(const glm::mat4 & proj, const glm::mat4 & view);
 
   private:
@@ -81,17 +119,27 @@ private:
   private:
     glm::mat4 m_mw; ///< modelWorld matrix
     std::vector<RenderObjectPart> m_parts;
+    BoundingSphere m_bounds;                 ///< bounding sphere (in object space)
+    std::vector<BoundingBox> m_partBounds;   ///< bounding boxes of the parts (in world space)
+    std::vector<unsigned char> m_partsDrawn; ///< 1 for the parts which survived the last culling
+    unsigned int m_lod;                      ///< level of detail currently drawn
     std::unique_ptr<Sampler> m_colormap;
   };
 
 private:
   std::vector<std::unique_ptr<RenderObject>> m_objects; ///< render objects
+  RenderQueue m_renderQueue;                            ///< draw calls of the current frame
   glm::mat4 m_proj;                                     ///< Projection matrix
   glm::mat4 m_view;                                     ///< worldView matrix
   float m_eyePhi;                                       ///< Camera position longitude angle
   float m_eyeTheta;                                     ///< Camera position latitude angle
   float m_currentTime;                                  ///< elapsed time since first frame
   float m_deltaTime;                                    ///< elapsed time since last frame
+  std::vector<BoundingSphere> m_objectBounds;           ///< bounding spheres of the render objects (in world space)
+  std::vector<unsigned char> m_objectsDrawn;            ///< 1 for the render objects which survived the frustum culling
+  unsigned int m_nbDrawnParts;                          ///< parts drawn since the last culling report
+  unsigned int m_nbCulledParts;                         ///< parts culled since the last culling report
+  float m_lastReportTime;                               ///< time of the last culling report
 };
 
 #endif // !defined(__PA4_APPLICATION_H__)
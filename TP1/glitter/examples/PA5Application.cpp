@@ -2,48 +2,86 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "PA5Application.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <random>
+#include "ImageCache.hpp"
 #include "ObjLoader.hpp"
-#include "stb_image.h"
+#include "TextureStreamer.hpp"
+#include "ThreadPool.hpp"
 #include "utils.hpp"
 
-PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld)
+namespace
 {
-  m_diffusemap = std::unique_ptr<Sampler>(new Sampler(0));
-  m_normalmap = std::unique_ptr<Sampler>(new Sampler(1));
-  m_specularmap = std::unique_ptr<Sampler>(new Sampler(2));
+/// largest occluder extracted from a wavefront object (the parts with the smallest triangles are left out of it)
+const size_t maxOccluderTriangles = 4096;
+
+/// radius of the circles followed by the point and spot lights
+const float lightOrbitRadius = 0.5f;
+
+/// options of the variants of the material programs (see shaders/simplemat.f.glsl)
+const std::vector<std::string> materialOptions = {"DISPLAY_NORMALS", "CLUSTERED_LIGHTS", "GBUFFER"};
+
+/// sets the three directional lights (defined in world space) of a bound program (see shaders/lighting.glsl)
+void setDirectionalLights(const Program & program)
+{
+  program.setUniform("lightsInWorld[0].direction", glm::normalize(glm::vec3(0, -1, -1)));
+  program.setUniform("lightsInWorld[0].intensity", glm::vec3(0.7, 0.7, 0.7));
+  program.setUniform("lightsInWorld[1].direction", glm::normalize(glm::vec3(0, 1, -0.5)));
+  program.setUniform("lightsInWorld[1].intensity", glm::vec3(0.5, 0.5, 0.5));
+  program.setUniform("lightsInWorld[2].direction", glm::normalize(glm::vec3(-1, 0, -1)));
+  program.setUniform("lightsInWorld[2].intensity", glm::vec3(0.6, 0.6, 0.6));
+}
+
+/// mean area of the triangles of a triangle list
+float meanTriangleArea(const std::vector<glm::vec3> & positions, const std::vector<uint> & ibo)
+{
+  float area = 0;
+  for (size_t i = 0; i + 2 < ibo.size(); i += 3) {
+    const glm::vec3 & a = positions[ibo[i]];
+    area += 0.5f * glm::length(glm::cross(positions[ibo[i + 1]] - a, positions[ibo[i + 2]] - a));
+  }
+  return ibo.empty() ? 0 : 3 * area / ibo.size();
+}
+} // namespace
+
+PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld), m_lod(0), m_projectedSize(0), m_textureStreamer(nullptr)
+{
+  m_diffusemap = std::shared_ptr<Sampler>(new Sampler(0));
+  m_normalmap = std::shared_ptr<Sampler>(new Sampler(1));
+  m_specularmap = std::shared_ptr<Sampler>(new Sampler(2));
 }
 
 std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createCheckerBoardPlaneInstance(const glm::mat4 & modelWorld)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
   std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-  Image<> rgbMapImage;
-  std::string rgbFilename = absolutename("meshes/checkerboardRGB.png");
-  rgbMapImage.data = stbi_load(rgbFilename.c_str(), &rgbMapImage.width, &rgbMapImage.height, &rgbMapImage.channels, STBI_default);
-  texture->setData(rgbMapImage, true);
+  Image<> rgbMapImage = ImageCache::load(absolutename("meshes/checkerboardRGB.png"));
+  texture->setData(rgbMapImage, true, true);
 
   std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
   stexture->setData(rgbMapImage, true);
 
   std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
-  Image<> normalMapImage;
-  std::string nmFilename = absolutename("meshes/checkerboardNM.png");
-  normalMapImage.data = stbi_load(nmFilename.c_str(), &normalMapImage.width, &normalMapImage.height, &normalMapImage.channels, STBI_default);
+  Image<> normalMapImage = ImageCache::load(absolutename("meshes/checkerboardNM.png"));
   ntexture->setData(normalMapImage, true);
 
   object->m_diffusemap->enableAnisotropicFiltering();
 
-  std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
   SimpleMaterial material;
   material.name = "checkerboard";
   material.ambient = {0.1, 0.1, 0.1};
   material.diffuse = {0.5, 0.5, 0.5};
   material.specular = {1, 1, 1};
   material.shininess = 90;
-  object->setProgramMaterial(program, material);
+  RenderObject * target = object.get();
+  std::shared_ptr<ProgramVariants> program(
+      new ProgramVariants("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl", materialOptions, [target, material](Program & variant) { target->setProgramMaterial(variant, material); }));
   std::shared_ptr<VAO> vao(new VAO(4));
   std::vector<glm::vec3> vertexPositions = {{-0.5, -0.5, 0}, {0.5, -0.5, 0}, {0.5, 0.5, 0}, {-0.5, 0.5, 0}};
   std::vector<glm::vec2> vertexUVs = {{0, 0}, {0, 40}, {40, 40}, {40, 0}};
@@ -61,63 +99,149 @@ std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::crea
   vao->setIBO(ibo);
 
   object->m_parts.emplace_back(vao, program, texture, ntexture, stexture);
+  object->m_bounds = BoundingSphere::fromPoints(vertexPositions);
+  object->m_objectPartBounds.push_back(BoundingBox::fromPoints(vertexPositions));
+  object->m_partBounds.push_back(object->m_objectPartBounds.back().transformed(modelWorld));
+  object->m_occluder = OccluderMesh::fromTriangles(vertexPositions, ibo, 2);
   return object;
 }
 
-void PA5Application::RenderObject::draw()
+std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createCopy(const RenderObject & model, const glm::mat4 & modelWorld)
 {
-  m_diffusemap->bind();
-  m_normalmap->bind();
-  m_specularmap->bind();
-  for (auto & part : m_parts) {
-    part.draw(m_diffusemap.get(), m_normalmap.get(), m_specularmap.get());
+  std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
+  object->m_parts = std::vector<RenderObjectPart>(model.m_parts);
+  object->m_bounds = model.m_bounds;
+  object->m_objectPartBounds = model.m_objectPartBounds;
+  for (const auto & bounds : model.m_objectPartBounds) {
+    object->m_partBounds.push_back(bounds.transformed(modelWorld));
   }
-  m_diffusemap->unbind();
-  m_normalmap->unbind();
-  m_specularmap->unbind();
+  object->m_textureStreamer = model.m_textureStreamer;
+  object->m_partTextures = model.m_partTextures;
+  object->m_occluder = model.m_occluder;
+  // the samplers are shared too, so that the copies use the same materials as their model
+  object->m_diffusemap = model.m_diffusemap;
+  object->m_normalmap = model.m_normalmap;
+  object->m_specularmap = model.m_specularmap;
+  return object;
 }
 
-void PA5Application::RenderObject::update(const glm::mat4 & proj, const glm::mat4 & view)
+void PA5Application::RenderObject::submit(RenderQueue & queue, const glm::mat4 & view, unsigned int slot) const
 {
+  const Sampler * samplers[3] = {m_diffusemap.get(), m_normalmap.get(), m_specularmap.get()};
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (m_partsDrawn[k]) {
+      float depth = -(view * glm::vec4(m_partBounds[k].center(), 1)).z;
+      m_parts[k].submit(queue, samplers, m_lod, m_mw, depth, slot);
+    }
+  }
+}
+
+unsigned int PA5Application::RenderObject::updatePrograms(const FrameUniforms & uniforms)
+{
+  unsigned int nbUpdates = 0;
   for (auto & part : m_parts) {
-    part.update(proj, view, m_mw, displayNormals);
+    nbUpdates += part.update(uniforms);
+  }
+  return nbUpdates;
+}
+
+void PA5Application::RenderObject::update(const glm::mat4 & proj, const glm::mat4 & view, CullingStatistics & stats)
+{
+  unsigned int nbLevels = 0;
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    nbLevels = std::max(nbLevels, m_parts[k].nbLODs());
+  }
+  m_projectedSize = m_bounds.transformed(m_mw).projectedSize(proj, view);
+  m_lod = selectLevelOfDetail(m_projectedSize, m_lod, nbLevels);
+  // the meshlets are culled in object space, which spares the transformation of their bounds
+  Frustum frustum = Frustum::fromMatrix(proj * view * m_mw);
+  glm::vec3 viewpoint(glm::inverse(view * m_mw) * glm::vec4(0, 0, 0, 1));
+  bool backfaceCulling = glm::determinant(glm::mat3(m_mw)) > 0; // mirroring transforms swap the facing
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (m_partsDrawn[k]) {
+      m_parts[k].cull(frustum, viewpoint, backfaceCulling, m_lod, stats);
+    }
+  }
+}
+
+void PA5Application::RenderObject::requestTextures()
+{
+  if (not m_textureStreamer) {
+    return;
+  }
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (not m_partsDrawn[k]) {
+      continue;
+    }
+    for (unsigned int id : m_partTextures[k]) {
+      m_textureStreamer->request(id, m_projectedSize);
+    }
   }
 }
 
-std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld)
+BoundingSphere PA5Application::RenderObject::worldBounds() const
+{
+  return m_bounds.transformed(m_mw);
+}
+
+BoundingBox PA5Application::RenderObject::worldBox() const
+{
+  BoundingBox box;
+  for (const auto & bounds : m_partBounds) {
+    box.min = box.empty() ? bounds.min : glm::min(box.min, bounds.min);
+    box.max = box.empty() ? bounds.max : glm::max(box.max, bounds.max);
+  }
+  return box;
+}
+
+unsigned int PA5Application::RenderObject::nbParts() const
+{
+  return m_parts.size();
+}
+
+unsigned int PA5Application::RenderObject::cull(const Frustum & frustum)
+{
+  m_partsDrawn.resize(m_partBounds.size());
+  frustum.intersects(m_partBounds.data(), m_partBounds.size(), m_partsDrawn.data());
+  return std::count(m_partsDrawn.begin(), m_partsDrawn.end(), 1);
+}
+
+std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld, TextureStreamer * textureStreamer)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
-  object->loadWavefront(objname);
+  object->loadWavefront(objname, textureStreamer);
   return object;
 }
 
-void PA5Application::RenderObject::setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const
-{
-  program->bind();
-  program->setUniform("lightsInWorld[0].direction", glm::normalize(glm::vec3(0, -1, -1)));
-  program->setUniform("lightsInWorld[0].intensity", glm::vec3(0.7, 0.7, 0.7));
-  program->setUniform("lightsInWorld[1].direction", glm::normalize(glm::vec3(0, 1, -0.5)));
-  program->setUniform("lightsInWorld[1].intensity", glm::vec3(0.5, 0.5, 0.5));
-  program->setUniform("lightsInWorld[2].direction", glm::normalize(glm::vec3(-1, 0, -1)));
-  program->setUniform("lightsInWorld[2].intensity", glm::vec3(0.6, 0.6, 0.6));
-  program->setUniform("material.ambient", material.ambient);
-  program->setUniform("material.diffuse", material.diffuse);
-  program->setUniform("material.specular", material.specular);
-  program->setUniform("material.shininess", material.shininess);
-  m_diffusemap->attachToProgram(*program, "material.colormap", Sampler::DoNotBind);
-  m_normalmap->attachToProgram(*program, "material.normalmap", Sampler::DoNotBind);
-  m_specularmap->attachToProgram(*program, "material.specularmap", Sampler::DoNotBind);
-  program->unbind();
+void PA5Application::RenderObject::setProgramMaterial(Program & program, const SimpleMaterial & material) const
+{
+  program.bind();
+  setDirectionalLights(program);
+  program.setUniform("material.ambient", material.ambient);
+  program.setUniform("material.diffuse", material.diffuse);
+  program.setUniform("material.specular", material.specular);
+  program.setUniform("material.shininess", material.shininess);
+  m_diffusemap->attachToProgram(program, "material.colormap", Sampler::DoNotBind);
+  m_normalmap->attachToProgram(program, "material.normalmap", Sampler::DoNotBind);
+  m_specularmap->attachToProgram(program, "material.specularmap", Sampler::DoNotBind);
+  program.unbind();
 }
 
-void PA5Application::RenderObject::loadWavefront(const std::string & objname)
+void PA5Application::RenderObject::loadWavefront(const std::string & objname, TextureStreamer * textureStreamer)
 {
-  ObjLoader objLoader(objname);
+  // the fragment shader is expensive, hence the triangles are also sorted to reduce overdraw
+  ObjLoader::Options options;
+  options.optimizeOverdraw = true;
+  options.nbLODs = 4;
+  options.buildMeshlets = true;
+  options.decodeImages = textureStreamer == nullptr; // the streamed textures are read from their mip cache
+  ObjLoader objLoader(objname, options);
+  m_textureStreamer = textureStreamer;
   const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vertexPositions = objLoader.vertexPositions();
+  const std::vector<glm::vec3> & vertexPositions = objLoader.vertexPositions();
   const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
-  std::vector<glm::vec3> vertexNormals = objLoader.vertexNormals();
-  std::vector<glm::vec3> vertexTangents = objLoader.vertexTangents();
+  const std::vector<glm::vec3> & vertexNormals = objLoader.vertexNormals();
+  const std::vector<glm::vec3> & vertexTangents = objLoader.vertexTangents();
   // set up the VBOs of the master VAO
   std::shared_ptr<VAO> vao(new VAO(4));
   vao->setVBO(0, vertexPositions);
@@ -125,6 +249,7 @@ void PA5Application::RenderObject::loadWavefront(const std::string & objname)
   vao->setVBO(2, vertexNormals);
   vao->setVBO(3, vertexTangents);
   size_t nbParts = objLoader.nbIBOs();
+  std::vector<std::pair<float, size_t>> occluderParts; // (mean triangle area, part) of the candidate occluders
   for (size_t k = 0; k < nbParts; k++) {
     const std::vector<uint> & ibo = objLoader.ibo(k);
     if (ibo.size() == 0) {
@@ -132,22 +257,46 @@ void PA5Application::RenderObject::loadWavefront(const std::string & objname)
     }
     std::shared_ptr<VAO> vaoSlave;
     vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
+    vaoSlave->setIBO(objLoader.lodIBO(k)); // the ranges of all the levels of detail
 
-    std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
     const SimpleMaterial & material = materials[k];
-    setProgramMaterial(program, material);
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
-    Image<> normalMap = objLoader.image(material.normalTexName);
-    std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
-    ntexture->setData(normalMap);
-    Image<> specularMap = objLoader.image(material.specularTexName);
-    std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
-    stexture->setData(specularMap);
-    m_parts.emplace_back(vaoSlave, program, texture, ntexture, stexture);
+    std::shared_ptr<ProgramVariants> program(
+        new ProgramVariants("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl", materialOptions, [this, material](Program & variant) { setProgramMaterial(variant, material); }));
+    std::vector<unsigned int> streamedTextures;
+    auto makeTexture = [&](const std::string & name, bool srgb) {
+      std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
+      std::string filename = objLoader.imageFilename(name);
+      if (textureStreamer and not filename.empty()) {
+        streamedTextures.push_back(textureStreamer->add(texture, filename, srgb));
+      } else {
+        texture->setData(objLoader.image(name));
+      }
+      return texture;
+    };
+    std::shared_ptr<Texture> texture = makeTexture(material.diffuseTexName, true);
+    std::shared_ptr<Texture> ntexture = makeTexture(material.normalTexName, false);
+    std::shared_ptr<Texture> stexture = makeTexture(material.specularTexName, false);
+    m_partTextures.push_back(streamedTextures);
+    m_parts.emplace_back(vaoSlave, program, texture, ntexture, stexture, objLoader.lods(k), objLoader.meshlets(k));
+    m_objectPartBounds.push_back(objLoader.partBoundingBox(k));
+    m_partBounds.push_back(m_objectPartBounds.back().transformed(m_mw));
+    occluderParts.emplace_back(meanTriangleArea(vertexPositions, ibo), k);
   }
+  // the simplified levels of detail may bulge out of the surface, hence hide objects which are visible:
+  // the occluder is made of the full resolution triangles of the parts with the largest triangles
+  // (e.g. the walls and the floor), which cover the most pixels per triangle within the budget
+  std::sort(occluderParts.begin(), occluderParts.end(), std::greater<std::pair<float, size_t>>());
+  std::vector<uint> occluderIBO;
+  for (const auto & part : occluderParts) {
+    const std::vector<uint> & ibo = objLoader.ibo(part.second);
+    if (occluderIBO.size() + ibo.size() <= 3 * maxOccluderTriangles) {
+      occluderIBO.insert(occluderIBO.end(), ibo.begin(), ibo.end());
+    }
+  }
+  m_occluder = OccluderMesh::fromTriangles(vertexPositions, occluderIBO, maxOccluderTriangles);
+  objLoader.release(); // the geometry now lives on the GPU only
+  std::cout << "Peak RSS after loading " << objname << " : " << peakResidentSetSize() / (1024 * 1024) << " MB" << std::endl;
+  m_bounds = objLoader.boundingSphere();
   m_diffusemap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   m_diffusemap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   m_diffusemap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -163,9 +312,30 @@ void PA5Application::RenderObject::loadWavefront(const std::string & objname)
 }
 
 bool PA5Application::displayNormals;
+bool PA5Application::textureStreaming = true;
+size_t PA5Application::textureBudget = 16 << 20;
+unsigned int PA5Application::nbCopies = 1;
+bool PA5Application::occlusionCulling = true;
+unsigned int PA5Application::nbLights = 256;
+bool PA5Application::clusteredLighting = true;
+bool PA5Application::deferredShading = false;
+bool PA5Application::depthPrepass = true;
 
-PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(windowWidth, windowHeight), m_currentTime(0), m_deltaTime(0)
+PA5Application::PA5Application(int windowWidth, int windowHeight)
+    : Application(windowWidth, windowHeight), m_proj(glm::mat4(1)), m_view(glm::mat4(1)), m_cameraPosition(0), m_currentTime(0), m_deltaTime(0), m_occlusionTime(0), m_lightingTime(0),
+      m_nbFrames(0), m_gpuTime(0), m_nbTimedFrames(0), m_shadedFragments(0), m_nbCulledFrames(0), m_lastReportTime(0), m_depthProgram("shaders/depth.v.glsl", "shaders/depth.f.glsl"),
+      m_depthProgramVersion(0), m_nbProgramUpdates(0), m_nbRenderedFrames(0)
 {
+  // the lighting pass reads the G-buffer, its variants following the options of the material programs
+  m_lightingProgram = std::unique_ptr<ProgramVariants>(new ProgramVariants("shaders/fullscreen.v.glsl", "shaders/deferred.f.glsl", {"DISPLAY_NORMALS", "CLUSTERED_LIGHTS"}, [this](Program & variant) {
+    variant.bind();
+    setDirectionalLights(variant);
+    m_gbuffer.setUniforms(variant);
+    variant.unbind();
+  }));
+  if (textureStreaming) {
+    m_textureStreamer = std::unique_ptr<TextureStreamer>(new TextureStreamer(textureBudget));
+  }
   GLFWwindow * window = glfwGetCurrentContext();
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
   resize(window, windowWidth, windowHeight);
@@ -181,11 +351,46 @@ PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(
   mw = glm::rotate(mw, -pi / 2, {1, 0, 0});
   mw = glm::rotate(mw, -5 * pi / 6, {0, 1, 0});
   mw = glm::scale(mw, glm::vec3(0.25));
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Tron/TronLightCycle.obj", mw));
+  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Tron/TronLightCycle.obj", mw, m_textureStreamer.get()));
   mw = glm::mat4(1);
   mw = glm::translate(mw, {2, 1, -0.1});
   mw = glm::rotate(mw, pi, {1, 0, 0});
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Pallet/Bswap_HPBake_Planks.obj", mw));
+  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Pallet/Bswap_HPBake_Planks.obj", mw, m_textureStreamer.get()));
+  // the copies of the wavefront objects are laid out on a square grid around the originals
+  m_nbModels = m_objects.size();
+  const int gridSize = std::ceil(std::sqrt(float(nbCopies)));
+  const int centerCell = (gridSize / 2) * gridSize + gridSize / 2;
+  const float spacing = 3;
+  for (unsigned int c = 1; c < nbCopies; c++) {
+    int cell = c - 1 < unsigned(centerCell) ? c - 1 : c; // the center cell holds the originals
+    glm::vec3 offset(spacing * (cell % gridSize - gridSize / 2), spacing * (cell / gridSize - gridSize / 2), 0);
+    for (size_t k = 1; k < m_nbModels; k++) {
+      m_objects.push_back(RenderObject::createCopy(*m_objects[k], glm::translate(glm::mat4(1), offset) * m_objects[k]->modelWorld()));
+    }
+  }
+  // the objects do not move, hence their bounds are computed once
+  for (auto & object : m_objects) {
+    m_objectBounds.push_back(object->worldBounds());
+    m_objectBoxes.push_back(object->worldBox());
+  }
+  m_objectsDrawn.resize(m_objects.size());
+  // the lights move above the objects, on circles spread over the grid
+  std::mt19937 random(4);
+  std::uniform_real_distribution<float> uniform(0, 1);
+  const float extent = spacing * std::max(gridSize, 1) / 2;
+  for (unsigned int k = 0; k < nbLights; k++) {
+    glm::vec3 center(extent * (2 * uniform(random) - 1), extent * (2 * uniform(random) - 1), -0.2f - 0.8f * uniform(random));
+    m_lightOrbits.push_back(glm::vec4(center, 2 * glm::pi<float>() * uniform(random)));
+    glm::vec3 color = glm::vec3(uniform(random), uniform(random), uniform(random));
+    color = 2.f * color / std::max(std::max(color.r, color.g), std::max(color.b, 0.1f));
+    if (k % 4 == 3) {
+      // the spots look down (towards z), slightly tilted
+      glm::vec3 direction(uniform(random) - 0.5f, uniform(random) - 0.5f, 1);
+      m_lights.add(Light::spot(center, direction, 3, 2.f * color, 0.3f, 0.6f));
+    } else {
+      m_lights.add(Light::point(center, 1 + uniform(random), color));
+    }
+  }
 }
 
 void PA5Application::setCallbacks()
@@ -198,21 +403,84 @@ void PA5Application::setCallbacks()
 void PA5Application::usage(std::string & shortDescription, std::string & synopsis, std::string & description)
 {
   shortDescription = "Application for programming assignment 4";
-  synopsis = "pa4";
+  synopsis = "pa5 [<copies> [<lights>]]";
   description = "  An application for texture mapping.\n"
+                "  The wavefront objects are drawn <copies> times (1 by default), laid out on a grid.\n"
+                "  <lights> point and spot lights (256 by default) move over the grid, shaded by clustered forward lighting.\n"
+                "  The GPU time of the frames is reported, to compare forward and deferred shading.\n"
                 "  The following key bindings are available to interact with thi application:\n"
                 "     <up> / <down>    increase / decrease latitude angle of the camera position\n"
                 "     <left> / <right> increase / decrease longitude angle of the camera position\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     S                toggle the sorting of the draw calls by OpenGL state\n"
+                "     O                toggle the occlusion culling\n"
+                "     L                toggle the point and spot lights\n"
+                "     D                toggle deferred shading\n"
+                "     P                toggle the depth pre-pass\n"
+                "     F                toggle the front to back sorting of the opaque draw calls\n";
 }
 
 void PA5Application::renderFrame()
 {
+  // the query of the previous frame is read, the one of the frame before being reused
+  TimerQuery & query = m_frameQueries[m_nbFrames % 2];
+  SamplesQuery & shaded = m_shadedQueries[m_nbFrames % 2];
+  if (query.started()) {
+    m_gpuTime += query.milliseconds();
+    m_shadedFragments += shaded.samples();
+    m_nbTimedFrames++;
+  }
+  query.begin();
+  m_renderQueue.sort();
+  if (deferredShading) {
+    // geometry pass: the attributes of the visible surfaces
+    m_gbuffer.begin();
+    drawOpaque(shaded);
+    m_gbuffer.end();
+  }
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
   glClear(GL_DEPTH_BUFFER_BIT);
-  for (auto & object : m_objects) {
-    object->draw();
+  if (clusteredLighting) {
+    m_lights.bind();
+  }
+  if (deferredShading) {
+    // lighting pass: each pixel is shaded once
+    glDisable(GL_DEPTH_TEST);
+    m_gbuffer.bindTextures();
+    m_lightingProgram->current().bind();
+    m_gbuffer.drawFullScreen();
+    m_lightingProgram->current().unbind();
+    m_gbuffer.unbindTextures();
+    glEnable(GL_DEPTH_TEST);
+  } else {
+    drawOpaque(shaded);
+  }
+  if (clusteredLighting) {
+    m_lights.unbind();
+  }
+  query.end();
+  m_nbFrames++;
+  m_renderStats += m_renderQueue.statistics();
+  m_nbRenderedFrames++;
+}
+
+void PA5Application::drawOpaque(SamplesQuery & shaded)
+{
+  if (depthPrepass) {
+    // the depth of the visible surfaces, then the shading of the fragments lying at this depth
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    m_renderQueue.executeDepth(m_depthProgram);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+  }
+  shaded.begin();
+  m_renderQueue.execute();
+  shaded.end();
+  if (depthPrepass) {
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
   }
 }
 
@@ -222,8 +490,158 @@ void PA5Application::update()
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
   continuousKey();
-  for (auto & object : m_objects) {
-    object->update(m_proj, m_view);
+  ThreadPool & pool = ThreadPool::global();
+  if (clusteredLighting) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int k = 0; k < m_lights.nbLights(); k++) {
+      const glm::vec4 & orbit = m_lightOrbits[k];
+      const float angle = orbit.w + 0.5f * m_currentTime;
+      m_lights.light(k).position = glm::vec3(orbit) + lightOrbitRadius * glm::vec3(std::cos(angle), std::sin(angle), 0);
+    }
+    m_lights.build(m_view.get(), pool);
+    m_lightingTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_lights.upload();
+  }
+  // the uniforms are only set when the camera changed since their last update
+  FrameUniforms uniforms;
+  uniforms.proj = m_proj.get();
+  uniforms.view = m_view.get();
+  uniforms.cameraPosition = m_cameraPosition;
+  uniforms.lights = clusteredLighting ? &m_lights : nullptr;
+  uniforms.displayNormals = displayNormals;
+  uniforms.deferred = deferredShading;
+  uniforms.version = m_proj.version() + m_view.version();
+  for (size_t k = 0; k < m_nbModels; k++) {
+    m_nbProgramUpdates += m_objects[k]->updatePrograms(uniforms);
+  }
+  if (depthPrepass and m_depthProgramVersion != uniforms.version) {
+    m_depthProgram.bind();
+    m_depthProgram.setUniform("V", uniforms.view);
+    m_depthProgram.setUniform("P", uniforms.proj);
+    m_depthProgram.unbind();
+    m_depthProgramVersion = uniforms.version;
+    m_nbProgramUpdates++;
+  }
+  if (deferredShading) {
+    uint key = displayNormals ? m_lightingProgram->option("DISPLAY_NORMALS") : (clusteredLighting ? m_lightingProgram->option("CLUSTERED_LIGHTS") : 0);
+    Program & program = m_lightingProgram->select(key);
+    if (m_lightingProgram->outdated(uniforms.version)) {
+      program.bind();
+      program.setUniform("V", uniforms.view);
+      program.setUniform("viewProjInverse", glm::inverse(uniforms.proj * uniforms.view));
+      program.setUniform("positionCameraInWorld", uniforms.cameraPosition);
+      if (clusteredLighting) {
+        m_lights.setUniforms(program);
+      }
+      program.unbind();
+      m_nbProgramUpdates++;
+    }
+  }
+  // whole objects are culled first (all at once), then the parts of the remaining ones
+  const glm::mat4 & proj = m_proj.get();
+  const glm::mat4 & view = m_view.get();
+  Frustum frustum = Frustum::fromMatrix(proj * view);
+  frustum.intersects(m_objectBounds.data(), m_objectBounds.size(), m_objectsDrawn.data());
+  CullingStatistics occlusionStats;
+  if (occlusionCulling) {
+    // the visible occluders are rasterized, then the objects they hide are culled as a whole
+    auto start = std::chrono::steady_clock::now();
+    m_occlusionCuller.begin(proj * view);
+    for (size_t k = 0; k < m_objects.size(); k++) {
+      if (m_objectsDrawn[k] and m_objects[k]->occluder()) {
+        m_occlusionCuller.addOccluder(*m_objects[k]->occluder(), m_objects[k]->modelWorld());
+      }
+    }
+    m_occlusionCuller.rasterize(pool);
+    std::vector<unsigned char> inFrustum(m_objectsDrawn);
+    m_occlusionCuller.cull(m_objectBoxes.data(), m_objectBoxes.size(), m_objectsDrawn.data());
+    for (size_t k = 0; k < m_objects.size(); k++) {
+      if (inFrustum[k] and not m_objectsDrawn[k]) {
+        occlusionStats.nbOccludedParts += m_objects[k]->nbParts();
+      }
+    }
+    m_occlusionTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  m_cullingStats += occlusionStats;
+  // the objects are split into slots, culled and submitted to the render queue concurrently
+  const size_t nbSlots = std::min<size_t>(4 * (pool.size() + 1), m_objects.size());
+  const size_t slotSize = (m_objects.size() + nbSlots - 1) / nbSlots;
+  std::vector<CullingStatistics> slotStats(nbSlots);
+  m_renderQueue.clear(nbSlots);
+  pool.parallelFor(nbSlots, [&](size_t begin, size_t end) {
+    for (size_t slot = begin; slot < end; slot++) {
+      CullingStatistics & stats = slotStats[slot];
+      for (size_t k = slot * slotSize; k < std::min(m_objects.size(), (slot + 1) * slotSize); k++) {
+        unsigned int nbDrawn = m_objectsDrawn[k] ? m_objects[k]->cull(frustum) : 0;
+        stats.nbDrawnParts += nbDrawn;
+        stats.nbCulledParts += m_objects[k]->nbParts() - nbDrawn;
+        if (nbDrawn > 0) {
+          m_objects[k]->update(proj, view, stats);
+          m_objects[k]->submit(m_renderQueue, view, slot);
+        } else {
+          m_objectsDrawn[k] = 0;
+        }
+      }
+    }
+  });
+  for (const auto & stats : slotStats) {
+    m_cullingStats += stats;
+  }
+  // the streamer is not thread-safe, and the copies of an object share its textures
+  for (size_t k = 0; k < m_objects.size(); k++) {
+    if (m_objectsDrawn[k]) {
+      m_objects[k]->requestTextures();
+    }
+  }
+  if (m_textureStreamer) {
+    m_textureStreamer->update();
+  }
+  m_nbCulledFrames++;
+  if (m_currentTime - m_lastReportTime >= 1) {
+    float total = std::max(m_cullingStats.nbTriangles, 1u);
+    std::cout << "Parts : " << m_cullingStats.nbDrawnParts << " drawn, " << m_cullingStats.nbCulledParts << " culled (" << m_cullingStats.nbOccludedParts << " hidden by the occluders)"
+              << std::endl;
+    if (occlusionCulling) {
+      float parts = std::max(m_cullingStats.nbDrawnParts + m_cullingStats.nbCulledParts, 1u);
+      std::cout << "Occlusion culling : " << 100 * m_cullingStats.nbOccludedParts / parts << "% of the draws culled, " << m_occlusionTime / m_nbCulledFrames << " ms per frame ("
+                << m_occlusionCuller.statistics().nbTriangles << " occluder triangles in a " << m_occlusionCuller.width() << "x" << m_occlusionCuller.height() << " depth buffer)"
+                << std::endl;
+    }
+    if (clusteredLighting) {
+      const ClusteredLights::Statistics & stats = m_lights.statistics();
+      std::cout << "Lights : " << m_lights.nbLights() << " lights, " << stats.nbIndices / std::max(stats.nbLitClusters, 1u) << " per lit cluster on average (at most "
+                << stats.maxClusterSize << ", " << stats.nbLitClusters << " lit clusters), " << m_lightingTime / m_nbCulledFrames << " ms per frame" << std::endl;
+    }
+    std::cout << "Culled triangles : " << 100 * (m_cullingStats.nbFrustumCulled + m_cullingStats.nbBackfaceCulled) / total << "% (frustum " << 100 * m_cullingStats.nbFrustumCulled / total
+              << "%, backfacing " << 100 * m_cullingStats.nbBackfaceCulled / total << "%), " << m_cullingStats.nbTriangles / m_nbCulledFrames << " triangles per frame" << std::endl;
+    if (m_textureStreamer) {
+      std::cout << "Textures : " << m_textureStreamer->residentBytes() / 1024 << " KB resident (budget " << m_textureStreamer->budget() / 1024 << " KB), " << m_textureStreamer->nbStreamedLevels()
+                << " levels streamed, " << m_textureStreamer->nbEvictedLevels() << " evicted" << std::endl;
+    }
+    std::cout << "Uniform updates : " << float(m_nbProgramUpdates) / m_nbCulledFrames << " programs per frame" << std::endl;
+    if (m_nbTimedFrames > 0) {
+      std::cout << "GPU : " << m_gpuTime / m_nbTimedFrames << " ms per frame (" << (deferredShading ? "deferred" : "forward") << " shading)" << std::endl;
+      const double pixels = m_gbuffer.width() * m_gbuffer.height();
+      std::cout << "Shaded fragments : " << m_shadedFragments / m_nbTimedFrames << " per frame, " << m_shadedFragments / m_nbTimedFrames / pixels << " per pixel ("
+                << (depthPrepass ? "depth pre-pass" : "no depth pre-pass") << ", " << (RenderQueue::frontToBack ? "front to back" : "sorted by state") << ")" << std::endl;
+    }
+    if (m_nbRenderedFrames > 0) {
+      const RenderQueue::Statistics & stats = m_renderStats;
+      std::cout << "State changes : " << stats.nbStateChanges() / m_nbRenderedFrames << " per frame for " << stats.nbDraws / m_nbRenderedFrames << " draws (programs "
+                << stats.nbProgramChanges / m_nbRenderedFrames << ", textures " << stats.nbTextureChanges / m_nbRenderedFrames << ", samplers " << stats.nbSamplerChanges / m_nbRenderedFrames
+                << ", VAOs " << stats.nbVAOChanges / m_nbRenderedFrames << ")" << (RenderQueue::sorting ? "" : ", unsorted") << std::endl;
+    }
+    m_renderStats = RenderQueue::Statistics();
+    m_nbRenderedFrames = 0;
+    m_cullingStats = CullingStatistics();
+    m_occlusionTime = 0;
+    m_lightingTime = 0;
+    m_gpuTime = 0;
+    m_shadedFragments = 0;
+    m_nbProgramUpdates = 0;
+    m_nbTimedFrames = 0;
+    m_nbCulledFrames = 0;
+    m_lastReportTime = m_currentTime;
   }
 }
 
@@ -237,7 +655,10 @@ void PA5Application::computeView(bool reset)
   glm::vec3 center(0, 0, 0);
   glm::vec3 up(0, 0, -1);
   glm::vec3 eyePos = 5.f * glm::vec3(cos(m_eyePhi) * sin(m_eyeTheta), sin(m_eyePhi) * sin(m_eyeTheta), cos(m_eyeTheta));
-  m_view = glm::lookAt(eyePos, center, up);
+  // the view is set every frame, but only changes (with its version) when the camera moves
+  if (m_view.set(glm::lookAt(eyePos, center, up))) {
+    m_cameraPosition = eyePos;
+  }
 }
 
 void PA5Application::continuousKey()
@@ -267,7 +688,17 @@ void PA5Application::resize(GLFWwindow * window, int framebufferWidth, int frame
 {
   PA5Application & app = *static_cast<PA5Application *>(glfwGetWindowUserPointer(window));
   float aspect = framebufferWidth / float(framebufferHeight);
-  app.m_proj = glm::perspective(120.f, aspect, 0.1f, 100.f);
+  const float near = 0.1f;
+  const float far = 100.f;
+  app.m_proj.set(glm::perspective(120.f, aspect, near, far));
+  app.m_proj.touch(); // the uniforms of the clustered lights also depend on the size of the viewport
+  app.m_renderQueue.setDepthRange(near, far);
+  app.m_lights.setProjection(app.m_proj.get(), near, far, glm::vec2(framebufferWidth, framebufferHeight));
+  app.m_gbuffer.resize(framebufferWidth, framebufferHeight);
+  app.m_occlusionCuller.resize(256, std::max(256 * framebufferHeight / std::max(framebufferWidth, 1), 1));
+  if (app.m_textureStreamer) {
+    app.m_textureStreamer->setViewportHeight(framebufferHeight);
+  }
   glViewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
@@ -283,36 +714,123 @@ void PA5Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
       displayNormals = not displayNormals;
     }
     break;
+  case 'S':
+    if (action == GLFW_PRESS) {
+      RenderQueue::sorting = not RenderQueue::sorting;
+    }
+    break;
+  case 'O':
+    if (action == GLFW_PRESS) {
+      occlusionCulling = not occlusionCulling;
+    }
+    break;
+  case 'L':
+    if (action == GLFW_PRESS) {
+      clusteredLighting = not clusteredLighting;
+    }
+    break;
+  case 'D':
+    if (action == GLFW_PRESS) {
+      deferredShading = not deferredShading;
+    }
+    break;
+  case 'P':
+    if (action == GLFW_PRESS) {
+      depthPrepass = not depthPrepass;
+    }
+    break;
+  case 'F':
+    if (action == GLFW_PRESS) {
+      RenderQueue::frontToBack = not RenderQueue::frontToBack;
+    }
+    break;
   }
 }
 
-PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture,
-                                                   std::shared_ptr<Texture> stexture)
-    : m_vao(vao), m_program(program), m_diffuseTexture(texture), m_normalTexture(ntexture), m_specularTexture(stexture)
+PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<ProgramVariants> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture,
+                                                   std::shared_ptr<Texture> stexture, const std::vector<LevelOfDetail> & lods, const std::vector<Meshlet> & meshlets)
+    : m_lods(lods), m_meshlets(meshlets), m_vao(vao), m_program(program), m_diffuseTexture(texture), m_normalTexture(ntexture), m_specularTexture(stexture)
 {
 }
 
-void PA5Application::RenderObjectPart::draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap)
+unsigned int PA5Application::RenderObjectPart::nbLODs() const
 {
-  m_program->bind();
-  colormap->attachTexture(*m_diffuseTexture);
-  normalmap->attachTexture(*m_normalTexture);
-  specularmap->attachTexture(*m_specularTexture);
-  m_vao->draw();
-  m_program->unbind();
+  return m_lods.size();
 }
 
-void PA5Application::RenderObjectPart::update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals)
+void PA5Application::RenderObjectPart::submit(RenderQueue & queue, const Sampler * const samplers[3], unsigned int lod, const glm::mat4 & mw, float depth, unsigned int slot) const
 {
-  m_program->bind();
-  m_program->setUniform("M", mw);
-  m_program->setUniform("V", view);
-  m_program->setUniform("P", proj);
-  m_program->setUniform("positionCameraInWorld", glm::vec3(glm::inverse(view) * glm::vec4(0, 0, 0, 1)));
-  if (displayNormals) {
-    m_program->setUniform("displayNormals", 1);
+  DrawPacket packet;
+  packet.program = &m_program->current();
+  packet.vao = m_vao.get();
+  packet.textures[0] = m_diffuseTexture.get();
+  packet.textures[1] = m_normalTexture.get();
+  packet.textures[2] = m_specularTexture.get();
+  std::copy(samplers, samplers + 3, packet.samplers);
+  // the program may be shared by copies of the object, hence the modelWorld matrix is set at draw time
+  packet.matrixName = "M";
+  packet.matrix = mw;
+  if (not m_meshlets.empty()) {
+    if (m_visibleCounts.empty()) {
+      return;
+    }
+    packet.offsets = &m_visibleOffsets;
+    packet.counts = &m_visibleCounts;
+  } else if (m_lods.empty()) {
+    packet.count = m_vao->nbIndices();
   } else {
-    m_program->setUniform("displayNormals", 0);
+    const LevelOfDetail & range = m_lods[std::min<size_t>(lod, m_lods.size() - 1)];
+    packet.offset = range.offset;
+    packet.count = range.count;
+  }
+  queue.submit(packet, RenderPass::Opaque, depth, slot);
+}
+
+bool PA5Application::RenderObjectPart::update(const FrameUniforms & uniforms)
+{
+  // the variant is shared by the copies of the object, which draw the current one
+  uint key = uniforms.displayNormals ? m_program->option("DISPLAY_NORMALS") : (uniforms.lights ? m_program->option("CLUSTERED_LIGHTS") : 0);
+  if (uniforms.deferred) {
+    key = m_program->option("GBUFFER");
+  }
+  Program & program = m_program->select(key);
+  if (not m_program->outdated(uniforms.version)) {
+    return false;
+  }
+  program.bind();
+  program.setUniform("V", uniforms.view);
+  program.setUniform("P", uniforms.proj);
+  program.setUniform("positionCameraInWorld", uniforms.cameraPosition);
+  if (key & m_program->option("CLUSTERED_LIGHTS")) {
+    uniforms.lights->setUniforms(program);
+  }
+  program.unbind();
+  return true;
+}
+
+void PA5Application::RenderObjectPart::cull(const Frustum & frustum, const glm::vec3 & viewpoint, bool backfaceCulling, unsigned int lod, CullingStatistics & stats)
+{
+  if (m_lods.empty()) {
+    return;
+  }
+  const LevelOfDetail & level = m_lods[std::min<size_t>(lod, m_lods.size() - 1)];
+  stats.nbTriangles += level.count / 3;
+  if (m_meshlets.empty()) {
+    return;
+  }
+  m_visibleOffsets.clear();
+  m_visibleCounts.clear();
+  for (unsigned int k = level.firstMeshlet; k < level.firstMeshlet + level.nbMeshlets; k++) {
+    const Meshlet & meshlet = m_meshlets[k];
+    if (not frustum.intersects(meshlet.bounds)) {
+      stats.nbFrustumCulled += meshlet.count / 3;
+    } else if (backfaceCulling and meshlet.cone.backfacing(meshlet.bounds, viewpoint)) {
+      stats.nbBackfaceCulled += meshlet.count / 3;
+    } else if (not m_visibleCounts.empty() and m_visibleOffsets.back() + m_visibleCounts.back() == meshlet.offset) {
+      m_visibleCounts.back() += meshlet.count; // merge with the previous range
+    } else {
+      m_visibleOffsets.push_back(meshlet.offset);
+      m_visibleCounts.push_back(meshlet.count);
+    }
   }
-  m_program->unbind();
 }
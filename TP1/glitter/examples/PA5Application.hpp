@@ -3,6 +3,15 @@
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "Bounds.hpp"
+#include "ClusteredLights.hpp"
+#include "GBuffer.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "OcclusionCuller.hpp"
+#include "RenderQueue.hpp"
+#include "TextureStreamer.hpp"
+#include "Versioned.hpp"
 #include "glApi.hpp"
 
 // forward declarations
@@ -15,10 +24,20 @@ public:
   static void usage(std::string & shortDescritpion, std::string & synopsis, std::string & description);
 
 public:
-  static bool displayNormals; ///< Toggles normal display
+  static bool displayNormals;    ///< Toggles normal display
+  static bool textureStreaming;  ///< Toggles the streaming of the levels of the material textures
+  static size_t textureBudget;   ///< GPU memory available to the streamed textures (in bytes)
+  static unsigned int nbCopies;  ///< Number of copies of the wavefront objects (laid out on a grid), to measure the rendering of many objects
+  static bool occlusionCulling;  ///< Toggles the culling of the objects hidden by the occluders
+  static unsigned int nbLights;  ///< Number of point and spot lights moving over the scene
+  static bool clusteredLighting; ///< Toggles the point and spot lights (shaded by clustered forward lighting)
+  static bool deferredShading;   ///< Toggles deferred shading (the material programs filling a G-buffer, shaded by a full screen lighting pass)
+  static bool depthPrepass;      ///< Toggles the depth pre-pass (the shading pass then only shades the visible fragments)
 
 private:
   void renderFrame() override;
+  /// draws the opaque draw calls of the render queue (after the depth pre-pass if enabled), counting the shaded fragments
+  void drawOpaque(SamplesQuery & shaded);
   void update() override;
   static void resize(GLFWwindow * window, int framebufferWidth, int framebufferHeight);
   static void keyCallback(GLFWwindow * window, int key, int scancode, int action, int mods);
@@ -26,18 +45,85 @@ private:
   void computeView(bool reset = false);
 
 private:
+  /// Triangle counts of a frame, measuring the efficiency of the meshlet culling
+  struct CullingStatistics {
+    unsigned int nbTriangles;      ///< triangles of the levels of detail to be drawn
+    unsigned int nbFrustumCulled;  ///< triangles of the meshlets lying outside the view frustum
+    unsigned int nbBackfaceCulled; ///< triangles of the meshlets facing away from the camera
+    unsigned int nbDrawnParts;     ///< object parts intersecting the view frustum
+    unsigned int nbCulledParts;    ///< object parts lying outside the view frustum (possibly with their whole object)
+    unsigned int nbOccludedParts;  ///< object parts of the objects hidden by the occluders (also counted in nbCulledParts)
+
+    CullingStatistics() : nbTriangles(0), nbFrustumCulled(0), nbBackfaceCulled(0), nbDrawnParts(0), nbCulledParts(0), nbOccludedParts(0) {}
+
+    CullingStatistics & operator+=(const CullingStatistics & other)
+    {
+      nbTriangles += other.nbTriangles;
+      nbFrustumCulled += other.nbFrustumCulled;
+      nbBackfaceCulled += other.nbBackfaceCulled;
+      nbDrawnParts += other.nbDrawnParts;
+      nbCulledParts += other.nbCulledParts;
+      nbOccludedParts += other.nbOccludedParts;
+      return *this;
+    }
+  };
+
+  /// The inputs of the uniform variables of the material programs, in a frame
+  struct FrameUniforms {
+    glm::mat4 proj;                 ///< projection matrix
+    glm::mat4 view;                 ///< worldView matrix
+    glm::vec3 cameraPosition;       ///< camera center in world space
+    const ClusteredLights * lights; ///< the point and spot lights (null to shade only the directional lights)
+    bool displayNormals;            ///< denotes if the normals are displayed instead of the shading
+    bool deferred;                  ///< denotes if the parts are drawn into the G-buffer (the other options being left to the lighting pass)
+    unsigned int version;           ///< version of the camera (see Versioned), the uniforms being only set again when it changes
+  };
+
   class RenderObjectPart {
   public:
     RenderObjectPart() = delete;
-    RenderObjectPart(const RenderObjectPart &) = delete;
+    RenderObjectPart(const RenderObjectPart &) = default; ///< the copies share the GPU resources (see RenderObject::createCopy)
     RenderObjectPart(RenderObjectPart &&) = default;
-    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture, std::shared_ptr<Texture> stexture);
-    void draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap);
-    void update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals);
+    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<ProgramVariants> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture, std::shared_ptr<Texture> stexture,
+                     const std::vector<LevelOfDetail> & lods = std::vector<LevelOfDetail>(), const std::vector<Meshlet> & meshlets = std::vector<Meshlet>());
+
+    /**
+     * @brief adds the draw call of this part to a render queue
+     * @param queue the render queue
+     * @param samplers the samplers of the diffuse, normal and specular maps
+     * @param lod the level of detail to be drawn
+     * @param mw the modelWorld matrix
+     * @param depth the distance between the camera and the part (in view space)
+     * @param slot the slot of the queue receiving the draw call
+     */
+    void submit(RenderQueue & queue, const Sampler * const samplers[3], unsigned int lod, const glm::mat4 & mw, float depth, unsigned int slot) const;
+    /**
+     * @brief selects the variant of the program and updates its uniform variables (but the modelWorld matrix)
+     * @param uniforms the inputs of the uniform variables
+     * @return false if the variant was already up to date
+     */
+    bool update(const FrameUniforms & uniforms);
+
+    /**
+     * @brief selects the meshlets of a level of detail to be drawn
+     * @param frustum the view frustum (in object space)
+     * @param viewpoint the camera position (in object space)
+     * @param backfaceCulling denotes if meshlets facing away from the camera can be culled
+     * @param lod the level of detail to be drawn
+     * @param stats the statistics to be updated
+     */
+    void cull(const Frustum & frustum, const glm::vec3 & viewpoint, bool backfaceCulling, unsigned int lod, CullingStatistics & stats);
+
+    /// number of levels of detail available for this part
+    unsigned int nbLODs() const;
 
   private:
+    std::vector<LevelOfDetail> m_lods;    ///< IBO ranges of the levels of detail (the whole IBO is drawn if empty)
+    std::vector<Meshlet> m_meshlets;      ///< meshlets of all the levels of detail (the level is drawn as a whole if empty)
+    std::vector<uint> m_visibleOffsets;   ///< IBO offsets of the meshlet ranges which survived the culling
+    std::vector<GLsizei> m_visibleCounts; ///< IBO counts of the meshlet ranges which survived the culling
     std::shared_ptr<VAO> m_vao;
-    std::shared_ptr<Program> m_program;
+    std::shared_ptr<ProgramVariants> m_program;
     std::shared_ptr<Texture> m_diffuseTexture;
     std::shared_ptr<Texture> m_normalTexture;
     std::shared_ptr<Texture> m_specularTexture;
@@ -58,9 +144,18 @@ private:
      * @brief creates an instance from a wavefront file and modelWorld matrix
      * @param objname the filename of the wavefront file
      * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     * @param textureStreamer if not null, streams the levels of the material textures (which are fully loaded otherwise)
      * @return the created RenderObject as a smart pointer
      */
-    static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld);
+    static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld, TextureStreamer * textureStreamer = nullptr);
+
+    /**
+     * @brief creates a copy of a RenderObject at another place
+     * @param model the RenderObject to be copied
+     * @param modelWorld the modelWorld matrix of the copy
+     * @return the created RenderObject, sharing the programs, textures, samplers and VAOs of @p model
+     */
+    static std::unique_ptr<RenderObject> createCopy(const RenderObject & model, const glm::mat4 & modelWorld);
 
     /**
      * @brief Sets all uniform variables related to material and lighting
@@ -68,41 +163,122 @@ private:
      * @param material
      *
      * @note Besides the material, three directional lights (defined in world space) are passed to the GLSL program.
+     * It is the setup of the variants of the programs of the parts (see ProgramVariants), called once per variant.
      */
-    void setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const;
+    void setProgramMaterial(Program & program, const SimpleMaterial & material) const;
 
     /**
-     * @brief Draw this RenderObject
+     * @brief adds the draw calls of the parts of this RenderObject which survived the last culling to a render queue
+     * @param queue the render queue
+     * @param view the worldView matrix
+     * @param slot the slot of the queue receiving the draw calls
      */
-    void draw();
+    void submit(RenderQueue & queue, const glm::mat4 & view, unsigned int slot) const;
 
     /**
-     * @brief update the program MVP uniform variable
+     * @brief bounding sphere of this RenderObject
+     * @return a sphere enclosing the object (in world space)
+     */
+    BoundingSphere worldBounds() const;
+
+    /// axis aligned box enclosing this RenderObject (in world space)
+    BoundingBox worldBox() const;
+
+    /// the occluder of this RenderObject (the full resolution triangles of some of its parts), null if it has none
+    const OccluderMesh * occluder() const { return m_occluder.get(); }
+
+    /**
+     * @brief tests the parts of this RenderObject against the view frustum
+     * @param frustum the view frustum (in world space)
+     * @return the number of parts to be drawn
+     */
+    unsigned int cull(const Frustum & frustum);
+
+    /// number of parts of this RenderObject
+    unsigned int nbParts() const;
+
+    /// modelWorld matrix of this RenderObject
+    const glm::mat4 & modelWorld() const { return m_mw; }
+
+    /**
+     * @brief update the uniform variables of the programs (but the modelWorld matrix, set at draw time)
+     * @param uniforms the inputs of the uniform variables
+     * @return the number of programs whose uniforms were set (none if the camera did not change since their last update)
+     *
+     * @note the copies of this RenderObject (see createCopy) share its programs, hence need no update
+     */
+    unsigned int updatePrograms(const FrameUniforms & uniforms);
+
+    /**
+     * @brief select the level of detail and cull the meshlets
      * @param proj the projection matrix
      * @param view the worldView matrix
+     * @param stats the culling statistics to be updated
+     *
+     * @note this method does not call OpenGL, hence can be called concurrently for distinct RenderObjects
      */
-    void update(const glm::mat4 & proj, const glm::mat4 & view);
+    void update(const glm::mat4 & proj, const glm::mat4 & view, CullingStatistics & stats);
+
+    /// request the texture levels needed at the on-screen size computed by the last update
+    void requestTextures();
 
   private:
     RenderObject(const glm::mat4 & modelWorld);
-    void loadWavefront(const std::string & objname);
+    void loadWavefront(const std::string & objname, TextureStreamer * textureStreamer);
 
   private:
     glm::mat4 m_mw; ///< modelWorld matrix
     std::vector<RenderObjectPart> m_parts;
-    std::unique_ptr<Sampler> m_diffusemap;
-    std::unique_ptr<Sampler> m_normalmap;
-    std::unique_ptr<Sampler> m_specularmap;
+    BoundingSphere m_bounds;                               ///< bounding sphere (in object space)
+    std::vector<BoundingBox> m_objectPartBounds;           ///< bounding boxes of the parts (in object space)
+    std::vector<BoundingBox> m_partBounds;                 ///< bounding boxes of the parts (in world space)
+    std::vector<unsigned char> m_partsDrawn;               ///< 1 for the parts which survived the last culling
+    unsigned int m_lod;                                    ///< level of detail currently drawn
+    float m_projectedSize;                                 ///< on-screen size computed by the last update
+    TextureStreamer * m_textureStreamer;                   ///< streamer of the material textures (null if they are fully loaded)
+    std::vector<std::vector<unsigned int>> m_partTextures; ///< identifiers in m_textureStreamer of the textures of each part
+    std::shared_ptr<OccluderMesh> m_occluder;              ///< part of the geometry hiding the other objects (null if none), shared by the copies
+    std::shared_ptr<Sampler> m_diffusemap;
+    std::shared_ptr<Sampler> m_normalmap;
+    std::shared_ptr<Sampler> m_specularmap;
   };
 
 private:
   std::vector<std::unique_ptr<RenderObject>> m_objects; ///< render objects
-  glm::mat4 m_proj;                                     ///< Projection matrix
-  glm::mat4 m_view;                                     ///< worldView matrix
+  size_t m_nbModels;                                    ///< number of render objects owning their programs (the next ones are copies)
+  Versioned<glm::mat4> m_proj;                          ///< Projection matrix
+  Versioned<glm::mat4> m_view;                          ///< worldView matrix
+  glm::vec3 m_cameraPosition;                           ///< camera center in world space (follows m_view)
   float m_eyePhi;                                       ///< Camera position longitude angle
   float m_eyeTheta;                                     ///< Camera position latitude angle
   float m_currentTime;                                  ///< elapsed time since first frame
   float m_deltaTime;                                    ///< elapsed time since last frame
+  std::vector<BoundingSphere> m_objectBounds;           ///< bounding spheres of the render objects (in world space)
+  std::vector<unsigned char> m_objectsDrawn;            ///< 1 for the render objects which survived the frustum culling
+  std::vector<BoundingBox> m_objectBoxes;               ///< bounding boxes of the render objects (in world space)
+  OcclusionCuller m_occlusionCuller;                    ///< depth buffer of the occluders
+  double m_occlusionTime;                               ///< time spent in the occlusion culling since the last report (in ms)
+  ClusteredLights m_lights;                             ///< the point and spot lights, and their lists per cluster
+  std::vector<glm::vec4> m_lightOrbits;                 ///< center (xyz) and phase (w) of the circle followed by each light
+  double m_lightingTime;                                ///< time spent in the building of the light lists since the last report (in ms)
+  GBuffer m_gbuffer;                                    ///< targets of the geometry pass of deferred shading
+  std::unique_ptr<ProgramVariants> m_lightingProgram;   ///< lighting pass of deferred shading (see shaders/deferred.f.glsl)
+  TimerQuery m_frameQueries[2];                         ///< GPU time of the last two frames, each one read a frame after its end
+  SamplesQuery m_shadedQueries[2];                      ///< fragments shaded by the last two frames (those passing the depth test of the shading pass)
+  unsigned int m_nbFrames;                              ///< number of frames rendered since the start
+  double m_gpuTime;                                     ///< GPU time of the frames measured since the last report (in ms)
+  unsigned int m_nbTimedFrames;                         ///< number of frames accumulated in m_gpuTime and m_shadedFragments
+  double m_shadedFragments;                             ///< fragments shaded by the frames measured since the last report
+  CullingStatistics m_cullingStats;                     ///< culling statistics accumulated since the last report
+  unsigned int m_nbCulledFrames;                        ///< number of frames accumulated in m_cullingStats
+  float m_lastReportTime;                               ///< time of the last culling report
+  std::unique_ptr<TextureStreamer> m_textureStreamer;   ///< streamer of the material textures (null if they are fully loaded)
+  RenderQueue m_renderQueue;                            ///< draw calls of the current frame
+  Program m_depthProgram;                               ///< program of the depth pre-pass, drawing the positions only
+  unsigned int m_depthProgramVersion;                   ///< version of the camera of the uniforms of m_depthProgram
+  unsigned int m_nbProgramUpdates;                      ///< programs whose uniforms were set since the last report
+  RenderQueue::Statistics m_renderStats;                ///< state changes accumulated since the last report
+  unsigned int m_nbRenderedFrames;                      ///< number of frames accumulated in m_renderStats
 };
 
 #endif // !defined(__PA5_APPLICATION_H__)
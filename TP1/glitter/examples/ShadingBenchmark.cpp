@@ -0,0 +1,219 @@
+#define GLM_FORCE_RADIANS
+#include "ShadingBenchmark.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Benchmark.hpp"
+#include "ClusteredLights.hpp"
+#include "GBuffer.hpp"
+#include "glApi.hpp"
+
+namespace
+{
+const int nbRuns = 5;
+const int width = 1280;
+const int height = 720;
+const unsigned int maxLayers = 16;
+
+/// best GPU time (in ms) of several runs of a frame
+double bestGpuTime(const std::function<void()> & frame)
+{
+  TimerQuery query;
+  double best = 0;
+  for (int i = 0; i < nbRuns; i++) {
+    query.begin();
+    frame();
+    query.end();
+    double duration = query.milliseconds();
+    best = i == 0 ? duration : std::min(best, duration);
+  }
+  return best;
+}
+
+/// a unit square in the xy plane, with the vertex attributes of the simplemat program
+std::unique_ptr<VAO> makeQuad()
+{
+  std::unique_ptr<VAO> vao(new VAO(4));
+  vao->setVBO(0, std::vector<glm::vec3>{{-0.5f, -0.5f, 0}, {0.5f, -0.5f, 0}, {-0.5f, 0.5f, 0}, {0.5f, 0.5f, 0}});
+  vao->setVBO(1, std::vector<glm::vec2>{{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+  vao->setVBO(2, std::vector<glm::vec3>(4, glm::vec3(0, 0, 1)));
+  vao->setVBO(3, std::vector<glm::vec3>(4, glm::vec3(1, 0, 0)));
+  vao->setIBO(std::vector<uint>{0, 1, 3, 0, 3, 2});
+  return vao;
+}
+
+/// sets the three dim directional lights of a bound program (see shaders/lighting.glsl)
+void setDirectionalLights(const Program & program)
+{
+  for (int k = 0; k < 3; k++) {
+    const std::string light = "lightsInWorld[" + std::to_string(k) + "]";
+    program.setUniform(light + ".direction", glm::normalize(glm::vec3(k - 1, 1, -1)));
+    program.setUniform(light + ".intensity", glm::vec3(0.2f));
+  }
+}
+
+/// sets the lights and a white material, the maps being read from the texture units 0 to 2
+void setMaterial(Program & program)
+{
+  program.bind();
+  setDirectionalLights(program);
+  program.setUniform("material.ambient", glm::vec3(0.05f));
+  program.setUniform("material.diffuse", glm::vec3(0.8f));
+  program.setUniform("material.specular", glm::vec3(0.5f));
+  program.setUniform("material.shininess", 32.f);
+  program.setUniform("material.colormap", 0);
+  program.setUniform("material.normalmap", 1);
+  program.setUniform("material.specularmap", 2);
+  program.unbind();
+}
+} // namespace
+
+void benchmarkShading(unsigned int maxLights)
+{
+  GLFWwindow * window = createBenchmarkContext("shading");
+  if (!window) {
+    std::cerr << "Could not create an OpenGL context" << std::endl;
+    return;
+  }
+  std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+  {
+    // the target of forward shading
+    Texture color(GL_TEXTURE_2D), depth(GL_TEXTURE_2D);
+    color.allocate(GL_RGBA8, width, height);
+    depth.allocate(GL_DEPTH_COMPONENT24, width, height);
+    Framebuffer target;
+    target.attach(GL_COLOR_ATTACHMENT0, color);
+    target.attach(GL_DEPTH_ATTACHMENT, depth);
+    target.setDrawBuffers(1);
+    target.complete();
+    GBuffer gbuffer(width, height);
+
+    // white maps (the normal map being unused by the material program)
+    std::vector<std::unique_ptr<Texture>> maps;
+    std::vector<GLubyte> white(4, 0xff);
+    for (int unit = 0; unit < 3; unit++) {
+      maps.emplace_back(new Texture(GL_TEXTURE_2D));
+      maps.back()->setData(Image<>(white.data(), 1, 1, 4), true);
+    }
+    std::unique_ptr<VAO> quad = makeQuad();
+    ProgramVariants materials("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl", {"CLUSTERED_LIGHTS", "GBUFFER"}, setMaterial);
+    ProgramVariants lighting("shaders/fullscreen.v.glsl", "shaders/deferred.f.glsl", {"CLUSTERED_LIGHTS"}, [&](Program & variant) {
+      variant.bind();
+      setDirectionalLights(variant);
+      gbuffer.setUniforms(variant);
+      variant.unbind();
+    });
+    Program & forwardProgram = materials.variant(materials.option("CLUSTERED_LIGHTS"));
+    Program & gbufferProgram = materials.variant(materials.option("GBUFFER"));
+    Program & lightingProgram = lighting.variant(lighting.option("CLUSTERED_LIGHTS"));
+
+    // the camera looks down the z axis, at layers filling the view between the distances 4 and 6
+    const float near = 0.1f, far = 20.f;
+    const glm::mat4 proj = glm::perspective(glm::radians(60.f), float(width) / height, near, far);
+    const glm::mat4 view(1);
+    const glm::vec3 camera(0);
+    std::vector<glm::mat4> layers;
+    for (unsigned int k = 0; k < maxLayers; k++) {
+      const float distance = 6 - 2.f * k / maxLayers;
+      layers.push_back(glm::scale(glm::translate(glm::mat4(1), glm::vec3(0, 0, -distance)), glm::vec3(2.5f * distance, 1.5f * distance, 1)));
+    }
+    for (Program * program : {&forwardProgram, &gbufferProgram}) {
+      program->bind();
+      program->setUniform("V", view);
+      program->setUniform("P", proj);
+      program->setUniform("positionCameraInWorld", camera);
+      program->unbind();
+    }
+    lightingProgram.bind();
+    lightingProgram.setUniform("V", view);
+    lightingProgram.setUniform("viewProjInverse", glm::inverse(proj * view));
+    lightingProgram.setUniform("positionCameraInWorld", camera);
+    lightingProgram.unbind();
+
+    // draws the farthest layers back to front with a bound program
+    auto drawLayers = [&](Program & program, unsigned int nbLayers) {
+      program.bind();
+      quad->bind();
+      for (unsigned int k = 0; k < nbLayers; k++) {
+        program.setUniform("M", layers[k]);
+        glDrawElements(GL_TRIANGLES, quad->nbIndices(), GL_UNSIGNED_INT, nullptr);
+      }
+      quad->unbind();
+      program.unbind();
+    };
+
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    for (int unit = 0; unit < 3; unit++) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      maps[unit]->bind();
+    }
+    glActiveTexture(GL_TEXTURE0);
+    std::cout << "GPU time of a " << width << "x" << height << " frame, forward / deferred shading (in ms), for layers drawn back to front:" << std::fixed << std::setprecision(3)
+              << std::endl;
+    std::cout << "  lights ";
+    for (unsigned int nbLayers = 1; nbLayers <= maxLayers; nbLayers *= 4) {
+      std::cout << "| " << std::setw(2) << nbLayers << " layer" << (nbLayers > 1 ? "s" : " ") << "         ";
+    }
+    std::cout << std::endl;
+    for (unsigned int nbLights = 16; nbLights <= std::max(maxLights, 16u); nbLights *= 4) {
+      // the lights lie between the camera and the layers, spread over the view
+      ClusteredLights lights;
+      lights.setProjection(proj, near, far, glm::vec2(width, height));
+      std::mt19937 random(6);
+      std::uniform_real_distribution<float> uniform(0, 1);
+      for (unsigned int k = 0; k < nbLights; k++) {
+        const float distance = 2 + 2 * uniform(random);
+        glm::vec3 position(distance * (1.2f * uniform(random) - 0.6f), distance * (0.7f * uniform(random) - 0.35f), -distance);
+        lights.add(Light::point(position, 1 + 2 * uniform(random), glm::vec3(uniform(random), uniform(random), uniform(random))));
+      }
+      lights.build(view);
+      lights.upload();
+      for (Program * program : {&forwardProgram, &lightingProgram}) {
+        program->bind();
+        lights.setUniforms(*program);
+        program->unbind();
+      }
+      lights.bind();
+      std::cout << "  " << std::setw(6) << nbLights << " ";
+      for (unsigned int nbLayers = 1; nbLayers <= maxLayers; nbLayers *= 4) {
+        double forwardTime = bestGpuTime([&]() {
+          target.bind();
+          glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+          drawLayers(forwardProgram, nbLayers);
+          target.unbind();
+        });
+        double deferredTime = bestGpuTime([&]() {
+          gbuffer.begin();
+          drawLayers(gbufferProgram, nbLayers);
+          gbuffer.end();
+          target.bind();
+          glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+          glDisable(GL_DEPTH_TEST);
+          gbuffer.bindTextures();
+          lightingProgram.bind();
+          gbuffer.drawFullScreen();
+          lightingProgram.unbind();
+          gbuffer.unbindTextures();
+          glEnable(GL_DEPTH_TEST);
+          target.unbind();
+        });
+        std::cout << "| " << std::setw(7) << forwardTime << " / " << std::setw(7) << deferredTime << " ";
+      }
+      std::cout << std::endl;
+      lights.unbind();
+    }
+    for (int unit = 0; unit < 3; unit++) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      maps[unit]->unbind();
+    }
+    glActiveTexture(GL_TEXTURE0);
+  }
+  destroyBenchmarkContext(window);
+}
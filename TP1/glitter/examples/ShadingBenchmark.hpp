@@ -0,0 +1,17 @@
+#ifndef __SHADING_BENCHMARK_H__
+#define __SHADING_BENCHMARK_H__
+
+/**
+ * @brief compares forward and deferred shading, for increasing numbers of lights and depth complexities
+ * @param maxLights the largest number of point lights
+ *
+ * The scene is a stack of layers covering a 1280x720 offscreen target, drawn back to front (each layer
+ * hiding the previous ones, which is the worst case of forward shading) with the material program of PA5
+ * (see shaders/simplemat.f.glsl) and clustered point lights (see ClusteredLights). Forward shading lights
+ * every fragment of every layer, while deferred shading writes the layers into a GBuffer and then lights
+ * each pixel once (see shaders/deferred.f.glsl). For 16 to @p maxLights lights and 1 to 16 layers, prints
+ * the GPU time of a frame (the best of several runs, measured by a TimerQuery) of both paths.
+ */
+void benchmarkShading(unsigned int maxLights);
+
+#endif // !defined(__SHADING_BENCHMARK_H__)
@@ -0,0 +1,87 @@
+#define GLM_FORCE_RADIANS
+#include "TessellationBenchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <glm/gtc/constants.hpp>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "ParamSurface.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+const int nbRuns = 3;
+
+/// best duration (in ms) of several runs of a function
+double bestTime(const std::function<void()> & run)
+{
+  double best = 0;
+  for (int i = 0; i < nbRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    best = i == 0 ? duration : std::min(best, duration);
+  }
+  return best;
+}
+
+/// the former tessellation: a std::function call per vertex, vectors grown one element at a time, two triangles per quad
+void referenceTessellation(DiscreteLinRange rgPhi, DiscreteLinRange rgTheta, const std::function<glm::vec3(float, float)> & posFunc, bool isCyclicInPhi, bool isCyclicInTheta,
+                           std::vector<glm::vec3> & positions, std::vector<unsigned int> & ibo)
+{
+  auto index = [&](unsigned int i, unsigned int j) { return (i % rgPhi.nbVals) * rgTheta.nbVals + (j % rgTheta.nbVals); };
+  for (unsigned int kPhi = 0; kPhi < rgPhi.nbVals; kPhi++) {
+    for (unsigned int kTheta = 0; kTheta < rgTheta.nbVals; kTheta++) {
+      positions.push_back(posFunc(rgPhi.value(kPhi), rgTheta.value(kTheta)));
+      if ((kPhi == rgPhi.nbVals - 1 and not isCyclicInPhi) or (kTheta == rgTheta.nbVals - 1 and not isCyclicInTheta)) {
+        continue;
+      }
+      unsigned int patchIndices[] = {
+          index(kPhi, kTheta),     index(kPhi + 1, kTheta), index(kPhi, kTheta + 1),     // first triangle
+          index(kPhi, kTheta + 1), index(kPhi + 1, kTheta), index(kPhi + 1, kTheta + 1), // second triangle
+      };
+      ibo.insert(ibo.end(), patchIndices, patchIndices + 6);
+    }
+  }
+}
+} // namespace
+
+void benchmarkTessellation(unsigned int resolution)
+{
+  const float pi = glm::pi<float>();
+  const DiscreteLinRange rgPhi(resolution, 0, 2 * pi), rgTheta(resolution, 0, pi);
+  auto position = [](float phi, float theta) { return glm::vec3(std::cos(phi) * std::sin(theta), std::sin(phi) * std::sin(theta), 1 - std::cos(theta)); };
+  auto normal = [](float phi, float theta) { return glm::vec3(std::cos(phi) * std::sin(theta), std::sin(phi) * std::sin(theta), -std::cos(theta)); };
+  ThreadPool singleThread(0);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Sphere of " << resolution << "x" << resolution << " vertices:" << std::endl;
+  size_t nbIndices = 0;
+  double referenceTime = bestTime([&]() {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> ibo;
+    referenceTessellation(rgPhi, rgTheta, position, true, false, positions, ibo);
+    nbIndices = ibo.size();
+  });
+  std::cout << "  std::function, triangles (reference)  : " << referenceTime << " ms, " << nbIndices << " indices" << std::endl;
+
+  TessellationOptions options;
+  options.pool = &singleThread;
+  double trianglesTime = bestTime([&]() { nbIndices = tessellate(rgPhi, rgTheta, position, true, false, options).indices.size(); });
+  std::cout << "  tessellate, triangles, 1 thread       : " << trianglesTime << " ms (speedup " << referenceTime / trianglesTime << "), " << nbIndices << " indices" << std::endl;
+
+  options.strips = true;
+  double stripsTime = bestTime([&]() { nbIndices = tessellate(rgPhi, rgTheta, position, true, false, options).indices.size(); });
+  std::cout << "  tessellate, strips, 1 thread          : " << stripsTime << " ms (speedup " << referenceTime / stripsTime << "), " << nbIndices << " indices" << std::endl;
+
+  options.pool = &ThreadPool::global();
+  options.normals = true;
+  double parallelTime = bestTime([&]() { nbIndices = tessellate(rgPhi, rgTheta, position, normal, true, false, options).indices.size(); });
+  const size_t nbThreads = ThreadPool::global().size() + 1;
+  const std::string label = "tessellate, strips, normals, " + std::to_string(nbThreads) + (nbThreads > 1 ? " threads" : " thread");
+  std::cout << "  " << std::left << std::setw(38) << label << std::right << ": " << parallelTime << " ms (speedup " << referenceTime / parallelTime << "), " << nbIndices
+            << " indices" << std::endl;
+}
@@ -0,0 +1,15 @@
+#ifndef __TESSELLATION_BENCHMARK_H__
+#define __TESSELLATION_BENCHMARK_H__
+
+/**
+ * @brief compares the tessellation of a parametric surface by tessellate() with a per-vertex std::function implementation
+ * @param resolution the number of vertices in each parameter (the surface having resolution x resolution vertices)
+ *
+ * The surface is a sphere. Prints the time (the best of several runs) of: the reference, calling a
+ * std::function per vertex and growing its vectors, with two triangles per quad; tessellate() on one thread
+ * with triangles, then with triangle strips; and tessellate() on all the cores with triangle strips and
+ * analytic normals.
+ */
+void benchmarkTessellation(unsigned int resolution);
+
+#endif // !defined(__TESSELLATION_BENCHMARK_H__)
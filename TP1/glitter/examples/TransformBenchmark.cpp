@@ -0,0 +1,127 @@
+#define GLM_FORCE_RADIANS
+#include "TransformBenchmark.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Benchmark.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include "TransformBatch.hpp"
+#include "glApi.hpp"
+
+namespace
+{
+const int nbRuns = 5;
+const size_t instancesPerRun = 2000000; ///< matrices transformed by each run (several frames for the small sets)
+
+/// best duration (in ms) of a frame, over several runs of several frames
+double bestFrameTime(size_t nbInstances, const std::function<void()> & frame)
+{
+  const size_t nbFrames = std::max<size_t>(instancesPerRun / nbInstances, 1);
+  double best = 0;
+  for (int i = 0; i < nbRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < nbFrames; f++) {
+      frame();
+    }
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / nbFrames;
+    best = i == 0 ? duration : std::min(best, duration);
+  }
+  return best;
+}
+
+/// random rotations, non uniform scales and translations
+std::vector<glm::mat4> makeMatrices(size_t count)
+{
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> uniform(-1, 1);
+  std::vector<glm::mat4> matrices(count);
+  for (auto & matrix : matrices) {
+    glm::vec3 axis = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + 0.01f);
+    matrix = glm::translate(glm::mat4(1), 50.f * glm::vec3(uniform(random), uniform(random), uniform(random)));
+    matrix = glm::rotate(matrix, glm::pi<float>() * uniform(random), axis);
+    matrix = glm::scale(matrix, glm::vec3(1) + 0.5f * glm::vec3(uniform(random), uniform(random), uniform(random)));
+  }
+  return matrices;
+}
+
+/// largest absolute difference between the coefficients of two sets of matrices
+template <typename M> float maxDifference(const std::vector<M> & a, const std::vector<M> & b)
+{
+  float difference = 0;
+  for (size_t k = 0; k < a.size(); k++) {
+    for (int c = 0; c < a[k].length(); c++) {
+      for (int r = 0; r < a[k][c].length(); r++) {
+        difference = std::max(difference, std::abs(a[k][c][r] - b[k][c][r]));
+      }
+    }
+  }
+  return difference;
+}
+} // namespace
+
+void benchmarkTransforms(size_t maxInstances)
+{
+  GLFWwindow * window = createBenchmarkContext("transforms");
+  if (!window) {
+    std::cerr << "Could not create an OpenGL context, the uploads will not be measured" << std::endl;
+  } else {
+    std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+  }
+  {
+    ThreadPool singleThread(0);
+    ThreadPool & pool = ThreadPool::global();
+    const glm::mat4 proj = glm::perspective(glm::radians(60.f), 16 / 9.f, 0.1f, 200.f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(60, 40, 30), glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
+    std::unique_ptr<Buffer> instances(window ? new Buffer() : nullptr);
+    std::cout << "Time per frame of the MVP and normal matrices (simd::Float::width = " << simd::Float::width << ", " << pool.size() + 1 << " threads):" << std::endl;
+    for (size_t nbInstances = 100; nbInstances <= std::max<size_t>(maxInstances, 100); nbInstances *= 10) {
+      std::vector<glm::mat4> matrices = makeMatrices(nbInstances);
+      TransformBatch batch;
+      for (const auto & matrix : matrices) {
+        batch.add(matrix);
+      }
+      std::vector<glm::mat4> mvps(nbInstances), batchMvps(nbInstances);
+      std::vector<glm::mat3> normals(nbInstances), batchNormals(nbInstances);
+
+      double glmTime = bestFrameTime(nbInstances, [&]() {
+        for (size_t k = 0; k < nbInstances; k++) {
+          mvps[k] = proj * view * matrices[k];
+          normals[k] = glm::inverseTranspose(glm::mat3(view * matrices[k]));
+        }
+      });
+      // the normal matrices are optional (e.g. PA3 only reads the MVP matrices)
+      double glmMvpTime = bestFrameTime(nbInstances, [&]() {
+        for (size_t k = 0; k < nbInstances; k++) {
+          mvps[k] = proj * view * matrices[k];
+        }
+      });
+      double batchMvpTime = bestFrameTime(nbInstances, [&]() { batch.compute(proj, view, batchMvps.data(), nullptr, singleThread); });
+      double batchTime = bestFrameTime(nbInstances, [&]() { batch.compute(proj, view, batchMvps.data(), batchNormals.data(), singleThread); });
+      double parallelTime = bestFrameTime(nbInstances, [&]() { batch.compute(proj, view, batchMvps.data(), batchNormals.data(), pool); });
+
+      std::cout << std::setw(8) << nbInstances << " instances:" << std::fixed << std::setprecision(3) << std::endl;
+      std::cout << "  glm, per instance   : " << glmTime << " ms (reference)" << std::endl;
+      std::cout << "  batch, 1 thread     : " << batchTime << " ms (speedup " << glmTime / batchTime << ")" << std::endl;
+      std::cout << "  batch, all threads  : " << parallelTime << " ms (speedup " << glmTime / parallelTime << ")" << std::endl;
+      if (instances) {
+        double uploadTime = bestFrameTime(nbInstances, [&]() { batch.upload(*instances, proj, view, true, pool); });
+        std::cout << "  batch, mapped buffer: " << uploadTime << " ms (speedup " << glmTime / uploadTime << ")" << std::endl;
+      }
+      std::cout << "  MVP only, glm       : " << glmMvpTime << " ms (reference)" << std::endl;
+      std::cout << "  MVP only, batch     : " << batchMvpTime << " ms (speedup " << glmMvpTime / batchMvpTime << ")" << std::endl;
+      std::cout << std::scientific << std::setprecision(1) << "  max difference      : " << maxDifference(mvps, batchMvps) << " (MVP), " << maxDifference(normals, batchNormals)
+                << " (normal)" << std::endl;
+    }
+  }
+  destroyBenchmarkContext(window);
+}
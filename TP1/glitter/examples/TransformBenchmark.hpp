@@ -0,0 +1,16 @@
+#ifndef __TRANSFORM_BENCHMARK_H__
+#define __TRANSFORM_BENCHMARK_H__
+#include <cstddef>
+
+/**
+ * @brief compares the computation of the model-view-projection and normal matrices of instances with glm and with a TransformBatch
+ * @param maxInstances the size of the largest set of instances (sets of 100, 1000, ... instances are measured up to this size)
+ *
+ * For each set, prints the time per frame of: glm, one instance at a time; TransformBatch::compute on one
+ * thread, then on all the cores; and TransformBatch::upload into a mapped instance buffer (if an OpenGL
+ * context is available); then the MVP matrices alone, with glm and TransformBatch::compute on one thread.
+ * The largest difference between the glm and the batched matrices is printed too.
+ */
+void benchmarkTransforms(size_t maxInstances);
+
+#endif // !defined(__TRANSFORM_BENCHMARK_H__)
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 // matrix and vectors
@@ -9,6 +11,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 // loading stuffs
+#include "ComputeBenchmark.hpp"
+#include "DrawBenchmark.hpp"
+#include "MipmapBenchmark.hpp"
+#include "ShadingBenchmark.hpp"
+#include "TessellationBenchmark.hpp"
+#include "TransformBenchmark.hpp"
+#include "ObjLoader.hpp"
 #include "PA1Application.hpp"
 #include "PA2Application.hpp"
 #include "PA3Application.hpp"
@@ -41,7 +50,21 @@ void printUsage(int argc, char * argv[])
               << "  pa2         " << pa2ShortDescription << "\n"
               << "  pa3         " << pa3ShortDescription << "\n"
               << "  pa4         " << pa4ShortDescription << "\n"
-              << "  pa5         " << pa5ShortDescription << "\n";
+              << "  pa5         " << pa5ShortDescription << "\n"
+              << "  meshinfo    "
+              << "load meshes (all the ones in meshes/ if none is given in <args>) and print their statistics\n"
+              << "  mipbench    "
+              << "compare the CPU mipmap generation with glGenerateMipmap (on the pallet maps if no image is given in <args>)\n"
+              << "  drawbench   "
+              << "measure the recording of the draw calls of a synthetic scene on 1 to all the cores (of 10000 objects if no count is given in <args>)\n"
+              << "  xformbench  "
+              << "compare the batched SIMD computation of instance matrices with glm, for 100 to 1000000 instances (or the count given in <args>)\n"
+              << "  tessbench   "
+              << "measure the tessellation of a parametric surface of 4096x4096 vertices (or the resolution given in <args>)\n"
+              << "  compbench   "
+              << "compare the transformation of 1000000 points (or the count given in <args>) on the CPU and by a compute shader\n"
+              << "  shadebench  "
+              << "compare forward and deferred shading for 16 to 1024 lights (or the count given in <args>) and 1 to 16 layers\n";
   } else {
     std::string name = argv[2];
     std::string shortDescription;
@@ -92,7 +115,64 @@ int main(int argc, char * argv[])
     app = new PA4Application(640, 480);
   } else if (!strcmp(argv[1], "pa5")) {
     PA5Application::displayNormals = false;
+    if (argc >= 3) {
+      PA5Application::nbCopies = std::max(atoi(argv[2]), 1);
+    }
+    if (argc >= 4) {
+      PA5Application::nbLights = std::max(atoi(argv[3]), 0);
+    }
     app = new PA5Application(640, 480);
+  } else if (!strcmp(argv[1], "meshinfo")) {
+    std::vector<std::string> filenames(argv + 2, argv + argc);
+    if (filenames.empty()) {
+      filenames = listFiles("meshes", ".obj");
+    }
+    for (const auto & filename : filenames) {
+      std::cout << termcolor::bold << filename << termcolor::reset << std::endl;
+      ObjLoader loader(filename);
+      std::cout << "Peak RSS : " << peakResidentSetSize() / (1024 * 1024) << " MB" << std::endl;
+    }
+    exit(0);
+  } else if (!strcmp(argv[1], "mipbench")) {
+    std::vector<std::string> filenames(argv + 2, argv + argc);
+    if (filenames.empty()) {
+      filenames = listFiles("meshes/Pallet", ".png");
+    }
+    benchmarkMipmaps(filenames);
+    exit(0);
+  } else if (!strcmp(argv[1], "drawbench")) {
+    unsigned int nbObjects = 10000;
+    if (argc >= 3) {
+      nbObjects = std::max(atoi(argv[2]), 1);
+    }
+    exit(benchmarkDrawing(nbObjects) ? EXIT_SUCCESS : EXIT_FAILURE);
+  } else if (!strcmp(argv[1], "xformbench")) {
+    size_t maxInstances = 1000000;
+    if (argc >= 3) {
+      maxInstances = std::max(atoi(argv[2]), 1);
+    }
+    benchmarkTransforms(maxInstances);
+    exit(0);
+  } else if (!strcmp(argv[1], "tessbench")) {
+    unsigned int resolution = 4096;
+    if (argc >= 3) {
+      resolution = std::max(atoi(argv[2]), 2);
+    }
+    benchmarkTessellation(resolution);
+    exit(0);
+  } else if (!strcmp(argv[1], "compbench")) {
+    size_t nbPoints = 1000000;
+    if (argc >= 3) {
+      nbPoints = std::max(atoi(argv[2]), 1);
+    }
+    exit(benchmarkCompute(nbPoints) ? EXIT_SUCCESS : EXIT_FAILURE);
+  } else if (!strcmp(argv[1], "shadebench")) {
+    unsigned int maxLights = 1024;
+    if (argc >= 3) {
+      maxLights = std::max(atoi(argv[2]), 16);
+    }
+    benchmarkShading(maxLights);
+    exit(0);
   }
   app->setCallbacks();
   app->mainLoop();
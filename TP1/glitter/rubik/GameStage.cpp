@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "RubikSolver.hpp"
 
 StartMenuStage::StartMenuStage()
 {
@@ -37,15 +38,31 @@ void StartMenuStage::resize(GLFWwindow * window, int framebufferWidth, int frame
 
 void PlayingStage::turnClockwise(unsigned int faceID)
 {
-  if (m_renderer.isLocked()) {
+  if (m_renderer.isLocked() or not m_pendingTurns.empty()) {
     return;
   }
-  RubikFace face = m_renderer.getFace(faceID);
+  turn(m_renderer.getFace(faceID));
+}
+
+void PlayingStage::turn(const RubikFace & face)
+{
   std::array<uint, 9> pieces = m_state.piecesOnFace(face);
   m_renderer.launchFaceRotation(face, pieces);
   m_state.applyFaceRotation(face);
 }
 
+void PlayingStage::solve()
+{
+  std::vector<RubikMove> solution;
+  if (not m_pendingTurns.empty() or not RubikSolver().solve(RubikCubies(m_state), solution)) {
+    return;
+  }
+  std::cout << "solution (" << solution.size() << " moves): " << RubikMove::name(solution) << std::endl;
+  for (const auto & move : solution) {
+    m_pendingTurns.insert(m_pendingTurns.end(), move.turns, move.face);
+  }
+}
+
 std::unique_ptr<GameStage> StartMenuStage::nextStage() const
 {
   return std::unique_ptr<GameStage>(new PlayingStage());
@@ -62,6 +79,10 @@ void PlayingStage::renderFrame()
 void PlayingStage::update()
 {
   m_renderer.update();
+  if (not m_pendingTurns.empty() and not m_renderer.isLocked()) {
+    turn(RubikFace(m_pendingTurns.front()));
+    m_pendingTurns.pop_front();
+  }
 }
 
 void PlayingStage::keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
@@ -75,6 +96,9 @@ void PlayingStage::keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*
       m_displayHelp = not m_displayHelp;
       break;
     }
+    case 'S':
+      solve();
+      break;
     case GLFW_KEY_UP: {
       if (not m_renderer.isLocked()) {
         glm::vec3 right{1, 0, 0};
@@ -1,6 +1,7 @@
 #ifndef __GAME_STAGE_H__
 #define __GAME_STAGE_H__
 
+#include <deque>
 #include "RubikLogic.hpp"
 #include "RubikRenderer.hpp"
 #include "TextPrinter.hpp"
@@ -67,6 +68,8 @@ public:
     m_helper.printText(std::string(w1, ' ') + "horizontally ", 0, 2, fontSize, blue, fillColor, w1 + w2);
     m_helper.printText("up / down :", 0, 3, fontSize, red, fillColor, w1);
     m_helper.printText("rotate cube vertically", w1, 3, fontSize, blue, fillColor, w2);
+    m_helper.printText("    s     :", 0, 4, fontSize, red, fillColor, w1);
+    m_helper.printText("solve the cube", w1, 4, fontSize, blue, fillColor, w2);
   }
 
   void renderFrame() override;
@@ -82,11 +85,18 @@ public:
 private:
   void turnClockwise(unsigned int faceID);
 
+  /// Animates and applies a quarter turn of a face
+  void turn(const RubikFace & face);
+
+  /// Queues the turns solving the cube
+  void solve();
+
 private:
-  RubikRenderer m_renderer; ///< the rubik's cube renderer
-  RubikState m_state;       ///< the rubik's cube state
+  RubikRenderer m_renderer;                 ///< the rubik's cube renderer
+  RubikState m_state;                       ///< the rubik's cube state
   TextPrinter m_helper;
   bool m_displayHelp;
+  std::deque<RubikFaceName> m_pendingTurns; ///< quarter turns of the solution being played
 };
 
 /// game over menu
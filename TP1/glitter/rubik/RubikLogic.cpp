@@ -1,4 +1,16 @@
 #include "RubikLogic.hpp"
+#include <algorithm>
+#include "Simd.hpp"
+
+namespace
+{
+/// index of the piece of a facet
+uint facetPiece(uint facet)
+{
+  RubikFacet f(facet);
+  return RubikPiece(RubikFace(f.face), f.a, f.b);
+}
+} // namespace
 
 RubikFace::RubikFace(RubikFaceName name) : name(name), prev(RubikFaceName((uint(name) + 5) % 6)), next(RubikFaceName((uint(name) + 1) % 6))
 {
@@ -7,51 +19,11 @@ RubikFace::RubikFace(RubikFaceName name) : name(name), prev(RubikFaceName((uint(
 
 void RubikFace::computeTangentSpace()
 {
-  switch (name) {
-  case RubikFaceName::F:
-    t = {1, 0, 0};
-    b = {0, 1, 0};
-    n = {0, 0, 1};
-    assert(prev == RubikFaceName::T);
-    assert(next == RubikFaceName::R);
-    break;
-  case RubikFaceName::R:
-    t = {0, -1, 0};
-    b = {0, 0, 1};
-    n = {-1, 0, 0};
-    assert(prev == RubikFaceName::F);
-    assert(next == RubikFaceName::D);
-    break;
-  case RubikFaceName::D:
-    t = {0, 0, 1};
-    b = {1, 0, 0};
-    n = {0, 1, 0};
-    assert(prev == RubikFaceName::R);
-    assert(next == RubikFaceName::B);
-    break;
-  case RubikFaceName::B:
-    t = {-1, 0, 0};
-    b = {0, 1, 0};
-    n = {0, 0, -1};
-    assert(prev == RubikFaceName::D);
-    assert(next == RubikFaceName::L);
-    break;
-  case RubikFaceName::L:
-    t = {0, 1, 0};
-    b = {0, 0, 1};
-    n = {1, 0, 0};
-    assert(prev == RubikFaceName::B);
-    assert(next == RubikFaceName::T);
-    break;
-  case RubikFaceName::T:
-    t = {0, 0, -1};
-    b = {1, 0, 0};
-    n = {0, -1, 0};
-    assert(prev == RubikFaceName::L);
-    assert(next == RubikFaceName::F);
-    break;
-  default:
-    break;
+  // shared with the face turns computed at compile time (see RubikPermutation)
+  for (uint axis = 0; axis < 3; axis++) {
+    t[axis] = rubikTangentSpace(uint(name), 0, axis);
+    b[axis] = rubikTangentSpace(uint(name), 1, axis);
+    n[axis] = rubikTangentSpace(uint(name), 2, axis);
   }
 }
 
@@ -81,71 +53,36 @@ RubikFacet::operator uint() const
   return static_cast<uint>(face) * 9 + (a + 1) * 3 + (b + 1);
 }
 
-RubikState::RubikState()
+RubikState::RubikState() {}
+
+RubikState::RubikState(const std::array<uint, 54> & facets)
 {
-  std::iota(m_facetMapping.begin(), m_facetMapping.end(), 0);       // identity (0...53)
-  std::iota(m_invfacetMapping.begin(), m_invfacetMapping.end(), 0); // identity (0...53)
-  std::iota(m_pieceMapping.begin(), m_pieceMapping.end(), 0);       // identity (0...26)
-  std::iota(m_invpieceMapping.begin(), m_invpieceMapping.end(), 0); // identity
+  std::copy(facets.begin(), facets.end(), m_facets.facets);
 }
 
 void RubikState::applyFaceRotation(const RubikFace & face)
 {
-  // update the facet permutation
-  RubikFace next(face.next);
-  RubikFace prev(face.prev);
-  std::array<uint, 4> cycle;
-  cycle = {{RubikFacet(face.name, -1, -1), RubikFacet(face.name, 1, -1), RubikFacet(face.name, 1, 1), RubikFacet(face.name, -1, 1)}};
-  cycle4Facets(cycle.data());
-  cycle = {{RubikFacet(face.name, 0, -1), RubikFacet(face.name, 1, 0), RubikFacet(face.name, 0, 1), RubikFacet(face.name, -1, 0)}};
-  cycle4Facets(cycle.data());
-  cycle = {{RubikFacet(face.next, 0, 1), RubikFacet(face.prev, 1, 0), RubikFacet(prev.prev, 0, -1), RubikFacet(next.next, -1, 0)}};
-  cycle4Facets(cycle.data());
-  cycle = {{RubikFacet(face.next, -1, 1), RubikFacet(face.prev, 1, -1), RubikFacet(prev.prev, 1, -1), RubikFacet(next.next, -1, 1)}};
-  cycle4Facets(cycle.data());
-  cycle = {{RubikFacet(face.next, 1, 1), RubikFacet(face.prev, 1, 1), RubikFacet(prev.prev, -1, -1), RubikFacet(next.next, -1, -1)}};
-  cycle4Facets(cycle.data());
-  // update the piece permutation
-  std::array<uint, 9> pieces = piecesOnFace(face, true);
-  std::vector<uint> invpieces;
-  for (uint a = 0; a < 3; ++a) {
-    for (uint b = 0; b < 3; ++b) {
-      uint p1 = pieces[a * 3 + b];       // source piece
-      uint p2 = pieces[(2 - b) * 3 + a]; // target piece (clockwise rotation of p1);
-      m_pieceMapping[m_invpieceMapping[p2]] = p1;
-      invpieces.push_back(m_invpieceMapping[p2]);
-    }
-  }
-  // update the inverse mapping
-  for (uint invp : invpieces) {
-    m_invpieceMapping[m_pieceMapping[invp]] = invp;
-  }
-  for (uint p = 0; p < m_pieceMapping.size(); ++p) {
-    assert(p == m_invpieceMapping[m_pieceMapping[p]]);
-    assert(p == m_pieceMapping[m_invpieceMapping[p]]);
-  }
+  apply(rubikTurns[3 * uint(face.name)]);
 }
 
-void RubikState::cycle4Facets(uint cycle[])
+void RubikState::apply(const RubikPermutation & permutation)
 {
-  uint x1 = cycle[0];
-  uint x2 = cycle[1];
-  uint x3 = cycle[2];
-  uint x4 = cycle[3];
-  m_facetMapping[m_invfacetMapping[x1]] = x2;
-  m_facetMapping[m_invfacetMapping[x2]] = x3;
-  m_facetMapping[m_invfacetMapping[x3]] = x4;
-  m_facetMapping[m_invfacetMapping[x4]] = x1;
-  for (auto y : {m_invfacetMapping[x1], m_invfacetMapping[x2], m_invfacetMapping[x3], m_invfacetMapping[x4]}) {
-    m_invfacetMapping[m_facetMapping[y]] = y;
-  }
+  simd::permuteBytes(m_facets.facets, permutation.facets, m_facets.facets);
 }
 
 void RubikState::print() const
 {
+  // the direct mappings, from the facet lying at each location
+  std::array<uint, 54> facetMapping;
+  std::array<uint, 27> pieceMapping;
+  std::iota(pieceMapping.begin(), pieceMapping.end(), 0);
+  for (uint location = 0; location < facetMapping.size(); location++) {
+    facetMapping[facetAt(location)] = location;
+    pieceMapping[facetPiece(facetAt(location))] = facetPiece(location);
+  }
   uint cnt = 0;
   std::cout << "facets: [";
-  for (auto n : m_facetMapping) {
+  for (auto n : facetMapping) {
     if (n != cnt) {
       std::cout << cnt << "->" << n << ' ';
     }
@@ -154,7 +91,7 @@ void RubikState::print() const
   std::cout << ']' << std::endl;
   cnt = 0;
   std::cout << "pieces: [";
-  for (auto n : m_pieceMapping) {
+  for (auto n : pieceMapping) {
     if (n != cnt) {
       std::cout << cnt << "->" << n << ' ';
     }
@@ -163,32 +100,7 @@ void RubikState::print() const
   std::cout << ']' << std::endl;
 }
 
-void RubikState::testCycle()
-{
-  RubikState s;
-  s.print();
-  uint twoCycles[] = {
-      1, 7, 9, 10, 1, 4, 2, 10,
-  };
-  uint * cycle = twoCycles;
-  s.cycle4Facets(cycle);
-  assert(s.m_facetMapping[1] == 7);
-  assert(s.m_facetMapping[7] == 9);
-  assert(s.m_facetMapping[9] == 10);
-  assert(s.m_facetMapping[10] == 1);
-  s.print();
-  cycle = twoCycles + 4;
-  s.cycle4Facets(cycle);
-  assert(s.m_facetMapping[1] == 7);
-  assert(s.m_facetMapping[4] == 2);
-  assert(s.m_facetMapping[2] == 10);
-  assert(s.m_facetMapping[7] == 9);
-  assert(s.m_facetMapping[9] == 1);
-  assert(s.m_facetMapping[10] == 4);
-  s.print();
-}
-
-std::array<uint, 9> RubikState::piecesOnFace(const RubikFace & face, bool defaultConfig)
+std::array<uint, 9> RubikState::piecesOnFace(const RubikFace & face, bool defaultConfig) const
 {
   std::array<uint, 9> pieces;
   uint k = 0;
@@ -196,7 +108,7 @@ std::array<uint, 9> RubikState::piecesOnFace(const RubikFace & face, bool defaul
     for (int b = -1; b <= 1; b++) {
       uint piece = RubikPiece(face, a, b);
       if (not defaultConfig) {
-        piece = m_invpieceMapping[piece];
+        piece = facetPiece(facetAt(RubikFacet(face.name, a, b))); // the piece of the facet lying there
       }
       pieces[k++] = piece;
     }
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <numeric>
 #include <vector>
+#include "RubikPermutation.hpp"
 
 enum class RubikFaceName
 {
@@ -71,34 +72,40 @@ public:
   /// Default constructor (identity mapping)
   RubikState();
 
-  /// Apply a face rotation
+  /**
+   * @brief Constructor from the facets lying at each location (the pieces following their facets)
+   * @param facets the facet (named by its location in the solved state) lying at each location
+   */
+  explicit RubikState(const std::array<uint, 54> & facets);
+
+  /**
+   * @brief Apply a face rotation (the clockwise quarter turn of rubikTurns)
+   *
+   * The facets of the layer follow the turn of their pieces, as animated by the renderer. The facet cycles of
+   * the first implementation did not: a single turn left 9 to 11 pieces with facets of different pieces. The turn
+   * is a single byte shuffle, faster than these cycles (see `rubik turns`).
+   */
   void applyFaceRotation(const RubikFace & face);
 
+  /// Applies a permutation of the facets (e.g. one of rubikTurns, or a sequence of them), as a single byte shuffle
+  void apply(const RubikPermutation & permutation);
+
   /**
    * @brief Return the list of pieces that belong to a face
    * @param face the target face
    * @param defaultConfig denotes if the current piece mapping should be disregarded
    * @return the index codes of the wanted pieces
    */
-  std::array<uint, 9> piecesOnFace(const RubikFace & face, bool defaultConfig = false);
+  std::array<uint, 9> piecesOnFace(const RubikFace & face, bool defaultConfig = false) const;
+
+  /// the facet (named by its location in the solved state) lying at a location
+  uint facetAt(uint location) const { return m_facets.facets[location]; }
 
   /// prints the direct mapping
   void print() const;
 
 private:
-  /// Composes the direct facet mapping with a 4-order cycle (left composition)
-  void cycle4Facets(uint cycle[4]);
-
-  /// unit test
-  static void testCycle();
-
-private:
-  using FacetPermutation = std::array<uint, 54>;
-  using PiecePermutation = std::array<uint, 27>;
-  FacetPermutation m_facetMapping;    ///< permutation of the 54 facets
-  FacetPermutation m_invfacetMapping; ///< inverse permutation of the 54 facets
-  PiecePermutation m_pieceMapping;    ///< permutation of the 27 pieces
-  PiecePermutation m_invpieceMapping; ///< inverse permutation of the 27 pieces
+  RubikPermutation m_facets; ///< the facet lying at each location, i.e. the product of the moves (the pieces follow their facets)
 };
 
 #endif // !defined(__RUBIK_LOGIC_H__)
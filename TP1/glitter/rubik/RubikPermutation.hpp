@@ -0,0 +1,176 @@
+#ifndef __RUBIK_PERMUTATION_H__
+#define __RUBIK_PERMUTATION_H__
+#include <cassert>
+#include <cstdint>
+
+/**
+ * @brief the tangent space of a face (see RubikFace), usable at compile time
+ * @param face the index of the face (see RubikFaceName)
+ * @param vector 0 for the tangent, 1 for the bitangent, 2 for the inward normal
+ * @param axis the coordinate (0, 1 or 2)
+ * @return the coordinate of the vector (-1, 0 or 1)
+ */
+constexpr int rubikTangentSpace(unsigned int face, unsigned int vector, unsigned int axis)
+{
+  constexpr signed char frames[6][3][3] = {
+      {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},    // F
+      {{0, -1, 0}, {0, 0, 1}, {-1, 0, 0}},  // R
+      {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},    // D
+      {{-1, 0, 0}, {0, 1, 0}, {0, 0, -1}},  // B
+      {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},    // L
+      {{0, 0, -1}, {1, 0, 0}, {0, -1, 0}}}; // T
+  return frames[face][vector][axis];
+}
+
+/**
+ * @brief A permutation of the 54 facets, as the location from which each location takes its facet
+ *
+ * Applied to the facets lying at each location (see RubikState), the permutation moves the facet of location
+ * facets[i] to location i: it is a byte shuffle (see simd::permuteBytes), and the facets after a sequence of
+ * moves are the product of the permutations of these moves. The bytes are padded to 64 with the identity, so
+ * that a shuffle handles whole registers.
+ *
+ * The permutations of the face turns and of the sequences of face turns written in the usual notation are
+ * computed at compile time (see rubikTurns and sequence()).
+ */
+struct RubikPermutation {
+  uint8_t facets[64]; ///< the location from which each location takes its facet (identity after the 54 facets)
+
+  /// Default constructor (identity)
+  constexpr RubikPermutation() : facets{}
+  {
+    for (unsigned int i = 0; i < 64; i++) {
+      facets[i] = i;
+    }
+  }
+
+  /// the permutation followed by another one
+  constexpr RubikPermutation operator*(const RubikPermutation & other) const
+  {
+    RubikPermutation product;
+    for (unsigned int i = 0; i < 64; i++) {
+      product.facets[i] = facets[other.facets[i]];
+    }
+    return product;
+  }
+
+  /// the permutation repeated n times
+  constexpr RubikPermutation power(unsigned int n) const
+  {
+    RubikPermutation product;
+    for (unsigned int k = 0; k < n; k++) {
+      product = product * *this;
+    }
+    return product;
+  }
+
+  /// equality test
+  constexpr bool operator==(const RubikPermutation & other) const
+  {
+    for (unsigned int i = 0; i < 64; i++) {
+      if (facets[i] != other.facets[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief the clockwise quarter turn of a face (see RubikState::applyFaceRotation)
+   * @param face the index of the face (see RubikFaceName)
+   *
+   * The facets of the layer of the face follow their pieces, rotated by a quarter turn around the outward normal of
+   * the face (as animated by the renderer).
+   */
+  static constexpr RubikPermutation quarterTurn(unsigned int face)
+  {
+    RubikPermutation turn;
+    int axis[3] = {}, position[3] = {}, normal[3] = {}, rotatedPosition[3] = {}, rotatedNormal[3] = {};
+    for (unsigned int k = 0; k < 3; k++) {
+      axis[k] = -rubikTangentSpace(face, 2, k);
+    }
+    for (unsigned int facet = 0; facet < 54; facet++) {
+      const unsigned int facetFace = facet / 9;
+      const int a = facet / 3 % 3 - 1, b = facet % 3 - 1;
+      for (unsigned int k = 0; k < 3; k++) {
+        position[k] = a * rubikTangentSpace(facetFace, 0, k) + b * rubikTangentSpace(facetFace, 1, k) - rubikTangentSpace(facetFace, 2, k);
+        normal[k] = -rubikTangentSpace(facetFace, 2, k);
+      }
+      if (dot(axis, position) != 1) {
+        continue; // not on the layer of the face
+      }
+      rotate(axis, position, rotatedPosition);
+      rotate(axis, normal, rotatedNormal);
+      for (unsigned int target = 0; target < 6; target++) {
+        int targetNormal[3] = {};
+        for (unsigned int k = 0; k < 3; k++) {
+          targetNormal[k] = -rubikTangentSpace(target, 2, k);
+        }
+        if (dot(targetNormal, rotatedNormal) == 1) {
+          int tangent[3] = {}, bitangent[3] = {};
+          for (unsigned int k = 0; k < 3; k++) {
+            tangent[k] = rubikTangentSpace(target, 0, k);
+            bitangent[k] = rubikTangentSpace(target, 1, k);
+          }
+          turn.facets[target * 9 + (dot(tangent, rotatedPosition) + 1) * 3 + dot(bitangent, rotatedPosition) + 1] = facet;
+        }
+      }
+    }
+    return turn;
+  }
+
+  /// one of the 18 face turns (3 * face + number of quarter turns - 1, see RubikMove)
+  static constexpr RubikPermutation turn(unsigned int move) { return quarterTurn(move / 3).power(move % 3 + 1); }
+
+  /**
+   * @brief a sequence of face turns, as a single permutation
+   * @param moves the turns in the usual notation, separated by spaces (e.g. "R T R' T'" or "F2 B2")
+   */
+  static constexpr RubikPermutation sequence(const char * moves)
+  {
+    constexpr char faces[] = "FRDBLT";
+    RubikPermutation product;
+    for (const char * c = moves; *c != '\0'; c++) {
+      if (*c == ' ') {
+        continue;
+      }
+      unsigned int face = 0;
+      while (faces[face] != '\0' and faces[face] != *c) {
+        face++;
+      }
+      assert(face < 6 and "unknown face in a move sequence");
+      unsigned int turns = 1;
+      if (c[1] == '2' or c[1] == '\'') {
+        turns = c[1] == '2' ? 2 : 3;
+        c++;
+      }
+      product = product * turn(3 * face + turns - 1);
+    }
+    return product;
+  }
+
+private:
+  /// dot product of integer vectors
+  static constexpr int dot(const int * u, const int * v) { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; }
+
+  /// quarter turn of an integer vector around a unit axis (counterclockwise when seen from the axis)
+  static constexpr void rotate(const int * axis, const int * v, int * result)
+  {
+    const int along = dot(axis, v);
+    result[0] = axis[1] * v[2] - axis[2] * v[1] + along * axis[0];
+    result[1] = axis[2] * v[0] - axis[0] * v[2] + along * axis[1];
+    result[2] = axis[0] * v[1] - axis[1] * v[0] + along * axis[2];
+  }
+};
+
+/// the permutations of the 18 face turns (3 * face + number of quarter turns - 1), computed at compile time
+constexpr RubikPermutation rubikTurns[18] = {
+    RubikPermutation::turn(0),  RubikPermutation::turn(1),  RubikPermutation::turn(2),  RubikPermutation::turn(3),  RubikPermutation::turn(4),
+    RubikPermutation::turn(5),  RubikPermutation::turn(6),  RubikPermutation::turn(7),  RubikPermutation::turn(8),  RubikPermutation::turn(9),
+    RubikPermutation::turn(10), RubikPermutation::turn(11), RubikPermutation::turn(12), RubikPermutation::turn(13), RubikPermutation::turn(14),
+    RubikPermutation::turn(15), RubikPermutation::turn(16), RubikPermutation::turn(17)};
+
+static_assert(rubikTurns[0].power(4) == RubikPermutation(), "a face turn is of order 4");
+static_assert(RubikPermutation::sequence("R T R' T'").power(6) == RubikPermutation(), "the commutator of two adjacent faces is of order 6");
+
+#endif // !defined(__RUBIK_PERMUTATION_H__)
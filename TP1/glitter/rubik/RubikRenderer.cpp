@@ -1,68 +1,39 @@
 #include "RubikRenderer.hpp"
 #include <GLFW/glfw3.h>
-#include <functional>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <unordered_map>
+#include "ParamSurface.hpp"
 #include "RubikLogic.hpp"
 
-/// a simple struct for discrete linear range of the form {minVal, minVal+delta,...,minVal+length}
-struct DiscreteLinRange {
-  uint nbVals;  ///< the number of values in the range
-  float minVal; ///< the minimum value of the range
-  float length; ///< the lengh (max -min) of the range
-
-  /// Constructor
-  DiscreteLinRange(uint nbVals, float minVal, float length) : nbVals(nbVals), minVal(minVal), length(length) {}
-
-  /// Returns the k^{th} value of the range
-  float value(uint k) { return minVal + k * length / (nbVals - 1); }
-};
-
-std::shared_ptr<VAO> makeParamSurf(DiscreteLinRange rgPhi, DiscreteLinRange rgTheta, const std::function<glm::vec3(float, float)> & posFunc, bool isCyclicInPhi, bool isCyclicInTheta)
+std::shared_ptr<VAO> makeParamSurf(const ParamSurfaceMesh & mesh)
 {
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> colors;
-  std::vector<uint> ibo;
-  for (uint kPhi = 0; kPhi < rgPhi.nbVals; kPhi++) {
-    for (uint kTheta = 0; kTheta < rgTheta.nbVals; kTheta++) {
-      float phi = rgPhi.value(kPhi);
-      float theta = rgTheta.value(kTheta);
-      glm::vec3 position = posFunc(phi, theta);
-      positions.push_back(position);
-      glm::vec3 color(0);
-      const float eps = 0.01;
-      if (0.5 - position.x < eps) {
-        color = glm::vec3(1, 1, 1); // right face is white
-      } else if (0.5 + position.x < eps) {
-        color = glm::vec3(1, 1, 0); // left face is yellow
-      } else if (0.5 - position.y < eps) {
-        color = glm::vec3(0, 1, 0); // top face is green
-      } else if (0.5 + position.y < eps) {
-        color = glm::vec3(0, 0, 1); // down face is blue
-      } else if (0.5 - position.z < eps) {
-        color = glm::vec3(1, 0, 0); // front face is red
-      } else if (0.5 + position.z < eps) {
-        color = glm::vec3(1, 0.5, 0); // back face is orange
-      }
-      colors.push_back(color);
-      if ((kPhi == rgPhi.nbVals - 1 and not isCyclicInPhi) or (kTheta == rgTheta.nbVals - 1 and not isCyclicInTheta)) {
-        continue;
-      }
-      auto index = [&](uint i, uint j) { return (i % rgPhi.nbVals) * rgTheta.nbVals + (j % rgTheta.nbVals); };
-      uint patchIndices[] = {
-          index(kPhi, kTheta),     index(kPhi, kTheta + 1), index(kPhi + 1, kTheta),     // first triangle
-          index(kPhi + 1, kTheta), index(kPhi, kTheta + 1), index(kPhi + 1, kTheta + 1), // second triangle
-      };
-      ibo.insert(ibo.end(), patchIndices, patchIndices + 6);
+  std::vector<glm::vec3> colors(mesh.positions.size());
+  for (size_t k = 0; k < colors.size(); k++) {
+    const glm::vec3 & position = mesh.positions[k];
+    glm::vec3 color(0);
+    const float eps = 0.01;
+    if (0.5 - position.x < eps) {
+      color = glm::vec3(1, 1, 1); // right face is white
+    } else if (0.5 + position.x < eps) {
+      color = glm::vec3(1, 1, 0); // left face is yellow
+    } else if (0.5 - position.y < eps) {
+      color = glm::vec3(0, 1, 0); // top face is green
+    } else if (0.5 + position.y < eps) {
+      color = glm::vec3(0, 0, 1); // down face is blue
+    } else if (0.5 - position.z < eps) {
+      color = glm::vec3(1, 0, 0); // front face is red
+    } else if (0.5 + position.z < eps) {
+      color = glm::vec3(1, 0.5, 0); // back face is orange
     }
+    colors[k] = color;
   }
 
   std::shared_ptr<VAO> vao(new VAO(2));
-  vao->setVBO(0, positions);
+  vao->setVBO(0, mesh.positions);
   vao->setVBO(1, colors);
-  vao->setIBO(ibo);
+  vao->setIBO(mesh.indices);
   return vao;
 }
 
@@ -78,10 +49,12 @@ std::shared_ptr<VAO> RubikRenderer::InstancedVAO::makeARoundedCube(unsigned int
   auto posFunc = [&](float phi, float theta) { return 0.5f * glm::vec3(signPow(cos(phi) * sin(theta), exponent), signPow(sin(phi) * sin(theta), exponent), signPow(-cos(theta), exponent)); };
 
   const float pi = glm::pi<float>();
-  return makeParamSurf(DiscreteLinRange(nbPhi, 0, 2 * pi), DiscreteLinRange(nbTheta, 0, pi), posFunc, true, false);
+  TessellationOptions options;
+  options.reverseWinding = true;
+  return makeParamSurf(tessellate(DiscreteLinRange(nbPhi, 0, 2 * pi), DiscreteLinRange(nbTheta, 0, pi), posFunc, true, false, options));
 }
 
-RubikRenderer::RubikRenderer() : m_program("rubik/rubik.v.glsl", "rubik/rubik.f.glsl"), m_view(1), m_currentTime(0), m_deltaTime(0)
+RubikRenderer::RubikRenderer() : m_programs("rubik/rubik.v.glsl", "rubik/rubik.f.glsl", {"DEFORM"}), m_view(1), m_currentTime(0), m_deltaTime(0)
 {
   GLFWwindow * window = glfwGetCurrentContext();
   int windowWidth, windowHeight;
@@ -109,6 +82,10 @@ void RubikRenderer::createTheVAO()
       }
     }
   }
+  // the MVP matrix of each piece is a per-instance attribute (see rubik.v.glsl)
+  m_transforms.resize(27);
+  m_instances.allocate(27 * sizeof(glm::mat4));
+  m_vao->setInstanceMatrices(2, m_instances, 4, 4);
 }
 
 void RubikRenderer::initGLState() const
@@ -120,9 +97,8 @@ void RubikRenderer::initGLState() const
 
 void RubikRenderer::deform(bool activate)
 {
-  m_program.bind();
-  m_program.setUniform("deform", (uint)activate);
-  m_program.unbind();
+  // the deformation is compiled in a variant of the program, which has the uniform time
+  m_programs.select(activate ? m_programs.option("DEFORM") : 0);
 }
 
 // Template specialization of std::hash
@@ -162,16 +138,17 @@ RubikFace RubikRenderer::getFace(unsigned int face) const
 
 void RubikRenderer::renderFrame()
 {
-  m_program.bind();
   glm::mat4 view(1);
   const float pi = glm::pi<float>();
   view = glm::rotate(glm::mat4(1), pi / 7, {0, 1, 0});
   view = glm::rotate(glm::mat4(1), -pi / 4, {1, 0, 0}) * view * m_view;
-  for (const auto & vao : m_vaos) {
-    vao->updateProgram(m_program, m_proj, view);
-    vao->draw();
+  for (unsigned int k = 0; k < 27; k++) {
+    m_transforms.set(k, m_vaos[k]->modelWorld());
   }
-  m_program.unbind();
+  m_transforms.upload(m_instances, m_proj, view);
+  m_programs.current().bind();
+  m_vao->drawInstanced(GL_TRIANGLES, 27);
+  m_programs.current().unbind();
 }
 
 bool RubikRenderer::isLocked() const
@@ -188,9 +165,11 @@ void RubikRenderer::update()
   float prevTime = m_currentTime;
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
-  m_program.bind();
-  m_program.setUniform("time", m_currentTime);
-  m_program.unbind();
+  if (m_programs.currentKey() != 0) {
+    m_programs.current().bind();
+    m_programs.current().setUniform("time", m_currentTime);
+    m_programs.current().unbind();
+  }
   m_viewAnim.update(m_deltaTime);
   for (auto & vao : m_vaos) {
     vao->update(m_deltaTime);
@@ -235,18 +214,6 @@ std::shared_ptr<RubikRenderer::InstancedVAO> RubikRenderer::InstancedVAO::create
   return std::shared_ptr<InstancedVAO>(new InstancedVAO(vao, modelWorld));
 }
 
-void RubikRenderer::InstancedVAO::draw(GLenum mode) const
-{
-  if (m_vao) {
-    m_vao->draw(mode);
-  }
-}
-
-void RubikRenderer::InstancedVAO::updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view) const
-{
-  prog.setUniform("MVP", proj * view * m_mw);
-}
-
 void RubikRenderer::InstancedVAO::launchRotation(const glm::vec3 & axis, float angle)
 {
   m_anim.startAnimation(m_mw, axis, angle);
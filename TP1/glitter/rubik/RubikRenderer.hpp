@@ -1,6 +1,7 @@
 #ifndef __RUBIK_RENDERER_H__
 #define __RUBIK_RENDERER_H__
 
+#include "TransformBatch.hpp"
 #include "glApi.hpp"
 
 // forward declarations
@@ -16,7 +17,7 @@ public:
   /// OpenGL state initialization
   void initGLState() const;
 
-  /// Creates a unique vao for all the pieces and instanciates them
+  /// Creates a unique vao for all the pieces and instanciates them (drawn by a single instanced draw call)
   void createTheVAO();
 
   /// Handles window resizing
@@ -84,18 +85,8 @@ private:
      */
     static std::shared_ptr<InstancedVAO> createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld);
 
-    /**
-     * @brief Draw this VAO
-     */
-    void draw(GLenum mode = GL_TRIANGLES) const;
-
-    /**
-     * @brief update the program MVP uniform variable
-     * @param prog the target program
-     * @param proj the projection matrix
-     * @param view the worldView matrix
-     */
-    void updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view = glm::mat4(1)) const;
+    /// the modelWorld matrix
+    const glm::mat4 & modelWorld() const { return m_mw; }
 
     /// Launches a rotation animation.
     void launchRotation(const glm::vec3 & axis, float angle);
@@ -120,7 +111,9 @@ private:
 private:
   std::shared_ptr<InstancedVAO> m_vaos[27]; ///< List of instanced VAOs (VAO + modelView matrix)
   std::shared_ptr<VAO> m_vao;               ///< a unique VAO (shared by all instanced one)
-  Program m_program;                        ///< A GLSL progam
+  TransformBatch m_transforms;              ///< modelWorld matrices of the instanced VAOs
+  Buffer m_instances;                       ///< MVP matrices of the instanced VAOs (per-instance attribute of m_vao)
+  ProgramVariants m_programs;               ///< the GLSL programs, with or without deformation
   glm::mat4 m_proj;                         ///< Projection matrix
   glm::mat4 m_view;                         ///< worldView matrix
   float m_currentTime;                      ///< elapsed time since first frame
@@ -0,0 +1,585 @@
+#include "RubikSolver.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+const unsigned int nbMoves = 18;          ///< number of face turns
+const unsigned int nbPhase2Moves = 10;    ///< number of face turns of the second phase
+const unsigned int nbTwists = 2187;       ///< 3^7 corner orientations
+const unsigned int nbFlips = 2048;        ///< 2^11 edge orientations
+const unsigned int nbSlices = 495;        ///< 12 choose 4 positions of the middle layer edges
+const unsigned int nbCornerPerms = 40320; ///< 8! corner permutations
+const unsigned int nbEdgePerms = 40320;   ///< 8! permutations of the top and down layer edges
+const unsigned int nbSlicePerms = 24;     ///< 4! permutations of the middle layer edges
+const unsigned int maxPhase2Length = 18;  ///< longest solution of the second phase
+const unsigned int firstSliceEdge = 8;    ///< the middle layer edges are the last four ones
+
+/// the face turns of the second phase (all the turns of the top and down faces, the half turns of the other ones)
+const unsigned char phase2Moves[nbPhase2Moves] = {6, 7, 8, 15, 16, 17, 1, 4, 10, 13};
+
+/// denotes if a face turn belongs to the second phase
+bool isPhase2Move(unsigned int move)
+{
+  return std::find(phase2Moves, phase2Moves + nbPhase2Moves, move) != phase2Moves + nbPhase2Moves;
+}
+
+/// denotes if a face turn may follow another one (the same face is not turned twice, opposite faces are turned in a single order)
+bool canFollow(unsigned int move, unsigned int previous)
+{
+  const unsigned int face = move / 3, previousFace = previous / 3;
+  return face != previousFace and not(face == (previousFace + 3) % 6 and face < previousFace);
+}
+
+/// the facets of the corner and edge positions, the reference facet first
+struct Layout {
+  std::array<std::array<uint, 3>, RubikCubies::nbCorners> corners; ///< facets of the corners, in the same orientation
+  std::array<std::array<uint, 2>, RubikCubies::nbEdges> edges;     ///< facets of the edges
+  std::array<uint, 54> cubies;                                     ///< position of the cubie of each facet (unused for the centers)
+
+  Layout()
+  {
+    // the facets of each piece
+    std::vector<uint> facets[27];
+    for (uint facet = 0; facet < 54; facet++) {
+      RubikFacet f(facet);
+      if (f.a != 0 or f.b != 0) {
+        facets[RubikPiece(RubikFace(f.face), f.a, f.b)].push_back(facet);
+      }
+    }
+    auto isHorizontal = [](uint facet) { return RubikFacet(facet).face == RubikFaceName::T or RubikFacet(facet).face == RubikFaceName::D; };
+    auto normal = [](uint facet) { return -RubikFace(RubikFacet(facet).face).n; };
+    uint nbCorners = 0, nbTopEdges = 0, nbSliceEdges = 0;
+    for (const auto & piece : facets) {
+      std::vector<uint> sorted = piece;
+      std::stable_partition(sorted.begin(), sorted.end(), isHorizontal);
+      if (sorted.size() == 3) {
+        if (glm::dot(glm::cross(normal(sorted[0]), normal(sorted[1])), normal(sorted[2])) < 0) {
+          std::swap(sorted[1], sorted[2]);
+        }
+        corners[nbCorners] = {{sorted[0], sorted[1], sorted[2]}};
+        for (uint facet : sorted) {
+          cubies[facet] = nbCorners;
+        }
+        nbCorners++;
+      } else if (sorted.size() == 2) {
+        if (not isHorizontal(sorted[0])) {
+          // a middle layer edge, referenced by its front or back facet
+          RubikFaceName face = RubikFacet(sorted[0]).face;
+          if (face != RubikFaceName::F and face != RubikFaceName::B) {
+            std::swap(sorted[0], sorted[1]);
+          }
+        }
+        const uint position = isHorizontal(sorted[0]) ? nbTopEdges++ : firstSliceEdge + nbSliceEdges++;
+        edges[position] = {{sorted[0], sorted[1]}};
+        cubies[sorted[0]] = cubies[sorted[1]] = position;
+      }
+    }
+    assert(nbCorners == RubikCubies::nbCorners and nbTopEdges == firstSliceEdge and nbSliceEdges == 4);
+  }
+};
+
+/// the layout of the cubies, computed once
+const Layout & layout()
+{
+  static const Layout instance;
+  return instance;
+}
+
+/// the cubies of the 18 face turns, computed once from their facets
+const std::array<RubikCubies, nbMoves> & moveCubies()
+{
+  static const std::array<RubikCubies, nbMoves> instance = [] {
+    std::array<RubikCubies, nbMoves> moves;
+    for (uint m = 0; m < nbMoves; m++) {
+      RubikState state;
+      state.apply(rubikTurns[m]);
+      moves[m] = RubikCubies(state);
+    }
+    return moves;
+  }();
+  return instance;
+}
+
+/// rank of a permutation of n distinct values among their n! orderings (Lehmer code)
+template <typename Value> uint permutationRank(const Value * values, uint n)
+{
+  uint rank = 0;
+  for (uint i = 0; i < n; i++) {
+    uint smaller = 0;
+    for (uint j = i + 1; j < n; j++) {
+      smaller += values[j] < values[i];
+    }
+    rank = rank * (n - i) + smaller;
+  }
+  return rank;
+}
+
+/// permutation of 0...n-1 of a given rank (inverse of permutationRank)
+void permutationFromRank(uint rank, uint n, uint8_t * values)
+{
+  std::vector<uint> digits(n);
+  for (uint i = n; i-- > 0;) {
+    digits[i] = rank % (n - i);
+    rank /= n - i;
+  }
+  std::vector<uint8_t> remaining(n);
+  for (uint i = 0; i < n; i++) {
+    remaining[i] = i;
+  }
+  for (uint i = 0; i < n; i++) {
+    values[i] = remaining[digits[i]];
+    remaining.erase(remaining.begin() + digits[i]);
+  }
+}
+
+/// orientations of the first corners, in base 3
+uint twistCoordinate(const RubikCubies & cube)
+{
+  uint twist = 0;
+  for (uint i = 0; i + 1 < RubikCubies::nbCorners; i++) {
+    twist = 3 * twist + cube.twist(i);
+  }
+  return twist;
+}
+
+/// orientations of the first edges, in base 2
+uint flipCoordinate(const RubikCubies & cube)
+{
+  uint flip = 0;
+  for (uint i = 0; i + 1 < RubikCubies::nbEdges; i++) {
+    flip = 2 * flip + cube.flip(i);
+  }
+  return flip;
+}
+
+/// positions of the middle layer edges, as a bit mask
+uint sliceMask(const RubikCubies & cube)
+{
+  uint mask = 0;
+  for (uint i = 0; i < RubikCubies::nbEdges; i++) {
+    mask |= uint(cube.edge(i) >= firstSliceEdge) << i;
+  }
+  return mask;
+}
+
+/// permutation of the corners
+uint cornerPermCoordinate(const RubikCubies & cube)
+{
+  uint8_t corners[RubikCubies::nbCorners];
+  for (uint i = 0; i < RubikCubies::nbCorners; i++) {
+    corners[i] = cube.corner(i);
+  }
+  return permutationRank(corners, RubikCubies::nbCorners);
+}
+
+/// permutation of the top and down layer edges (within the subgroup of the second phase)
+uint edgePermCoordinate(const RubikCubies & cube)
+{
+  uint8_t edges[firstSliceEdge];
+  for (uint i = 0; i < firstSliceEdge; i++) {
+    edges[i] = cube.edge(i);
+  }
+  return permutationRank(edges, firstSliceEdge);
+}
+
+/// permutation of the middle layer edges (within the subgroup of the second phase)
+uint slicePermCoordinate(const RubikCubies & cube)
+{
+  uint8_t edges[4];
+  for (uint i = 0; i < 4; i++) {
+    edges[i] = cube.edge(firstSliceEdge + i);
+  }
+  return permutationRank(edges, 4);
+}
+
+/// the parity of a permutation
+template <typename Cubie> uint parity(const Cubie & cubie, uint n)
+{
+  uint inversions = 0;
+  for (uint i = 0; i < n; i++) {
+    for (uint j = i + 1; j < n; j++) {
+      inversions += cubie(j) < cubie(i);
+    }
+  }
+  return inversions & 1;
+}
+
+/**
+ * @brief computes the table of a coordinate turned by a set of moves
+ * @param size number of values of the coordinate
+ * @param moves the moves
+ * @param nbMoves number of moves
+ * @param cube a cube of a given coordinate
+ * @param coordinate the coordinate of a cube
+ * @return the coordinate of each value (row) after each move (column)
+ */
+template <typename Cube, typename Coordinate> std::vector<uint16_t> moveTable(uint size, const unsigned char * moves, uint nbMoves, Cube cube, Coordinate coordinate)
+{
+  std::vector<uint16_t> table(size * nbMoves);
+  for (uint value = 0; value < size; value++) {
+    const RubikCubies start = cube(value);
+    assert(coordinate(start) == value);
+    for (uint m = 0; m < nbMoves; m++) {
+      table[value * nbMoves + m] = coordinate(start * moveCubies()[moves[m]]);
+    }
+  }
+  return table;
+}
+
+/**
+ * @brief computes the number of moves solving a pair of coordinates (breadth first search)
+ * @param table1 the move table of the first coordinate
+ * @param size1 number of values of the first coordinate
+ * @param table2 the move table of the second coordinate
+ * @param size2 number of values of the second coordinate
+ * @param nbMoves number of moves (columns of the move tables)
+ * @return the distance of each pair (index1 * size2 + index2) to the solved pair (0, 0)
+ */
+std::vector<uint8_t> pruningTable(const std::vector<uint16_t> & table1, uint size1, const std::vector<uint16_t> & table2, uint size2, uint nbMoves)
+{
+  std::vector<uint8_t> distances(size1 * size2, 0xff);
+  std::vector<uint> frontier(1, 0), next;
+  distances[0] = 0;
+  for (uint8_t depth = 1; not frontier.empty(); depth++) {
+    next.clear();
+    for (uint index : frontier) {
+      const uint value1 = index / size2, value2 = index % size2;
+      for (uint m = 0; m < nbMoves; m++) {
+        const uint neighbour = table1[value1 * nbMoves + m] * size2 + table2[value2 * nbMoves + m];
+        if (distances[neighbour] == 0xff) {
+          distances[neighbour] = depth;
+          next.push_back(neighbour);
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+  return distances;
+}
+} // namespace
+
+RubikMove::RubikMove(RubikFaceName face, unsigned char turns) : face(face), turns(turns) {}
+
+RubikMove::RubikMove(unsigned int index) : face(RubikFaceName(index / 3)), turns(index % 3 + 1) {}
+
+RubikMove::operator uint() const
+{
+  return uint(face) * 3 + turns - 1;
+}
+
+RubikMove RubikMove::inverse() const
+{
+  return RubikMove(face, 4 - turns);
+}
+
+std::string RubikMove::name() const
+{
+  static const char faces[] = "FRDBLT";
+  static const char * const suffixes[] = {"", "2", "'"};
+  return faces[uint(face)] + std::string(suffixes[turns - 1]);
+}
+
+std::string RubikMove::name(const std::vector<RubikMove> & moves)
+{
+  std::string names;
+  for (const auto & move : moves) {
+    names += (names.empty() ? "" : " ") + move.name();
+  }
+  return names;
+}
+
+RubikCubies::RubikCubies()
+{
+  for (uint i = 0; i < nbCorners; i++) {
+    corners[i] = i;
+  }
+  for (uint i = 0; i < nbEdges; i++) {
+    edges[i] = i;
+  }
+}
+
+RubikCubies::RubikCubies(const RubikState & state)
+{
+  // the facets lying on a position tell the cubie, its reference facet tells the orientation
+  const Layout & cubies = layout();
+  for (uint i = 0; i < nbCorners; i++) {
+    const uint corner = cubies.cubies[state.facetAt(cubies.corners[i][0])];
+    uint twist = 0;
+    while (state.facetAt(cubies.corners[i][twist]) != cubies.corners[corner][0]) {
+      twist++;
+    }
+    corners[i] = corner | twist << 3;
+  }
+  for (uint i = 0; i < nbEdges; i++) {
+    const uint edge = cubies.cubies[state.facetAt(cubies.edges[i][0])];
+    const uint flip = state.facetAt(cubies.edges[i][0]) != cubies.edges[edge][0];
+    edges[i] = edge | flip << 4;
+  }
+}
+
+RubikState RubikCubies::toState() const
+{
+  // the facets of a cubie keep their cyclic order on the facets of its position, from its orientation
+  const Layout & cubies = layout();
+  std::array<uint, 54> facets;
+  for (uint facet = 0; facet < facets.size(); facet++) {
+    facets[facet] = facet; // the centers
+  }
+  for (uint i = 0; i < nbCorners; i++) {
+    for (uint k = 0; k < 3; k++) {
+      facets[cubies.corners[i][(twist(i) + k) % 3]] = cubies.corners[corner(i)][k];
+    }
+  }
+  for (uint i = 0; i < nbEdges; i++) {
+    for (uint k = 0; k < 2; k++) {
+      facets[cubies.edges[i][(flip(i) + k) % 2]] = cubies.edges[edge(i)][k];
+    }
+  }
+  return RubikState(facets);
+}
+
+const RubikCubies & RubikCubies::move(const RubikMove & move)
+{
+  return moveCubies()[move];
+}
+
+RubikCubies RubikCubies::operator*(const RubikCubies & other) const
+{
+  // position i receives the cubie of position other[i], with both orientations added
+  RubikCubies cube;
+  for (uint i = 0; i < nbCorners; i++) {
+    const uint from = other.corners[i], cubie = corners[from & 7];
+    cube.corners[i] = (cubie & 7) | ((cubie >> 3) + (from >> 3)) % 3 << 3;
+  }
+  for (uint i = 0; i < nbEdges; i++) {
+    const uint from = other.edges[i], cubie = edges[from & 15];
+    cube.edges[i] = ((cubie ^ from) & 16) | (cubie & 15);
+  }
+  return cube;
+}
+
+bool RubikCubies::valid() const
+{
+  uint cornerSet = 0, edgeSet = 0, twists = 0, flips = 0;
+  for (uint i = 0; i < nbCorners; i++) {
+    cornerSet |= 1 << corner(i);
+    twists += twist(i);
+  }
+  for (uint i = 0; i < nbEdges; i++) {
+    edgeSet |= 1 << edge(i);
+    flips += flip(i);
+  }
+  if (cornerSet != 0xff or edgeSet != 0xfff or twists % 3 != 0 or flips % 2 != 0) {
+    return false;
+  }
+  return parity([this](uint i) { return corner(i); }, nbCorners) == parity([this](uint i) { return edge(i); }, nbEdges);
+}
+
+/// the move and pruning tables
+struct RubikSolver::Tables {
+  std::vector<uint16_t> twistMoves;         ///< twist coordinate after each face turn
+  std::vector<uint16_t> flipMoves;          ///< flip coordinate after each face turn
+  std::vector<uint16_t> sliceMoves;         ///< slice coordinate after each face turn
+  std::vector<uint16_t> cornerMoves;        ///< corner permutation after each face turn of the second phase
+  std::vector<uint16_t> edgeMoves;          ///< top and down edge permutation after each face turn of the second phase
+  std::vector<uint16_t> slicePermMoves;     ///< middle layer edge permutation after each face turn of the second phase
+  std::vector<uint8_t> sliceTwistDistances; ///< moves solving the slice and twist coordinates
+  std::vector<uint8_t> sliceFlipDistances;  ///< moves solving the slice and flip coordinates
+  std::vector<uint8_t> cornerDistances;     ///< moves of the second phase solving the middle layer edge and corner permutations
+  std::vector<uint8_t> edgeDistances;       ///< moves of the second phase solving the middle layer edge and top and down edge permutations
+  std::vector<uint16_t> sliceIndices;       ///< slice coordinate of each bit mask of the positions of the middle layer edges
+
+  Tables();
+
+  /// the slice coordinate of a cube
+  uint slice(const RubikCubies & cube) const { return sliceIndices[sliceMask(cube)]; }
+};
+
+RubikSolver::Tables::Tables() : sliceIndices(1 << RubikCubies::nbEdges, 0xffff)
+{
+  unsigned char allMoves[nbMoves];
+  for (uint m = 0; m < nbMoves; m++) {
+    allMoves[m] = m;
+  }
+  // the slice coordinate numbers the masks of 4 bits, the solved one first
+  std::vector<uint> masks(1, 0xf00);
+  for (uint mask = 0; mask < (1u << RubikCubies::nbEdges); mask++) {
+    if (__builtin_popcount(mask) == 4 and mask != 0xf00) {
+      masks.push_back(mask);
+    }
+  }
+  assert(masks.size() == nbSlices);
+  for (uint index = 0; index < nbSlices; index++) {
+    sliceIndices[masks[index]] = index;
+  }
+
+  twistMoves = moveTable(nbTwists, allMoves, nbMoves,
+                         [](uint twist) {
+                           RubikCubies cube;
+                           uint total = 0;
+                           for (uint i = RubikCubies::nbCorners - 1; i-- > 0; twist /= 3) {
+                             cube.corners[i] |= twist % 3 << 3;
+                             total += twist % 3;
+                           }
+                           cube.corners[RubikCubies::nbCorners - 1] |= (3 - total % 3) % 3 << 3;
+                           return cube;
+                         },
+                         twistCoordinate);
+  flipMoves = moveTable(nbFlips, allMoves, nbMoves,
+                        [](uint flip) {
+                          RubikCubies cube;
+                          uint total = 0;
+                          for (uint i = RubikCubies::nbEdges - 1; i-- > 0; flip /= 2) {
+                            cube.edges[i] |= flip % 2 << 4;
+                            total += flip % 2;
+                          }
+                          cube.edges[RubikCubies::nbEdges - 1] |= total % 2 << 4;
+                          return cube;
+                        },
+                        flipCoordinate);
+  sliceMoves = moveTable(nbSlices, allMoves, nbMoves,
+                         [&masks](uint slice) {
+                           RubikCubies cube;
+                           uint sliceEdge = firstSliceEdge, otherEdge = 0;
+                           for (uint i = 0; i < RubikCubies::nbEdges; i++) {
+                             cube.edges[i] = (masks[slice] >> i) & 1 ? sliceEdge++ : otherEdge++;
+                           }
+                           return cube;
+                         },
+                         [this](const RubikCubies & cube) { return slice(cube); });
+  cornerMoves = moveTable(nbCornerPerms, phase2Moves, nbPhase2Moves,
+                          [](uint perm) {
+                            RubikCubies cube;
+                            permutationFromRank(perm, RubikCubies::nbCorners, cube.corners.data());
+                            return cube;
+                          },
+                          cornerPermCoordinate);
+  edgeMoves = moveTable(nbEdgePerms, phase2Moves, nbPhase2Moves,
+                        [](uint perm) {
+                          RubikCubies cube;
+                          permutationFromRank(perm, firstSliceEdge, cube.edges.data());
+                          return cube;
+                        },
+                        edgePermCoordinate);
+  slicePermMoves = moveTable(nbSlicePerms, phase2Moves, nbPhase2Moves,
+                             [](uint perm) {
+                               RubikCubies cube;
+                               permutationFromRank(perm, 4, cube.edges.data() + firstSliceEdge);
+                               for (uint i = firstSliceEdge; i < RubikCubies::nbEdges; i++) {
+                                 cube.edges[i] += firstSliceEdge;
+                               }
+                               return cube;
+                             },
+                             slicePermCoordinate);
+
+  sliceTwistDistances = pruningTable(sliceMoves, nbSlices, twistMoves, nbTwists, nbMoves);
+  sliceFlipDistances = pruningTable(sliceMoves, nbSlices, flipMoves, nbFlips, nbMoves);
+  cornerDistances = pruningTable(slicePermMoves, nbSlicePerms, cornerMoves, nbCornerPerms, nbPhase2Moves);
+  edgeDistances = pruningTable(slicePermMoves, nbSlicePerms, edgeMoves, nbEdgePerms, nbPhase2Moves);
+}
+
+/// the state of a two-phase search
+struct RubikSolver::Search {
+  const Tables & tables;    ///< move and pruning tables
+  const RubikCubies & cube; ///< the cube to solve
+  uint maxLength;           ///< maximal number of moves
+  std::vector<uint> moves;  ///< the current move sequence (face turns of the first phase, then of the second one)
+
+  /// searches the first phase solutions of exactly togo more moves, and completes them
+  bool phase1(uint twist, uint flip, uint slice, uint togo)
+  {
+    if (togo == 0) {
+      // a shorter first phase would end with a move of the second phase
+      return twist == 0 and flip == 0 and slice == 0 and (moves.empty() or not isPhase2Move(moves.back())) and startPhase2();
+    }
+    for (uint m = 0; m < nbMoves; m++) {
+      if (not moves.empty() and not canFollow(m, moves.back())) {
+        continue;
+      }
+      const uint t = tables.twistMoves[twist * nbMoves + m], f = tables.flipMoves[flip * nbMoves + m], s = tables.sliceMoves[slice * nbMoves + m];
+      if (std::max(tables.sliceTwistDistances[s * nbTwists + t], tables.sliceFlipDistances[s * nbFlips + f]) >= togo) {
+        continue;
+      }
+      moves.push_back(m);
+      if (phase1(t, f, s, togo - 1)) {
+        return true;
+      }
+      moves.pop_back();
+    }
+    return false;
+  }
+
+  /// searches the shortest second phase from the cube turned by the first phase
+  bool startPhase2()
+  {
+    RubikCubies turned = cube;
+    for (uint m : moves) {
+      turned = turned * moveCubies()[m];
+    }
+    const uint corners = cornerPermCoordinate(turned), edges = edgePermCoordinate(turned), slices = slicePermCoordinate(turned);
+    const uint budget = std::min(maxLength - uint(moves.size()), maxPhase2Length);
+    for (uint length = distance(corners, edges, slices); length <= budget; length++) {
+      if (phase2(corners, edges, slices, length)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// lower bound of the second phase length
+  uint distance(uint corners, uint edges, uint slices) const
+  {
+    return std::max(tables.cornerDistances[slices * nbCornerPerms + corners], tables.edgeDistances[slices * nbEdgePerms + edges]);
+  }
+
+  /// searches the second phase solutions of exactly togo more moves
+  bool phase2(uint corners, uint edges, uint slices, uint togo)
+  {
+    if (togo == 0) {
+      return corners == 0 and edges == 0 and slices == 0;
+    }
+    for (uint k = 0; k < nbPhase2Moves; k++) {
+      const uint m = phase2Moves[k];
+      if (not moves.empty() and not canFollow(m, moves.back())) {
+        continue;
+      }
+      const uint c = tables.cornerMoves[corners * nbPhase2Moves + k], e = tables.edgeMoves[edges * nbPhase2Moves + k];
+      const uint s = tables.slicePermMoves[slices * nbPhase2Moves + k];
+      if (distance(c, e, s) >= togo) {
+        continue;
+      }
+      moves.push_back(m);
+      if (phase2(c, e, s, togo - 1)) {
+        return true;
+      }
+      moves.pop_back();
+    }
+    return false;
+  }
+};
+
+RubikSolver::RubikSolver() : m_tables([]() -> const Tables & {
+    static const Tables tables;
+    return tables;
+  }())
+{
+}
+
+bool RubikSolver::solve(const RubikCubies & cube, std::vector<RubikMove> & solution, unsigned int maxLength) const
+{
+  solution.clear();
+  if (not cube.valid()) {
+    return false;
+  }
+  Search search{m_tables, cube, maxLength, std::vector<uint>()};
+  search.moves.reserve(maxLength + maxPhase2Length);
+  const uint twist = twistCoordinate(cube), flip = flipCoordinate(cube), slice = m_tables.slice(cube);
+  for (uint length = std::max(m_tables.sliceTwistDistances[slice * nbTwists + twist], m_tables.sliceFlipDistances[slice * nbFlips + flip]); length <= maxLength; length++) {
+    if (search.phase1(twist, flip, slice, length)) {
+      solution.assign(search.moves.begin(), search.moves.end());
+      return true;
+    }
+  }
+  return false;
+}
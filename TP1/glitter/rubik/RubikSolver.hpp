@@ -0,0 +1,122 @@
+#ifndef __RUBIK_SOLVER_H__
+#define __RUBIK_SOLVER_H__
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RubikLogic.hpp"
+
+/// A face turn, as a number of clockwise quarter turns (see RubikState::applyFaceRotation)
+struct RubikMove {
+  RubikFaceName face;  ///< the turned face
+  unsigned char turns; ///< number of quarter turns (1, 2 or 3)
+
+  /// Constructor from a face and a number of quarter turns
+  RubikMove(RubikFaceName face = RubikFaceName::F, unsigned char turns = 1);
+
+  /// Constructor from an index among the 18 face turns (inverse hashing)
+  RubikMove(unsigned int index);
+
+  /// cast into an index among the 18 face turns (direct hashing)
+  operator uint() const;
+
+  /// the move undoing this one
+  RubikMove inverse() const;
+
+  /// the move in the usual notation (e.g. F, R2 or T')
+  std::string name() const;
+
+  /// a move sequence in the usual notation, separated by spaces
+  static std::string name(const std::vector<RubikMove> & moves);
+};
+
+/**
+ * @brief The cube as a permutation of its 8 corner and 12 edge cubies, with their orientations
+ *
+ * Each position of a corner (resp. edge) packs into a single byte the corner (resp. edge) lying there and its
+ * orientation, i.e. the index of the facet of the position on which lies the reference facet of the cubie: the
+ * facet on the top or down face for the corners and for the edges of these two layers, the facet on the front or
+ * back face for the four edges of the middle layer (the last four edges). A face turn is then the permutation of
+ * 20 bytes, instead of the 54 facets of RubikState.
+ */
+struct RubikCubies {
+  static const unsigned int nbCorners = 8; ///< number of corner cubies
+  static const unsigned int nbEdges = 12;  ///< number of edge cubies
+
+  std::array<uint8_t, nbCorners> corners; ///< for each position, the corner lying there (3 low bits) and its twist (times 8)
+  std::array<uint8_t, nbEdges> edges;     ///< for each position, the edge lying there (4 low bits) and its flip (times 16)
+
+  /// Default constructor (solved cube)
+  RubikCubies();
+
+  /// Constructor from the facets of a state
+  explicit RubikCubies(const RubikState & state);
+
+  /// conversion into a state
+  RubikState toState() const;
+
+  /// the cubies of a face turn, applied to the solved cube
+  static const RubikCubies & move(const RubikMove & move);
+
+  /// the cube after another permutation (e.g. a face turn)
+  RubikCubies operator*(const RubikCubies & other) const;
+
+  /// applies a face turn
+  RubikCubies & apply(const RubikMove & move) { return *this = *this * RubikCubies::move(move); }
+
+  /// equality test
+  bool operator==(const RubikCubies & other) const { return corners == other.corners and edges == other.edges; }
+
+  /// denotes if the cube is solved
+  bool solved() const { return *this == RubikCubies(); }
+
+  /// denotes if the cube can be reached by face turns (permutations of equal parities, total twist and flip of zero)
+  bool valid() const;
+
+  /// the corner lying at a position
+  unsigned int corner(unsigned int position) const { return corners[position] & 7; }
+
+  /// the twist (0, 1 or 2) of the corner lying at a position
+  unsigned int twist(unsigned int position) const { return corners[position] >> 3; }
+
+  /// the edge lying at a position
+  unsigned int edge(unsigned int position) const { return edges[position] & 15; }
+
+  /// the flip (0 or 1) of the edge lying at a position
+  unsigned int flip(unsigned int position) const { return edges[position] >> 4; }
+};
+
+/**
+ * @brief A two-phase solver (after H. Kociemba)
+ *
+ * The first phase brings the cube into the subgroup generated by the turns of the top and down faces and by the
+ * half turns of the other faces, where the corners are not twisted, the edges are not flipped and the edges of the
+ * middle layer stay in this layer. The second phase solves the cube within this subgroup. Each phase is an
+ * iterative deepening A* search on a few coordinates of the cube (the orientations and the permutations of some
+ * cubies, as integers), turned by move tables and bounded below by pruning tables (the exact number of moves
+ * solving a pair of coordinates, computed by a breadth first search). The first solutions of the first phase are
+ * completed by the second phase until the total length fits in the requested maximum.
+ *
+ * The tables (about 6 MB) are computed once, by the first constructed solver.
+ */
+class RubikSolver {
+public:
+  /// Constructor (computes the tables on first use)
+  RubikSolver();
+
+  /**
+   * @brief searches a move sequence solving a cube
+   * @param cube the cube to solve
+   * @param solution the moves solving the cube
+   * @param maxLength the maximal number of moves (solutions of at most 22 moves are usually found in a few milliseconds)
+   * @return false if the cube is not valid or if no solution is found within maxLength moves
+   */
+  bool solve(const RubikCubies & cube, std::vector<RubikMove> & solution, unsigned int maxLength = 22) const;
+
+private:
+  struct Tables;
+  struct Search;
+  const Tables & m_tables; ///< move and pruning tables (shared by all the solvers)
+};
+
+#endif // !defined(__RUBIK_SOLVER_H__)
@@ -1,18 +1,15 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/ext.hpp"
 
-#include "Image.hpp"
+#include "ImageCache.hpp"
 #include "TextPrinter.hpp"
-#include "stb_image.h"
 #include "utils.hpp"
 
 TextPrinter::TextPrinter(uint width, uint height)
     : m_width(width), m_height(height), m_nbChar(16), m_wOverH(width / float(height)), m_program("rubik/font.v.glsl", "rubik/font.f.glsl"), m_fontTexture(GL_TEXTURE_2D), m_sampler(0)
 {
   //
-  Image<GLubyte> fontImage;
-  std::string rgbFilename = absolutename("rubik/font.png");
-  fontImage.data = stbi_load(rgbFilename.c_str(), &fontImage.width, &fontImage.height, &fontImage.channels, STBI_default);
+  Image<GLubyte> fontImage = ImageCache::load(absolutename("rubik/font.png"));
   m_fontTexture.setData(fontImage, true);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
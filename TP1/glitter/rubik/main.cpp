@@ -1,4 +1,13 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <numeric>
+#include <random>
 #include <vector>
 // matrix and vectors
 // to declare before including glm.hpp, to use the swizzle operators
@@ -9,11 +18,195 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "RubikApplication.hpp"
+#include "RubikSolver.hpp"
 #include "glApi.hpp"
 #include "termcolor/termcolor.hpp"
 
-int main(int /*argc*/, char * /*argv*/ [])
+namespace
 {
+/// solves random scrambles, and reports the timings of the solver
+void benchmarkSolver(unsigned int nbScrambles)
+{
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  RubikSolver solver;
+  std::cout << "tables: " << std::chrono::duration<double, std::milli>(clock::now() - start).count() << " ms" << std::endl;
+  std::mt19937 generator(0);
+  double total = 0, longest = 0;
+  size_t nbMoves = 0;
+  for (unsigned int k = 0; k < nbScrambles; k++) {
+    RubikState state;
+    for (int turn = 0; turn < 50; turn++) {
+      state.applyFaceRotation(RubikFace(RubikFaceName(generator() % 6)));
+    }
+    std::vector<RubikMove> solution;
+    start = clock::now();
+    const bool solved = solver.solve(RubikCubies(state), solution);
+    const double time = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    total += time;
+    longest = std::max(longest, time);
+    nbMoves += solution.size();
+    if (not solved) {
+      std::cerr << "scramble " << k << " not solved" << std::endl;
+    }
+  }
+  std::cout << nbScrambles << " scrambles: " << total / nbScrambles << " ms on average (at most " << longest << " ms), " << double(nbMoves) / nbScrambles
+            << " moves on average" << std::endl;
+}
+
+/**
+ * @brief The first implementation of the moves (before the solver), kept as a reference for benchmarkTurns
+ *
+ * The facets and the pieces are permutations with their inverses, and each face turn composes them with the
+ * 4-cycles of the facets of its layer, before turning the pieces of the face. These facet cycles split the
+ * pieces (see RubikState::applyFaceRotation), hence only the pieces are checked against RubikState.
+ */
+class ReferenceState {
+public:
+  /// Default constructor (solved cube)
+  ReferenceState()
+  {
+    std::iota(m_facetMapping.begin(), m_facetMapping.end(), 0);
+    std::iota(m_invfacetMapping.begin(), m_invfacetMapping.end(), 0);
+    std::iota(m_pieceMapping.begin(), m_pieceMapping.end(), 0);
+    std::iota(m_invpieceMapping.begin(), m_invpieceMapping.end(), 0);
+  }
+
+  /// Apply a face rotation (see RubikState::applyFaceRotation)
+  void applyFaceRotation(const RubikFace & face)
+  {
+    // update the facet permutation
+    RubikFace next(face.next);
+    RubikFace prev(face.prev);
+    std::array<uint, 4> cycle;
+    cycle = {{RubikFacet(face.name, -1, -1), RubikFacet(face.name, 1, -1), RubikFacet(face.name, 1, 1), RubikFacet(face.name, -1, 1)}};
+    cycle4Facets(cycle.data());
+    cycle = {{RubikFacet(face.name, 0, -1), RubikFacet(face.name, 1, 0), RubikFacet(face.name, 0, 1), RubikFacet(face.name, -1, 0)}};
+    cycle4Facets(cycle.data());
+    cycle = {{RubikFacet(face.next, 0, 1), RubikFacet(face.prev, 1, 0), RubikFacet(prev.prev, 0, -1), RubikFacet(next.next, -1, 0)}};
+    cycle4Facets(cycle.data());
+    cycle = {{RubikFacet(face.next, -1, 1), RubikFacet(face.prev, 1, -1), RubikFacet(prev.prev, 1, -1), RubikFacet(next.next, -1, 1)}};
+    cycle4Facets(cycle.data());
+    cycle = {{RubikFacet(face.next, 1, 1), RubikFacet(face.prev, 1, 1), RubikFacet(prev.prev, -1, -1), RubikFacet(next.next, -1, -1)}};
+    cycle4Facets(cycle.data());
+    // update the piece permutation
+    std::array<uint, 9> pieces = piecesOnFace(face);
+    std::vector<uint> invpieces;
+    for (uint a = 0; a < 3; ++a) {
+      for (uint b = 0; b < 3; ++b) {
+        uint p1 = pieces[a * 3 + b];       // source piece
+        uint p2 = pieces[(2 - b) * 3 + a]; // target piece (clockwise rotation of p1);
+        m_pieceMapping[m_invpieceMapping[p2]] = p1;
+        invpieces.push_back(m_invpieceMapping[p2]);
+      }
+    }
+    // update the inverse mapping
+    for (uint invp : invpieces) {
+      m_invpieceMapping[m_pieceMapping[invp]] = invp;
+    }
+    for (uint p = 0; p < m_pieceMapping.size(); ++p) {
+      assert(p == m_invpieceMapping[m_pieceMapping[p]]);
+      assert(p == m_pieceMapping[m_invpieceMapping[p]]);
+    }
+  }
+
+  /// the piece lying at a location
+  uint pieceAt(uint location) const { return m_invpieceMapping[location]; }
+
+private:
+  /// the pieces of a face in the solved state (see RubikState::piecesOnFace)
+  static std::array<uint, 9> piecesOnFace(const RubikFace & face)
+  {
+    std::array<uint, 9> pieces;
+    uint k = 0;
+    for (int a = -1; a <= 1; a++) {
+      for (int b = -1; b <= 1; b++) {
+        pieces[k++] = RubikPiece(face, a, b);
+      }
+    }
+    return pieces;
+  }
+
+  /// Composes the direct facet mapping with a 4-order cycle (left composition)
+  void cycle4Facets(uint cycle[4])
+  {
+    uint x1 = cycle[0];
+    uint x2 = cycle[1];
+    uint x3 = cycle[2];
+    uint x4 = cycle[3];
+    m_facetMapping[m_invfacetMapping[x1]] = x2;
+    m_facetMapping[m_invfacetMapping[x2]] = x3;
+    m_facetMapping[m_invfacetMapping[x3]] = x4;
+    m_facetMapping[m_invfacetMapping[x4]] = x1;
+    for (auto y : {m_invfacetMapping[x1], m_invfacetMapping[x2], m_invfacetMapping[x3], m_invfacetMapping[x4]}) {
+      m_invfacetMapping[m_facetMapping[y]] = y;
+    }
+  }
+
+  std::array<uint, 54> m_facetMapping;    ///< permutation of the 54 facets
+  std::array<uint, 54> m_invfacetMapping; ///< inverse permutation of the 54 facets
+  std::array<uint, 27> m_pieceMapping;    ///< permutation of the 27 pieces
+  std::array<uint, 27> m_invpieceMapping; ///< inverse permutation of the 27 pieces
+};
+
+/// applies face turns to a state, and reports the number of moves per second
+void benchmarkTurns(unsigned int nbMoves)
+{
+  using clock = std::chrono::steady_clock;
+  auto movesPerSecond = [](unsigned int count, clock::time_point start) { return count / std::chrono::duration<double>(clock::now() - start).count(); };
+  const RubikFace faces[] = {RubikFaceName::F, RubikFaceName::R, RubikFaceName::D, RubikFaceName::B, RubikFaceName::L, RubikFaceName::T};
+  // the reference is much slower, hence it only plays the first hundredth of the moves
+  const unsigned int nbReferenceMoves = std::max(nbMoves / 100, 1u);
+  ReferenceState reference;
+  auto start = clock::now();
+  for (unsigned int k = 0; k < nbReferenceMoves; k++) {
+    reference.applyFaceRotation(faces[k * 7 % 6]);
+  }
+  std::cout << "face turns (reference, facet cycles): " << movesPerSecond(nbReferenceMoves, start) / 1e6 << " M moves/s" << std::endl;
+  RubikState state;
+  for (unsigned int k = 0; k < nbReferenceMoves; k++) {
+    state.applyFaceRotation(faces[k * 7 % 6]);
+  }
+  for (uint location = 0; location < 54; location++) {
+    const RubikFacet facet(state.facetAt(location));
+    const RubikFacet here(location);
+    if (RubikPiece(RubikFace(facet.face), facet.a, facet.b) != reference.pieceAt(RubikPiece(RubikFace(here.face), here.a, here.b))) {
+      std::cerr << "the pieces of the byte shuffle and of the reference disagree at location " << location << std::endl;
+      break;
+    }
+  }
+  state = RubikState();
+  start = clock::now();
+  for (unsigned int k = 0; k < nbMoves; k++) {
+    state.applyFaceRotation(faces[k * 7 % 6]);
+  }
+  std::cout << "face turns (byte shuffle): " << movesPerSecond(nbMoves, start) / 1e6 << " M moves/s" << std::endl;
+  RubikPermutation product;
+  start = clock::now();
+  for (unsigned int k = 0; k < nbMoves; k++) {
+    product = product * rubikTurns[3 * (k * 7 % 6)];
+  }
+  std::cout << "face turns (scalar product): " << movesPerSecond(nbMoves, start) / 1e6 << " M moves/s" << std::endl;
+  // a sequence of 8 moves collapsed into one permutation at compile time
+  constexpr RubikPermutation sequence = RubikPermutation::sequence("R T R' T' F2 B2 L D'");
+  start = clock::now();
+  for (unsigned int k = 0; k < nbMoves / 8; k++) {
+    state.apply(sequence);
+  }
+  std::cout << "sequences of 8 moves: " << movesPerSecond(nbMoves, start) / 1e6 << " M moves/s" << std::endl;
+  std::cout << "(facets at location 0: " << state.facetAt(0) << ", " << uint(product.facets[0]) << ")" << std::endl;
+}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+  if (argc > 1 and not strcmp(argv[1], "solve")) {
+    benchmarkSolver(argc > 2 ? std::max(atoi(argv[2]), 1) : 100);
+    return 0;
+  } else if (argc > 1 and not strcmp(argv[1], "turns")) {
+    benchmarkTurns(argc > 2 ? std::max(atoi(argv[2]), 8) : 10000000);
+    return 0;
+  }
   RubikApplication app;
   app.setCallbacks();
   app.mainLoop();
@@ -0,0 +1,48 @@
+/** point and spot lights of the clusters of the view frustum (see ClusteredLights), included by the material shaders after the declaration of DirLight */
+
+uniform samplerBuffer lights;        ///< three texels per light: position and range, intensity and cosOuter, direction and cosInner (in world space)
+uniform usamplerBuffer clusters;     ///< range (offset, count) of the light list of each cluster in lightIndices
+uniform usamplerBuffer lightIndices; ///< light lists of the clusters
+uniform vec3 clusterGrid;            ///< number of clusters along the width and the height of the screen, and in depth
+uniform vec2 clusterDepth;           ///< slice of the depth d: log(d) * clusterDepth.x + clusterDepth.y
+uniform vec2 viewportSize;           ///< size of the viewport (in pixels)
+uniform mat4 V;                      ///< world view matrix
+
+/**
+ * @brief finds the lights reaching a fragment
+ * @param fragCoord the window coordinates of the fragment (gl_FragCoord)
+ * @param positionInWorld the position of the fragment in world space
+ * @return the range (offset, count) of the lights of its cluster in lightIndices
+ */
+uvec2 clusterLights(const in vec4 fragCoord, const in vec3 positionInWorld)
+{
+  float depth = max(-(V * vec4(positionInWorld, 1)).z, 1e-4);
+  ivec3 cell = ivec3(fragCoord.xy / viewportSize * clusterGrid.xy, log(depth) * clusterDepth.x + clusterDepth.y);
+  cell = clamp(cell, ivec3(0), ivec3(clusterGrid) - 1);
+  return texelFetch(clusters, (cell.z * int(clusterGrid.y) + cell.y) * int(clusterGrid.x) + cell.x).xy;
+}
+
+/**
+ * @brief a point or spot light, seen as a directional light by a fragment
+ * @param index the index of the light
+ * @param positionInWorld the position of the fragment in world space
+ * @return the direction from the light to the fragment, and the intensity reaching it
+ */
+DirLight clusteredLight(const in uint index, const in vec3 positionInWorld)
+{
+  vec4 positionRange = texelFetch(lights, int(3 * index));
+  vec4 intensityCosOuter = texelFetch(lights, int(3 * index + 1));
+  vec4 directionCosInner = texelFetch(lights, int(3 * index + 2));
+  vec3 toFragment = positionInWorld - positionRange.xyz;
+  float distance = length(toFragment);
+  DirLight light;
+  light.direction = toFragment / max(distance, 1e-4);
+  // inverse square falloff, smoothly windowed to reach zero at the range of the light
+  float ratio = distance / positionRange.w;
+  float window = clamp(1 - ratio * ratio * ratio * ratio, 0, 1);
+  float attenuation = window * window / (1 + distance * distance);
+  // the point lights have a cosOuter lower than -1, hence are never attenuated by the cone
+  attenuation *= smoothstep(intensityCosOuter.w, directionCosInner.w, dot(light.direction, directionCosInner.xyz));
+  light.intensity = intensityCosOuter.rgb * attenuation;
+  return light;
+}
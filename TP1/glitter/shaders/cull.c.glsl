@@ -0,0 +1,55 @@
+#version 430
+/** Frustum culling of the instances of a GpuDrivenScene, one invocation per instance */
+layout(local_size_x = 256) in;
+
+struct Mesh {
+  uint firstIndex;    ///< index of the first IBO element
+  uint count;         ///< number of IBO elements
+  uint firstInstance; ///< position of the range of its instances in the list of visible instances
+  uint nbInstances;   ///< number of instances of the mesh
+  vec4 bounds;        ///< bounding sphere in object space (center, radius)
+};
+
+// buffers (see GpuDrivenScene::cull)
+layout(std430, binding = 0) readonly buffer Models {
+  mat4 models[];
+};
+layout(std430, binding = 1) readonly buffer InstanceMeshes {
+  uint instanceMeshes[];
+};
+layout(std430, binding = 2) readonly buffer Meshes {
+  Mesh meshes[];
+};
+layout(std430, binding = 3) buffer Counters {
+  uint counters[]; ///< number of visible instances of each mesh
+};
+layout(std430, binding = 4) writeonly buffer Visible {
+  uint visible[]; ///< indices of the visible instances, grouped by mesh
+};
+
+// uniforms
+uniform vec4 planes[6];   ///< frustum planes in world space (normals pointing inside)
+uniform uint nbInstances; ///< the number of instances
+
+void main()
+{
+  uint instance = gl_GlobalInvocationID.x;
+  if (instance >= nbInstances) {
+    return;
+  }
+  uint meshIndex = instanceMeshes[instance];
+  Mesh mesh = meshes[meshIndex];
+  mat4 model = models[instance];
+
+  // sphere enclosing the transformed bounding sphere (the scale being the largest one of the axes)
+  vec3 center = (model * vec4(mesh.bounds.xyz, 1)).xyz;
+  float scale = sqrt(max(max(dot(model[0].xyz, model[0].xyz), dot(model[1].xyz, model[1].xyz)), dot(model[2].xyz, model[2].xyz)));
+  float radius = scale * mesh.bounds.w;
+  for (int k = 0; k < 6; k++) {
+    if (dot(planes[k].xyz, center) + planes[k].w < -radius) {
+      return;
+    }
+  }
+  uint slot = atomicAdd(counters[meshIndex], 1u);
+  visible[mesh.firstInstance + slot] = instance;
+}
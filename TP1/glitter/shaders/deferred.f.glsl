@@ -0,0 +1,66 @@
+#version 410
+/**
+ * lighting pass of deferred shading: shades each pixel once from the targets of the G-buffer (see GBuffer),
+ * with the point and spot lights of ClusteredLights if CLUSTERED_LIGHTS is defined,
+ * or displays the normals if DISPLAY_NORMALS is defined
+ */
+
+// Fragment attributes
+in vec2 uv; ///< texture coordinates in the viewport
+
+#include "lighting.glsl"
+
+uniform DirLight lightsInWorld[3];  ///< lights in world space
+uniform vec3 positionCameraInWorld; ///< camera center in worldSpace
+uniform mat4 viewProjInverse;       ///< inverse of the world clip matrix (P * V)
+
+#ifdef CLUSTERED_LIGHTS
+#include "clusteredlights.glsl"
+#endif
+
+// targets of the G-buffer
+uniform sampler2D gAlbedo;   ///< diffuse albedo
+uniform sampler2D gNormal;   ///< shading normal (in world space) and shininess
+uniform sampler2D gSpecular; ///< specular albedo
+uniform sampler2D gAmbient;  ///< ambient color
+uniform sampler2D gDepth;    ///< depth of the geometry pass
+
+// output color
+out vec4 fragColor;
+
+void main()
+{
+  float depth = texture(gDepth, uv).r;
+  if (depth == 1) {
+    discard; // background, left to the clear color
+  }
+  vec4 normalShininess = texture(gNormal, uv);
+  vec3 normal = normalize(normalShininess.xyz);
+#ifdef DISPLAY_NORMALS
+  fragColor = vec4(0.5 * (normal + 1), 1);
+#else
+  // position of the surface, from its depth
+  vec4 position = viewProjInverse * vec4(2 * vec3(uv, depth) - 1, 1);
+  vec3 positionInWorld = position.xyz / position.w;
+  vec3 diffuse = texture(gAlbedo, uv).rgb;
+  vec3 specular = texture(gSpecular, uv).rgb;
+  float shininess = normalShininess.w;
+  vec3 lambert = vec3(0);
+  vec3 phong = vec3(0);
+  vec3 directionToCamera = normalize(positionCameraInWorld - positionInWorld);
+  for (int k = 0; k < 3; k++) {
+    lambert += computeLightLambert(lightsInWorld[k], normal, diffuse);
+    phong += computeLightSpecular(lightsInWorld[k], normal, directionToCamera, specular, shininess);
+  }
+#ifdef CLUSTERED_LIGHTS
+  // only the lights of the cluster of the pixel
+  uvec2 range = clusterLights(gl_FragCoord, positionInWorld);
+  for (uint k = range.x; k < range.x + range.y; k++) {
+    DirLight light = clusteredLight(texelFetch(lightIndices, int(k)).r, positionInWorld);
+    lambert += computeLightLambert(light, normal, diffuse);
+    phong += computeLightSpecular(light, normal, directionToCamera, specular, shininess);
+  }
+#endif
+  fragColor = vec4(texture(gAmbient, uv).rgb + lambert + phong, 1);
+#endif
+}
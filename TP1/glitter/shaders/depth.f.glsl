@@ -0,0 +1,6 @@
+#version 410
+/** depth pre-pass: no color is written, the depth being the one of the rasterized fragment */
+
+void main()
+{
+}
@@ -0,0 +1,17 @@
+#version 410
+/** depth pre-pass: the positions of simplemat.v.glsl, computed identically so that the shading pass can test its depth with GL_EQUAL */
+
+// ins (vertex input attributes)
+layout(location = 0) in vec3 vertexPosition;
+
+// uniforms
+uniform mat4 M; ///< model world matrix
+uniform mat4 V; ///< world view matrix
+uniform mat4 P; ///< projection matrix
+
+invariant gl_Position;
+
+void main()
+{
+  gl_Position = P * V * (M * vec4(vertexPosition, 1));
+}
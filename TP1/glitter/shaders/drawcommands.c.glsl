@@ -0,0 +1,57 @@
+#version 430
+/** Indirect draw commands of the meshes of a GpuDrivenScene, one invocation per mesh */
+layout(local_size_x = 64) in;
+
+struct Mesh {
+  uint firstIndex;    ///< index of the first IBO element
+  uint count;         ///< number of IBO elements
+  uint firstInstance; ///< position of the range of its instances in the list of visible instances
+  uint nbInstances;   ///< number of instances of the mesh
+  vec4 bounds;        ///< bounding sphere in object space (center, radius)
+};
+
+/// layout of the commands read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+// buffers (see GpuDrivenScene::cull)
+layout(std430, binding = 2) readonly buffer Meshes {
+  Mesh meshes[];
+};
+layout(std430, binding = 3) readonly buffer Counters {
+  uint counters[]; ///< number of visible instances of each mesh
+};
+layout(std430, binding = 5) writeonly buffer Commands {
+  DrawElementsIndirectCommand commands[];
+};
+layout(std430, binding = 6) buffer DrawCount {
+  uint drawCount; ///< number of commands written (if compact)
+};
+
+// uniforms
+uniform uint nbMeshes; ///< the number of meshes
+uniform bool compact;  ///< skips the meshes without visible instance (the number of commands being read from DrawCount)
+
+void main()
+{
+  uint meshIndex = gl_GlobalInvocationID.x;
+  if (meshIndex >= nbMeshes) {
+    return;
+  }
+  uint nbVisible = counters[meshIndex];
+  uint slot = meshIndex;
+  if (compact) {
+    if (nbVisible == 0) {
+      return;
+    }
+    slot = atomicAdd(drawCount, 1u);
+  }
+  // the instance attribute of the first instance is the first one of the range of the mesh
+  Mesh mesh = meshes[meshIndex];
+  commands[slot] = DrawElementsIndirectCommand(mesh.count, nbVisible, mesh.firstIndex, 0, mesh.firstInstance);
+}
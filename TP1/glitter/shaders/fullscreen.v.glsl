@@ -0,0 +1,12 @@
+#version 410
+/** a triangle covering the viewport, generated from gl_VertexID (drawn without vertex attributes, see GBuffer::drawFullScreen) */
+
+// out (vertex output attributes)
+out vec2 uv; ///< texture coordinates in the viewport
+
+void main()
+{
+  // (0, 0), (2, 0) and (0, 2): the part of the triangle outside of the viewport is clipped
+  uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(2 * uv - 1, 0, 1);
+}
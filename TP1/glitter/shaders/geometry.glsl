@@ -0,0 +1,8 @@
+/** geometric attributes passed from the vertex to the fragment shaders of the materials (included by simplemat.v.glsl, simplemat.f.glsl, ...) */
+
+struct Geometry {
+  vec4 position;  ///< homogeneous position in world space
+  vec3 normal;    ///< normal in world space
+  vec3 tangent;   ///< tangent in world space
+  vec3 bitangent; ///< bitangent (normal cross tangent)
+};
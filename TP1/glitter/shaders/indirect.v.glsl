@@ -0,0 +1,35 @@
+#version 430
+/** simplemat.v.glsl for the instances of a GpuDrivenScene, whose model matrices are read from a buffer */
+
+// ins (vertex input attributes)
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal;
+layout(location = 3) in vec3 vertexTangent;
+layout(location = 4) in uint instance; ///< index of the instance (per instance attribute)
+
+// buffers (see GpuDrivenScene::modelsBinding)
+layout(std430, binding = 0) readonly buffer Models {
+  mat4 models[]; ///< model world matrices of the instances
+};
+
+// uniforms
+uniform mat4 V; ///< world view matrix
+uniform mat4 P; ///< projection matrix
+
+#include "geometry.glsl"
+
+// out (vertex output attributes)
+out Geometry geomInWorld; ///< All geometric attributes (in world space).
+out vec2 uv;              ///< uv coordinates
+
+void main()
+{
+  mat4 M = models[instance];
+  geomInWorld.position = M * vec4(vertexPosition, 1);
+  gl_Position = P * V * geomInWorld.position;
+  geomInWorld.normal = normalize(inverse(transpose(mat3(M))) * vertexNormal);
+  geomInWorld.tangent = normalize(mat3(M) * vertexTangent);
+  geomInWorld.bitangent = cross(geomInWorld.normal, geomInWorld.tangent);
+  uv = vertexUV;
+}
@@ -0,0 +1,16 @@
+#version 410
+/** Same as simple3d.v.glsl, with the MVP matrix read from a per-instance attribute */
+
+// ins (inputs)
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexColors;
+layout(location = 2) in mat4 MVP; // per instance
+// outs
+out vec4 color;
+
+void main()
+{
+    vec4 positionH = vec4(vertexPosition,1);
+    gl_Position =  MVP * positionH;
+    color = vec4(vertexColors, 1);
+}
@@ -0,0 +1,42 @@
+/** directional lights and their contributions, shared by the forward (simplemat.f.glsl) and deferred (deferred.f.glsl) shading */
+
+// Directional light struct
+struct DirLight {
+  vec3 direction;
+  vec3 intensity;
+};
+
+/**
+ * @brief computes the diffuse contribution of a light source
+ * @param light a directional light source
+ * @param normal the object normal in the same coordinates as the light
+ * @param diffuse the diffuse albedo of the material
+ * @return the Lambertian contribution
+ *
+ * @note PA5 (part 2)
+ */
+vec3 computeLightLambert(const in DirLight light, const in vec3 normal, const in vec3 diffuse)
+{
+  return max(dot(normal, -light.direction), 0) * light.intensity * diffuse;
+}
+
+/**
+ * @brief computes the specular (Phong or Blinn-Phong) contribution of a light source
+ * @param light a directional light source
+ * @param normal the object normal in the same coordinates as the light
+ * @param directionToCamera the direction from the fragment to the camera center
+ * @param specular the specular albedo of the material
+ * @param shininess the shininess of the material
+ * @return the specular contribution
+ *
+ * @note PA5 (part 2): Here you should implement one specular illumination model (you may choose freely between Phong and Blinn-Phong model).
+ */
+vec3 computeLightSpecular(const in DirLight light, const in vec3 normal, const in vec3 directionToCamera, const in vec3 specular, const in float shininess)
+{
+  // Blinn-Phong, the surfaces facing away from the light getting no highlight
+  if (dot(normal, -light.direction) <= 0) {
+    return vec3(0);
+  }
+  vec3 halfway = normalize(directionToCamera - light.direction);
+  return pow(max(dot(normal, halfway), 0), shininess) * light.intensity * specular;
+}
@@ -0,0 +1,40 @@
+#version 410
+/** Screen-space adaptive tessellation levels: each edge of a patch is split into segments of about pixelsPerEdge pixels */
+layout(vertices = 4) out;
+
+// ins (inputs)
+in vec2 tcParameters[];
+in vec4 tcClipPosition[];
+in mat4 tcMVP[];
+uniform vec2 viewportSize;  // in pixels
+uniform float pixelsPerEdge;
+// outs
+out vec2 teParameters[];
+patch out mat4 teMVP;
+
+vec2 screenPosition(int k)
+{
+    vec4 clip = tcClipPosition[k];
+    return 0.5 * viewportSize * clip.xy / max(clip.w, 1e-4);
+}
+
+// level of the edge between two corners, computed identically by the two patches sharing it
+float edgeLevel(int a, int b)
+{
+    return clamp(distance(screenPosition(a), screenPosition(b)) / pixelsPerEdge, 1, gl_MaxTessGenLevel);
+}
+
+void main()
+{
+    teParameters[gl_InvocationID] = tcParameters[gl_InvocationID];
+    if (gl_InvocationID == 0) {
+        teMVP = tcMVP[0];
+        // corners: 0 = (u0, v0), 1 = (u1, v0), 2 = (u1, v1), 3 = (u0, v1)
+        gl_TessLevelOuter[0] = edgeLevel(3, 0);
+        gl_TessLevelOuter[1] = edgeLevel(0, 1);
+        gl_TessLevelOuter[2] = edgeLevel(1, 2);
+        gl_TessLevelOuter[3] = edgeLevel(2, 3);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+    }
+}
@@ -0,0 +1,31 @@
+#version 410
+/** Evaluates the parametric surfaces of PA3 at the tessellated parameters */
+layout(quads, equal_spacing, ccw) in;
+
+// ins (inputs)
+in vec2 teParameters[];
+patch in mat4 teMVP;
+uniform int surface; // 0: sphere, 1: torus, 2: shell
+uniform float smallRadius;
+// outs
+out vec4 color;
+
+vec3 position(float phi, float theta)
+{
+    if (surface == 0) {
+        return vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), 1 - cos(theta));
+    } else if (surface == 1) {
+        float r = 4 * smallRadius + smallRadius * cos(phi);
+        return vec3(r * cos(theta), r * sin(theta), smallRadius * sin(phi));
+    }
+    // the shell swaps the names of its parameters
+    return vec3(-theta * sin(phi) * sin(phi) * sin(theta), theta * sin(phi) * sin(phi) * cos(theta), theta * sin(phi) * cos(phi));
+}
+
+void main()
+{
+    vec2 u = gl_TessCoord.xy;
+    vec2 parameters = mix(mix(teParameters[0], teParameters[1], u.x), mix(teParameters[3], teParameters[2], u.x), u.y);
+    gl_Position = teMVP * vec4(position(parameters.x, parameters.y), 1);
+    color = vec4(1, 0, 1, 1);
+}
@@ -0,0 +1,18 @@
+#version 410
+/** Vertices of the coarse patch grid of a parametric surface (see paramsurf.te.glsl) */
+
+// ins (inputs)
+layout(location = 0) in vec2 vertexParameters; // (phi, theta)
+layout(location = 1) in vec3 vertexPosition;   // position at these parameters, for the tessellation levels
+layout(location = 2) in mat4 MVP;              // per instance
+// outs
+out vec2 tcParameters;
+out vec4 tcClipPosition;
+out mat4 tcMVP;
+
+void main()
+{
+    tcParameters = vertexParameters;
+    tcClipPosition = MVP * vec4(vertexPosition, 1);
+    tcMVP = MVP;
+}
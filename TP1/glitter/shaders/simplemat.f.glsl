@@ -1,25 +1,25 @@
 #version 410
+/**
+ * material shading, or display of the normals if DISPLAY_NORMALS is defined
+ * (with the point and spot lights of ClusteredLights if CLUSTERED_LIGHTS is defined),
+ * or output of the attributes of the surface to the G-buffer if GBUFFER is defined (see GBuffer)
+ */
 
-struct Geometry {
-  vec4 position;  ///< homogeneous position in world space
-  vec3 normal;    ///< normal in world space
-  vec3 tangent;   ///< tangent in world space
-  vec3 bitangent; ///< bitangent (normal cross tangent)
-};
+#include "geometry.glsl"
 
 // Fragment attributes
 in Geometry geomInWorld; ///< All geometric attributes (in world space).
 in vec2 uv;              ///< uv coordinates
 
-// Directional light struct
-struct DirLight {
-  vec3 direction;
-  vec3 intensity;
-};
+#include "lighting.glsl"
 
 uniform DirLight lightsInWorld[3];  ///< lights in world space
 uniform vec3 positionCameraInWorld; ///< camera center in worldSpace
 
+#ifdef CLUSTERED_LIGHTS
+#include "clusteredlights.glsl"
+#endif
+
 // Material properties uniforms
 struct Material {
   vec3 ambient;
@@ -34,40 +34,17 @@ struct Material {
 };
 
 uniform Material material;
-uniform bool displayNormals;
 
+#ifdef GBUFFER
+// outputs to the targets of the G-buffer (see GBuffer::Target)
+layout(location = 0) out vec4 gAlbedo;   ///< diffuse albedo
+layout(location = 1) out vec4 gNormal;   ///< shading normal (in world space) and shininess
+layout(location = 2) out vec4 gSpecular; ///< specular albedo
+layout(location = 3) out vec4 gAmbient;  ///< ambient color
+#else
 // output color
 out vec4 fragColor;
-
-/**
- * @brief computes the diffuse contribution of a light source
- * @param light a directional light source
- * @param normal the object normal in the same coordinates as the light
- * @param diffuse the diffuse albedo of the material
- * @return the Lambertian contribution
- *
- * @note PA5 (part 2)
- */
-vec3 computeLightLambert(const in DirLight light, const in vec3 normal, const in vec3 diffuse)
-{
-  return vec3(0);
-}
-
-/**
- * @brief computes the specular (Phong or Blinn-Phong) contribution of a light source
- * @param light a directional light source
- * @param normal the object normal in the same coordinates as the light
- * @param directionToCamera the direction from the fragment to the camera center
- * @param specular the specular albedo of the material
- * @param shininess the shininess of the material
- * @return the specular contribution
- *
- * @note PA5 (part 2): Here you should implement one specular illumination model (you may choose freely between Phong and Blinn-Phong model).
- */
-vec3 computeLightSpecular(const in DirLight light, const in vec3 normal, const in vec3 directionToCamera, const in vec3 specular, const in float shininess)
-{
-  return vec3(0);
-}
+#endif
 
 /**
  * @brief computes the diffuse contribution of a light source
@@ -94,11 +71,14 @@ vec4 normal2Color(vec3 n)
 void main()
 {
   vec3 microNormal = computeMicroNormal(geomInWorld.normal, geomInWorld.tangent, geomInWorld.bitangent);
-  if (displayNormals) {
-    fragColor = normal2Color(microNormal);
-    return;
-  }
-
+#if defined(GBUFFER)
+  gAlbedo = vec4(material.diffuse * texture(material.colormap, uv).rgb, 1);
+  gNormal = vec4(normalize(microNormal), material.shininess);
+  gSpecular = vec4(material.specular * texture(material.specularmap, uv).rgb, 1);
+  gAmbient = vec4(material.ambient, 1);
+#elif defined(DISPLAY_NORMALS)
+  fragColor = normal2Color(microNormal);
+#else
   vec3 diffuse = material.diffuse * texture(material.colormap, uv).rgb;
   vec3 specular = material.specular * texture(material.specularmap, uv).rgb;
   vec3 lambert = vec3(0);
@@ -108,5 +88,16 @@ void main()
     lambert += computeLightLambert(lightsInWorld[k], microNormal, diffuse);
     phong += computeLightSpecular(lightsInWorld[k], microNormal, directionToCamera, specular, material.shininess);
   }
+#ifdef CLUSTERED_LIGHTS
+  // only the lights of the cluster of the fragment
+  vec3 position = geomInWorld.position.xyz / geomInWorld.position.w;
+  uvec2 range = clusterLights(gl_FragCoord, position);
+  for (uint k = range.x; k < range.x + range.y; k++) {
+    DirLight light = clusteredLight(texelFetch(lightIndices, int(k)).r, position);
+    lambert += computeLightLambert(light, microNormal, diffuse);
+    phong += computeLightSpecular(light, microNormal, directionToCamera, specular, material.shininess);
+  }
+#endif
   fragColor = vec4(material.ambient + lambert + phong, 1);
+#endif
 }
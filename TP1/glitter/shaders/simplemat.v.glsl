@@ -11,17 +11,15 @@ uniform mat4 M; ///< model world matrix
 uniform mat4 V; ///< world view matrix
 uniform mat4 P; ///< projection matrix
 
-struct Geometry {
-  vec4 position;  ///< homogeneous position in world space
-  vec3 normal;    ///< normal in world space
-  vec3 tangent;   ///< tangent in world space
-  vec3 bitangent; ///< bitangent (normal cross tangent)
-};
+#include "geometry.glsl"
 
 // out (vertex output attributes)
 out Geometry geomInWorld; ///< All geometric attributes (in world space).
 out vec2 uv;              ///< uv coordinates
 
+// the depth must match the one of the depth pre-pass (see depth.v.glsl)
+invariant gl_Position;
+
 /**
  * @brief computes the normal in world space
  * @param modelWorld the transform between the object and the world
@@ -0,0 +1,23 @@
+#version 430
+/** Transforms an array of points by a matrix, one invocation per point */
+layout(local_size_x = 256) in;
+
+// buffers (bound with Buffer::bindBase)
+layout(std430, binding = 0) readonly buffer Points {
+  vec4 points[];
+};
+layout(std430, binding = 1) writeonly buffer Transformed {
+  vec4 transformed[];
+};
+
+// uniforms
+uniform mat4 matrix; // the transformation
+uniform uint count;  // the number of points (the last work group being partially used)
+
+void main()
+{
+  uint k = gl_GlobalInvocationID.x;
+  if (k < count) {
+    transformed[k] = matrix * points[k];
+  }
+}
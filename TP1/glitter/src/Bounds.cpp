@@ -0,0 +1,274 @@
+#include "Bounds.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(BoundingSphere) == 4 * sizeof(float), "BoundingSphere is loaded as a SSE register");
+
+BoundingSphere BoundingSphere::fromPoints(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices)
+{
+  size_t nbPoints = indices.empty() ? positions.size() : indices.size();
+  auto point = [&](size_t k) -> const glm::vec3 & { return indices.empty() ? positions[k] : positions[indices[k]]; };
+  if (nbPoints == 0) {
+    return BoundingSphere();
+  }
+  // initial guess: the two most distant points along the axis of largest extent
+  size_t extremes[3][2] = {{0, 0}, {0, 0}, {0, 0}};
+  for (size_t k = 0; k < nbPoints; k++) {
+    for (int axis = 0; axis < 3; axis++) {
+      if (point(k)[axis] < point(extremes[axis][0])[axis]) {
+        extremes[axis][0] = k;
+      }
+      if (point(k)[axis] > point(extremes[axis][1])[axis]) {
+        extremes[axis][1] = k;
+      }
+    }
+  }
+  int bestAxis = 0;
+  float bestDistance = -1;
+  for (int axis = 0; axis < 3; axis++) {
+    float distance = glm::distance(point(extremes[axis][0]), point(extremes[axis][1]));
+    if (distance > bestDistance) {
+      bestDistance = distance;
+      bestAxis = axis;
+    }
+  }
+  glm::vec3 center = 0.5f * (point(extremes[bestAxis][0]) + point(extremes[bestAxis][1]));
+  float radius = 0.5f * bestDistance;
+  // grow the sphere so that it includes all the points
+  for (size_t k = 0; k < nbPoints; k++) {
+    float distance = glm::distance(point(k), center);
+    if (distance > radius) {
+      float newRadius = 0.5f * (radius + distance);
+      center += (newRadius - radius) / distance * (point(k) - center);
+      radius = newRadius;
+    }
+  }
+  return BoundingSphere(center, radius);
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4 & transform) const
+{
+  if (empty()) {
+    return *this;
+  }
+  float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+  return BoundingSphere(glm::vec3(transform * glm::vec4(center, 1)), radius * scale);
+}
+
+float BoundingSphere::projectedSize(const glm::mat4 & proj, const glm::mat4 & view) const
+{
+  if (empty()) {
+    return 0;
+  }
+  if (proj[3][3] == 1) {
+    // orthographic projection: the size does not depend on the distance
+    return radius * proj[1][1];
+  }
+  float distance = -(view * glm::vec4(center, 1)).z;
+  if (distance <= radius) {
+    // the camera is inside the sphere
+    return std::numeric_limits<float>::infinity();
+  }
+  return radius * proj[1][1] / std::sqrt(distance * distance - radius * radius);
+}
+
+BoundingBox BoundingBox::fromPoints(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices)
+{
+  BoundingBox box;
+  if (indices.empty() and positions.empty()) {
+    return box;
+  }
+  box.min = box.max = indices.empty() ? positions[0] : positions[indices[0]];
+  auto include = [&box](const glm::vec3 & p) {
+    box.min = glm::min(box.min, p);
+    box.max = glm::max(box.max, p);
+  };
+  if (indices.empty()) {
+    std::for_each(positions.begin(), positions.end(), include);
+  } else {
+    for (unsigned int index : indices) {
+      include(positions[index]);
+    }
+  }
+  return box;
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4 & transform) const
+{
+  if (empty()) {
+    return *this;
+  }
+  glm::vec3 c(transform * glm::vec4(center(), 1));
+  glm::vec3 e = extent();
+  glm::vec3 newExtent(0);
+  for (int j = 0; j < 3; j++) {
+    newExtent += glm::abs(glm::vec3(transform[j])) * e[j];
+  }
+  return BoundingBox(c - newExtent, c + newExtent);
+}
+
+NormalCone NormalCone::fromTriangles(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, size_t begin, size_t end)
+{
+  std::vector<glm::vec3> normals;
+  normals.reserve((end - begin) / 3);
+  glm::vec3 average(0);
+  for (size_t k = begin; k + 2 < end; k += 3) {
+    const glm::vec3 & x0 = positions[indices[k + 0]];
+    glm::vec3 n = glm::cross(positions[indices[k + 1]] - x0, positions[indices[k + 2]] - x0);
+    float length = glm::length(n);
+    if (length > 0) {
+      normals.push_back(n / length);
+      average += normals.back();
+    }
+  }
+  float length = glm::length(average);
+  if (length <= 0) {
+    return NormalCone();
+  }
+  glm::vec3 axis = average / length;
+  float minDot = 1;
+  for (const auto & n : normals) {
+    minDot = std::min(minDot, glm::dot(n, axis));
+  }
+  if (minDot <= 0) {
+    return NormalCone(axis, 1); // wider than a half space
+  }
+  return NormalCone(axis, std::sqrt(1 - minDot * minDot));
+}
+
+bool NormalCone::backfacing(const BoundingSphere & bounds, const glm::vec3 & viewpoint) const
+{
+  if (cutoff >= 1 or bounds.empty()) {
+    return false;
+  }
+  // the angle between the axis and any direction from the viewpoint to the sphere must be
+  // smaller than pi/2 - the cone half-angle
+  glm::vec3 direction = bounds.center - viewpoint;
+  return glm::dot(direction, axis) >= cutoff * glm::length(direction) + bounds.radius;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4 & viewProj)
+{
+  Frustum frustum;
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; r++) {
+    row[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+  }
+  for (int k = 0; k < 3; k++) {
+    frustum.planes[2 * k + 0] = row[3] + row[k];
+    frustum.planes[2 * k + 1] = row[3] - row[k];
+  }
+  for (auto & plane : frustum.planes) {
+    float length = glm::length(glm::vec3(plane));
+    if (length > 0) {
+      plane /= length;
+    }
+  }
+  return frustum;
+}
+
+bool Frustum::intersects(const BoundingSphere & sphere) const
+{
+  if (sphere.empty()) {
+    return false;
+  }
+  for (const auto & plane : planes) {
+    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::intersects(const BoundingBox & box) const
+{
+  if (box.empty()) {
+    return false;
+  }
+  glm::vec3 c = box.center();
+  glm::vec3 e = box.extent();
+  for (const auto & plane : planes) {
+    glm::vec3 n(plane);
+    if (glm::dot(n, c) + plane.w < -glm::dot(glm::abs(n), e)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Frustum::intersects(const BoundingSphere * spheres, size_t count, unsigned char * visible) const
+{
+  size_t k = 0;
+#ifdef __SSE2__
+  for (; k + 4 <= count; k += 4) {
+    // transpose four spheres (x, y, z, r) into x, y, z and r registers
+    __m128 x = _mm_loadu_ps(&spheres[k].center.x);
+    __m128 y = _mm_loadu_ps(&spheres[k + 1].center.x);
+    __m128 z = _mm_loadu_ps(&spheres[k + 2].center.x);
+    __m128 r = _mm_loadu_ps(&spheres[k + 3].center.x);
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+    __m128 outside = _mm_cmplt_ps(r, _mm_setzero_ps()); // empty spheres
+    for (const auto & plane : planes) {
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))), _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negativeRadius));
+    }
+    int mask = _mm_movemask_ps(outside);
+    for (int i = 0; i < 4; i++) {
+      visible[k + i] = ((mask >> i) & 1) ? 0 : 1;
+    }
+  }
+#endif
+  for (; k < count; k++) {
+    visible[k] = intersects(spheres[k]) ? 1 : 0;
+  }
+}
+
+void Frustum::intersects(const BoundingBox * boxes, size_t count, unsigned char * visible) const
+{
+#ifdef __SSE2__
+  // planes in SoA layout, as two groups of four (the last two planes being repeated)
+  __m128 px[2], py[2], pz[2], pw[2], ax[2], ay[2], az[2];
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  for (int g = 0; g < 2; g++) {
+    const glm::vec4 & p0 = planes[4 * g];
+    const glm::vec4 & p1 = planes[4 * g + 1];
+    const glm::vec4 & p2 = planes[std::min(4 * g + 2, 5)];
+    const glm::vec4 & p3 = planes[std::min(4 * g + 3, 5)];
+    px[g] = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+    py[g] = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+    pz[g] = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+    pw[g] = _mm_setr_ps(p0.w, p1.w, p2.w, p3.w);
+    ax[g] = _mm_and_ps(px[g], absMask);
+    ay[g] = _mm_and_ps(py[g], absMask);
+    az[g] = _mm_and_ps(pz[g], absMask);
+  }
+  for (size_t k = 0; k < count; k++) {
+    const BoundingBox & box = boxes[k];
+    if (box.empty()) {
+      visible[k] = 0;
+      continue;
+    }
+    glm::vec3 c = box.center();
+    glm::vec3 e = box.extent();
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    int outside = 0;
+    for (int g = 0; g < 2; g++) {
+      // signed distance of the center, and projected radius of the box on the plane normal
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[g], cx), _mm_mul_ps(py[g], cy)), _mm_add_ps(_mm_mul_ps(pz[g], cz), pw[g]));
+      __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[g], ex), _mm_mul_ps(ay[g], ey)), _mm_mul_ps(az[g], ez));
+      outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, radius), _mm_setzero_ps()));
+    }
+    visible[k] = outside ? 0 : 1;
+  }
+#else
+  for (size_t k = 0; k < count; k++) {
+    visible[k] = intersects(boxes[k]) ? 1 : 0;
+  }
+#endif
+}
@@ -0,0 +1,164 @@
+/** @file */
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief A bounding sphere
+ */
+struct BoundingSphere {
+  glm::vec3 center; ///< center of the sphere
+  float radius;     ///< radius of the sphere (negative for an empty sphere)
+
+  /// Default constructor (empty sphere)
+  BoundingSphere() : center(0), radius(-1) {}
+
+  /// Constructor from a center and a radius
+  BoundingSphere(const glm::vec3 & center, float radius) : center(center), radius(radius) {}
+
+  /**
+   * @brief computes a sphere enclosing a set of points
+   * @param positions the point coordinates
+   * @param indices if not empty, only the points referenced here are considered
+   * @return an approximation (Ritter's algorithm) of the minimal bounding sphere
+   */
+  static BoundingSphere fromPoints(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices = std::vector<unsigned int>());
+
+  /// Denotes if the sphere is empty
+  bool empty() const { return radius < 0; }
+
+  /**
+   * @brief applies an affine transform to the sphere
+   * @param transform the affine transform (possibly with a non uniform scale)
+   * @return a sphere enclosing the transformed sphere
+   */
+  BoundingSphere transformed(const glm::mat4 & transform) const;
+
+  /**
+   * @brief computes the size of the sphere once projected on screen
+   * @param proj the projection matrix
+   * @param view the world view matrix (this sphere being expressed in world coordinates)
+   * @return the ratio between the projected radius and half the viewport height (1 when the sphere fills the viewport vertically)
+   */
+  float projectedSize(const glm::mat4 & proj, const glm::mat4 & view) const;
+};
+
+/**
+ * @brief An axis aligned bounding box
+ */
+struct BoundingBox {
+  glm::vec3 min; ///< lower corner
+  glm::vec3 max; ///< upper corner (lower than min for an empty box)
+
+  /// Default constructor (empty box)
+  BoundingBox() : min(1), max(-1) {}
+
+  /// Constructor from two corners
+  BoundingBox(const glm::vec3 & min, const glm::vec3 & max) : min(min), max(max) {}
+
+  /**
+   * @brief computes the box enclosing a set of points
+   * @param positions the point coordinates
+   * @param indices if not empty, only the points referenced here are considered
+   * @return the minimal axis aligned box
+   */
+  static BoundingBox fromPoints(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices = std::vector<unsigned int>());
+
+  /// Denotes if the box is empty
+  bool empty() const { return min.x > max.x; }
+
+  /// Center of the box
+  glm::vec3 center() const { return 0.5f * (min + max); }
+
+  /// Half the size of the box along each axis
+  glm::vec3 extent() const { return 0.5f * (max - min); }
+
+  /**
+   * @brief applies an affine transform to the box
+   * @param transform the affine transform
+   * @return the axis aligned box enclosing the transformed box (Arvo's method)
+   */
+  BoundingBox transformed(const glm::mat4 & transform) const;
+};
+
+/**
+ * @brief A cone bounding the normals of a set of triangles
+ *
+ * All the triangles face away from a viewpoint located in the backfacing region of the cone,
+ * hence they can be culled together (see backfacing()). As the facing of a triangle is preserved by
+ * affine transforms with a positive determinant, the test can be performed in object space.
+ */
+struct NormalCone {
+  glm::vec3 axis; ///< average direction of the normals (unit vector)
+  float cutoff;   ///< sine of the cone half-angle (1 or more for a cone which can never be culled)
+
+  /// Default constructor (a cone which can never be culled)
+  NormalCone() : axis(0, 0, 1), cutoff(1) {}
+
+  /// Constructor from an axis and a cutoff
+  NormalCone(const glm::vec3 & axis, float cutoff) : axis(axis), cutoff(cutoff) {}
+
+  /**
+   * @brief computes the cone bounding the normals of a triangle list
+   * @param positions the vertex positions
+   * @param indices the triangle list
+   * @param begin index of the first element of the triangles to be considered
+   * @param end index past the last element of the triangles to be considered
+   */
+  static NormalCone fromTriangles(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, size_t begin, size_t end);
+
+  /**
+   * @brief denotes if all the triangles bounded by the cone face away from a viewpoint
+   * @param bounds a sphere enclosing the triangles
+   * @param viewpoint the camera position (in the same space as the cone and the sphere)
+   * @return true when no triangle can be front facing, for any point of @p bounds
+   */
+  bool backfacing(const BoundingSphere & bounds, const glm::vec3 & viewpoint) const;
+};
+
+/**
+ * @brief A view frustum, as a set of six planes
+ */
+struct Frustum {
+  glm::vec4 planes[6]; ///< left, right, bottom, top, near and far planes (normals pointing inside, unit length)
+
+  /**
+   * @brief extracts the planes of a projection matrix (Gribb and Hartmann method)
+   * @param viewProj the projection matrix, possibly multiplied by a view (and a model) matrix
+   * @return the frustum in the space where @p viewProj is applied
+   */
+  static Frustum fromMatrix(const glm::mat4 & viewProj);
+
+  /**
+   * @brief tests a sphere against the frustum
+   * @param sphere the sphere to be tested
+   * @return false if the sphere lies entirely outside the frustum (conservative)
+   */
+  bool intersects(const BoundingSphere & sphere) const;
+
+  /**
+   * @brief tests a box against the frustum
+   * @param box the box to be tested
+   * @return false if the box lies entirely outside the frustum (conservative)
+   */
+  bool intersects(const BoundingBox & box) const;
+
+  /**
+   * @brief tests a batch of spheres against the frustum (four spheres at a time with SSE)
+   * @param spheres the spheres to be tested
+   * @param count the number of spheres
+   * @param visible receives, for each sphere, 1 if it may intersect the frustum, 0 otherwise
+   */
+  void intersects(const BoundingSphere * spheres, size_t count, unsigned char * visible) const;
+
+  /**
+   * @brief tests a batch of boxes against the frustum (four planes at a time with SSE)
+   * @param boxes the boxes to be tested
+   * @param count the number of boxes
+   * @param visible receives, for each box, 1 if it may intersect the frustum, 0 otherwise
+   */
+  void intersects(const BoundingBox * boxes, size_t count, unsigned char * visible) const;
+};
+
+#endif // !defined(__BOUNDS_H__)
@@ -0,0 +1,265 @@
+#include "ClusteredLights.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+#include "Simd.hpp"
+
+namespace
+{
+using simd::Float;
+
+/// the texels of the lights, three per light (see ClusteredLights::m_lightBuffer)
+std::vector<glm::vec4> lightTexels(const std::vector<Light> & lights)
+{
+  std::vector<glm::vec4> texels;
+  texels.reserve(3 * std::max<size_t>(lights.size(), 1));
+  for (const auto & light : lights) {
+    texels.push_back(glm::vec4(light.position, light.radius));
+    texels.push_back(glm::vec4(light.intensity, light.cosOuter));
+    texels.push_back(glm::vec4(light.direction, light.cosInner));
+  }
+  if (texels.empty()) {
+    texels.resize(3); // a buffer texture needs a data store
+  }
+  return texels;
+}
+
+/**
+ * @brief tests a cone against a sphere (conservative)
+ * @param apex the apex of the cone
+ * @param direction the unit axis of the cone
+ * @param height the height of the cone
+ * @param cosAngle the cosine of the half angle of the cone (positive)
+ * @param center the center of the sphere
+ * @param radius the radius of the sphere
+ * @return false if the sphere lies outside of the cone
+ */
+bool coneIntersectsSphere(const glm::vec3 & apex, const glm::vec3 & direction, float height, float cosAngle, const glm::vec3 & center, float radius)
+{
+  const glm::vec3 v = center - apex;
+  const float lengthSq = glm::dot(v, v);
+  const float axial = glm::dot(v, direction);
+  const float sinAngle = std::sqrt(std::max(1 - cosAngle * cosAngle, 0.f));
+  const float distance = cosAngle * std::sqrt(std::max(lengthSq - axial * axial, 0.f)) - axial * sinAngle;
+  return distance <= radius and axial <= radius + height and axial >= -radius;
+}
+
+/// binds a buffer texture to a texture unit
+void bindUnit(const Texture & texture, unsigned int unit)
+{
+  glActiveTexture(GL_TEXTURE0 + unit);
+  texture.bind();
+}
+} // namespace
+
+Light Light::point(const glm::vec3 & position, float radius, const glm::vec3 & intensity)
+{
+  Light light;
+  light.position = position;
+  light.radius = radius;
+  light.intensity = intensity;
+  light.direction = glm::vec3(0, 0, -1);
+  // any direction is in the cone (see shaders/clusteredlights.glsl)
+  light.cosInner = -1;
+  light.cosOuter = -2;
+  return light;
+}
+
+Light Light::spot(const glm::vec3 & position, const glm::vec3 & direction, float radius, const glm::vec3 & intensity, float innerAngle, float outerAngle)
+{
+  Light light;
+  light.position = position;
+  light.radius = radius;
+  light.intensity = intensity;
+  light.direction = glm::normalize(direction);
+  light.cosInner = std::cos(innerAngle);
+  light.cosOuter = std::min(std::cos(outerAngle), light.cosInner - 1e-3f);
+  return light;
+}
+
+ClusteredLights::ClusteredLights()
+    : m_near(0.1f), m_far(100.f), m_viewportSize(1), m_sliceLights(gridZ), m_sliceLists(gridZ), m_clusters(gridX * gridY * gridZ), m_lightBuffer(GL_TEXTURE_BUFFER),
+      m_clusterBuffer(GL_TEXTURE_BUFFER), m_indexBuffer(GL_TEXTURE_BUFFER), m_lightTexture(GL_TEXTURE_BUFFER), m_clusterTexture(GL_TEXTURE_BUFFER),
+      m_indexTexture(GL_TEXTURE_BUFFER)
+{
+  setProjection(glm::perspective(1.f, 1.f, m_near, m_far), m_near, m_far, m_viewportSize);
+}
+
+void ClusteredLights::setProjection(const glm::mat4 & proj, float near, float far, const glm::vec2 & viewportSize)
+{
+  m_near = near;
+  m_far = far;
+  m_viewportSize = viewportSize;
+  m_boxMin.resize(gridX * gridY * gridZ);
+  m_boxMax.resize(gridX * gridY * gridZ);
+  const glm::mat4 unproject = glm::inverse(proj);
+  for (unsigned int y = 0; y < gridY; y++) {
+    for (unsigned int x = 0; x < gridX; x++) {
+      // rays through the corners of the tile, scaled to a unit depth
+      glm::vec3 rays[4];
+      for (int corner = 0; corner < 4; corner++) {
+        glm::vec4 ndc(-1 + 2.f * (x + (corner & 1)) / gridX, -1 + 2.f * (y + (corner >> 1)) / gridY, 1, 1);
+        glm::vec4 point = unproject * ndc;
+        rays[corner] = glm::vec3(point) / -point.z;
+      }
+      for (unsigned int z = 0; z < gridZ; z++) {
+        const float depths[2] = {near * std::pow(far / near, float(z) / gridZ), near * std::pow(far / near, float(z + 1) / gridZ)};
+        glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+        for (float depth : depths) {
+          for (const auto & ray : rays) {
+            lower = glm::min(lower, ray * depth);
+            upper = glm::max(upper, ray * depth);
+          }
+        }
+        m_boxMin[clusterIndex(x, y, z)] = lower;
+        m_boxMax[clusterIndex(x, y, z)] = upper;
+      }
+    }
+  }
+}
+
+unsigned int ClusteredLights::add(const Light & light)
+{
+  m_lights.push_back(light);
+  return m_lights.size() - 1;
+}
+
+void ClusteredLights::build(const glm::mat4 & view, ThreadPool & pool)
+{
+  m_viewLights.resize(m_lights.size());
+  m_viewSpots.resize(m_lights.size());
+  for (size_t k = 0; k < m_lights.size(); k++) {
+    const Light & light = m_lights[k];
+    m_viewLights[k] = glm::vec4(glm::vec3(view * glm::vec4(light.position, 1)), light.radius);
+    m_viewSpots[k] = glm::vec4(glm::mat3(view) * light.direction, light.cosOuter);
+  }
+  pool.parallelFor(gridZ, [&](size_t begin, size_t end) {
+    for (size_t slice = begin; slice < end; slice++) {
+      buildSlice(slice);
+    }
+  });
+  // the lists of the slices are concatenated
+  m_indices.clear();
+  m_stats = Statistics();
+  for (unsigned int slice = 0; slice < gridZ; slice++) {
+    const unsigned int offset = m_indices.size();
+    for (unsigned int k = clusterIndex(0, 0, slice); k < clusterIndex(0, 0, slice + 1); k++) {
+      m_clusters[k].x += offset;
+      m_stats.maxClusterSize = std::max(m_stats.maxClusterSize, m_clusters[k].y);
+      m_stats.nbLitClusters += m_clusters[k].y > 0;
+    }
+    m_indices.insert(m_indices.end(), m_sliceLists[slice].begin(), m_sliceLists[slice].end());
+  }
+  m_stats.nbIndices = m_indices.size();
+}
+
+void ClusteredLights::buildSlice(unsigned int slice)
+{
+  // the lights overlapping the depth range of the slice
+  const float nearDepth = m_near * std::pow(m_far / m_near, float(slice) / gridZ);
+  const float farDepth = m_near * std::pow(m_far / m_near, float(slice + 1) / gridZ);
+  SliceLights & lights = m_sliceLights[slice];
+  lights.indices.clear();
+  lights.x.clear();
+  lights.y.clear();
+  lights.z.clear();
+  lights.radii.clear();
+  for (size_t k = 0; k < m_viewLights.size(); k++) {
+    const glm::vec4 & light = m_viewLights[k];
+    if (-light.z + light.w >= nearDepth and -light.z - light.w <= farDepth) {
+      lights.indices.push_back(k);
+      lights.x.push_back(light.x);
+      lights.y.push_back(light.y);
+      lights.z.push_back(light.z);
+      lights.radii.push_back(light.w);
+    }
+  }
+  const size_t nbLights = lights.indices.size();
+  // the padding lights lie behind the camera, with a null range
+  const size_t padded = (nbLights + Float::width - 1) / Float::width * Float::width;
+  lights.x.resize(padded, 0.f);
+  lights.y.resize(padded, 0.f);
+  lights.z.resize(padded, 1.f);
+  lights.radii.resize(padded, 0.f);
+
+  std::vector<unsigned int> & list = m_sliceLists[slice];
+  list.clear();
+  const Float zero(0.f);
+  for (unsigned int y = 0; y < gridY; y++) {
+    for (unsigned int x = 0; x < gridX; x++) {
+      const unsigned int cluster = clusterIndex(x, y, slice);
+      const glm::vec3 & lower = m_boxMin[cluster];
+      const glm::vec3 & upper = m_boxMax[cluster];
+      const glm::vec3 center = 0.5f * (lower + upper);
+      const float radius = 0.5f * glm::length(upper - lower);
+      const Float minX(lower.x), minY(lower.y), minZ(lower.z), maxX(upper.x), maxY(upper.y), maxZ(upper.z);
+      const unsigned int first = list.size();
+      for (size_t k = 0; k < padded; k += Float::width) {
+        // distance between the centers and the box, compared to the ranges
+        const Float cx = Float::load(&lights.x[k]), cy = Float::load(&lights.y[k]), cz = Float::load(&lights.z[k]);
+        const Float dx = simd::max(simd::max(minX - cx, cx - maxX), zero);
+        const Float dy = simd::max(simd::max(minY - cy, cy - maxY), zero);
+        const Float dz = simd::max(simd::max(minZ - cz, cz - maxZ), zero);
+        const Float radii = Float::load(&lights.radii[k]);
+        const int hits = simd::bits(dx * dx + dy * dy + dz * dz <= radii * radii);
+        for (int lane = 0; hits >> lane; lane++) {
+          if (not((hits >> lane) & 1)) {
+            continue;
+          }
+          const unsigned int index = lights.indices[k + lane];
+          const glm::vec4 & spot = m_viewSpots[index];
+          // the spots narrower than a half space are also tested against the bounding sphere of the cluster
+          if (spot.w > 0 and not coneIntersectsSphere(glm::vec3(m_viewLights[index]), glm::vec3(spot), m_viewLights[index].w, spot.w, center, radius)) {
+            continue;
+          }
+          list.push_back(index);
+        }
+      }
+      m_clusters[cluster] = glm::uvec2(first, list.size() - first);
+    }
+  }
+}
+
+void ClusteredLights::upload()
+{
+  std::vector<glm::vec4> texels = lightTexels(m_lights);
+  m_lightBuffer.allocate(texels.size() * sizeof(glm::vec4), GL_STREAM_DRAW);
+  m_lightBuffer.write(texels.data(), texels.size() * sizeof(glm::vec4));
+  m_clusterBuffer.allocate(m_clusters.size() * sizeof(glm::uvec2), GL_STREAM_DRAW);
+  m_clusterBuffer.write(m_clusters.data(), m_clusters.size() * sizeof(glm::uvec2));
+  m_indexBuffer.allocate(std::max<size_t>(m_indices.size(), 1) * sizeof(unsigned int), GL_STREAM_DRAW);
+  m_indexBuffer.write(m_indices.data(), m_indices.size() * sizeof(unsigned int));
+  // the textures follow the buffer objects, whose storage has been reallocated
+  m_lightTexture.setBuffer(m_lightBuffer, GL_RGBA32F);
+  m_clusterTexture.setBuffer(m_clusterBuffer, GL_RG32UI);
+  m_indexTexture.setBuffer(m_indexBuffer, GL_R32UI);
+}
+
+void ClusteredLights::bind() const
+{
+  bindUnit(m_lightTexture, lightsUnit);
+  bindUnit(m_clusterTexture, clustersUnit);
+  bindUnit(m_indexTexture, indicesUnit);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void ClusteredLights::unbind() const
+{
+  for (unsigned int unit : {lightsUnit, clustersUnit, indicesUnit}) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    m_lightTexture.unbind();
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void ClusteredLights::setUniforms(const Program & program) const
+{
+  const float logRange = std::log(m_far / m_near);
+  program.setUniform("lights", int(lightsUnit));
+  program.setUniform("clusters", int(clustersUnit));
+  program.setUniform("lightIndices", int(indicesUnit));
+  program.setUniform("clusterGrid", glm::vec3(gridX, gridY, gridZ));
+  program.setUniform("clusterDepth", glm::vec2(gridZ / logRange, -gridZ * std::log(m_near) / logRange));
+  program.setUniform("viewportSize", m_viewportSize);
+}
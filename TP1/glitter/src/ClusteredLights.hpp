@@ -0,0 +1,143 @@
+/** @file */
+#ifndef __CLUSTERED_LIGHTS_H__
+#define __CLUSTERED_LIGHTS_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "ThreadPool.hpp"
+#include "glApi.hpp"
+
+/// A point or spot light
+struct Light {
+  glm::vec3 position;  ///< position in world space
+  float radius;        ///< range of the light (its intensity falls to zero at this distance)
+  glm::vec3 intensity; ///< color times intensity
+  glm::vec3 direction; ///< unit direction of the spot in world space (unused by point lights)
+  float cosInner;      ///< cosine of the half angle of the fully lit cone of a spot
+  float cosOuter;      ///< cosine of the half angle of the cone of a spot (less than -1 for a point light)
+
+  /// a point light
+  static Light point(const glm::vec3 & position, float radius, const glm::vec3 & intensity);
+
+  /// a spot light, lit within @p outerAngle of its direction and fully lit within @p innerAngle (in radians)
+  static Light spot(const glm::vec3 & position, const glm::vec3 & direction, float radius, const glm::vec3 & intensity, float innerAngle, float outerAngle);
+};
+
+/**
+ * @brief Clustered forward lighting: the lists of the lights reaching each cluster of the view frustum
+ *
+ * The view frustum is divided into a grid of gridX x gridY tiles on screen and gridZ slices in depth (the
+ * slices being exponentially distributed between the near and far planes, so that the clusters are roughly
+ * cubic). Every frame, build() lists the lights whose range intersects the box of each cluster: the slices
+ * are processed concurrently, each one testing simd::Float::width lights at a time against its clusters
+ * (the spots are then tested against the bounding spheres of the clusters). upload() copies the lights,
+ * the ranges of the clusters and the light lists into buffers read as buffer textures by the material
+ * shader (see shaders/clusteredlights.glsl), which only shades the lights of the cluster of its fragment:
+ * the cost of a fragment depends on the number of lights around it rather than on the total number of lights.
+ *
+ * Usage, once per frame: build(), upload(), then bind() before drawing with programs set up by setUniforms().
+ *
+ * @note buffer textures are used instead of shader storage blocks, which require OpenGL 4.3 (the material
+ * shaders target OpenGL 4.1)
+ */
+class ClusteredLights {
+public:
+  static const unsigned int gridX = 16;       ///< number of tiles along the width of the screen
+  static const unsigned int gridY = 9;        ///< number of tiles along the height of the screen
+  static const unsigned int gridZ = 24;       ///< number of slices in depth
+  static const unsigned int lightsUnit = 3;   ///< texture unit of the lights
+  static const unsigned int clustersUnit = 4; ///< texture unit of the ranges of the clusters in the light lists
+  static const unsigned int indicesUnit = 5;  ///< texture unit of the light lists
+
+  /// Statistics of the last build
+  struct Statistics {
+    unsigned int nbIndices;      ///< total length of the light lists
+    unsigned int maxClusterSize; ///< length of the longest light list
+    unsigned int nbLitClusters;  ///< clusters reached by at least one light
+
+    Statistics() : nbIndices(0), maxClusterSize(0), nbLitClusters(0) {}
+  };
+
+  /// Constructor (the projection must be set before the first build)
+  ClusteredLights();
+
+  /**
+   * @brief sets the projection, on which the boxes of the clusters depend
+   * @param proj the projection matrix (a perspective)
+   * @param near the distance of the near plane
+   * @param far the distance of the far plane
+   * @param viewportSize the size of the viewport (in pixels)
+   */
+  void setProjection(const glm::mat4 & proj, float near, float far, const glm::vec2 & viewportSize);
+
+  /// adds a light, and returns its index
+  unsigned int add(const Light & light);
+
+  /// a light, which may be modified until the next build
+  Light & light(unsigned int index) { return m_lights[index]; }
+
+  /// number of lights
+  unsigned int nbLights() const { return m_lights.size(); }
+
+  /**
+   * @brief lists the lights reaching each cluster
+   * @param view the worldView matrix
+   * @param pool the threads sharing the slices (the calling one included)
+   *
+   * @note this method does not call OpenGL
+   */
+  void build(const glm::mat4 & view, ThreadPool & pool = ThreadPool::global());
+
+  /// copies the lights and the light lists of the last build to the GPU
+  void upload();
+
+  /// binds the buffer textures to their texture units (lightsUnit, clustersUnit and indicesUnit)
+  void bind() const;
+
+  /// unbinds the buffer textures
+  void unbind() const;
+
+  /**
+   * @brief sets the uniforms of the lighting of a program (see shaders/clusteredlights.glsl), but the worldView matrix V
+   * @param program the bound program
+   */
+  void setUniforms(const Program & program) const;
+
+  /// statistics of the last build
+  const Statistics & statistics() const { return m_stats; }
+
+private:
+  /// the lights of a slice, as tested against its clusters (structure of arrays padded to simd::Float::width)
+  struct SliceLights {
+    std::vector<unsigned int> indices; ///< indices of the lights
+    std::vector<float> x, y, z;        ///< centers in view space
+    std::vector<float> radii;          ///< ranges
+  };
+
+  /// lists the lights of the clusters of a slice
+  void buildSlice(unsigned int slice);
+
+  /// index of a cluster
+  static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z) { return (z * gridY + y) * gridX + x; }
+
+  std::vector<Light> m_lights;                         ///< the lights
+  float m_near;                                        ///< distance of the near plane
+  float m_far;                                         ///< distance of the far plane
+  glm::vec2 m_viewportSize;                            ///< size of the viewport (in pixels)
+  std::vector<glm::vec3> m_boxMin;                     ///< lower corner of the box of each cluster (in view space)
+  std::vector<glm::vec3> m_boxMax;                     ///< upper corner of the box of each cluster (in view space)
+  std::vector<glm::vec4> m_viewLights;                 ///< centers (in view space) and ranges of the lights of the current build
+  std::vector<glm::vec4> m_viewSpots;                  ///< directions (in view space) and cosines of the outer angles of the lights of the current build
+  std::vector<SliceLights> m_sliceLights;              ///< lights of each slice of the current build
+  std::vector<std::vector<unsigned int>> m_sliceLists; ///< light lists of the clusters of each slice, concatenated
+  std::vector<glm::uvec2> m_clusters;                  ///< range (offset, count) of each cluster in the light lists
+  std::vector<unsigned int> m_indices;                 ///< light lists of the clusters, concatenated
+  Statistics m_stats;                                  ///< statistics of the last build
+  Buffer m_lightBuffer;                                ///< three texels per light (position and range, intensity and cosOuter, direction and cosInner)
+  Buffer m_clusterBuffer;                              ///< range of each cluster in the light lists
+  Buffer m_indexBuffer;                                ///< light lists
+  Texture m_lightTexture;                              ///< buffer texture of m_lightBuffer
+  Texture m_clusterTexture;                            ///< buffer texture of m_clusterBuffer
+  Texture m_indexTexture;                              ///< buffer texture of m_indexBuffer
+};
+
+#endif // !defined(__CLUSTERED_LIGHTS_H__)
@@ -0,0 +1,142 @@
+#include "CommandList.hpp"
+
+CommandList::Statistics & CommandList::Statistics::operator+=(const Statistics & other)
+{
+  nbDraws += other.nbDraws;
+  nbProgramChanges += other.nbProgramChanges;
+  nbTextureChanges += other.nbTextureChanges;
+  nbSamplerChanges += other.nbSamplerChanges;
+  nbVAOChanges += other.nbVAOChanges;
+  return *this;
+}
+
+void CommandList::clear()
+{
+  m_commands.clear();
+  m_staging.clear();
+}
+
+void CommandList::push(Type type, GLenum param, const void * object)
+{
+  Command command;
+  command.type = type;
+  command.param = param;
+  command.object = object;
+  command.counts = nullptr;
+  command.setter = nullptr;
+  command.offset = 0;
+  command.count = 0;
+  m_commands.push_back(command);
+}
+
+void CommandList::bindProgram(const Program & program)
+{
+  push(Type::Program, 0, &program);
+}
+
+void CommandList::bindVAO(const VAO & vao)
+{
+  push(Type::VAO, 0, &vao);
+}
+
+void CommandList::bindTexture(unsigned int unit, const Texture & texture)
+{
+  push(Type::Texture, unit, &texture);
+}
+
+void CommandList::bindSampler(unsigned int unit, const Sampler * sampler)
+{
+  push(Type::Sampler, unit, sampler);
+}
+
+void CommandList::draw(GLenum mode, uint offset, uint count)
+{
+  push(Type::Draw, mode, nullptr);
+  m_commands.back().offset = offset;
+  m_commands.back().count = count;
+}
+
+void CommandList::draw(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts)
+{
+  push(Type::MultiDraw, mode, &offsets);
+  m_commands.back().counts = &counts;
+}
+
+CommandList::Statistics CommandList::execute(const std::vector<CommandList> & lists, size_t count)
+{
+  Statistics stats;
+  const Program * program = nullptr;
+  const VAO * vao = nullptr;
+  const Texture * textures[maxTextureUnits] = {};
+  const Sampler * samplers[maxTextureUnits] = {};
+  GLenum activeUnit = maxTextureUnits; // unknown
+  for (size_t l = 0; l < count; l++) {
+    const CommandList & list = lists[l];
+    for (const Command & command : list.m_commands) {
+      switch (command.type) {
+      case Type::Program:
+        if (command.object != program) {
+          program = static_cast<const Program *>(command.object);
+          program->bind();
+          stats.nbProgramChanges++;
+        }
+        break;
+      case Type::VAO:
+        if (command.object != vao) {
+          vao = static_cast<const VAO *>(command.object);
+          vao->bind();
+          stats.nbVAOChanges++;
+        }
+        break;
+      case Type::Texture:
+        if (command.object != textures[command.param]) {
+          if (activeUnit != command.param) {
+            glActiveTexture(GL_TEXTURE0 + command.param);
+            activeUnit = command.param;
+          }
+          textures[command.param] = static_cast<const Texture *>(command.object);
+          textures[command.param]->bind();
+          stats.nbTextureChanges++;
+        }
+        break;
+      case Type::Sampler:
+        if (command.object != samplers[command.param]) {
+          if (command.object) {
+            static_cast<const Sampler *>(command.object)->bind();
+          } else {
+            samplers[command.param]->unbind();
+          }
+          samplers[command.param] = static_cast<const Sampler *>(command.object);
+          stats.nbSamplerChanges++;
+        }
+        break;
+      case Type::Uniform:
+        command.setter(*program, static_cast<const char *>(command.object), list.m_staging.data() + command.offset);
+        break;
+      case Type::Draw:
+        vao->drawBound(command.param, command.offset, command.count);
+        stats.nbDraws++;
+        break;
+      case Type::MultiDraw:
+        vao->drawBound(command.param, *static_cast<const std::vector<uint> *>(command.object), *static_cast<const std::vector<GLsizei> *>(command.counts));
+        stats.nbDraws++;
+        break;
+      }
+    }
+  }
+  if (vao) {
+    vao->unbind();
+  }
+  if (program) {
+    program->unbind();
+  }
+  for (unsigned int k = 0; k < maxTextureUnits; k++) {
+    if (samplers[k]) {
+      samplers[k]->unbind();
+    }
+  }
+  if (activeUnit != 0) {
+    glActiveTexture(GL_TEXTURE0);
+  }
+  return stats;
+}
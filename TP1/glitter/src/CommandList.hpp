@@ -0,0 +1,130 @@
+/** @file */
+#ifndef __COMMAND_LIST_H__
+#define __COMMAND_LIST_H__
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief Rendering commands recorded as plain data, and replayed later by the thread owning the OpenGL context
+ *
+ * Recording a list does not call OpenGL, hence lists can be recorded concurrently by threads without
+ * OpenGL context (each list by one thread at a time). The values of the uniform variables are copied into a
+ * staging buffer owned by the list. The commands and the staging buffer keep their memory when the list is
+ * cleared, so that recording the next frames does not allocate.
+ *
+ * The replay skips the binds of objects already bound, including the ones repeated at the start of a list
+ * by the previous list.
+ */
+class CommandList {
+public:
+  /// OpenGL state changes made by a replay
+  struct Statistics {
+    unsigned int nbDraws;          ///< draw calls
+    unsigned int nbProgramChanges; ///< glUseProgram calls
+    unsigned int nbTextureChanges; ///< glBindTexture calls
+    unsigned int nbSamplerChanges; ///< glBindSampler calls
+    unsigned int nbVAOChanges;     ///< glBindVertexArray calls
+
+    Statistics() : nbDraws(0), nbProgramChanges(0), nbTextureChanges(0), nbSamplerChanges(0), nbVAOChanges(0) {}
+
+    /// total number of state changes
+    unsigned int nbStateChanges() const { return nbProgramChanges + nbTextureChanges + nbSamplerChanges + nbVAOChanges; }
+
+    Statistics & operator+=(const Statistics & other);
+  };
+
+  static const unsigned int maxTextureUnits = 16; ///< number of texture units handled by the replay
+
+  /// removes all the commands (the memory is kept)
+  void clear();
+
+  /// number of commands
+  size_t size() const { return m_commands.size(); }
+
+  /// records the bind of a program, used by the next uniform writes and draws
+  void bindProgram(const Program & program);
+
+  /// records the bind of a VAO, used by the next draws
+  void bindVAO(const VAO & vao);
+
+  /// records the bind of a texture to a texture unit
+  void bindTexture(unsigned int unit, const Texture & texture);
+
+  /// records the bind of a sampler to a texture unit (which must be the unit of the sampler), or its unbind if @p sampler is null
+  void bindSampler(unsigned int unit, const Sampler * sampler);
+
+  /**
+   * @brief records the assignment of a uniform variable of the program bound
+   * @param name the name of the uniform variable, which must outlive the replay (e.g. a string literal)
+   * @param value the value, copied into the staging buffer
+   */
+  template <typename T> void setUniform(const char * name, const T & value);
+
+  /// records the draw of a range of the IBO of the VAO bound (see VAO::drawBound)
+  void draw(GLenum mode, uint offset, uint count);
+
+  /// records a multi-draw of ranges of the IBO of the VAO bound, the vectors must outlive the replay
+  void draw(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts);
+
+  /**
+   * @brief replays lists in order, then restores the default state (no program, VAO or sampler bound)
+   * @param lists the command lists
+   * @param count the number of lists to be replayed (the first ones)
+   * @return the state changes made
+   */
+  static Statistics execute(const std::vector<CommandList> & lists, size_t count);
+
+private:
+  typedef void (*UniformSetter)(const Program & program, const char * name, const unsigned char * value);
+
+  enum class Type : uint8_t
+  {
+    Program,
+    VAO,
+    Texture,
+    Sampler,
+    Uniform,
+    Draw,
+    MultiDraw
+  };
+
+  struct Command {
+    Type type;
+    GLenum param;         ///< texture unit of a bind, primitive type of a draw
+    const void * object;  ///< object bound, name of a uniform variable, or offsets of a multi-draw
+    const void * counts;  ///< counts of a multi-draw
+    UniformSetter setter; ///< assignment of a uniform variable
+    size_t offset;        ///< index of the first IBO element drawn, or position of a uniform value in the staging buffer
+    uint count;           ///< number of IBO elements drawn
+  };
+
+  template <typename T> static void setStagedUniform(const Program & program, const char * name, const unsigned char * value);
+  void push(Type type, GLenum param, const void * object);
+
+  std::vector<Command> m_commands;
+  std::vector<unsigned char> m_staging; ///< values of the uniform variables
+};
+
+/*
+ * Definition of method templates
+ */
+template <typename T> void CommandList::setUniform(const char * name, const T & value)
+{
+  push(Type::Uniform, 0, name);
+  m_commands.back().setter = &setStagedUniform<T>;
+  m_commands.back().offset = m_staging.size();
+  const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&value);
+  m_staging.insert(m_staging.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> void CommandList::setStagedUniform(const Program & program, const char * name, const unsigned char * value)
+{
+  // the staging buffer does not align the values
+  T staged;
+  std::memcpy(&staged, value, sizeof(T));
+  program.setUniform(name, staged);
+}
+
+#endif // !defined(__COMMAND_LIST_H__)
@@ -0,0 +1,83 @@
+#include "GBuffer.hpp"
+#include <algorithm>
+
+namespace
+{
+/// format of each target
+const GLenum targetFormats[GBuffer::nbTargets] = {GL_RGBA8, GL_RGBA16F, GL_RGBA8, GL_RGBA8};
+
+/// name of the sampler of each target in the lighting program
+const char * const targetNames[GBuffer::nbTargets] = {"gAlbedo", "gNormal", "gSpecular", "gAmbient"};
+} // namespace
+
+GBuffer::GBuffer(int width, int height) : m_width(0), m_height(0), m_depth(GL_TEXTURE_2D), m_emptyVAO(0)
+{
+  for (int k = 0; k < nbTargets; k++) {
+    m_targets.emplace_back(new Texture(GL_TEXTURE_2D));
+  }
+  resize(width, height);
+  for (int k = 0; k < nbTargets; k++) {
+    m_framebuffer.attach(GL_COLOR_ATTACHMENT0 + k, *m_targets[k]);
+  }
+  m_framebuffer.attach(GL_DEPTH_ATTACHMENT, m_depth);
+  m_framebuffer.setDrawBuffers(nbTargets);
+  m_framebuffer.complete();
+}
+
+void GBuffer::resize(int width, int height)
+{
+  m_width = std::max(width, 1);
+  m_height = std::max(height, 1);
+  // the attachments follow the reallocation of their textures
+  for (int k = 0; k < nbTargets; k++) {
+    m_targets[k]->allocate(targetFormats[k], m_width, m_height);
+  }
+  m_depth.allocate(GL_DEPTH_COMPONENT24, m_width, m_height);
+}
+
+void GBuffer::begin() const
+{
+  m_framebuffer.bind();
+  glClearColor(0, 0, 0, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::end() const
+{
+  m_framebuffer.unbind();
+}
+
+void GBuffer::bindTextures() const
+{
+  for (int k = 0; k < nbTargets; k++) {
+    glActiveTexture(GL_TEXTURE0 + firstUnit + k);
+    m_targets[k]->bind();
+  }
+  glActiveTexture(GL_TEXTURE0 + firstUnit + nbTargets);
+  m_depth.bind();
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::unbindTextures() const
+{
+  for (int k = 0; k <= nbTargets; k++) {
+    glActiveTexture(GL_TEXTURE0 + firstUnit + k);
+    m_depth.unbind();
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::setUniforms(const Program & program) const
+{
+  for (int k = 0; k < nbTargets; k++) {
+    program.setUniform(targetNames[k], int(firstUnit + k));
+  }
+  program.setUniform("gDepth", int(firstUnit + nbTargets));
+}
+
+void GBuffer::drawFullScreen() const
+{
+  m_emptyVAO.bind();
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  m_emptyVAO.unbind();
+}
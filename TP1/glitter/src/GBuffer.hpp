@@ -0,0 +1,81 @@
+/** @file */
+#ifndef __GBUFFER_H__
+#define __GBUFFER_H__
+#include <memory>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief The geometry buffer of deferred shading
+ *
+ * The geometry pass renders the scene into the targets of the G-buffer, with the material programs writing
+ * the attributes of the visible surface of each pixel instead of shading it (see the GBUFFER option of
+ * shaders/simplemat.f.glsl): its diffuse and specular albedos, its shading normal and shininess, and its
+ * ambient color. The lighting pass then draws a single triangle covering the screen (drawFullScreen()), whose
+ * fragment shader reads the targets and the depth, and shades each pixel once (see shaders/deferred.f.glsl),
+ * whatever the number of surfaces drawn over it.
+ *
+ * The targets are read from the texture units following the ones of the material maps and of the
+ * clustered lights (see ClusteredLights), starting at firstUnit.
+ */
+class GBuffer {
+public:
+  /// the color targets, in the order of the fragment outputs of the geometry pass
+  enum Target
+  {
+    Albedo,   ///< diffuse albedo (RGBA8)
+    Normal,   ///< unit shading normal in world space, and shininess (RGBA16F)
+    Specular, ///< specular albedo (RGBA8)
+    Ambient,  ///< ambient color (RGBA8)
+    nbTargets
+  };
+
+  static const unsigned int firstUnit = 6; ///< texture unit of the first target (the depth being read at firstUnit + nbTargets)
+
+  /**
+   * @brief Constructor
+   * @param width the width of the targets
+   * @param height the height of the targets
+   */
+  GBuffer(int width = 1, int height = 1);
+
+  /// reallocates the targets (e.g. when the window is resized)
+  void resize(int width, int height);
+
+  /// width of the targets
+  int width() const { return m_width; }
+
+  /// height of the targets
+  int height() const { return m_height; }
+
+  /// starts the geometry pass: binds the framebuffer and clears the targets and the depth
+  void begin() const;
+
+  /// ends the geometry pass: binds back the default framebuffer
+  void end() const;
+
+  /// binds the targets and the depth to their texture units, for the lighting pass
+  void bindTextures() const;
+
+  /// unbinds the targets and the depth
+  void unbindTextures() const;
+
+  /**
+   * @brief sets the samplers of the lighting program (gAlbedo, gNormal, gSpecular, gAmbient and gDepth)
+   * @param program the bound program
+   */
+  void setUniforms(const Program & program) const;
+
+  /// draws a triangle covering the viewport, with the lighting program bound (see shaders/fullscreen.v.glsl)
+  void drawFullScreen() const;
+
+private:
+  int m_width;                                     ///< width of the targets
+  int m_height;                                    ///< height of the targets
+  Framebuffer m_framebuffer;                       ///< framebuffer of the geometry pass
+  std::vector<std::unique_ptr<Texture>> m_targets; ///< the color targets
+  Texture m_depth;                                 ///< the depth buffer
+  VAO m_emptyVAO;                                  ///< a VAO without attribute, the full screen triangle being generated from gl_VertexID
+};
+
+#endif // !defined(__GBUFFER_H__)
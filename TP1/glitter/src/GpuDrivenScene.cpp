@@ -0,0 +1,163 @@
+#include "GpuDrivenScene.hpp"
+#include <algorithm>
+#include <string>
+
+namespace
+{
+/// bindings of the shader storage blocks of the compute shaders (see cull.c.glsl and drawcommands.c.glsl)
+enum Binding
+{
+  Models = GpuDrivenScene::modelsBinding,
+  InstanceMeshes,
+  Meshes,
+  Counters,
+  Visible,
+  Commands,
+  DrawCount
+};
+
+const uint commandSize = 5 * sizeof(uint); ///< size of a DrawElementsIndirectCommand
+} // namespace
+
+GpuDrivenScene::GpuDrivenScene(const VAO & vao, uint instanceAttribute)
+    : m_vao(vao), m_instanceAttribute(instanceAttribute), m_modified(false), m_dirtyBegin(0), m_dirtyEnd(0), m_cullProgram("shaders/cull.c.glsl"),
+      m_commandsProgram("shaders/drawcommands.c.glsl"), m_modelBuffer(GL_SHADER_STORAGE_BUFFER), m_instanceMeshBuffer(GL_SHADER_STORAGE_BUFFER),
+      m_meshBuffer(GL_SHADER_STORAGE_BUFFER), m_counterBuffer(GL_SHADER_STORAGE_BUFFER), m_visibleBuffer(GL_ARRAY_BUFFER), m_commandBuffer(GL_DRAW_INDIRECT_BUFFER),
+      m_drawCountBuffer(GL_SHADER_STORAGE_BUFFER)
+{
+  m_drawCountBuffer.allocate(sizeof(uint), GL_DYNAMIC_COPY);
+}
+
+uint GpuDrivenScene::addMesh(uint firstIndex, uint count, const BoundingSphere & bounds)
+{
+  Mesh mesh;
+  mesh.firstIndex = firstIndex;
+  mesh.count = count;
+  mesh.firstInstance = 0;
+  mesh.nbInstances = 0;
+  mesh.bounds = glm::vec4(bounds.center, bounds.radius);
+  m_meshes.push_back(mesh);
+  m_modified = true;
+  return m_meshes.size() - 1;
+}
+
+uint GpuDrivenScene::addInstance(uint mesh, const glm::mat4 & modelWorld)
+{
+  assert(mesh < m_meshes.size());
+  m_models.push_back(modelWorld);
+  m_instanceMeshes.push_back(mesh);
+  m_meshes[mesh].nbInstances++;
+  m_modified = true;
+  return m_models.size() - 1;
+}
+
+void GpuDrivenScene::setTransform(uint instance, const glm::mat4 & modelWorld)
+{
+  assert(instance < m_models.size());
+  m_models[instance] = modelWorld;
+  if (m_dirtyBegin == m_dirtyEnd) {
+    m_dirtyBegin = instance;
+    m_dirtyEnd = instance + 1;
+  } else {
+    m_dirtyBegin = std::min(m_dirtyBegin, instance);
+    m_dirtyEnd = std::max(m_dirtyEnd, instance + 1);
+  }
+}
+
+void GpuDrivenScene::upload()
+{
+  // each mesh gets a range of the list of visible instances large enough for all its instances
+  uint firstInstance = 0;
+  for (auto & mesh : m_meshes) {
+    mesh.firstInstance = firstInstance;
+    firstInstance += mesh.nbInstances;
+  }
+  m_modelBuffer.allocate(std::max<size_t>(m_models.size(), 1) * sizeof(glm::mat4), GL_DYNAMIC_DRAW);
+  m_modelBuffer.write(m_models.data(), m_models.size() * sizeof(glm::mat4));
+  m_instanceMeshBuffer.allocate(std::max<size_t>(m_instanceMeshes.size(), 1) * sizeof(uint), GL_STATIC_DRAW);
+  m_instanceMeshBuffer.write(m_instanceMeshes.data(), m_instanceMeshes.size() * sizeof(uint));
+  m_meshBuffer.allocate(std::max<size_t>(m_meshes.size(), 1) * sizeof(Mesh), GL_STATIC_DRAW);
+  m_meshBuffer.write(m_meshes.data(), m_meshes.size() * sizeof(Mesh));
+  m_counterBuffer.allocate(std::max<size_t>(m_meshes.size(), 1) * sizeof(uint), GL_DYNAMIC_COPY);
+  m_visibleBuffer.allocate(std::max<size_t>(m_models.size(), 1) * sizeof(uint), GL_DYNAMIC_COPY);
+  m_commandBuffer.allocate(std::max<size_t>(m_meshes.size(), 1) * commandSize, GL_DYNAMIC_COPY);
+  // the VAO keeps the buffer object, which is not replaced by allocate()
+  m_vao.setInstanceIndices(m_instanceAttribute, m_visibleBuffer);
+  m_modified = false;
+  m_dirtyBegin = m_dirtyEnd = 0;
+}
+
+void GpuDrivenScene::cull(const glm::mat4 & viewProj)
+{
+  if (m_modified) {
+    upload();
+  } else if (m_dirtyBegin < m_dirtyEnd) {
+    m_modelBuffer.write(m_models.data() + m_dirtyBegin, (m_dirtyEnd - m_dirtyBegin) * sizeof(glm::mat4), m_dirtyBegin * sizeof(glm::mat4));
+    m_dirtyBegin = m_dirtyEnd = 0;
+  }
+  if (m_models.empty()) {
+    return;
+  }
+  m_counterBuffer.clear();
+  m_drawCountBuffer.clear();
+  m_modelBuffer.bindBase(Models);
+  m_instanceMeshBuffer.bindBase(InstanceMeshes);
+  m_meshBuffer.bindBase(Meshes);
+  m_counterBuffer.bindBase(Counters);
+  m_visibleBuffer.bindBase(Visible);
+  m_commandBuffer.bindBase(Commands);
+  m_drawCountBuffer.bindBase(DrawCount);
+
+  // visible instances, appended to the ranges of their meshes
+  const Frustum frustum = Frustum::fromMatrix(viewProj);
+  m_cullProgram.bind();
+  for (int k = 0; k < 6; k++) {
+    m_cullProgram.setUniform("planes[" + std::to_string(k) + "]", frustum.planes[k]);
+  }
+  m_cullProgram.setUniform("nbInstances", nbInstances());
+  m_cullProgram.dispatch(ComputeProgram::groupCount(nbInstances(), m_cullProgram.workGroupSize().x));
+  barrier::storage();
+
+  // one command per mesh, only for the meshes having visible instances if the GPU reads the number of commands
+  m_commandsProgram.bind();
+  m_commandsProgram.setUniform("nbMeshes", nbMeshes());
+  m_commandsProgram.setUniform("compact", int(drawCountSupported()));
+  m_commandsProgram.dispatch(ComputeProgram::groupCount(nbMeshes(), m_commandsProgram.workGroupSize().x));
+  m_commandsProgram.unbind();
+  barrier::indirectCommands();
+  barrier::vertexAttributes();
+
+  for (uint binding = InstanceMeshes; binding <= DrawCount; binding++) {
+    Buffer::unbindBase(binding);
+  }
+}
+
+void GpuDrivenScene::draw(GLenum mode) const
+{
+  if (m_models.empty()) {
+    return;
+  }
+  m_modelBuffer.bindBase(Models);
+  m_vao.multiDrawIndirect(mode, m_commandBuffer, nbMeshes(), drawCountSupported() ? &m_drawCountBuffer : nullptr);
+  Buffer::unbindBase(Models);
+}
+
+uint GpuDrivenScene::visibleCount() const
+{
+  if (m_models.empty()) {
+    return 0;
+  }
+  barrier::bufferUpdate();
+  std::vector<uint> counters(nbMeshes());
+  m_counterBuffer.read(counters.data(), counters.size() * sizeof(uint));
+  uint count = 0;
+  for (uint counter : counters) {
+    count += counter;
+  }
+  return count;
+}
+
+bool GpuDrivenScene::drawCountSupported()
+{
+  return GLEW_ARB_indirect_parameters;
+}
@@ -0,0 +1,126 @@
+/** @file */
+#ifndef __GPU_DRIVEN_SCENE_H__
+#define __GPU_DRIVEN_SCENE_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.hpp"
+#include "glApi.hpp"
+
+/**
+ * @brief Instances of meshes culled and drawn by the GPU
+ *
+ * The meshes are ranges of the IBO of a single VAO. The model matrices of the instances, their meshes and
+ * the bounding spheres of the meshes live in shader storage buffers. Every frame, cull() launches two
+ * compute passes (see shaders/cull.c.glsl and shaders/drawcommands.c.glsl): the first one tests each instance
+ * against the view frustum and appends the visible ones to the range of their mesh in a list of instance
+ * indices; the second one writes one indirect draw command per mesh having visible instances. draw() then
+ * renders the whole scene with a single multi-draw call, whose number of commands is read from a buffer
+ * when ARB_indirect_parameters is available (otherwise, one command per mesh is drawn, possibly with no
+ * instance). The CPU cost of a frame thus does not depend on the number of instances, as long as they
+ * do not move (see setTransform()).
+ *
+ * The vertex shader gets the index of its instance from the instanced attribute instanceAttribute, and
+ * reads its model matrix from the shader storage block at binding modelsBinding, e.g.
+ * @code
+ * layout(location = 4) in uint instance;
+ * layout(std430, binding = 0) readonly buffer Models { mat4 models[]; };
+ * @endcode
+ * (see shaders/indirect.v.glsl). Requires OpenGL 4.3.
+ */
+class GpuDrivenScene {
+public:
+  static const uint modelsBinding = 0; ///< shader storage binding of the model matrices, for the vertex shader
+
+  /**
+   * @brief Constructor
+   * @param vao the VAO holding the meshes (it must outlive this scene)
+   * @param instanceAttribute the location of the instanced attribute receiving the instance index (greater than the VBOs of @p vao)
+   */
+  GpuDrivenScene(const VAO & vao, uint instanceAttribute);
+
+  GpuDrivenScene(const GpuDrivenScene &) = delete;
+  GpuDrivenScene & operator=(const GpuDrivenScene &) = delete;
+
+  /**
+   * @brief adds a mesh
+   * @param firstIndex the index of the first IBO element of the mesh
+   * @param count the number of IBO elements of the mesh
+   * @param bounds a sphere enclosing the mesh (in object space)
+   * @return the index of the mesh
+   */
+  uint addMesh(uint firstIndex, uint count, const BoundingSphere & bounds);
+
+  /**
+   * @brief adds an instance
+   * @param mesh the index of its mesh
+   * @param modelWorld its model matrix
+   * @return the index of the instance
+   */
+  uint addInstance(uint mesh, const glm::mat4 & modelWorld);
+
+  /// replaces the model matrix of an instance (only the modified matrices are uploaded by the next cull())
+  void setTransform(uint instance, const glm::mat4 & modelWorld);
+
+  /// number of instances
+  uint nbInstances() const { return m_instanceMeshes.size(); }
+
+  /// number of meshes
+  uint nbMeshes() const { return m_meshes.size(); }
+
+  /**
+   * @brief uploads the modifications, then computes the draw commands of the visible instances
+   * @param viewProj the projection matrix multiplied by the worldView matrix
+   */
+  void cull(const glm::mat4 & viewProj);
+
+  /**
+   * @brief draws the instances kept by the last cull()
+   * @param mode primitive type
+   *
+   * @note the program is bound beforehand, with its other uniforms set
+   */
+  void draw(GLenum mode = GL_TRIANGLES) const;
+
+  /**
+   * @brief reads back the number of instances kept by the last cull()
+   *
+   * @note this call waits for the GPU, it is meant for statistics and not for every frame
+   */
+  uint visibleCount() const;
+
+  /// denotes if the number of draw commands is read by the GPU (ARB_indirect_parameters), instead of drawing one command per mesh
+  static bool drawCountSupported();
+
+private:
+  /// a mesh, as read by the compute shaders (std430 layout)
+  struct Mesh {
+    uint firstIndex;    ///< index of the first IBO element
+    uint count;         ///< number of IBO elements
+    uint firstInstance; ///< position of the range of its instances in the list of visible instances
+    uint nbInstances;   ///< number of instances of the mesh (size of its range)
+    glm::vec4 bounds;   ///< bounding sphere in object space (center, radius)
+  };
+
+  /// uploads the instances, the meshes and the ranges of the meshes in the list of visible instances
+  void upload();
+
+  const VAO & m_vao;                  ///< the VAO holding the meshes
+  uint m_instanceAttribute;           ///< location of the instance index attribute
+  std::vector<Mesh> m_meshes;         ///< the meshes
+  std::vector<glm::mat4> m_models;    ///< model matrix of each instance
+  std::vector<uint> m_instanceMeshes; ///< mesh of each instance
+  bool m_modified;                    ///< instances or meshes were added since the last upload
+  uint m_dirtyBegin;                  ///< first instance whose matrix was modified since the last upload
+  uint m_dirtyEnd;                    ///< past the last instance whose matrix was modified since the last upload
+  ComputeProgram m_cullProgram;       ///< frustum culling of the instances
+  ComputeProgram m_commandsProgram;   ///< draw commands of the meshes
+  Buffer m_modelBuffer;               ///< model matrices (shader storage)
+  Buffer m_instanceMeshBuffer;        ///< mesh of each instance (shader storage)
+  Buffer m_meshBuffer;                ///< the meshes (shader storage)
+  Buffer m_counterBuffer;             ///< number of visible instances of each mesh (shader storage)
+  Buffer m_visibleBuffer;             ///< indices of the visible instances, grouped by mesh (shader storage, instanced attribute)
+  Buffer m_commandBuffer;             ///< draw commands
+  Buffer m_drawCountBuffer;           ///< number of draw commands
+};
+
+#endif // !defined(__GPU_DRIVEN_SCENE_H__)
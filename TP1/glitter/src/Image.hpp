@@ -1,11 +1,17 @@
 #ifndef __IMAGE_H__
 #define __IMAGE_H__
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
 
 /**
  * @brief The Image struct
  *
  * A simple template struct for holding an image and its format description.
- * Allocation and deallocation should be taken care of elsewhere.
+ * An image either borrows its data (the allocation and deallocation being taken care of elsewhere),
+ * or shares the ownership of its buffer with its copies (see allocate() and adopt()): the buffer is
+ * then freed when the last copy is destroyed.
  */
 template <typename T = unsigned char> struct Image {
 public:
@@ -32,11 +38,62 @@ public:
    * @param c channels
    */
   Image(T * data, int w, int h, int d, int c) : width(w), height(h), depth(d), channels(c), data(data) {}
+
+  /**
+   * @brief Allocates an image owning its buffer (3d image)
+   * @param w width
+   * @param h height
+   * @param d depth
+   * @param c channels
+   * @return the image, whose buffer is aligned on 64 bytes (a cache line, and the widest SIMD registers)
+   *
+   * @note the content of the buffer is left uninitialized
+   */
+  static Image allocate(int w, int h, int d, int c)
+  {
+    Image image(nullptr, w, h, d, c);
+    void * memory = nullptr;
+    if (posix_memalign(&memory, alignment, std::max<size_t>(image.size() * sizeof(T), 1)) != 0) {
+      std::cerr << "Unable to allocate a " << w << "x" << h << "x" << d << "x" << c << " image" << std::endl;
+      exit(1);
+    }
+    image.buffer = std::shared_ptr<T>(static_cast<T *>(memory), [](T * p) { free(p); });
+    image.data = image.buffer.get();
+    return image;
+  }
+
+  /// Allocates an image owning its buffer (2d image)
+  static Image allocate(int w, int h, int c) { return allocate(w, h, 1, c); }
+
+  /**
+   * @brief Takes the ownership of an existing buffer (2d image)
+   * @param data pointer to the data
+   * @param w width
+   * @param h height
+   * @param c channels
+   * @param deleter called on @p data once the last copy of the image is destroyed (e.g. stbi_image_free)
+   */
+  template <typename Deleter> static Image adopt(T * data, int w, int h, int c, Deleter deleter)
+  {
+    Image image(data, w, h, c);
+    image.buffer = std::shared_ptr<T>(data, deleter);
+    return image;
+  }
+
+  /// Denotes if the image shares the ownership of its buffer
+  bool owning() const { return bool(buffer); }
+
+  /// Number of elements of the image
+  size_t size() const { return size_t(width) * height * depth * channels; }
+
+  static const size_t alignment = 64; ///< alignment (in bytes) of the buffers made by allocate()
+
   int width;
   int height;
   int depth;
   int channels;
   T * data;
+  std::shared_ptr<T> buffer; ///< owner of the data (null when the data is borrowed)
 };
 
 #endif // !defined(__IMAGE_H__)
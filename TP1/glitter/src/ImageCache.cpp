@@ -0,0 +1,82 @@
+#include "ImageCache.hpp"
+#include <climits>
+#include <cstdlib>
+#include "stb_image.h"
+
+std::mutex ImageCache::s_mutex;
+std::unordered_map<std::string, ImageCache::Entry> ImageCache::s_entries;
+
+/// canonical form of a path (symbolic links, "." and ".." resolved), the path itself if it does not exist
+static std::string canonicalPath(const std::string & filename)
+{
+  char resolved[PATH_MAX];
+  if (realpath(filename.c_str(), resolved)) {
+    return resolved;
+  }
+  return filename;
+}
+
+Image<> ImageCache::load(const std::string & filename, int channels)
+{
+  std::string key = canonicalPath(filename) + "#" + std::to_string(channels);
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Image<> cached = find(key);
+    if (cached.data) {
+      return cached;
+    }
+  }
+
+  // decode without holding the lock, so that several images can be decoded concurrently
+  Image<> image;
+  unsigned char * data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, channels);
+  if (not data) {
+    return Image<>();
+  }
+  if (channels != 0) {
+    image.channels = channels;
+  }
+  image = Image<>::adopt(data, image.width, image.height, image.channels, stbi_image_free);
+
+  std::lock_guard<std::mutex> lock(s_mutex);
+  Image<> cached = find(key);
+  if (cached.data) {
+    return cached; // decoded by another thread meanwhile
+  }
+  // drop the entries of the images which have been freed meanwhile
+  for (auto it = s_entries.begin(); it != s_entries.end();) {
+    it = it->second.buffer.expired() ? s_entries.erase(it) : std::next(it);
+  }
+  Entry & entry = s_entries[key];
+  entry.buffer = image.buffer;
+  entry.width = image.width;
+  entry.height = image.height;
+  entry.channels = image.channels;
+  return image;
+}
+
+Image<> ImageCache::find(const std::string & key)
+{
+  auto found = s_entries.find(key);
+  if (found == s_entries.end()) {
+    return Image<>();
+  }
+  const Entry & entry = found->second;
+  std::shared_ptr<unsigned char> buffer = entry.buffer.lock();
+  if (not buffer) {
+    return Image<>();
+  }
+  Image<> image(buffer.get(), entry.width, entry.height, entry.channels);
+  image.buffer = buffer;
+  return image;
+}
+
+size_t ImageCache::size()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  size_t count = 0;
+  for (const auto & entry : s_entries) {
+    count += entry.second.buffer.expired() ? 0 : 1;
+  }
+  return count;
+}
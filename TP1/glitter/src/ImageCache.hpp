@@ -0,0 +1,53 @@
+/** @file */
+#ifndef __IMAGE_CACHE_H__
+#define __IMAGE_CACHE_H__
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Image.hpp"
+
+/**
+ * @brief A process-wide cache of decoded images
+ *
+ * Images are keyed by the canonical path of their file, so that the same file reached through
+ * different relative paths (e.g. by several ObjLoader instances) is decoded only once.
+ * The cache only holds weak references: an image is freed as soon as its last user drops it,
+ * and decoded again if it is requested afterwards.
+ *
+ * @note all the methods are thread safe, and images are decoded concurrently when requested from
+ * several threads. The stb_image version in use has no per-thread state: the vertical flip flag
+ * (stbi_set_flip_vertically_on_load) is a global read by every decoding, so it is never changed
+ * by the cache and must not be changed by anyone while images may be loading.
+ */
+class ImageCache {
+public:
+  ImageCache() = delete;
+
+  /**
+   * @brief provides a decoded image, from the cache or from its file
+   * @param filename the image file (absolute, or relative to the working directory)
+   * @param channels the number of channels wanted (0 to keep the channels of the file)
+   * @return the image, owning a share of its buffer (an empty image if the file cannot be decoded)
+   */
+  static Image<> load(const std::string & filename, int channels = 0);
+
+  /// number of images still alive in the cache
+  static size_t size();
+
+private:
+  struct Entry {
+    std::weak_ptr<unsigned char> buffer; ///< the decoded data, as long as some image uses it
+    int width;
+    int height;
+    int channels;
+  };
+
+  /// the live image of an entry, an empty image if there is none (the mutex must be held)
+  static Image<> find(const std::string & key);
+
+  static std::mutex s_mutex;
+  static std::unordered_map<std::string, Entry> s_entries;
+};
+
+#endif // !defined(__IMAGE_CACHE_H__)
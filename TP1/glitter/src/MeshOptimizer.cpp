@@ -0,0 +1,316 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+VertexCacheStatistics & VertexCacheStatistics::operator+=(const VertexCacheStatistics & other)
+{
+  nbTriangles += other.nbTriangles;
+  nbVertices += other.nbVertices;
+  nbTransformed += other.nbTransformed;
+  acmr = nbTriangles ? nbTransformed / float(nbTriangles) : 0;
+  atvr = nbVertices ? nbTransformed / float(nbVertices) : 0;
+  return *this;
+}
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> & indices, size_t nbVertices, unsigned int cacheSize)
+{
+  VertexCacheStatistics stats;
+  // A vertex is in the FIFO cache iff it was pushed less than cacheSize misses ago.
+  std::vector<unsigned int> timestamps(nbVertices, 0);
+  unsigned int time = cacheSize + 1;
+  for (unsigned int index : indices) {
+    if (timestamps[index] == 0) {
+      stats.nbVertices++;
+    }
+    if (time - timestamps[index] > cacheSize) {
+      timestamps[index] = time++;
+      stats.nbTransformed++;
+    }
+  }
+  stats.nbTriangles = indices.size() / 3;
+  stats.acmr = stats.nbTriangles ? stats.nbTransformed / float(stats.nbTriangles) : 0;
+  stats.atvr = stats.nbVertices ? stats.nbTransformed / float(stats.nbVertices) : 0;
+  return stats;
+}
+
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int> & indices, size_t nbVertices, unsigned int cacheSize, std::vector<unsigned int> * clusters)
+{
+  const unsigned int nbTriangles = indices.size() / 3;
+  // vertex -> triangles adjacency, stored contiguously (offsets / list)
+  std::vector<unsigned int> liveTriangles(nbVertices, 0);
+  for (unsigned int index : indices) {
+    liveTriangles[index]++;
+  }
+  std::vector<unsigned int> offsets(nbVertices + 1, 0);
+  for (size_t v = 0; v < nbVertices; v++) {
+    offsets[v + 1] = offsets[v] + liveTriangles[v];
+  }
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (unsigned int t = 0; t < nbTriangles; t++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      adjacency[fill[indices[3 * t + c]]++] = t;
+    }
+  }
+
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  if (clusters) {
+    clusters->clear();
+  }
+  std::vector<unsigned int> cacheTime(nbVertices, 0);
+  std::vector<bool> emitted(nbTriangles, false);
+  std::vector<unsigned int> deadEnd;
+  std::vector<unsigned int> candidates;
+  unsigned int time = cacheSize + 1;
+  size_t cursor = 0;
+  long fanning = nbVertices > 0 ? 0 : -1;
+  while (fanning >= 0) {
+    // emit all the remaining triangles around the fanning vertex
+    candidates.clear();
+    for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+      unsigned int t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (unsigned int c = 0; c < 3; c++) {
+        unsigned int v = indices[3 * t + c];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[v]--;
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // pick the candidate that will still be in the cache once all its triangles are emitted,
+    // favoring the oldest one.
+    long next = -1;
+    unsigned int bestPriority = 0;
+    for (unsigned int v : candidates) {
+      if (liveTriangles[v] == 0) {
+        continue;
+      }
+      unsigned int priority = 0;
+      if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+        priority = time - cacheTime[v];
+      }
+      if (next < 0 or priority > bestPriority) {
+        next = v;
+        bestPriority = priority;
+      }
+    }
+    if (next < 0) {
+      // dead end: go back to a recently used vertex, or to the next unprocessed one in the input order.
+      while (not deadEnd.empty() and next < 0) {
+        unsigned int v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0) {
+          next = v;
+        }
+      }
+      while (next < 0 and cursor < nbVertices) {
+        if (liveTriangles[cursor] > 0) {
+          next = cursor;
+          if (clusters and not output.empty()) {
+            clusters->push_back(output.size());
+          }
+        }
+        cursor++;
+      }
+    }
+    fanning = next;
+  }
+  if (clusters) {
+    clusters->insert(clusters->begin(), 0);
+  }
+  return output;
+}
+
+/// splits the hard clusters where the local ACMR is already close to the ACMR of the whole cluster
+static std::vector<unsigned int> softBoundaries(const std::vector<unsigned int> & indices, size_t nbVertices, const std::vector<unsigned int> & clusters, float threshold, unsigned int cacheSize)
+{
+  std::vector<unsigned int> boundaries;
+  std::vector<unsigned int> timestamps(nbVertices, 0);
+  unsigned int time = cacheSize + 1;
+  for (size_t c = 0; c < clusters.size(); c++) {
+    unsigned int begin = clusters[c];
+    unsigned int end = (c + 1 < clusters.size()) ? clusters[c + 1] : indices.size();
+    time += cacheSize + 1; // flush the cache
+    unsigned int clusterMisses = 0;
+    for (unsigned int i = begin; i < end; i++) {
+      if (time - timestamps[indices[i]] > cacheSize) {
+        timestamps[indices[i]] = time++;
+        clusterMisses++;
+      }
+    }
+    float targetACMR = threshold * clusterMisses / ((end - begin) / 3);
+
+    boundaries.push_back(begin);
+    time += cacheSize + 1;
+    unsigned int misses = 0;
+    unsigned int triangles = 0;
+    for (unsigned int k = begin; k < end; k += 3) {
+      for (unsigned int i = k; i < k + 3; i++) {
+        if (time - timestamps[indices[i]] > cacheSize) {
+          timestamps[indices[i]] = time++;
+          misses++;
+        }
+      }
+      triangles++;
+      if (k + 3 < end and misses <= targetACMR * triangles) {
+        boundaries.push_back(k + 3);
+        time += cacheSize + 1;
+        misses = 0;
+        triangles = 0;
+      }
+    }
+  }
+  return boundaries;
+}
+
+std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & clusters, float threshold,
+                                           unsigned int cacheSize)
+{
+  if (indices.empty() or clusters.empty()) {
+    return indices;
+  }
+  std::vector<unsigned int> boundaries = softBoundaries(indices, positions.size(), clusters, threshold, cacheSize);
+
+  // area weighted centroids and normals of the clusters
+  struct Cluster {
+    unsigned int begin;
+    unsigned int end;
+    glm::vec3 centroid;
+    glm::vec3 normal;
+    float sortKey;
+  };
+  std::vector<Cluster> sorted(boundaries.size());
+  glm::vec3 meshCentroid(0);
+  float meshArea = 0;
+  for (size_t c = 0; c < boundaries.size(); c++) {
+    Cluster & cluster = sorted[c];
+    cluster.begin = boundaries[c];
+    cluster.end = (c + 1 < boundaries.size()) ? boundaries[c + 1] : indices.size();
+    cluster.centroid = glm::vec3(0);
+    cluster.normal = glm::vec3(0);
+    float clusterArea = 0;
+    for (unsigned int k = cluster.begin; k < cluster.end; k += 3) {
+      const glm::vec3 & x0 = positions[indices[k + 0]];
+      const glm::vec3 & x1 = positions[indices[k + 1]];
+      const glm::vec3 & x2 = positions[indices[k + 2]];
+      glm::vec3 n = glm::cross(x1 - x0, x2 - x0);
+      float area = glm::length(n);
+      cluster.centroid += area * (x0 + x1 + x2) / 3.f;
+      cluster.normal += n;
+      clusterArea += area;
+    }
+    meshCentroid += cluster.centroid;
+    meshArea += clusterArea;
+    if (clusterArea > 0) {
+      cluster.centroid /= clusterArea;
+    }
+  }
+  if (meshArea > 0) {
+    meshCentroid /= meshArea;
+  }
+  for (auto & cluster : sorted) {
+    float length = glm::length(cluster.normal);
+    cluster.sortKey = (length > 0) ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length) : 0;
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & a, const Cluster & b) { return a.sortKey > b.sortKey; });
+
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  for (const auto & cluster : sorted) {
+    output.insert(output.end(), indices.begin() + cluster.begin, indices.begin() + cluster.end);
+  }
+  return output;
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions, size_t begin, size_t end, unsigned int maxVertices,
+                                   unsigned int maxTriangles)
+{
+  std::vector<Meshlet> meshlets;
+  std::vector<unsigned int> vertices; // distinct vertices of the current meshlet
+  vertices.reserve(maxVertices + 3);
+  auto isNew = [&vertices](unsigned int index) { return std::find(vertices.begin(), vertices.end(), index) == vertices.end(); };
+  size_t first = begin;
+  auto close = [&](size_t last) {
+    Meshlet meshlet(first, last - first);
+    meshlet.bounds = BoundingSphere::fromPoints(positions, vertices);
+    meshlet.cone = NormalCone::fromTriangles(positions, indices, first, last);
+    meshlets.push_back(meshlet);
+    vertices.clear();
+    first = last;
+  };
+  for (size_t k = begin; k + 2 < end; k += 3) {
+    unsigned int a = indices[k], b = indices[k + 1], c = indices[k + 2];
+    unsigned int added = isNew(a) + (isNew(b) and b != a) + (isNew(c) and c != a and c != b);
+    if (vertices.size() + added > maxVertices or k - first >= 3 * maxTriangles) {
+      close(k);
+    }
+    for (size_t i = k; i < k + 3; i++) {
+      if (isNew(indices[i])) {
+        vertices.push_back(indices[i]);
+      }
+    }
+  }
+  if (first < end) {
+    close(end);
+  }
+  return meshlets;
+}
+
+bool isClosed(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions)
+{
+  // weld the vertices sharing a position: sorted by position, each vertex takes the first index of its run
+  std::vector<unsigned int> order(positions.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto less = [&positions](unsigned int a, unsigned int b) {
+    const glm::vec3 & p = positions[a];
+    const glm::vec3 & q = positions[b];
+    return p.x < q.x or (p.x == q.x and (p.y < q.y or (p.y == q.y and p.z < q.z)));
+  };
+  std::sort(order.begin(), order.end(), less);
+  std::vector<unsigned int> welded(positions.size());
+  for (size_t k = 0; k < order.size(); k++) {
+    welded[order[k]] = k > 0 and positions[order[k]] == positions[order[k - 1]] ? welded[order[k - 1]] : order[k];
+  }
+  // each edge is counted +1 in one direction and -1 in the other: a closed mesh balances all its edges
+  std::unordered_map<unsigned long long, int> balance;
+  for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+    for (unsigned int c = 0; c < 3; c++) {
+      unsigned int a = welded[indices[k + c]], b = welded[indices[k + (c + 1) % 3]];
+      if (a != b) {
+        balance[(static_cast<unsigned long long>(std::min(a, b)) << 32) | std::max(a, b)] += a < b ? 1 : -1;
+      }
+    }
+  }
+  return std::all_of(balance.begin(), balance.end(), [](const std::pair<const unsigned long long, int> & edge) { return edge.second == 0; });
+}
+
+std::vector<unsigned int> computeVertexFetchRemap(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, size_t & nbUsed)
+{
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(nbVertices, unused);
+  unsigned int next = 0;
+  for (const auto & ibo : ibos) {
+    for (unsigned int index : ibo) {
+      if (remap[index] == unused) {
+        remap[index] = next++;
+      }
+    }
+  }
+  nbUsed = next;
+  for (auto & index : remap) {
+    if (index == unused) {
+      index = next++;
+    }
+  }
+  return remap;
+}
@@ -0,0 +1,136 @@
+/** @file */
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.hpp"
+
+/**
+ * @brief Efficiency of a triangle list with respect to a simulated FIFO post-transform vertex cache
+ */
+struct VertexCacheStatistics {
+  unsigned int nbTriangles;   ///< number of triangles in the list
+  unsigned int nbVertices;    ///< number of distinct vertices referenced by the list
+  unsigned int nbTransformed; ///< number of vertex shader invocations (cache misses)
+  float acmr;                 ///< average cache miss ratio (transformed vertices per triangle, in [0.5, 3])
+  float atvr;                 ///< average transformed vertex ratio (transformed vertices per distinct vertex, ideally 1)
+
+  /// Default constructor (empty list)
+  VertexCacheStatistics() : nbTriangles(0), nbVertices(0), nbTransformed(0), acmr(0), atvr(0) {}
+
+  /// Accumulates the statistics of another triangle list (e.g. another IBO sharing the same vertices)
+  VertexCacheStatistics & operator+=(const VertexCacheStatistics & other);
+};
+
+/**
+ * @brief simulates a FIFO post-transform vertex cache on a triangle list
+ * @param indices the triangle list
+ * @param nbVertices the size of the vertex arrays referenced by @p indices
+ * @param cacheSize the number of entries of the simulated cache
+ * @return the cache statistics
+ */
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> & indices, size_t nbVertices, unsigned int cacheSize = 16);
+
+/**
+ * @brief reorders the triangles of a list to improve the post-transform vertex cache hit rate
+ * @param indices the triangle list
+ * @param nbVertices the size of the vertex arrays referenced by @p indices
+ * @param cacheSize the number of entries of the targeted cache
+ * @param clusters if not null, receives the index offsets where the algorithm had to jump
+ * to a non adjacent triangle (starting with 0). Those "hard boundaries" delimit clusters of
+ * triangles that can be reordered without hurting the cache efficiency (see optimizeOverdraw()).
+ * @return the reordered triangle list
+ *
+ * @note This is the Tipsify algorithm of Sander, Nehab and Barczak ("Fast Triangle
+ * Reordering for Vertex Locality and Reduced Overdraw", SIGGRAPH 2007). It runs in
+ * linear time and does not depend on the exact size of the hardware cache.
+ */
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int> & indices, size_t nbVertices, unsigned int cacheSize = 16, std::vector<unsigned int> * clusters = nullptr);
+
+/**
+ * @brief reorders clusters of triangles so that outward facing clusters are drawn first
+ * @param indices a triangle list, as output by optimizeVertexCache()
+ * @param positions the vertex positions referenced by @p indices
+ * @param clusters the hard boundaries returned by optimizeVertexCache()
+ * @param threshold maximal degradation of the ACMR tolerated when splitting clusters further
+ * (1.05 allows a 5% degradation)
+ * @return the reordered triangle list
+ *
+ * Clusters are sorted by decreasing value of the dot product between their average normal and
+ * the direction from the mesh centroid to the cluster centroid, which is a view independent
+ * approximation of a front to back order.
+ */
+std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & clusters, float threshold = 1.05f,
+                                           unsigned int cacheSize = 16);
+
+/**
+ * @brief A small cluster of neighbouring triangles, culled as a whole
+ */
+struct Meshlet {
+  unsigned int offset;   ///< index of the first IBO element of the meshlet
+  unsigned int count;    ///< number of IBO elements of the meshlet
+  BoundingSphere bounds; ///< sphere enclosing the triangles
+  NormalCone cone;       ///< cone enclosing the triangle normals
+
+  /// Constructor from a range
+  Meshlet(unsigned int offset = 0, unsigned int count = 0) : offset(offset), count(count) {}
+};
+
+/**
+ * @brief splits a range of a triangle list into meshlets
+ * @param indices the triangle list
+ * @param positions the vertex positions referenced by @p indices
+ * @param begin index of the first element of the range
+ * @param end index past the last element of the range
+ * @param maxVertices maximal number of distinct vertices per meshlet
+ * @param maxTriangles maximal number of triangles per meshlet
+ * @return the meshlets, covering the range in order
+ *
+ * The triangles are not reordered: they are gathered greedily in the IBO order, which is
+ * already spatially coherent once optimizeVertexCache() has been applied.
+ */
+std::vector<Meshlet> buildMeshlets(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions, size_t begin, size_t end, unsigned int maxVertices = 64,
+                                   unsigned int maxTriangles = 124);
+
+/**
+ * @brief denotes if a triangle list bounds a closed volume, with consistently oriented triangles
+ * @param indices the triangle list
+ * @param positions the vertex positions referenced by @p indices
+ * @return true when every edge is shared by as many triangles in both directions
+ *
+ * The vertices are welded by position, so that the seams of the other attributes (e.g. the
+ * texture coordinates) do not open the mesh. The back faces of a closed mesh are hidden by its
+ * front faces, hence its meshlets facing away from the camera can be culled (see NormalCone).
+ */
+bool isClosed(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & positions);
+
+/**
+ * @brief computes a vertex permutation sorting the vertices in the order they are first referenced
+ * @param ibos the triangle lists sharing the vertices (in drawing order)
+ * @param nbVertices the size of the vertex arrays
+ * @param nbUsed receives the number of referenced vertices
+ * @return the new index of every vertex (unreferenced vertices are sent at the end)
+ */
+std::vector<unsigned int> computeVertexFetchRemap(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, size_t & nbUsed);
+
+/**
+ * @brief applies a vertex permutation to a vertex attribute array
+ * @param attribute the attribute array (modified in place)
+ * @param remap the permutation, as returned by computeVertexFetchRemap()
+ * @param nbUsed the number of vertices to keep
+ */
+template <typename T> void remapVertexAttribute(std::vector<T> & attribute, const std::vector<unsigned int> & remap, size_t nbUsed)
+{
+  if (attribute.empty()) {
+    return;
+  }
+  std::vector<T> remapped(nbUsed);
+  for (size_t k = 0; k < attribute.size(); k++) {
+    if (remap[k] < nbUsed) {
+      remapped[remap[k]] = attribute[k];
+    }
+  }
+  attribute.swap(remapped);
+}
+
+#endif // !defined(__MESH_OPTIMIZER_H__)
@@ -0,0 +1,267 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+/// A symmetric 4x4 matrix measuring the (weighted) sum of squared distances to a set of planes
+struct Quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2; ///< upper triangle of the matrix
+  double weight;                                 ///< sum of the plane weights
+
+  Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+  /// Quadric of the plane {x, dot(n, x) + d = 0}, with n a unit vector
+  Quadric(const glm::vec3 & n, float d, double w)
+      : a2(w * n.x * n.x), ab(w * n.x * n.y), ac(w * n.x * n.z), ad(w * n.x * d), b2(w * n.y * n.y), bc(w * n.y * n.z), bd(w * n.y * d), c2(w * n.z * n.z), cd(w * n.z * d), d2(w * d * d), weight(w)
+  {
+  }
+
+  Quadric & operator+=(const Quadric & q)
+  {
+    a2 += q.a2;
+    ab += q.ab;
+    ac += q.ac;
+    ad += q.ad;
+    b2 += q.b2;
+    bc += q.bc;
+    bd += q.bd;
+    c2 += q.c2;
+    cd += q.cd;
+    d2 += q.d2;
+    weight += q.weight;
+    return *this;
+  }
+
+  /// weighted sum of the squared distances from @p p to the planes
+  double evaluate(const glm::vec3 & p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    double e = a2 * x * x + b2 * y * y + c2 * z * z + 2 * (ab * x * y + ac * x * z + bc * y * z) + 2 * (ad * x + bd * y + cd * z) + d2;
+    return std::max(e, 0.);
+  }
+};
+
+/// A candidate half-edge collapse (from -> to)
+struct Collapse {
+  double cost;
+  unsigned int from;
+  unsigned int to;
+  unsigned int fromStamp;
+  unsigned int toStamp;
+
+  bool operator<(const Collapse & other) const { return cost > other.cost; } // min-heap
+};
+} // namespace
+
+std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, const std::vector<bool> & lockedVertices, size_t targetIndexCount,
+                                       float maxError, float * resultError)
+{
+  const size_t nbVertices = positions.size();
+  const size_t nbTriangles = indices.size() / 3;
+  const double boundaryWeight = 10;
+  std::vector<unsigned int> triangles(indices.begin(), indices.begin() + 3 * nbTriangles);
+  std::vector<bool> alive(nbTriangles, true);
+  std::vector<std::vector<unsigned int>> vertexTriangles(nbVertices);
+  std::vector<Quadric> quadrics(nbVertices);
+  std::vector<bool> border(nbVertices, false);
+  std::vector<bool> removed(nbVertices, false);
+  std::vector<unsigned int> stamps(nbVertices, 0);
+  auto locked = [&](unsigned int v) { return v < lockedVertices.size() and lockedVertices[v]; };
+  auto contains = [&](unsigned int t, unsigned int v) { return triangles[3 * t] == v or triangles[3 * t + 1] == v or triangles[3 * t + 2] == v; };
+  auto normal = [&](unsigned int i0, unsigned int i1, unsigned int i2) { return glm::cross(positions[i1] - positions[i0], positions[i2] - positions[i0]); };
+
+  // plane quadrics (area weighted)
+  std::unordered_map<unsigned long long, unsigned int> edgeCount;
+  auto edgeKey = [](unsigned int a, unsigned int b) { return (static_cast<unsigned long long>(std::min(a, b)) << 32) | std::max(a, b); };
+  for (unsigned int t = 0; t < nbTriangles; t++) {
+    const unsigned int * tri = &triangles[3 * t];
+    glm::vec3 n = normal(tri[0], tri[1], tri[2]);
+    float area = glm::length(n);
+    for (unsigned int c = 0; c < 3; c++) {
+      vertexTriangles[tri[c]].push_back(t);
+      edgeCount[edgeKey(tri[c], tri[(c + 1) % 3])]++;
+    }
+    if (area > 0) {
+      n /= area;
+      Quadric q(n, -glm::dot(n, positions[tri[0]]), 0.5 * area);
+      for (unsigned int c = 0; c < 3; c++) {
+        quadrics[tri[c]] += q;
+      }
+    }
+  }
+  // constraint quadrics on open boundaries: planes orthogonal to the faces, containing the boundary edges
+  for (unsigned int t = 0; t < nbTriangles; t++) {
+    const unsigned int * tri = &triangles[3 * t];
+    glm::vec3 n = normal(tri[0], tri[1], tri[2]);
+    for (unsigned int c = 0; c < 3; c++) {
+      unsigned int a = tri[c];
+      unsigned int b = tri[(c + 1) % 3];
+      if (edgeCount[edgeKey(a, b)] != 1) {
+        continue;
+      }
+      border[a] = border[b] = true;
+      glm::vec3 edge = positions[b] - positions[a];
+      glm::vec3 p = glm::cross(edge, n);
+      float length = glm::length(p);
+      if (length > 0) {
+        p /= length;
+        Quadric q(p, -glm::dot(p, positions[a]), boundaryWeight * glm::dot(edge, edge));
+        quadrics[a] += q;
+        quadrics[b] += q;
+      }
+    }
+  }
+
+  // number of live triangles sharing the edge (a, b)
+  auto sharedTriangles = [&](unsigned int a, unsigned int b) {
+    unsigned int count = 0;
+    for (unsigned int t : vertexTriangles[a]) {
+      if (alive[t] and contains(t, b)) {
+        count++;
+      }
+    }
+    return count;
+  };
+  auto collapseCost = [&](unsigned int from, unsigned int to) {
+    Quadric q = quadrics[from];
+    q += quadrics[to];
+    return q.weight > 0 ? q.evaluate(positions[to]) / q.weight : 0.;
+  };
+  std::priority_queue<Collapse> heap;
+  auto pushCandidates = [&](unsigned int v) {
+    // drop dead triangles, and consider all the edges around v in both directions
+    std::vector<unsigned int> & list = vertexTriangles[v];
+    list.erase(std::remove_if(list.begin(), list.end(), [&](unsigned int t) { return not alive[t]; }), list.end());
+    for (unsigned int t : list) {
+      for (unsigned int c = 0; c < 3; c++) {
+        unsigned int w = triangles[3 * t + c];
+        if (w == v) {
+          continue;
+        }
+        if (not locked(v)) {
+          heap.push({collapseCost(v, w), v, w, stamps[v], stamps[w]});
+        }
+        if (not locked(w)) {
+          heap.push({collapseCost(w, v), w, v, stamps[w], stamps[v]});
+        }
+      }
+    }
+  };
+  auto isValid = [&](unsigned int from, unsigned int to) {
+    unsigned int shared = sharedTriangles(from, to);
+    if (shared == 0 or (border[from] and shared != 1)) {
+      // boundary vertices can only slide along the boundary
+      return false;
+    }
+    // link condition: the two vertices must not have other common neighbours than the opposite vertices of the edge
+    std::vector<unsigned int> fromNeighbours, toNeighbours;
+    for (unsigned int t : vertexTriangles[from]) {
+      if (alive[t]) {
+        fromNeighbours.insert(fromNeighbours.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+      }
+    }
+    for (unsigned int t : vertexTriangles[to]) {
+      if (alive[t]) {
+        toNeighbours.insert(toNeighbours.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+      }
+    }
+    std::sort(fromNeighbours.begin(), fromNeighbours.end());
+    fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+    std::sort(toNeighbours.begin(), toNeighbours.end());
+    toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+    std::vector<unsigned int> common;
+    std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(common));
+    if (common.size() != shared + 2) { // the opposite vertices, plus from and to themselves
+      return false;
+    }
+    // the triangles moved by the collapse must not flip nor degenerate
+    for (unsigned int t : vertexTriangles[from]) {
+      if (not alive[t] or contains(t, to)) {
+        continue;
+      }
+      unsigned int tri[3] = {triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2]};
+      glm::vec3 before = normal(tri[0], tri[1], tri[2]);
+      std::replace(tri, tri + 3, from, to);
+      glm::vec3 after = normal(tri[0], tri[1], tri[2]);
+      if (glm::dot(before, after) <= 0.1f * glm::length(before) * glm::length(after)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  for (unsigned int v = 0; v < nbVertices; v++) {
+    if (not vertexTriangles[v].empty()) {
+      pushCandidates(v);
+    }
+  }
+  size_t liveTriangles = nbTriangles;
+  const double maxCost = double(maxError) * maxError;
+  double error = 0;
+  while (3 * liveTriangles > targetIndexCount and not heap.empty()) {
+    Collapse collapse = heap.top();
+    heap.pop();
+    unsigned int from = collapse.from;
+    unsigned int to = collapse.to;
+    if (removed[from] or removed[to] or collapse.fromStamp != stamps[from] or collapse.toStamp != stamps[to]) {
+      continue; // outdated candidate
+    }
+    if (collapse.cost > maxCost) {
+      break;
+    }
+    if (not isValid(from, to)) {
+      continue;
+    }
+    for (unsigned int t : vertexTriangles[from]) {
+      if (not alive[t]) {
+        continue;
+      }
+      if (contains(t, to)) {
+        alive[t] = false;
+        liveTriangles--;
+      } else {
+        std::replace(&triangles[3 * t], &triangles[3 * t] + 3, from, to);
+        vertexTriangles[to].push_back(t);
+      }
+    }
+    vertexTriangles[from].clear();
+    quadrics[to] += quadrics[from];
+    removed[from] = true;
+    stamps[to]++;
+    error = std::max(error, collapse.cost);
+    pushCandidates(to);
+  }
+
+  std::vector<unsigned int> result;
+  result.reserve(3 * liveTriangles);
+  for (unsigned int t = 0; t < nbTriangles; t++) {
+    if (alive[t]) {
+      result.insert(result.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+    }
+  }
+  if (resultError) {
+    *resultError = std::sqrt(error);
+  }
+  return result;
+}
+
+unsigned int selectLevelOfDetail(float projectedSize, unsigned int current, unsigned int nbLevels, float fullDetailSize)
+{
+  const float hysteresis = 0.1f;
+  if (nbLevels == 0) {
+    return 0;
+  }
+  unsigned int level = std::min(current, nbLevels - 1);
+  // boundary(k) separates level k (above) from level k + 1 (below)
+  auto boundary = [fullDetailSize](unsigned int k) { return fullDetailSize / float(2 << k); };
+  while (level > 0 and projectedSize > boundary(level - 1) * (1 + hysteresis)) {
+    level--;
+  }
+  while (level + 1 < nbLevels and projectedSize < boundary(level) * (1 - hysteresis)) {
+    level++;
+  }
+  return level;
+}
@@ -0,0 +1,54 @@
+/** @file */
+#ifndef __MESH_SIMPLIFIER_H__
+#define __MESH_SIMPLIFIER_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief A level of detail, i.e. a range of indices in an IBO holding several versions of the same triangles
+ */
+struct LevelOfDetail {
+  unsigned int offset;       ///< index of the first element of the range
+  unsigned int count;        ///< number of elements in the range
+  float error;               ///< geometric error of the simplification (in object space units)
+  unsigned int firstMeshlet; ///< index of the first meshlet of the level (if meshlets were built)
+  unsigned int nbMeshlets;   ///< number of meshlets of the level (0 if meshlets were not built)
+
+  /// Constructor from a range
+  LevelOfDetail(unsigned int offset = 0, unsigned int count = 0, float error = 0) : offset(offset), count(count), error(error), firstMeshlet(0), nbMeshlets(0) {}
+};
+
+/**
+ * @brief simplifies a triangle list by iterative edge collapses driven by quadric error metrics
+ * @param positions the vertex positions
+ * @param indices the triangle list to be simplified
+ * @param lockedVertices flags denoting the vertices that must not be moved (e.g. vertices lying on UV seams or
+ * material boundaries), may be empty
+ * @param targetIndexCount the wanted number of indices (the result may be bigger)
+ * @param maxError the maximal geometric error allowed (in the same units as @p positions)
+ * @param resultError if not null, receives the geometric error of the result
+ * @return the simplified triangle list, referencing a subset of the input vertices
+ *
+ * The method of Garland and Heckbert is used with half-edge collapses: vertices are never
+ * created, so that the result can share the vertex arrays of the input. Open boundaries
+ * are preserved by additional constraint quadrics, and by only collapsing boundary vertices
+ * along boundary edges. Collapses that would flip a triangle or create a non-manifold edge
+ * are rejected.
+ */
+std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, const std::vector<bool> & lockedVertices, size_t targetIndexCount,
+                                       float maxError, float * resultError = nullptr);
+
+/**
+ * @brief selects a level of detail from the projected size of an object, with hysteresis
+ * @param projectedSize the ratio between the projected radius of the object bounding sphere and half the viewport height
+ * @param current the level currently used
+ * @param nbLevels the number of available levels
+ * @return the level to be used (0 being the finest one)
+ *
+ * The level k is used when the projected size lies in ]fullDetailSize / 2^(k+1), fullDetailSize / 2^k].
+ * A change of level only occurs when the size goes beyond a level boundary by more than 10%,
+ * so that objects lying close to a boundary do not pop between two levels every frame.
+ */
+unsigned int selectLevelOfDetail(float projectedSize, unsigned int current, unsigned int nbLevels, float fullDetailSize = 0.5f);
+
+#endif // !defined(__MESH_SIMPLIFIER_H__)
@@ -0,0 +1,133 @@
+#include "MipCache.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <vector>
+#include "ImageCache.hpp"
+#include "MipmapGenerator.hpp"
+#include "utils.hpp"
+
+std::string MipCache::directory = absolutename("mipcache");
+
+namespace
+{
+/// Header of a cache file, followed by the levels from the coarsest to the finest one
+struct Header {
+  char magic[4];      ///< "MIPS"
+  uint32_t version;   ///< format version
+  int32_t width;      ///< width of the finest level
+  int32_t height;     ///< height of the finest level
+  int32_t channels;   ///< number of channels
+  uint32_t nbLevels;  ///< number of levels
+  int64_t sourceTime; ///< modification time of the image file
+  int64_t sourceSize; ///< size of the image file
+};
+
+const uint32_t formatVersion = 1;
+} // namespace
+
+MipCache::MipCache(const std::string & imageFilename, bool srgb) : m_width(0), m_height(0), m_channels(0), m_nbLevels(0)
+{
+  char resolved[PATH_MAX];
+  std::string canonical = realpath(imageFilename.c_str(), resolved) ? resolved : imageFilename;
+  struct stat status;
+  if (stat(canonical.c_str(), &status) != 0) {
+    std::cerr << "Unable to find file: " << imageFilename << std::endl;
+    return;
+  }
+  // one cache file per image and color space, named after the full path of the image
+  std::string name = canonical;
+  std::replace(name.begin(), name.end(), '/', '_');
+  m_path = directory + "/" + name + (srgb ? ".srgb" : "") + ".mips";
+  if (not readHeader(status.st_mtime, status.st_size)) {
+    build(canonical, srgb, status.st_mtime, status.st_size);
+  }
+}
+
+bool MipCache::readHeader(long long sourceTime, long long sourceSize)
+{
+  std::ifstream file(m_path, std::ios::binary);
+  Header header;
+  if (not file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    return false;
+  }
+  if (std::memcmp(header.magic, "MIPS", 4) != 0 or header.version != formatVersion or header.sourceTime != sourceTime or header.sourceSize != sourceSize) {
+    return false;
+  }
+  m_width = header.width;
+  m_height = header.height;
+  m_channels = header.channels;
+  m_nbLevels = header.nbLevels;
+  return true;
+}
+
+void MipCache::build(const std::string & imageFilename, bool srgb, long long sourceTime, long long sourceSize)
+{
+  Image<> image = ImageCache::load(imageFilename);
+  if (!image.data) {
+    std::cerr << "Unable to load texture: " << imageFilename << std::endl;
+    return;
+  }
+  std::vector<Image<>> levels = generateMipmaps(image, srgb);
+  levels.insert(levels.begin(), image);
+
+  Header header;
+  std::memcpy(header.magic, "MIPS", 4);
+  header.version = formatVersion;
+  header.width = image.width;
+  header.height = image.height;
+  header.channels = image.channels;
+  header.nbLevels = levels.size();
+  header.sourceTime = sourceTime;
+  header.sourceSize = sourceSize;
+  // written to a temporary file first, so that a cache file is either complete or absent
+  mkdir(directory.c_str(), 0755);
+  std::string temporaryPath = m_path + ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (size_t k = levels.size(); k-- > 0;) {
+      file.write(reinterpret_cast<const char *>(levels[k].data), levels[k].size());
+    }
+    if (not file) {
+      std::cerr << "Unable to write the mipmap cache file: " << temporaryPath << std::endl;
+      return;
+    }
+  }
+  if (std::rename(temporaryPath.c_str(), m_path.c_str()) != 0) {
+    std::cerr << "Unable to write the mipmap cache file: " << m_path << std::endl;
+    return;
+  }
+  m_width = image.width;
+  m_height = image.height;
+  m_channels = image.channels;
+  m_nbLevels = levels.size();
+}
+
+size_t MipCache::levelOffset(unsigned int level) const
+{
+  size_t offset = sizeof(Header);
+  for (unsigned int k = m_nbLevels - 1; k > level; k--) {
+    offset += levelSize(k);
+  }
+  return offset;
+}
+
+Image<> MipCache::readLevel(unsigned int level) const
+{
+  if (level >= m_nbLevels) {
+    return Image<>();
+  }
+  Image<> image = Image<>::allocate(width(level), height(level), m_channels);
+  std::ifstream file(m_path, std::ios::binary);
+  file.seekg(levelOffset(level));
+  if (not file.read(reinterpret_cast<char *>(image.data), image.size())) {
+    std::cerr << "Unable to read the mipmap cache file: " << m_path << std::endl;
+    return Image<>();
+  }
+  return image;
+}
@@ -0,0 +1,66 @@
+/** @file */
+#ifndef __MIP_CACHE_H__
+#define __MIP_CACHE_H__
+#include <string>
+#include "Image.hpp"
+
+/**
+ * @brief The mipmap chain of an image file, kept on disk
+ *
+ * The first access to an image decodes it and builds its mipmaps (see generateMipmaps()), which are
+ * written uncompressed in a cache file. The next accesses (in this run or in the next ones) read single
+ * levels from this file, without decoding the image. The levels are stored from the coarsest to the
+ * finest one, so that the coarse levels, which are loaded first, lie at the beginning of the file.
+ * A cache file is rebuilt when its image is modified.
+ */
+class MipCache {
+public:
+  /**
+   * @brief Constructor, opens (and builds if needed) the cache file of an image
+   * @param imageFilename the image file
+   * @param srgb denotes if the color channels of the image are sRGB encoded (see generateMipmaps())
+   */
+  MipCache(const std::string & imageFilename, bool srgb);
+
+  /// Denotes if the levels are available (i.e. the image could be decoded, and its cache file written)
+  bool valid() const { return m_nbLevels > 0; }
+
+  /// number of levels
+  unsigned int nbLevels() const { return m_nbLevels; }
+
+  /// width of a level
+  int width(unsigned int level) const { return std::max(1, m_width >> level); }
+
+  /// height of a level
+  int height(unsigned int level) const { return std::max(1, m_height >> level); }
+
+  /// number of channels of the levels
+  int channels() const { return m_channels; }
+
+  /// size of a level (in bytes)
+  size_t levelSize(unsigned int level) const { return size_t(width(level)) * height(level) * m_channels; }
+
+  /**
+   * @brief reads a level from the cache file
+   * @param level the level (0 being the finest one)
+   * @return the level, an empty image on failure
+   *
+   * @note this method can be called concurrently from several threads
+   */
+  Image<> readLevel(unsigned int level) const;
+
+  static std::string directory; ///< directory of the cache files (created if needed)
+
+private:
+  bool readHeader(long long sourceTime, long long sourceSize);
+  void build(const std::string & imageFilename, bool srgb, long long sourceTime, long long sourceSize);
+  size_t levelOffset(unsigned int level) const;
+
+  std::string m_path;      ///< cache file
+  int m_width;             ///< width of the finest level
+  int m_height;            ///< height of the finest level
+  int m_channels;          ///< number of channels
+  unsigned int m_nbLevels; ///< number of levels (0 if the cache is not valid)
+};
+
+#endif // !defined(__MIP_CACHE_H__)
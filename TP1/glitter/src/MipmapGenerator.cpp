@@ -0,0 +1,241 @@
+#include "MipmapGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+/// The taps of a 1d resampling filter: for each destination texel, a list of source texels with their weights
+struct Kernel {
+  std::vector<unsigned int> first; ///< first tap of each destination texel (plus the total number of taps)
+  std::vector<unsigned int> index; ///< source texel of each tap
+  std::vector<float> weight;       ///< weight of each tap (the weights of a destination texel sum to 1)
+};
+
+/// modified Bessel function of the first kind, of order 0
+double besselI0(double x)
+{
+  double sum = 1;
+  double term = 1;
+  for (int k = 1; term > 1e-12 * sum; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/// Kaiser windowed sinc, @p t being expressed in destination texels
+double kaiserSinc(double t)
+{
+  const double radius = 3;
+  const double alpha = 4;
+  if (std::fabs(t) >= radius) {
+    return 0;
+  }
+  const double pi = 3.14159265358979323846;
+  double sinc = t == 0 ? 1 : std::sin(pi * t) / (pi * t);
+  double r = t / radius;
+  return sinc * besselI0(alpha * std::sqrt(1 - r * r)) / besselI0(alpha);
+}
+
+Kernel buildKernel(int srcSize, int dstSize, MipmapFilter filter)
+{
+  const double scale = double(srcSize) / dstSize;
+  Kernel kernel;
+  kernel.first.push_back(0);
+  for (int x = 0; x < dstSize; x++) {
+    const unsigned int first = kernel.index.size();
+    // taps falling out of the image are clamped to the edges, and merged with the edge tap
+    auto addTap = [&](int i, double w) {
+      unsigned int clamped = std::min(std::max(i, 0), srcSize - 1);
+      if (kernel.index.size() > first and kernel.index.back() == clamped) {
+        kernel.weight.back() += w;
+      } else {
+        kernel.index.push_back(clamped);
+        kernel.weight.push_back(w);
+      }
+    };
+    const double center = (x + 0.5) * scale;
+    if (filter == MipmapFilter::Box) {
+      const double lo = center - scale / 2;
+      const double hi = center + scale / 2;
+      for (int i = int(std::floor(lo)); i < hi; i++) {
+        double overlap = std::min(hi, i + 1.) - std::max(lo, double(i));
+        if (overlap > 0) {
+          addTap(i, overlap);
+        }
+      }
+    } else {
+      const double radius = 3 * scale;
+      for (int i = int(std::floor(center - radius)); i <= int(std::ceil(center + radius)); i++) {
+        double w = kaiserSinc((i + 0.5 - center) / scale);
+        if (w != 0) {
+          addTap(i, w);
+        }
+      }
+    }
+    float sum = 0;
+    for (unsigned int k = first; k < kernel.index.size(); k++) {
+      sum += kernel.weight[k];
+    }
+    for (unsigned int k = first; k < kernel.index.size(); k++) {
+      kernel.weight[k] /= sum;
+    }
+    kernel.first.push_back(kernel.index.size());
+  }
+  return kernel;
+}
+
+/// Conversions between 8 bits values and floating point (linear) values
+struct Encoding {
+  static const int linearSteps = 16384;
+  float toLinear[256];                       ///< decoded value of each sRGB byte
+  unsigned char fromLinear[linearSteps + 1]; ///< sRGB byte of linear values sampled regularly in [0, 1]
+
+  Encoding()
+  {
+    for (int i = 0; i < 256; i++) {
+      float c = i / 255.f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i <= linearSteps; i++) {
+      float l = float(i) / linearSteps;
+      float c = l <= 0.0031308f ? 12.92f * l : 1.055f * std::pow(l, 1 / 2.4f) - 0.055f;
+      fromLinear[i] = static_cast<unsigned char>(c * 255 + 0.5f);
+    }
+  }
+
+  static const Encoding & instance()
+  {
+    static Encoding encoding;
+    return encoding;
+  }
+};
+
+/// denotes if the channel @p c of an image with @p channels channels holds sRGB encoded values
+inline bool isColorChannel(int c, int channels, bool srgb)
+{
+  return srgb and not((channels == 2 or channels == 4) and c == channels - 1);
+}
+
+/// horizontal pass of a row (with C channels)
+template <int C> void filterRow(const float * line, const Kernel & columns, int width, float * row)
+{
+  for (int x = 0; x < width; x++) {
+    float sum[C] = {};
+    for (unsigned int k = columns.first[x]; k < columns.first[x + 1]; k++) {
+      const float * texel = line + C * columns.index[k];
+      const float w = columns.weight[k];
+      for (int c = 0; c < C; c++) {
+        sum[c] += w * texel[c];
+      }
+    }
+    for (int c = 0; c < C; c++) {
+      row[C * x + c] = sum[c];
+    }
+  }
+}
+
+/**
+ * @brief filters a level into the next one
+ * @param src the previous level (linear values)
+ * @param dst the next level (linear values)
+ * @param encoded the next level (8 bits values)
+ */
+void downsample(const Image<float> & src, const Image<float> & dst, const Image<> & encoded, MipmapFilter filter, bool srgb, ThreadPool & pool)
+{
+  const Kernel rows = buildKernel(src.height, dst.height, filter);
+  const Kernel columns = buildKernel(src.width, dst.width, filter);
+  const int channels = src.channels;
+  const size_t srcRowSize = size_t(src.width) * channels;
+  const size_t dstRowSize = size_t(dst.width) * channels;
+  const Encoding & encoding = Encoding::instance();
+  pool.parallelFor(dst.height, [&](size_t begin, size_t end) {
+    std::vector<float> line(srcRowSize);
+    for (size_t y = begin; y < end; y++) {
+      // vertical pass: weighted sum of whole source rows, SIMD over the contiguous texels
+      std::fill(line.begin(), line.end(), 0.f);
+      for (unsigned int k = rows.first[y]; k < rows.first[y + 1]; k++) {
+        const float * s = src.data + rows.index[k] * srcRowSize;
+        float * l = line.data();
+        const float w = rows.weight[k];
+        const simd::Float ws(w);
+        size_t i = 0;
+        for (; i + simd::Float::width <= srcRowSize; i += simd::Float::width) {
+          (simd::Float::load(l + i) + ws * simd::Float::load(s + i)).store(l + i);
+        }
+        for (; i < srcRowSize; i++) {
+          l[i] += w * s[i];
+        }
+      }
+      // horizontal pass on the (already vertically reduced) row
+      float * row = dst.data + y * dstRowSize;
+      switch (channels) {
+      case 1:
+        filterRow<1>(line.data(), columns, dst.width, row);
+        break;
+      case 2:
+        filterRow<2>(line.data(), columns, dst.width, row);
+        break;
+      case 3:
+        filterRow<3>(line.data(), columns, dst.width, row);
+        break;
+      default:
+        filterRow<4>(line.data(), columns, dst.width, row);
+        break;
+      }
+      unsigned char * out = encoded.data + y * dstRowSize;
+      for (int c = 0; c < channels; c++) {
+        const bool color = isColorChannel(c, channels, srgb);
+        for (size_t i = c; i < dstRowSize; i += channels) {
+          float v = std::min(std::max(row[i], 0.f), 1.f);
+          out[i] = color ? encoding.fromLinear[int(v * Encoding::linearSteps + 0.5f)] : static_cast<unsigned char>(v * 255 + 0.5f);
+        }
+      }
+    }
+  });
+}
+} // namespace
+
+unsigned int mipmapLevelCount(int width, int height)
+{
+  unsigned int count = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2) {
+    count++;
+  }
+  return count;
+}
+
+std::vector<Image<>> generateMipmaps(const Image<> & image, bool srgb, MipmapFilter filter, ThreadPool & pool)
+{
+  std::vector<Image<>> levels;
+  if (image.channels < 1 or image.channels > 4) {
+    std::cerr << "Unable to generate the mipmaps of an image with " << image.channels << " channels" << std::endl;
+    return levels;
+  }
+  const Encoding & encoding = Encoding::instance();
+  const int channels = image.channels;
+  Image<float> previous = Image<float>::allocate(image.width, image.height, channels);
+  pool.parallelFor(image.height, [&](size_t begin, size_t end) {
+    for (int c = 0; c < channels; c++) {
+      const bool color = isColorChannel(c, channels, srgb);
+      for (size_t i = begin * image.width * channels + c; i < end * image.width * channels; i += channels) {
+        previous.data[i] = color ? encoding.toLinear[image.data[i]] : image.data[i] / 255.f;
+      }
+    }
+  });
+  levels.reserve(mipmapLevelCount(image.width, image.height) - 1);
+  while (previous.width > 1 or previous.height > 1) {
+    Image<float> next = Image<float>::allocate(std::max(1, previous.width / 2), std::max(1, previous.height / 2), channels);
+    levels.push_back(Image<>::allocate(next.width, next.height, channels));
+    downsample(previous, next, levels.back(), filter, srgb, pool);
+    previous = next;
+  }
+  return levels;
+}
+
+std::vector<Image<>> generateMipmaps(const Image<> & image, bool srgb, MipmapFilter filter)
+{
+  return generateMipmaps(image, srgb, filter, ThreadPool::global());
+}
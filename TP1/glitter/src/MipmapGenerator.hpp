@@ -0,0 +1,44 @@
+/** @file */
+#ifndef __MIPMAP_GENERATOR_H__
+#define __MIPMAP_GENERATOR_H__
+#include <vector>
+#include "Image.hpp"
+
+class ThreadPool;
+
+/// The reconstruction filters available to build the mipmaps
+enum class MipmapFilter
+{
+  Box,   ///< average over the footprint of the texel (cheap, a bit blurry)
+  Kaiser ///< Kaiser windowed sinc (sharper, may ring slightly on hard edges)
+};
+
+/**
+ * @brief provides the number of levels of a complete mipmap chain
+ * @param width the width of the finest level
+ * @param height the height of the finest level
+ * @return the number of levels, the finest one included
+ */
+unsigned int mipmapLevelCount(int width, int height);
+
+/**
+ * @brief builds the mipmap chain of an image
+ * @param image the finest level (2d, 8 bits per channel, any size)
+ * @param srgb denotes if the color channels are sRGB encoded, in which case they are filtered in linear space
+ * (alpha, i.e. the last channel of 2 or 4 channel images, is always linear)
+ * @param filter the reconstruction filter
+ * @param pool the threads filtering the rows of each level
+ * @return the levels 1 to mipmapLevelCount() - 1 (the level k being max(1, floor(width / 2^k))
+ * by max(1, floor(height / 2^k)), like OpenGL expects them)
+ *
+ * Each level is filtered from the previous one, kept in floating point to avoid accumulating
+ * quantization errors. The filters are separable, and are built for the actual ratio between
+ * the sizes of two levels, so that non power of two sizes are handled without shifting the content.
+ * Texels out of the image are clamped to the edges.
+ */
+std::vector<Image<>> generateMipmaps(const Image<> & image, bool srgb, MipmapFilter filter, ThreadPool & pool);
+
+/// builds the mipmap chain of an image with the process-wide thread pool
+std::vector<Image<>> generateMipmaps(const Image<> & image, bool srgb, MipmapFilter filter = MipmapFilter::Kaiser);
+
+#endif // !defined(__MIPMAP_GENERATOR_H__)
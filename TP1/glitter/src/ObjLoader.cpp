@@ -1,9 +1,16 @@
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
 #include <iostream>
+#include <numeric>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "ObjLoader.hpp"
+#include "ImageCache.hpp"
+#include "MeshOptimizer.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
 #include "utils.hpp"
 
 static glm::vec3 calcNormal(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 & v2)
@@ -20,7 +27,7 @@ std::string ObjLoader::defaultNormalName = "OBL:default_normal";
 unsigned char ObjLoader::bluish[4] = {128, 128, 255, 255};
 unsigned char ObjLoader::white[4] = {255, 255, 255, 255};
 
-ObjLoader::ObjLoader(const std::string & filename)
+ObjLoader::ObjLoader(const std::string & filename, const Options & options) : m_options(options)
 {
   std::string absolutepath = absolutename(filename);
   m_rootDir = basename(absolutepath);
@@ -39,6 +46,14 @@ Image<> ObjLoader::image(const std::string & name) const
   return m_images[name];
 }
 
+std::string ObjLoader::imageFilename(const std::string & name) const
+{
+  if (name.empty() or name == defaultDiffuseName or name == defaultNormalName) {
+    return std::string();
+  }
+  return m_rootDir + name;
+}
+
 size_t ObjLoader::nbIBOs() const
 {
   return m_ibos.size();
@@ -74,27 +89,90 @@ const std::vector<unsigned int> & ObjLoader::ibo(unsigned int materialIndex) con
   return m_ibos[materialIndex];
 }
 
-void ObjLoader::loadImage(std::string texture_filename)
+const std::vector<unsigned int> & ObjLoader::lodIBO(unsigned int materialIndex) const
 {
-  std::string key = texture_filename;
-  if (texture_filename.length() > 0) {
-    // Only load the texture if it is not already loaded
-    if (not m_images.find(key)) {
-      texture_filename = m_rootDir + texture_filename;
-      if (!fileExists(texture_filename)) {
-        std::cerr << "Unable to find file: " << texture_filename << std::endl;
-        exit(1);
-      }
+  return m_lodIBOs[materialIndex].empty() ? m_ibos[materialIndex] : m_lodIBOs[materialIndex];
+}
 
-      Image<> image;
-      image.data = stbi_load(texture_filename.c_str(), &image.width, &image.height, &image.channels, STBI_default);
-      if (!image.data) {
-        std::cerr << "Unable to load texture: " << texture_filename << std::endl;
-        exit(1);
-      }
-      std::cout << "Loaded texture: " << texture_filename << ", w = " << image.width << ", h = " << image.height << ", channels = " << image.channels << std::endl;
-      m_images.add(key, image);
+const std::vector<LevelOfDetail> & ObjLoader::lods(unsigned int materialIndex) const
+{
+  return m_lods[materialIndex];
+}
+
+const std::vector<Meshlet> & ObjLoader::meshlets(unsigned int materialIndex) const
+{
+  return m_meshlets[materialIndex];
+}
+
+const BoundingSphere & ObjLoader::boundingSphere() const
+{
+  return m_boundingSphere;
+}
+
+const BoundingBox & ObjLoader::boundingBox() const
+{
+  return m_boundingBox;
+}
+
+const BoundingSphere & ObjLoader::partBoundingSphere(unsigned int materialIndex) const
+{
+  return m_partBoundingSpheres[materialIndex];
+}
+
+const BoundingBox & ObjLoader::partBoundingBox(unsigned int materialIndex) const
+{
+  return m_partBoundingBoxes[materialIndex];
+}
+
+void ObjLoader::release()
+{
+  // swapping with empty vectors actually frees the memory, unlike clear()
+  std::vector<glm::vec3>().swap(m_vertexPositions);
+  std::vector<glm::vec4>().swap(m_vertexColors);
+  std::vector<glm::vec2>().swap(m_vertexUVs);
+  std::vector<glm::vec3>().swap(m_vertexNormals);
+  std::vector<glm::vec3>().swap(m_vertexTangents);
+  for (auto & ibo : m_ibos) {
+    IBO().swap(ibo);
+  }
+  for (auto & ibo : m_lodIBOs) {
+    IBO().swap(ibo);
+  }
+}
+
+std::vector<ObjLoader::PendingImage> ObjLoader::decodeImages(const std::vector<std::string> & names)
+{
+  std::vector<PendingImage> pendingImages;
+  for (const auto & name : names) {
+    // Only load each texture once
+    if (name.empty() or m_images.find(name) or std::any_of(pendingImages.begin(), pendingImages.end(), [&name](const PendingImage & p) { return p.name == name; })) {
+      continue;
+    }
+    std::string filename = m_rootDir + name;
+    if (!fileExists(filename)) {
+      std::cerr << "Unable to find file: " << filename << std::endl;
+      exit(1);
+    }
+    // the decoding runs concurrently with the other decodings and with the geometry processing
+    PendingImage pending;
+    pending.name = name;
+    pending.filename = filename;
+    pending.image = ThreadPool::global().submit([filename]() { return ImageCache::load(filename); });
+    pendingImages.push_back(std::move(pending));
+  }
+  return pendingImages;
+}
+
+void ObjLoader::addImages(std::vector<PendingImage> & pendingImages)
+{
+  for (auto & pending : pendingImages) {
+    Image<> image = pending.image.get();
+    if (!image.data) {
+      std::cerr << "Unable to load texture: " << pending.filename << std::endl;
+      exit(1);
     }
+    std::cout << "Loaded texture: " << pending.filename << ", w = " << image.width << ", h = " << image.height << ", channels = " << image.channels << std::endl;
+    m_images.add(pending.name, image);
   }
 }
 
@@ -120,6 +198,7 @@ void ObjLoader::parseFile(const std::string & filename)
   defaultMaterial.shininess = 1;
   defaultMaterial.name = "default_material";
   materials.push_back(defaultMaterial);
+  std::vector<std::string> textureNames;
   for (size_t m = 0; m < materials.size(); m++) {
     tinyobj::material_t * mp = &materials[m];
     SimpleMaterial material;
@@ -131,13 +210,34 @@ void ObjLoader::parseFile(const std::string & filename)
     material.diffuseTexName = (mp->diffuse_texname != "") ? mp->diffuse_texname : defaultDiffuseName;
     material.normalTexName = (mp->normal_texname != "") ? mp->normal_texname : defaultNormalName;
     material.specularTexName = (mp->normal_texname != "") ? mp->specular_texname : defaultDiffuseName;
-    loadImage(mp->diffuse_texname);
-    loadImage(mp->normal_texname);
-    loadImage(mp->specular_texname);
+    textureNames.push_back(mp->diffuse_texname);
+    textureNames.push_back(mp->normal_texname);
+    textureNames.push_back(mp->specular_texname);
     m_materials.push_back(material);
   }
+  std::vector<PendingImage> pendingImages = m_options.decodeImages ? decodeImages(textureNames) : std::vector<PendingImage>();
 
+  // Reserve the attribute arrays and the IBOs from the face counts (faces are triangulated by tinyobj)
   m_ibos.resize(m_materials.size());
+  std::vector<size_t> nbMaterialCorners(m_materials.size(), 0);
+  size_t nbCorners = 0;
+  for (const auto & shape : shapes) {
+    for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+      int materialId = shape.mesh.material_ids[f];
+      if (materialId < 0 or materialId >= static_cast<int>(materials.size())) {
+        materialId = materials.size() - 1;
+      }
+      nbMaterialCorners[materialId] += 3;
+      nbCorners += 3;
+    }
+  }
+  m_vertexPositions.reserve(nbCorners);
+  m_vertexNormals.reserve(nbCorners);
+  m_vertexUVs.reserve(nbCorners);
+  m_vertexColors.reserve(nbCorners);
+  for (size_t m = 0; m < m_ibos.size(); m++) {
+    m_ibos[m].reserve(nbMaterialCorners[m]);
+  }
   // Loop over shapes
   for (size_t s = 0; s < shapes.size(); s++) {
     // Loop over faces(polygon)
@@ -188,8 +288,14 @@ void ObjLoader::parseFile(const std::string & filename)
       }
     }
   }
-  computeTangents();
   cleanUpDuplicates();
+  computeTangents();
+  computeBounds();
+  optimizeMesh();
+  generateLODs();
+  optimizeVertexFetch();
+  generateMeshlets();
+  addImages(pendingImages);
 }
 
 void ObjLoader::computeTangents()
@@ -202,55 +308,153 @@ void ObjLoader::computeTangents()
   //! Solving this 2x2 linear system with Cramer's rule gives:
   //! t1 = det([1, delta u2; 0, delta v2]) /  det([delta u1, delta u2; delta v1, delta v2])
   //! t2 = det([delta u1, 1; delta v1, 0]) /  det([delta u1, delta u2; delta v1, delta v2])
-  glm::vec3 tangent;
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 3) {
-    glm::vec2 & uv0 = m_vertexUVs[i + 0];
-    glm::vec2 & uv1 = m_vertexUVs[i + 1];
-    glm::vec2 & uv2 = m_vertexUVs[i + 2];
-    // UV delta
-    glm::vec2 deltaUV1 = uv1 - uv0;
-    glm::vec2 deltaUV2 = uv2 - uv0;
-    float detDenom = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
-    if (detDenom != 0) {
-      // Shortcuts for m_vertexPositions
-      glm::vec3 & x0 = m_vertexPositions[i + 0];
-      glm::vec3 & x1 = m_vertexPositions[i + 1];
-      glm::vec3 & x2 = m_vertexPositions[i + 2];
-      // Edges of the triangle : postion delta
-      glm::vec3 deltaPos1 = x1 - x0;
-      glm::vec3 deltaPos2 = x2 - x0;
-      float r = 1.0f / detDenom;
-      tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+  //! The tangents of the triangles are accumulated on their (welded) vertices, weighted by the angle of
+  //! the triangle corners. The triangles are processed simd::Float::width at a time, in SoA layout.
+  using simd::Float;
+  const size_t width = Float::width;
+  const size_t nbVertices = m_vertexPositions.size();
+  size_t nbTriangles = 0;
+  for (const auto & ibo : m_ibos) {
+    nbTriangles += ibo.size() / 3;
+  }
+  const size_t padded = (nbTriangles + width - 1) / width * width;
+
+  // gather the corner attributes (x, y, z, u, v for each corner), padded with degenerate triangles
+  enum { X, Y, Z, U, V, NB_ATTRIBUTES };
+  std::vector<float> corners(3 * NB_ATTRIBUTES * padded, 0.f);
+  std::vector<unsigned int> triangleVertices;
+  triangleVertices.reserve(3 * nbTriangles);
+  for (const auto & ibo : m_ibos) {
+    triangleVertices.insert(triangleVertices.end(), ibo.begin(), ibo.end());
+  }
+  auto corner = [&corners, padded](unsigned int c, unsigned int attribute) { return &corners[(NB_ATTRIBUTES * c + attribute) * padded]; };
+  for (size_t t = 0; t < nbTriangles; t++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      const glm::vec3 & x = m_vertexPositions[triangleVertices[3 * t + c]];
+      const glm::vec2 & uv = m_vertexUVs[triangleVertices[3 * t + c]];
+      corner(c, X)[t] = x.x;
+      corner(c, Y)[t] = x.y;
+      corner(c, Z)[t] = x.z;
+      corner(c, U)[t] = uv.x;
+      corner(c, V)[t] = uv.y;
+    }
+  }
+
+  // unit tangent and corner weights of every triangle (all weights are 0 when the uvs are degenerate)
+  enum { TX, TY, TZ, W0, W1, W2, NB_OUTPUTS };
+  std::vector<float> faces(NB_OUTPUTS * padded);
+  auto face = [&faces, padded](unsigned int output) { return &faces[output * padded]; };
+  const Float zero(0.f), epsilon(1e-20f), pi(glm::pi<float>());
+  for (size_t t = 0; t < padded; t += width) {
+    Float x0 = Float::load(corner(0, X) + t), y0 = Float::load(corner(0, Y) + t), z0 = Float::load(corner(0, Z) + t);
+    Float e1x = Float::load(corner(1, X) + t) - x0, e1y = Float::load(corner(1, Y) + t) - y0, e1z = Float::load(corner(1, Z) + t) - z0;
+    Float e2x = Float::load(corner(2, X) + t) - x0, e2y = Float::load(corner(2, Y) + t) - y0, e2z = Float::load(corner(2, Z) + t) - z0;
+    Float u0 = Float::load(corner(0, U) + t), v0 = Float::load(corner(0, V) + t);
+    Float du1 = Float::load(corner(1, U) + t) - u0, dv1 = Float::load(corner(1, V) + t) - v0;
+    Float du2 = Float::load(corner(2, U) + t) - u0, dv2 = Float::load(corner(2, V) + t) - v0;
+    Float det = du1 * dv2 - du2 * dv1;
+    // the sign of the determinant orients the tangent towards increasing u
+    Float sign = simd::select(det < zero, Float(-1.f), Float(1.f));
+    Float tx = (e1x * dv2 - e2x * dv1) * sign, ty = (e1y * dv2 - e2y * dv1) * sign, tz = (e1z * dv2 - e2z * dv1) * sign;
+    Float length = simd::sqrt(simd::dot(tx, ty, tz, tx, ty, tz));
+    simd::Mask valid = (simd::abs(det) > epsilon) & (length > epsilon);
+    Float inverse = Float(1.f) / simd::max(length, epsilon);
+    // corner angles
+    Float l1 = simd::sqrt(simd::dot(e1x, e1y, e1z, e1x, e1y, e1z)), l2 = simd::sqrt(simd::dot(e2x, e2y, e2z, e2x, e2y, e2z));
+    Float e3x = e2x - e1x, e3y = e2y - e1y, e3z = e2z - e1z;
+    Float l3 = simd::sqrt(simd::dot(e3x, e3y, e3z, e3x, e3y, e3z));
+    valid = valid & (l1 * l2 * l3 > zero);
+    auto clamp = [](Float c) { return simd::min(simd::max(c, Float(-1.f)), Float(1.f)); };
+    Float a0 = simd::acos(clamp(simd::dot(e1x, e1y, e1z, e2x, e2y, e2z) / simd::max(l1 * l2, epsilon)));
+    Float a1 = simd::acos(clamp(zero - simd::dot(e1x, e1y, e1z, e3x, e3y, e3z) / simd::max(l1 * l3, epsilon)));
+    Float a2 = simd::max(pi - a0 - a1, zero);
+    (tx * inverse).store(face(TX) + t);
+    (ty * inverse).store(face(TY) + t);
+    (tz * inverse).store(face(TZ) + t);
+    simd::select(valid, a0, zero).store(face(W0) + t);
+    simd::select(valid, a1, zero).store(face(W1) + t);
+    simd::select(valid, a2, zero).store(face(W2) + t);
+  }
+
+  // accumulation on the vertices, in SoA layout (padded for the last SIMD iteration)
+  const size_t paddedVertices = (nbVertices + width - 1) / width * width;
+  std::vector<float> accumulated(3 * paddedVertices, 0.f);
+  float * ax = &accumulated[0];
+  float * ay = ax + paddedVertices;
+  float * az = ay + paddedVertices;
+  size_t nbDegenerate = 0;
+  for (size_t t = 0; t < nbTriangles; t++) {
+    if (face(W0)[t] + face(W1)[t] + face(W2)[t] == 0) {
+      nbDegenerate++;
+      continue;
+    }
+    for (unsigned int c = 0; c < 3; c++) {
+      unsigned int vertex = triangleVertices[3 * t + c];
+      float weight = face(W0 + c)[t];
+      ax[vertex] += weight * face(TX)[t];
+      ay[vertex] += weight * face(TY)[t];
+      az[vertex] += weight * face(TZ)[t];
     }
-    // Set the same tangent for all three vertices of the triangle.
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
   }
 
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 1) {
-    glm::vec3 & n = m_vertexNormals[i];
-    glm::vec3 & t = m_vertexTangents[i];
-    // Gram-Schmidt orthogonalize
-    t = glm::normalize(t - n * glm::dot(n, t));
+  // Gram-Schmidt orthogonalization against the normals. Vertices without any valid contribution (or with
+  // a tangent parallel to the normal) get an arbitrary unit vector orthogonal to the normal.
+  std::vector<float> normals(3 * paddedVertices, 0.f);
+  float * nx = &normals[0];
+  float * ny = nx + paddedVertices;
+  float * nz = ny + paddedVertices;
+  for (size_t k = 0; k < nbVertices; k++) {
+    nx[k] = m_vertexNormals[k].x;
+    ny[k] = m_vertexNormals[k].y;
+    nz[k] = m_vertexNormals[k].z;
+  }
+  for (size_t k = 0; k < paddedVertices; k += width) {
+    Float x = Float::load(ax + k), y = Float::load(ay + k), z = Float::load(az + k);
+    Float n_x = Float::load(nx + k), n_y = Float::load(ny + k), n_z = Float::load(nz + k);
+    Float normalScale = Float(1.f) / simd::max(simd::sqrt(simd::dot(n_x, n_y, n_z, n_x, n_y, n_z)), epsilon);
+    n_x = n_x * normalScale;
+    n_y = n_y * normalScale;
+    n_z = n_z * normalScale;
+    Float accumulatedLength = simd::sqrt(simd::dot(x, y, z, x, y, z));
+    for (int pass = 0; pass < 2; pass++) { // the second pass cancels the rounding errors of nearly parallel vectors
+      Float d = simd::dot(n_x, n_y, n_z, x, y, z);
+      x = x - n_x * d;
+      y = y - n_y * d;
+      z = z - n_z * d;
+    }
+    Float length = simd::sqrt(simd::dot(x, y, z, x, y, z));
+    // fallback: cross(n, X) = (0, nz, -ny), or cross(n, Y) = (-nz, 0, nx) when n is close to X
+    simd::Mask closeToX = simd::abs(n_x) > Float(0.9f);
+    Float fx = simd::select(closeToX, zero - n_z, zero), fy = simd::select(closeToX, zero, n_z), fz = simd::select(closeToX, n_x, zero - n_y);
+    Float fallbackLength = simd::sqrt(simd::dot(fx, fy, fz, fx, fy, fz));
+    simd::Mask degenerate = (length <= Float(1e-3f) * accumulatedLength) | (length <= epsilon);
+    Float scale = Float(1.f) / simd::max(simd::select(degenerate, fallbackLength, length), epsilon);
+    (simd::select(degenerate, fx, x) * scale).store(ax + k);
+    (simd::select(degenerate, fy, y) * scale).store(ay + k);
+    (simd::select(degenerate, fz, z) * scale).store(az + k);
+  }
+  m_vertexTangents.resize(nbVertices);
+  for (size_t k = 0; k < nbVertices; k++) {
+    m_vertexTangents[k] = glm::vec3(ax[k], ay[k], az[k]);
+  }
+  if (nbDegenerate > 0) {
+    std::cout << "Triangles with degenerate uvs : " << nbDegenerate << std::endl;
   }
 }
 
-struct PackedVertexPNTCUV {
+struct PackedVertexPNCUV {
   glm::vec3 position;
   glm::vec3 normal;
-  glm::vec3 tangent;
   glm::vec4 color;
   glm::vec2 uv;
 
-  PackedVertexPNTCUV(const glm::vec3 & position = glm::vec3(), const glm::vec3 & normal = glm::vec3(), const glm::vec3 & tangent = glm::vec3(), const glm::vec4 & color = glm::vec4(1),
-                     const glm::vec2 & uv = glm::vec2())
-      : position(position), normal(normal), tangent(tangent), color(color), uv(uv)
+  PackedVertexPNCUV(const glm::vec3 & position = glm::vec3(), const glm::vec3 & normal = glm::vec3(), const glm::vec4 & color = glm::vec4(1), const glm::vec2 & uv = glm::vec2())
+      : position(position), normal(normal), color(color), uv(uv)
   {
   }
-  bool operator==(const PackedVertexPNTCUV & other) const
+  bool operator==(const PackedVertexPNCUV & other) const
   {
-    return is_near(position, other.position) and is_near(normal, other.normal) and is_near(tangent, other.tangent) and is_near(uv, other.uv) and is_near(color, other.color);
+    return is_near(position, other.position) and is_near(normal, other.normal) and is_near(uv, other.uv) and is_near(color, other.color);
   }
 
   static bool is_near(float v1, float v2, float epsilon = 1e-2) { return fabs(v1 - v2) < epsilon; }
@@ -269,13 +473,13 @@ struct PackedVertexPNTCUV {
 // Template specialization of std::hash
 namespace std
 {
-template <> struct hash<PackedVertexPNTCUV> {
+template <> struct hash<PackedVertexPNCUV> {
 public:
-  std::size_t operator()(const PackedVertexPNTCUV & v) const
+  std::size_t operator()(const PackedVertexPNCUV & v) const
   {
-    std::size_t hashes[] = {std::hash<float>()(v.position.x), std::hash<float>()(v.position.y), std::hash<float>()(v.position.z), std::hash<float>()(v.normal.x),  std::hash<float>()(v.normal.y),
-                            std::hash<float>()(v.normal.z),   std::hash<float>()(v.tangent.x),  std::hash<float>()(v.tangent.y),  std::hash<float>()(v.tangent.z), std::hash<float>()(v.color.x),
-                            std::hash<float>()(v.color.y),    std::hash<float>()(v.color.z),    std::hash<float>()(v.color.w),    std::hash<float>()(v.uv.x),      std::hash<float>()(v.uv.y)};
+    std::size_t hashes[] = {std::hash<float>()(v.position.x), std::hash<float>()(v.position.y), std::hash<float>()(v.position.z), std::hash<float>()(v.normal.x), std::hash<float>()(v.normal.y),
+                            std::hash<float>()(v.normal.z),   std::hash<float>()(v.color.x),    std::hash<float>()(v.color.y),    std::hash<float>()(v.color.z),  std::hash<float>()(v.color.w),
+                            std::hash<float>()(v.uv.x),       std::hash<float>()(v.uv.y)};
     std::size_t seed = 0;
     for (std::size_t h : hashes) {
       // from boost::hash_combine
@@ -288,21 +492,25 @@ public:
 
 void ObjLoader::cleanUpDuplicates()
 {
-  std::vector<unsigned int> cleanIBO;
+  const size_t nbVertices = m_vertexPositions.size();
   std::vector<glm::vec3> cleanPositions;
   std::vector<glm::vec3> cleanNormals;
-  std::vector<glm::vec3> cleanTangents;
   std::vector<glm::vec4> cleanColors;
   std::vector<glm::vec2> cleanUVs;
-  std::unordered_map<PackedVertexPNTCUV, size_t> uniqueVertexIndices;
-  std::vector<size_t> vertexNewIndices;
-  for (size_t k = 0; k < m_vertexPositions.size(); k++) {
+  cleanPositions.reserve(nbVertices);
+  cleanNormals.reserve(nbVertices);
+  cleanColors.reserve(nbVertices);
+  cleanUVs.reserve(nbVertices);
+  std::unordered_map<PackedVertexPNCUV, size_t> uniqueVertexIndices;
+  uniqueVertexIndices.reserve(nbVertices);
+  std::vector<unsigned int> vertexNewIndices;
+  vertexNewIndices.reserve(nbVertices);
+  for (size_t k = 0; k < nbVertices; k++) {
     const glm::vec3 & position = m_vertexPositions[k];
     const glm::vec3 & normal = m_vertexNormals[k];
-    const glm::vec3 & tangent = m_vertexTangents[k];
     const glm::vec4 & color = m_vertexColors[k];
     const glm::vec2 & uv = m_vertexUVs[k];
-    PackedVertexPNTCUV vertex(position, normal, tangent, color, uv);
+    PackedVertexPNCUV vertex(position, normal, color, uv);
     auto uniqueIndexIterator = uniqueVertexIndices.find(vertex);
     bool found = (uniqueIndexIterator != uniqueVertexIndices.end());
     if (found) {
@@ -311,27 +519,184 @@ void ObjLoader::cleanUpDuplicates()
     } else {
       cleanPositions.push_back(position);
       cleanNormals.push_back(normal);
-      cleanTangents.push_back(tangent);
       cleanColors.push_back(color);
       cleanUVs.push_back(uv);
       size_t index = cleanPositions.size() - 1;
-      uniqueVertexIndices[vertex] = index;
+      uniqueVertexIndices.emplace(vertex, index);
       vertexNewIndices.push_back(index);
     }
   }
   for (auto & ibo : m_ibos) {
-    std::vector<unsigned int> cleanIBO;
-    for (unsigned int oldIndex : ibo) {
-      cleanIBO.push_back(vertexNewIndices[oldIndex]);
+    for (unsigned int & index : ibo) {
+      index = vertexNewIndices[index];
+    }
+  }
+  std::cout << "Old size : " << nbVertices << "\nNew size : " << cleanPositions.size() << std::endl;
+  // the welded arrays are moved in, and shrunk as they are kept until the geometry is released
+  cleanPositions.shrink_to_fit();
+  cleanNormals.shrink_to_fit();
+  cleanColors.shrink_to_fit();
+  cleanUVs.shrink_to_fit();
+  m_vertexPositions = std::move(cleanPositions);
+  m_vertexNormals = std::move(cleanNormals);
+  m_vertexColors = std::move(cleanColors);
+  m_vertexUVs = std::move(cleanUVs);
+}
+
+void ObjLoader::optimizeMesh()
+{
+  const size_t nbVertices = m_vertexPositions.size();
+  VertexCacheStatistics before;
+  for (const auto & ibo : m_ibos) {
+    before += analyzeVertexCache(ibo, nbVertices);
+  }
+
+  if (m_options.optimizeVertexCache) {
+    for (auto & ibo : m_ibos) {
+      std::vector<unsigned int> clusters;
+      ibo = optimizeVertexCache(ibo, nbVertices, 16, &clusters);
+      if (m_options.optimizeOverdraw) {
+        ibo = optimizeOverdraw(ibo, m_vertexPositions, clusters);
+      }
+    }
+  }
+
+  VertexCacheStatistics after;
+  for (const auto & ibo : m_ibos) {
+    after += analyzeVertexCache(ibo, nbVertices);
+  }
+  std::cout << "ACMR : " << before.acmr << " -> " << after.acmr << "\nATVR : " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+void ObjLoader::computeBounds()
+{
+  m_boundingSphere = BoundingSphere::fromPoints(m_vertexPositions);
+  m_boundingBox = BoundingBox::fromPoints(m_vertexPositions);
+  m_partBoundingSpheres.clear();
+  m_partBoundingBoxes.clear();
+  for (const auto & ibo : m_ibos) {
+    // the coarser levels of detail only reference vertices of the full resolution IBO
+    m_partBoundingSpheres.push_back(ibo.empty() ? BoundingSphere() : BoundingSphere::fromPoints(m_vertexPositions, ibo));
+    m_partBoundingBoxes.push_back(ibo.empty() ? BoundingBox() : BoundingBox::fromPoints(m_vertexPositions, ibo));
+  }
+}
+
+void ObjLoader::generateLODs()
+{
+  m_lods.resize(m_ibos.size());
+  m_lodIBOs.assign(m_ibos.size(), IBO());
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    m_lods[k].assign(1, LevelOfDetail(0, m_ibos[k].size()));
+  }
+  if (m_options.nbLODs <= 1) {
+    return;
+  }
+
+  // Vertices on UV seams (several vertices sharing a position) and on material boundaries are
+  // locked, so that the simplified IBOs do not open cracks in the surface.
+  std::vector<bool> locked(m_vertexPositions.size(), false);
+  std::vector<unsigned int> byPosition(m_vertexPositions.size());
+  std::iota(byPosition.begin(), byPosition.end(), 0);
+  auto lexicographic = [this](unsigned int a, unsigned int b) {
+    const glm::vec3 & pa = m_vertexPositions[a];
+    const glm::vec3 & pb = m_vertexPositions[b];
+    return pa.x < pb.x or (pa.x == pb.x and (pa.y < pb.y or (pa.y == pb.y and pa.z < pb.z)));
+  };
+  std::sort(byPosition.begin(), byPosition.end(), lexicographic);
+  for (size_t k = 1; k < byPosition.size(); k++) {
+    if (m_vertexPositions[byPosition[k]] == m_vertexPositions[byPosition[k - 1]]) {
+      locked[byPosition[k]] = locked[byPosition[k - 1]] = true;
+    }
+  }
+  std::vector<int> vertexMaterial(m_vertexPositions.size(), -1);
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    for (unsigned int index : m_ibos[k]) {
+      if (vertexMaterial[index] >= 0 and vertexMaterial[index] != int(k)) {
+        locked[index] = true;
+      }
+      vertexMaterial[index] = k;
+    }
+  }
+
+  const float maxError = 0.1f * m_boundingSphere.radius;
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    // the levels are appended to a copy of the full resolution IBO, which ibo() keeps returning
+    IBO & lodIBO = m_lodIBOs[k];
+    IBO level(m_ibos[k]);
+    while (m_lods[k].size() < m_options.nbLODs) {
+      float error;
+      IBO simplified = simplifyMesh(m_vertexPositions, level, locked, level.size() / 2, maxError, &error);
+      if (simplified.empty() or simplified.size() > 0.9 * level.size()) {
+        break; // not worth another level
+      }
+      level = optimizeVertexCache(simplified, m_vertexPositions.size());
+      if (lodIBO.empty()) {
+        lodIBO = m_ibos[k];
+      }
+      m_lods[k].push_back(LevelOfDetail(lodIBO.size(), level.size(), error));
+      lodIBO.insert(lodIBO.end(), level.begin(), level.end());
+    }
+    if (m_lods[k].size() > 1) {
+      std::cout << "LODs of " << m_materials[k].name << " :";
+      for (const auto & lod : m_lods[k]) {
+        std::cout << " " << lod.count / 3;
+      }
+      std::cout << " triangles" << std::endl;
+    }
+  }
+}
+
+void ObjLoader::optimizeVertexFetch()
+{
+  if (not m_options.optimizeVertexFetch) {
+    return;
+  }
+  size_t nbUsed;
+  // the coarser levels of detail only reference vertices of the full resolution IBOs
+  std::vector<unsigned int> remap = computeVertexFetchRemap(m_ibos, m_vertexPositions.size(), nbUsed);
+  for (auto & ibo : m_ibos) {
+    for (unsigned int & index : ibo) {
+      index = remap[index];
+    }
+  }
+  for (auto & ibo : m_lodIBOs) {
+    for (unsigned int & index : ibo) {
+      index = remap[index];
+    }
+  }
+  remapVertexAttribute(m_vertexPositions, remap, nbUsed);
+  remapVertexAttribute(m_vertexNormals, remap, nbUsed);
+  remapVertexAttribute(m_vertexTangents, remap, nbUsed);
+  remapVertexAttribute(m_vertexColors, remap, nbUsed);
+  remapVertexAttribute(m_vertexUVs, remap, nbUsed);
+}
+
+void ObjLoader::generateMeshlets()
+{
+  m_meshlets.assign(m_ibos.size(), std::vector<Meshlet>());
+  if (not m_options.buildMeshlets) {
+    return;
+  }
+  // the back faces of an open mesh may be visible (they are not culled by the GPU), hence so are its
+  // meshlets facing away from the camera: their cones are reset so that they are never culled
+  std::vector<unsigned int> triangles;
+  for (const auto & ibo : m_ibos) {
+    triangles.insert(triangles.end(), ibo.begin(), ibo.end());
+  }
+  const bool closed = isClosed(triangles, m_vertexPositions);
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    for (auto & lod : m_lods[k]) {
+      std::vector<Meshlet> meshlets = buildMeshlets(lodIBO(k), m_vertexPositions, lod.offset, lod.offset + lod.count);
+      if (not closed) {
+        for (auto & meshlet : meshlets) {
+          meshlet.cone = NormalCone();
+        }
+      }
+      lod.firstMeshlet = m_meshlets[k].size();
+      lod.nbMeshlets = meshlets.size();
+      m_meshlets[k].insert(m_meshlets[k].end(), meshlets.begin(), meshlets.end());
     }
-    ibo = cleanIBO;
   }
-  std::cout << "Old size : " << m_vertexPositions.size() << "\nNew size : " << cleanPositions.size() << std::endl;
-  m_vertexPositions = cleanPositions;
-  m_vertexNormals = cleanNormals;
-  m_vertexTangents = cleanTangents;
-  m_vertexColors = cleanColors;
-  m_vertexUVs = cleanUVs;
 }
 
 bool ObjLoader::NamedTextureImages::find(const std::string & name) const
@@ -352,14 +717,3 @@ Image<> ObjLoader::NamedTextureImages::operator[](const std::string & name) cons
   }
   return Image<>(white, 1, 1, 4);
 }
-
-ObjLoader::NamedTextureImages::~NamedTextureImages()
-{
-  for (auto namedImage : m_images) {
-    if (namedImage.first == defaultDiffuseName or namedImage.first == defaultNormalName) {
-      continue;
-    }
-    unsigned char * imgData = namedImage.second.data;
-    stbi_image_free(imgData);
-  }
-}
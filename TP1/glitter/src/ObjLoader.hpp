@@ -1,11 +1,15 @@
 #ifndef __OBJLOADER_H__
 #define __OBJLOADER_H__
+#include <future>
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "Bounds.hpp"
 #include "Image.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
 #include "SimpleMaterial.hpp"
 #include "tiny_obj_loader.h"
 typedef unsigned int uint;
@@ -22,6 +26,9 @@ typedef unsigned int uint;
  *		+ diffuse texture map (map_Ka)
  *		+ normal texture map (norm)
  *	+ per face material affectations
+ *	+ post-transform vertex cache, overdraw and vertex fetch optimizations
+ *	+ levels of detail (simplified versions of the IBOs)
+ *	+ meshlets (small clusters of triangles with bounds for culling)
  *
  * @note the class exposes vertex attributes as vectors of glm::vec, and faces as
  * IBOs (vectors of indices). One IBO is created per material, so that all faces
@@ -31,14 +38,30 @@ typedef unsigned int uint;
  */
 class ObjLoader {
 public:
+  /**
+   * @brief Optional processing steps applied to the geometry after parsing
+   */
+  struct Options {
+    bool optimizeVertexCache; ///< reorders the triangles of each IBO for post-transform vertex cache hits
+    bool optimizeOverdraw;    ///< reorders clusters of triangles so that outward facing ones are drawn first (requires optimizeVertexCache)
+    bool optimizeVertexFetch; ///< reorders the vertices in the order they are first referenced by the IBOs
+    unsigned int nbLODs;      ///< maximal number of levels of detail (including the full resolution one)
+    bool buildMeshlets;       ///< splits every level of detail into meshlets of at most 64 vertices and 124 triangles (backface culled only if the mesh is closed)
+    bool decodeImages;        ///< decodes the images of the materials (otherwise, only their file names are available, see imageFilename())
+
+    /// Default constructor (cache and fetch optimizations only)
+    Options() : optimizeVertexCache(true), optimizeOverdraw(false), optimizeVertexFetch(true), nbLODs(1), buildMeshlets(false), decodeImages(true) {}
+  };
+
   /**
    * @brief Constructor from a wavefront filename
    * @param filename the file to be parsed.
+   * @param options the optional processing steps
    *
    * The parsing is performed at construction time.
    * Then all the exposed attributes are accessible through getters.
    */
-  ObjLoader(const std::string & filename);
+  ObjLoader(const std::string & filename, const Options & options = Options());
 
   /**
    * @brief getter for vertex positions
@@ -73,10 +96,61 @@ public:
   /**
    * @brief getter for a given IBO
    * @param materialIndex index of the material associated with the desired IBO.
-   * @return
+   * @return the triangle list of the full resolution mesh (the finest level of detail)
    */
   const std::vector<unsigned int> & ibo(unsigned int materialIndex = 0) const;
 
+  /**
+   * @brief getter for the IBO of all the levels of detail of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the triangle lists of the levels of detail one after the other (see lods()), the same as ibo() without coarser levels
+   *
+   * @note Drawing it entirely would draw every level, only the ranges of lods() are meant to be drawn.
+   */
+  const std::vector<unsigned int> & lodIBO(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for the levels of detail of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the index ranges of lodIBO() corresponding to each level of detail, from the finest to the coarsest
+   *
+   * Without levels of detail (see Options::nbLODs), there is a single range covering the whole IBO.
+   */
+  const std::vector<LevelOfDetail> & lods(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for the meshlets of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the meshlets of all the levels of detail (see LevelOfDetail::firstMeshlet), empty if Options::buildMeshlets is not set
+   */
+  const std::vector<Meshlet> & meshlets(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for the bounding sphere of the mesh
+   * @return a sphere enclosing all the vertex positions (in object space)
+   */
+  const BoundingSphere & boundingSphere() const;
+
+  /**
+   * @brief getter for the bounding box of the mesh
+   * @return the axis aligned box enclosing all the vertex positions (in object space)
+   */
+  const BoundingBox & boundingBox() const;
+
+  /**
+   * @brief getter for the bounding sphere of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return a sphere enclosing the vertices referenced by the IBO (in object space, empty for an empty IBO)
+   */
+  const BoundingSphere & partBoundingSphere(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for the bounding box of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the axis aligned box enclosing the vertices referenced by the IBO (in object space, empty for an empty IBO)
+   */
+  const BoundingBox & partBoundingBox(unsigned int materialIndex = 0) const;
+
   /**
    * @brief getter for the materials
    * @return the list of materials.
@@ -90,6 +164,22 @@ public:
    */
   Image<> image(const std::string & name) const;
 
+  /**
+   * @brief provides the file of an image referenced in the materials
+   * @param name an alias for the image
+   * @return the absolute name of the file, empty for the default images (which have no file)
+   */
+  std::string imageFilename(const std::string & name) const;
+
+  /**
+   * @brief frees the vertex attributes and the IBOs
+   *
+   * To be called once the geometry has been uploaded to the GPU, so that the CPU copy does not
+   * outlive the upload. The attribute getters, ibo() and lodIBO() then return empty vectors, while the
+   * materials, images, levels of detail, meshlets and bounds remain available.
+   */
+  void release();
+
   /**
    * @brief provides the number of IBOs available after parsing
    * @return the number of IBOS.
@@ -106,8 +196,6 @@ private:
     void add(const std::string & name, const Image<> & image);
     Image<> operator[](const std::string & name) const;
 
-    ~NamedTextureImages();
-
   private:
     std::unordered_map<std::string, Image<>> m_images;
   };
@@ -116,8 +204,14 @@ private:
   void parseFile(const std::string & filename);
   void cleanUpDuplicates();
   void computeTangents();
+  void computeBounds();
+  void optimizeMesh();
+  void generateLODs();
+  void optimizeVertexFetch();
+  void generateMeshlets();
 
 private:
+  Options m_options;
   std::string m_rootDir;
   std::vector<glm::vec3> m_vertexPositions;
   std::vector<glm::vec4> m_vertexColors;
@@ -126,9 +220,23 @@ private:
   std::vector<glm::vec3> m_vertexTangents;
   typedef std::vector<unsigned int> IBO;
   std::vector<IBO> m_ibos;
+  std::vector<IBO> m_lodIBOs; // empty for the IBOs without coarser levels of detail
+  std::vector<std::vector<LevelOfDetail>> m_lods;
+  std::vector<std::vector<Meshlet>> m_meshlets;
+  BoundingSphere m_boundingSphere;
+  BoundingBox m_boundingBox;
+  std::vector<BoundingSphere> m_partBoundingSpheres;
+  std::vector<BoundingBox> m_partBoundingBoxes;
   NamedTextureImages m_images;
   std::vector<SimpleMaterial> m_materials;
-  void loadImage(std::string texture_filename);
+  /// An image being decoded
+  struct PendingImage {
+    std::string name;           ///< texture name, as given in the material file
+    std::string filename;       ///< image file
+    std::future<Image<>> image; ///< the decoded image
+  };
+  std::vector<PendingImage> decodeImages(const std::vector<std::string> & names);
+  void addImages(std::vector<PendingImage> & pendingImages);
   static unsigned char white[4];
   static unsigned char bluish[4];
   static std::string defaultDiffuseName;
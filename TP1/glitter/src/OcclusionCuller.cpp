@@ -0,0 +1,243 @@
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "Simd.hpp"
+
+namespace
+{
+using simd::Float;
+
+/// smallest w of a vertex in front of the camera (the triangles and boxes closer to the eye are not culled)
+const float minW = 1e-5f;
+
+/// rounds @p value up to a multiple of the tile size
+unsigned int tiled(unsigned int value)
+{
+  const unsigned int tileSize = OcclusionCuller::tileSize;
+  return std::max((value + tileSize - 1) / tileSize, 1u) * tileSize;
+}
+
+/// the offsets of the lanes of a register (0, 1, ..., width - 1)
+Float laneOffsets()
+{
+  float offsets[Float::width];
+  for (int k = 0; k < Float::width; k++) {
+    offsets[k] = k;
+  }
+  return Float::load(offsets);
+}
+} // namespace
+
+std::shared_ptr<OccluderMesh> OccluderMesh::fromTriangles(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, size_t maxTriangles)
+{
+  if (indices.empty() or indices.size() > 3 * maxTriangles) {
+    return nullptr;
+  }
+  std::shared_ptr<OccluderMesh> mesh(new OccluderMesh);
+  mesh->indices.reserve(indices.size());
+  std::unordered_map<unsigned int, unsigned int> remap;
+  for (unsigned int index : indices) {
+    auto inserted = remap.insert(std::make_pair(index, unsigned(mesh->positions.size())));
+    if (inserted.second) {
+      mesh->positions.push_back(positions[index]);
+    }
+    mesh->indices.push_back(inserted.first->second);
+  }
+  return mesh;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height) : m_width(0), m_height(0), m_viewProj(1)
+{
+  resize(width, height);
+}
+
+void OcclusionCuller::resize(unsigned int width, unsigned int height)
+{
+  m_width = tiled(width);
+  m_height = tiled(height);
+  m_depths.assign(m_width * m_height, 1.f);
+  m_tileDepths.assign((m_width / tileSize) * (m_height / tileSize), 1.f);
+}
+
+void OcclusionCuller::begin(const glm::mat4 & viewProj)
+{
+  m_viewProj = viewProj;
+  m_occluders.clear();
+  m_stats = Statistics();
+}
+
+void OcclusionCuller::addOccluder(const OccluderMesh & mesh, const glm::mat4 & modelWorld)
+{
+  Occluder occluder;
+  occluder.mesh = &mesh;
+  occluder.mvp = m_viewProj * modelWorld;
+  occluder.firstTriangle = m_occluders.empty() ? 0 : m_occluders.back().firstTriangle + m_occluders.back().mesh->indices.size() / 3;
+  m_occluders.push_back(occluder);
+}
+
+void OcclusionCuller::setup(const Occluder & occluder, size_t begin, size_t end)
+{
+  const std::vector<glm::vec3> & positions = occluder.mesh->positions;
+  const std::vector<unsigned int> & indices = occluder.mesh->indices;
+  const glm::vec2 viewport(m_width, m_height);
+  for (size_t t = begin; t < end; t++) {
+    ScreenTriangle & triangle = m_triangles[occluder.firstTriangle + t];
+    triangle.minX = triangle.minY = 0;
+    triangle.maxX = triangle.maxY = -1;
+    glm::vec3 screen[3];
+    bool clipped = false;
+    for (int v = 0; v < 3; v++) {
+      glm::vec4 clip = occluder.mvp * glm::vec4(positions[indices[3 * t + v]], 1);
+      clipped = clipped or clip.w < minW;
+      screen[v] = glm::vec3((0.5f * glm::vec2(clip) / clip.w + 0.5f) * viewport, 0.5f * clip.z / clip.w + 0.5f);
+    }
+    // the triangles crossing the near plane are skipped, as are the degenerate ones
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+    if (clipped or std::abs(area) < 1e-6f) {
+      continue;
+    }
+    // both orientations are rasterized, as the occluders may not be closed
+    if (area < 0) {
+      std::swap(screen[1], screen[2]);
+      area = -area;
+    }
+    glm::vec3 lower = glm::min(glm::min(screen[0], screen[1]), screen[2]);
+    glm::vec3 upper = glm::max(glm::max(screen[0], screen[1]), screen[2]);
+    triangle.minX = std::max(int(std::floor(lower.x)), 0);
+    triangle.minY = std::max(int(std::floor(lower.y)), 0);
+    triangle.maxX = std::min(int(std::ceil(upper.x)), int(m_width) - 1);
+    triangle.maxY = std::min(int(std::ceil(upper.y)), int(m_height) - 1);
+    for (int e = 0; e < 3; e++) {
+      const glm::vec3 & a = screen[e];
+      const glm::vec3 & b = screen[(e + 1) % 3];
+      triangle.edges[e] = glm::vec3(a.y - b.y, b.x - a.x, (b.y - a.y) * a.x - (b.x - a.x) * a.y);
+    }
+    const glm::vec3 d1 = screen[1] - screen[0], d2 = screen[2] - screen[0];
+    float a = (d1.z * d2.y - d2.z * d1.y) / area;
+    float b = (d1.x * d2.z - d2.x * d1.z) / area;
+    triangle.depth = glm::vec3(a, b, screen[0].z - a * screen[0].x - b * screen[0].y);
+  }
+}
+
+void OcclusionCuller::rasterize(ThreadPool & pool)
+{
+  const size_t nbTriangles = m_occluders.empty() ? 0 : m_occluders.back().firstTriangle + m_occluders.back().mesh->indices.size() / 3;
+  m_triangles.resize(nbTriangles);
+  m_stats.nbTriangles = nbTriangles;
+  pool.parallelFor(
+      nbTriangles,
+      [&](size_t begin, size_t end) {
+        for (const auto & occluder : m_occluders) {
+          const size_t first = occluder.firstTriangle, last = first + occluder.mesh->indices.size() / 3;
+          if (first < end and begin < last) {
+            setup(occluder, std::max(begin, first) - first, std::min(end, last) - first);
+          }
+        }
+      },
+      1024);
+  // one band per row of tiles
+  pool.parallelFor(m_height / tileSize, [&](size_t begin, size_t end) { rasterizeBand(begin * tileSize, end * tileSize); });
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int firstRow, unsigned int endRow)
+{
+  std::fill(m_depths.begin() + firstRow * m_width, m_depths.begin() + endRow * m_width, 1.f);
+  const Float lanes = laneOffsets();
+  for (const auto & triangle : m_triangles) {
+    const int minY = std::max(triangle.minY, int(firstRow)), maxY = std::min(triangle.maxY, int(endRow) - 1);
+    if (triangle.minX > triangle.maxX or minY > maxY) {
+      continue;
+    }
+    const int firstX = triangle.minX / Float::width * Float::width;
+    for (int y = minY; y <= maxY; y++) {
+      float * row = m_depths.data() + y * m_width;
+      const Float py(y + 0.5f);
+      for (int x = firstX; x <= triangle.maxX; x += Float::width) {
+        // pixel centers of the block, the width of the buffer being a multiple of the register width
+        const Float px = Float(x + 0.5f) + lanes;
+        simd::Mask inside = Float(triangle.edges[0].x) * px + Float(triangle.edges[0].y) * py + Float(triangle.edges[0].z) >= Float(0);
+        for (int e = 1; e < 3; e++) {
+          inside = inside & (Float(triangle.edges[e].x) * px + Float(triangle.edges[e].y) * py + Float(triangle.edges[e].z) >= Float(0));
+        }
+        if (simd::bits(inside) == 0) {
+          continue;
+        }
+        const Float z = Float(triangle.depth.x) * px + Float(triangle.depth.y) * py + Float(triangle.depth.z);
+        const Float depths = Float::load(row + x);
+        simd::select(inside, simd::min(depths, z), depths).store(row + x);
+      }
+    }
+  }
+  // farthest depth of each tile
+  const unsigned int nbTilesX = m_width / tileSize;
+  for (unsigned int tileY = firstRow / tileSize; tileY < endRow / tileSize; tileY++) {
+    for (unsigned int tileX = 0; tileX < nbTilesX; tileX++) {
+      float farthest = 0;
+      for (unsigned int y = tileY * tileSize; y < (tileY + 1) * tileSize; y++) {
+        const float * row = m_depths.data() + y * m_width + tileX * tileSize;
+        farthest = std::max(farthest, *std::max_element(row, row + tileSize));
+      }
+      m_tileDepths[tileY * nbTilesX + tileX] = farthest;
+    }
+  }
+}
+
+bool OcclusionCuller::visible(const BoundingBox & box) const
+{
+  if (box.empty()) {
+    return false;
+  }
+  glm::vec3 lower(m_width, m_height, 1), upper(-1, -1, 0);
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec3 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+    glm::vec4 clip = m_viewProj * glm::vec4(position, 1);
+    if (clip.w < minW) {
+      return true; // the box crosses the near plane
+    }
+    glm::vec3 screen((0.5f * glm::vec2(clip) / clip.w + 0.5f) * glm::vec2(m_width, m_height), 0.5f * clip.z / clip.w + 0.5f);
+    lower = glm::min(lower, screen);
+    upper = glm::max(upper, screen);
+  }
+  // the pixels overlapped by the projected box
+  const int minX = std::max(int(std::floor(lower.x)), 0), maxX = std::min(int(std::floor(upper.x)), int(m_width) - 1);
+  const int minY = std::max(int(std::floor(lower.y)), 0), maxY = std::min(int(std::floor(upper.y)), int(m_height) - 1);
+  if (minX > maxX or minY > maxY or lower.z <= 0) {
+    return true; // out of the screen (left to the frustum culling) or in front of the near plane
+  }
+  const float nearest = lower.z;
+  const unsigned int nbTilesX = m_width / tileSize;
+  for (int tileY = minY / int(tileSize); tileY <= maxY / int(tileSize); tileY++) {
+    for (int tileX = minX / int(tileSize); tileX <= maxX / int(tileSize); tileX++) {
+      if (m_tileDepths[tileY * nbTilesX + tileX] < nearest) {
+        continue; // the whole tile hides the box
+      }
+      for (int y = std::max(minY, tileY * int(tileSize)); y <= std::min(maxY, (tileY + 1) * int(tileSize) - 1); y++) {
+        const float * row = m_depths.data() + y * m_width;
+        for (int x = std::max(minX, tileX * int(tileSize)); x <= std::min(maxX, (tileX + 1) * int(tileSize) - 1); x++) {
+          if (row[x] >= nearest) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+unsigned int OcclusionCuller::cull(const BoundingBox * boxes, size_t count, unsigned char * visible)
+{
+  unsigned int nbOccluded = 0;
+  for (size_t k = 0; k < count; k++) {
+    if (not visible[k]) {
+      continue;
+    }
+    m_stats.nbTested++;
+    if (not this->visible(boxes[k])) {
+      visible[k] = 0;
+      nbOccluded++;
+    }
+  }
+  m_stats.nbOccluded += nbOccluded;
+  return nbOccluded;
+}
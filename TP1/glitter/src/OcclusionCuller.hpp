@@ -0,0 +1,144 @@
+/** @file */
+#ifndef __OCCLUSION_CULLER_H__
+#define __OCCLUSION_CULLER_H__
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include "Bounds.hpp"
+#include "ThreadPool.hpp"
+
+/// A triangle mesh rasterized as an occluder (it must not cover more than the object it stands for, e.g. a subset of its triangles)
+struct OccluderMesh {
+  std::vector<glm::vec3> positions;  ///< vertex positions (in object space)
+  std::vector<unsigned int> indices; ///< triangle list
+
+  /**
+   * @brief extracts an occluder from a triangle list (e.g. the largest triangles of an object)
+   * @param positions the vertex positions
+   * @param indices the triangle list
+   * @param maxTriangles the maximal number of triangles of the occluder
+   * @return the occluder, holding only the referenced vertices, null if it has no triangle or more than @p maxTriangles
+   */
+  static std::shared_ptr<OccluderMesh> fromTriangles(const std::vector<glm::vec3> & positions, const std::vector<unsigned int> & indices, size_t maxTriangles);
+};
+
+/**
+ * @brief Occlusion culling by a low resolution depth buffer rasterized on the CPU
+ *
+ * Every frame, the occluders are rasterized into a small depth buffer (the triangles crossing the near
+ * plane are skipped, which is conservative). The rows of the buffer are split into bands of tiles which
+ * are rasterized concurrently, each thread testing simd::Float::width pixels at a time. The farthest depth
+ * of each tile of tileSize x tileSize pixels is then kept, as a second level of the buffer.
+ *
+ * The bounding boxes of the objects are then tested against the buffer: a box is hidden when its nearest
+ * depth lies behind the depth of all the pixels it covers on screen. The test first reads the tiles, and
+ * only reads the pixels of the tiles whose farthest depth does not hide the box.
+ *
+ * The culling is conservative as long as the occluders lie inside the objects they stand for: a simplified
+ * level of detail may bulge out of the surface of its object, and hide the objects just behind it. An object
+ * does not hide itself as long as its occluder lies in its bounding box.
+ *
+ * Usage, once per frame: begin(), addOccluder() for each occluder, rasterize(), then cull().
+ */
+class OcclusionCuller {
+public:
+  static const unsigned int tileSize = 8; ///< width and height of the tiles (in pixels)
+
+  /// Statistics of the last frame
+  struct Statistics {
+    unsigned int nbTriangles; ///< occluder triangles rasterized
+    unsigned int nbTested;    ///< boxes tested
+    unsigned int nbOccluded;  ///< boxes found hidden
+
+    Statistics() : nbTriangles(0), nbTested(0), nbOccluded(0) {}
+  };
+
+  /**
+   * @brief Constructor
+   * @param width the width of the depth buffer (rounded up to a multiple of tileSize)
+   * @param height the height of the depth buffer (rounded up to a multiple of tileSize)
+   */
+  OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+  /// changes the resolution of the depth buffer (rounded up to multiples of tileSize)
+  void resize(unsigned int width, unsigned int height);
+
+  /// width of the depth buffer
+  unsigned int width() const { return m_width; }
+
+  /// height of the depth buffer
+  unsigned int height() const { return m_height; }
+
+  /**
+   * @brief starts a frame, removing the occluders of the previous one
+   * @param viewProj the projection matrix multiplied by the worldView matrix
+   */
+  void begin(const glm::mat4 & viewProj);
+
+  /**
+   * @brief adds an occluder to the frame
+   * @param mesh the occluder (it must outlive the call to rasterize())
+   * @param modelWorld the modelWorld matrix of the occluder
+   */
+  void addOccluder(const OccluderMesh & mesh, const glm::mat4 & modelWorld);
+
+  /**
+   * @brief rasterizes the occluders into the depth buffer
+   * @param pool the threads sharing the rasterization (the calling one included)
+   */
+  void rasterize(ThreadPool & pool = ThreadPool::global());
+
+  /**
+   * @brief tests a box against the depth buffer
+   * @param box the box (in world space)
+   * @return false if the box is hidden by the occluders
+   */
+  bool visible(const BoundingBox & box) const;
+
+  /**
+   * @brief tests a batch of boxes against the depth buffer
+   * @param boxes the boxes (in world space)
+   * @param count the number of boxes
+   * @param visible for each box, set to 0 if it is hidden (the boxes already flagged 0 are not tested)
+   * @return the number of boxes found hidden
+   */
+  unsigned int cull(const BoundingBox * boxes, size_t count, unsigned char * visible);
+
+  /// depth of a pixel, in [0, 1] (1 where no occluder was rasterized)
+  float depth(unsigned int x, unsigned int y) const { return m_depths[y * m_width + x]; }
+
+  /// statistics of the current frame
+  const Statistics & statistics() const { return m_stats; }
+
+private:
+  /// a triangle in screen space, as set up for the rasterization
+  struct ScreenTriangle {
+    int minX, maxX, minY, maxY; ///< bounding rectangle of the covered pixels (inclusive)
+    glm::vec3 edges[3];         ///< edge functions a * x + b * y + c, positive inside
+    glm::vec3 depth;            ///< depth plane a * x + b * y + c
+  };
+
+  /// an occluder of the current frame
+  struct Occluder {
+    const OccluderMesh * mesh; ///< the mesh
+    glm::mat4 mvp;             ///< its model-view-projection matrix
+    size_t firstTriangle;      ///< index of its first triangle in m_triangles
+  };
+
+  /// sets up the triangles [begin, end) of an occluder (the invalid ones get an empty rectangle)
+  void setup(const Occluder & occluder, size_t begin, size_t end);
+
+  /// rasterizes the triangles into the rows [firstRow, endRow) of the buffer, then computes their tiles
+  void rasterizeBand(unsigned int firstRow, unsigned int endRow);
+
+  unsigned int m_width;                    ///< width of the depth buffer
+  unsigned int m_height;                   ///< height of the depth buffer
+  glm::mat4 m_viewProj;                    ///< projection of the current frame
+  std::vector<float> m_depths;             ///< depth of the pixels, row by row
+  std::vector<float> m_tileDepths;         ///< farthest depth of each tile, row by row
+  std::vector<Occluder> m_occluders;       ///< occluders of the current frame
+  std::vector<ScreenTriangle> m_triangles; ///< triangles of the occluders
+  Statistics m_stats;                      ///< statistics of the current frame
+};
+
+#endif // !defined(__OCCLUSION_CULLER_H__)
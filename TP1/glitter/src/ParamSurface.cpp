@@ -0,0 +1,62 @@
+#include "ParamSurface.hpp"
+#include <algorithm>
+
+void tessellateIndices(unsigned int nbPhi, unsigned int nbTheta, bool isCyclicInPhi, bool isCyclicInTheta, const TessellationOptions & options, std::vector<unsigned int> & indices)
+{
+  indices.clear();
+  if (nbPhi < 2 or nbTheta < 2) {
+    return;
+  }
+  // rows and columns of quads
+  const size_t nbRows = isCyclicInPhi ? nbPhi : nbPhi - 1;
+  const size_t nbColumns = isCyclicInTheta ? nbTheta : nbTheta - 1;
+  auto index = [&](size_t kPhi, size_t kTheta) { return static_cast<unsigned int>((kPhi % nbPhi) * nbTheta + (kTheta % nbTheta)); };
+
+  // a strip zigzags between the rows kPhi and kPhi + 1, a reversed one starting with a degenerate triangle
+  // so that its triangles keep the diagonals of the non reversed ones
+  const size_t stripSize = 2 * (nbColumns + 1) + (options.reverseWinding ? 1 : 0);
+  const size_t rowSize = options.strips ? stripSize + 1 : 6 * nbColumns;
+  indices.resize(nbRows * rowSize - (options.strips ? 1 : 0)); // no restart after the last strip
+  ThreadPool & pool = options.pool ? *options.pool : ThreadPool::global();
+  pool.parallelFor(
+      nbRows,
+      [&](size_t begin, size_t end) {
+        for (size_t kPhi = begin; kPhi < end; kPhi++) {
+          unsigned int * row = indices.data() + kPhi * rowSize;
+          if (options.strips) {
+            if (options.reverseWinding) {
+              *row++ = index(kPhi, 0);
+            }
+            for (size_t kTheta = 0; kTheta <= nbColumns; kTheta++) {
+              *row++ = index(kPhi, kTheta);
+              *row++ = index(kPhi + 1, kTheta);
+            }
+            if (kPhi + 1 < nbRows) {
+              *row = primitiveRestartIndex;
+            }
+            continue;
+          }
+          for (size_t kTheta = 0; kTheta < nbColumns; kTheta++) {
+            const unsigned int a = index(kPhi, kTheta), b = index(kPhi + 1, kTheta), c = index(kPhi, kTheta + 1), d = index(kPhi + 1, kTheta + 1);
+            const unsigned int triangles[2][6] = {{a, b, c, c, b, d}, {a, c, b, b, c, d}};
+            row = std::copy(triangles[options.reverseWinding], triangles[options.reverseWinding] + 6, row);
+          }
+        }
+      },
+      std::max<size_t>(1, 4096 / nbColumns));
+}
+
+void tessellatePatches(unsigned int nbPhi, unsigned int nbTheta, std::vector<unsigned int> & indices)
+{
+  indices.clear();
+  if (nbPhi < 2 or nbTheta < 2) {
+    return;
+  }
+  indices.reserve(4 * size_t(nbPhi - 1) * (nbTheta - 1));
+  for (unsigned int kPhi = 0; kPhi + 1 < nbPhi; kPhi++) {
+    for (unsigned int kTheta = 0; kTheta + 1 < nbTheta; kTheta++) {
+      const unsigned int patch[] = {kPhi * nbTheta + kTheta, (kPhi + 1) * nbTheta + kTheta, (kPhi + 1) * nbTheta + kTheta + 1, kPhi * nbTheta + kTheta + 1};
+      indices.insert(indices.end(), patch, patch + 4);
+    }
+  }
+}
@@ -0,0 +1,188 @@
+/** @file */
+#ifndef __PARAM_SURFACE_H__
+#define __PARAM_SURFACE_H__
+#include <GL/glew.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <vector>
+#include "ThreadPool.hpp"
+
+/// a simple struct for discrete linear range of the form {minVal, minVal+delta,...,minVal+length}
+struct DiscreteLinRange {
+  unsigned int nbVals; ///< the number of values in the range
+  float minVal;        ///< the minimum value of the range
+  float length;        ///< the lengh (max -min) of the range
+
+  /// Constructor
+  DiscreteLinRange(unsigned int nbVals, float minVal, float length) : nbVals(nbVals), minVal(minVal), length(length) {}
+
+  /// Returns the k^{th} value of the range
+  float value(unsigned int k) const { return minVal + k * length / (nbVals - 1); }
+};
+
+/// IBO value separating the triangle strips (see glPrimitiveRestartIndex)
+const unsigned int primitiveRestartIndex = 0xffffffffu;
+
+/// Options of tessellate()
+struct TessellationOptions {
+  bool strips;         ///< one triangle strip per row of quads, the rows being separated by primitiveRestartIndex (two triangles per quad otherwise)
+  bool normals;        ///< computes the unit normals
+  bool reverseWinding; ///< front faces on the side of dP/dtheta x dP/dphi (dP/dphi x dP/dtheta otherwise), the normals following them
+  ThreadPool * pool;   ///< threads sharing the rows (null for the process-wide pool)
+
+  TessellationOptions() : strips(false), normals(false), reverseWinding(false), pool(nullptr) {}
+};
+
+/// A tessellated parametric surface
+struct ParamSurfaceMesh {
+  std::vector<glm::vec3> positions;  ///< positions, the vertex (kPhi, kTheta) being at index kPhi * nbTheta + kTheta
+  std::vector<glm::vec3> normals;    ///< unit normals (empty unless requested)
+  std::vector<unsigned int> indices; ///< IBO
+  GLenum mode;                       ///< primitive type of the IBO: GL_TRIANGLES or GL_TRIANGLE_STRIP (with primitive restarts)
+};
+
+/**
+ * @brief unit normals of a parametric surface computed from central differences of its position function
+ *
+ * Used for the surfaces without analytic normal. Where a partial derivative vanishes (e.g. at the poles
+ * of a sphere), the normal is taken slightly inside the parameter domain.
+ */
+template <typename P> struct FiniteDifferenceNormal {
+  const P & position; ///< the position function
+  float hPhi;         ///< difference step in phi
+  float hTheta;       ///< difference step in theta
+  float centerPhi;    ///< middle of the range of phi
+  float centerTheta;  ///< middle of the range of theta
+
+  /// Constructor, the steps being a small fraction of the parameter ranges
+  FiniteDifferenceNormal(const P & position, const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta)
+      : position(position), hPhi(1e-3f * rgPhi.length), hTheta(1e-3f * rgTheta.length), centerPhi(rgPhi.minVal + 0.5f * rgPhi.length),
+        centerTheta(rgTheta.minVal + 0.5f * rgTheta.length)
+  {
+  }
+
+  /// the unit normal at (phi, theta), null if the surface is degenerate around it
+  glm::vec3 operator()(float phi, float theta) const;
+
+private:
+  /// cross product of the partial derivatives, null where the surface is degenerate
+  glm::vec3 cross(float phi, float theta) const;
+};
+
+/**
+ * @brief tessellates a parametric surface
+ * @param rgPhi the discrete range of values for phi (the rows)
+ * @param rgTheta the discrete range of values for theta (the columns)
+ * @param position the position function, callable as glm::vec3(float phi, float theta)
+ * @param isCyclicInPhi cyclic behavior in phi (the last row is connected to the first one)
+ * @param isCyclicInTheta cyclic behavior in theta
+ * @param options the topology, normals and threads
+ * @return the mesh
+ *
+ * The position function is a template parameter, so that its calls are inlined. The outputs are sized
+ * beforehand, and the rows of vertices and of indices are computed concurrently. The normals, if requested,
+ * are computed by central differences (see FiniteDifferenceNormal).
+ */
+template <typename P>
+ParamSurfaceMesh tessellate(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & position, bool isCyclicInPhi, bool isCyclicInTheta,
+                            const TessellationOptions & options = TessellationOptions());
+
+/**
+ * @brief tessellates a parametric surface with an analytic normal
+ * @param normal the unit normal function, callable as glm::vec3(float phi, float theta), oriented as dP/dphi x dP/dtheta
+ *
+ * The other parameters are the ones of the previous function.
+ */
+template <typename P, typename N>
+ParamSurfaceMesh tessellate(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & position, const N & normal, bool isCyclicInPhi, bool isCyclicInTheta,
+                            const TessellationOptions & options = TessellationOptions());
+
+/**
+ * @brief builds the IBO of a grid of vertices
+ * @param nbPhi the number of rows of vertices
+ * @param nbTheta the number of vertices per row
+ * @param isCyclicInPhi cyclic behavior in phi
+ * @param isCyclicInTheta cyclic behavior in theta
+ * @param options the topology and threads (see TessellationOptions)
+ * @param indices receives the indices (the vertex (kPhi, kTheta) being at index kPhi * nbTheta + kTheta)
+ */
+void tessellateIndices(unsigned int nbPhi, unsigned int nbTheta, bool isCyclicInPhi, bool isCyclicInTheta, const TessellationOptions & options, std::vector<unsigned int> & indices);
+
+/**
+ * @brief builds the IBO of the quad patches of a grid of vertices, for the tessellation on the GPU
+ * @param nbPhi the number of rows of vertices
+ * @param nbTheta the number of vertices per row
+ * @param indices receives four indices per patch: (kPhi, kTheta), (kPhi + 1, kTheta), (kPhi + 1, kTheta + 1), (kPhi, kTheta + 1)
+ *
+ * The patches never wrap around: the parameters being interpolated within each patch, the seam of a cyclic
+ * surface is made of duplicated vertices (the ones of the first and last values of the range).
+ */
+void tessellatePatches(unsigned int nbPhi, unsigned int nbTheta, std::vector<unsigned int> & indices);
+
+/*
+ * Definition of method templates
+ */
+template <typename P> glm::vec3 FiniteDifferenceNormal<P>::cross(float phi, float theta) const
+{
+  glm::vec3 dPhi = position(phi + hPhi, theta) - position(phi - hPhi, theta);
+  glm::vec3 dTheta = position(phi, theta + hTheta) - position(phi, theta - hTheta);
+  glm::vec3 n = glm::cross(dPhi, dTheta);
+  // a derivative negligible against the other one leaves only rounding errors
+  float scale = std::max(glm::dot(dPhi, dPhi), glm::dot(dTheta, dTheta));
+  return glm::length(n) > 1e-5f * scale ? n : glm::vec3(0);
+}
+
+template <typename P> glm::vec3 FiniteDifferenceNormal<P>::operator()(float phi, float theta) const
+{
+  glm::vec3 n = cross(phi, theta);
+  if (glm::dot(n, n) == 0) {
+    // degenerate points are on the edges of the parameter domain in practice (outside of it, the orientation may flip)
+    n = cross(phi + (phi < centerPhi ? 2 : -2) * hPhi, theta + (theta < centerTheta ? 2 : -2) * hTheta);
+  }
+  float length = glm::length(n);
+  return length > 0 ? n / length : glm::vec3(0);
+}
+
+template <typename P>
+ParamSurfaceMesh tessellate(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & position, bool isCyclicInPhi, bool isCyclicInTheta,
+                            const TessellationOptions & options)
+{
+  return tessellate(rgPhi, rgTheta, position, FiniteDifferenceNormal<P>(position, rgPhi, rgTheta), isCyclicInPhi, isCyclicInTheta, options);
+}
+
+template <typename P, typename N>
+ParamSurfaceMesh tessellate(const DiscreteLinRange & rgPhi, const DiscreteLinRange & rgTheta, const P & position, const N & normal, bool isCyclicInPhi, bool isCyclicInTheta,
+                            const TessellationOptions & options)
+{
+  ParamSurfaceMesh mesh;
+  const size_t nbTheta = rgTheta.nbVals;
+  mesh.positions.resize(rgPhi.nbVals * nbTheta);
+  if (options.normals) {
+    mesh.normals.resize(mesh.positions.size());
+  }
+  const float orientation = options.reverseWinding ? -1.f : 1.f;
+  ThreadPool & pool = options.pool ? *options.pool : ThreadPool::global();
+  pool.parallelFor(
+      rgPhi.nbVals,
+      [&](size_t begin, size_t end) {
+        for (size_t kPhi = begin; kPhi < end; kPhi++) {
+          const float phi = rgPhi.value(kPhi);
+          glm::vec3 * positions = mesh.positions.data() + kPhi * nbTheta;
+          for (size_t kTheta = 0; kTheta < nbTheta; kTheta++) {
+            positions[kTheta] = position(phi, rgTheta.value(kTheta));
+          }
+          if (options.normals) {
+            glm::vec3 * normals = mesh.normals.data() + kPhi * nbTheta;
+            for (size_t kTheta = 0; kTheta < nbTheta; kTheta++) {
+              normals[kTheta] = orientation * normal(phi, rgTheta.value(kTheta));
+            }
+          }
+        }
+      },
+      std::max<size_t>(1, 4096 / std::max<size_t>(nbTheta, 1)));
+  tessellateIndices(rgPhi.nbVals, rgTheta.nbVals, isCyclicInPhi, isCyclicInTheta, options, mesh.indices);
+  mesh.mode = options.strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+  return mesh;
+}
+
+#endif // !defined(__PARAM_SURFACE_H__)
@@ -0,0 +1,207 @@
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <cmath>
+
+bool RenderQueue::sorting = true;
+bool RenderQueue::frontToBack = false;
+unsigned int RenderQueue::packetsPerList = 256;
+
+namespace
+{
+// layout of the sort keys, from the most to the least significant bits
+const unsigned int passBits = 4;
+const unsigned int programBits = 12;
+const unsigned int materialBits = 16;
+const unsigned int vaoBits = 12;
+const unsigned int depthBits = 20;
+const unsigned int depthShift = 0;
+const unsigned int vaoShift = depthShift + depthBits;
+const unsigned int materialShift = vaoShift + vaoBits;
+const unsigned int programShift = materialShift + materialBits;
+const unsigned int passShift = programShift + programBits;
+static_assert(passShift + passBits == 64, "the sort key fields must fill 64 bits");
+
+// layout of the sort keys of the opaque packets drawn front to back (see RenderQueue::frontToBack)
+const unsigned int frontVaoShift = 0;
+const unsigned int frontMaterialShift = frontVaoShift + vaoBits;
+const unsigned int frontProgramShift = frontMaterialShift + materialBits;
+const unsigned int frontDepthShift = frontProgramShift + programBits;
+static_assert(frontDepthShift + depthBits == passShift, "the depth must follow the pass");
+
+const uint64_t maxDepth = (uint64_t(1) << depthBits) - 1;
+} // namespace
+
+RenderQueue::RenderQueue() : m_slots(1), m_nbLists(0), m_nbDepthLists(0), m_near(0), m_far(1)
+{
+}
+
+void RenderQueue::setDepthRange(float near, float far)
+{
+  m_near = near;
+  m_far = far;
+}
+
+void RenderQueue::clear(unsigned int nbSlots)
+{
+  m_slots.resize(std::max(nbSlots, 1u));
+  for (auto & slot : m_slots) {
+    slot.packets.clear();
+    slot.entries.clear();
+  }
+  m_entries.clear();
+}
+
+uint64_t RenderQueue::materialIdentifier(const DrawPacket & packet)
+{
+  // hash of the locations of the textures and samplers, which merely interleaves two materials on a collision
+  uint32_t hash = 2166136261u;
+  for (unsigned int k = 0; k < DrawPacket::maxTextures; k++) {
+    hash = (hash ^ (packet.textures[k] ? packet.textures[k]->location() : 0)) * 16777619u;
+    hash = (hash ^ (packet.samplers[k] ? packet.samplers[k]->location() : 0)) * 16777619u;
+  }
+  return (hash ^ (hash >> materialBits)) & ((uint64_t(1) << materialBits) - 1);
+}
+
+void RenderQueue::submit(const DrawPacket & packet, RenderPass pass, float depth, unsigned int slot)
+{
+  // the identifiers derive from the OpenGL locations rather than from a shared table, so that concurrent
+  // submissions need no synchronization (distinct objects only share an identifier beyond 4096 programs or VAOs)
+  float normalizedDepth = std::min(std::max((depth - m_near) / (m_far - m_near), 0.f), 1.f);
+  uint64_t quantizedDepth = static_cast<uint64_t>(std::lround(normalizedDepth * maxDepth));
+  if (pass == RenderPass::Transparent) {
+    quantizedDepth = maxDepth - quantizedDepth; // back to front
+  }
+  const uint64_t programId = packet.program->location() & ((uint64_t(1) << programBits) - 1);
+  const uint64_t vaoId = packet.vao->location() & ((uint64_t(1) << vaoBits) - 1);
+  Slot & target = m_slots[slot];
+  Entry entry;
+  if (frontToBack and pass == RenderPass::Opaque) {
+    entry.key = uint64_t(pass) << passShift | quantizedDepth << frontDepthShift | programId << frontProgramShift | materialIdentifier(packet) << frontMaterialShift | vaoId << frontVaoShift;
+  } else {
+    entry.key = uint64_t(pass) << passShift | programId << programShift | materialIdentifier(packet) << materialShift | vaoId << vaoShift | quantizedDepth << depthShift;
+  }
+  entry.slot = slot;
+  entry.packet = target.packets.size();
+  target.entries.push_back(entry);
+  target.packets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+  m_entries.clear();
+  for (const auto & slot : m_slots) {
+    m_entries.insert(m_entries.end(), slot.entries.begin(), slot.entries.end());
+  }
+  if (sorting) {
+    radixSort();
+  }
+}
+void RenderQueue::radixSort()
+{
+  // least significant digit first, one byte per pass
+  if (m_entries.size() < 2) {
+    return;
+  }
+  const unsigned int nbBytes = sizeof(uint64_t);
+  uint32_t histograms[nbBytes][256] = {};
+  for (const Entry & entry : m_entries) {
+    for (unsigned int b = 0; b < nbBytes; b++) {
+      histograms[b][(entry.key >> (8 * b)) & 0xff]++;
+    }
+  }
+  m_scratch.resize(m_entries.size());
+  for (unsigned int b = 0; b < nbBytes; b++) {
+    uint32_t * histogram = histograms[b];
+    // bytes shared by all the keys (e.g. unused identifier bits) leave the order unchanged
+    if (histogram[(m_entries.front().key >> (8 * b)) & 0xff] == m_entries.size()) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (unsigned int digit = 0; digit < 256; digit++) {
+      uint32_t bucketSize = histogram[digit];
+      histogram[digit] = offset;
+      offset += bucketSize;
+    }
+    for (const Entry & entry : m_entries) {
+      m_scratch[histogram[(entry.key >> (8 * b)) & 0xff]++] = entry;
+    }
+    m_entries.swap(m_scratch);
+  }
+}
+
+void RenderQueue::record(ThreadPool & pool)
+{
+  record(m_lists, m_nbLists, nullptr, pool);
+}
+
+void RenderQueue::recordDepth(const Program & program, ThreadPool & pool)
+{
+  record(m_depthLists, m_nbDepthLists, &program, pool);
+}
+
+void RenderQueue::record(std::vector<CommandList> & lists, size_t & nbLists, const Program * depthProgram, ThreadPool & pool)
+{
+  nbLists = (m_entries.size() + packetsPerList - 1) / packetsPerList;
+  if (lists.size() < nbLists) {
+    lists.resize(nbLists);
+  }
+  pool.parallelFor(nbLists, [&](size_t begin, size_t end) {
+    for (size_t l = begin; l < end; l++) {
+      record(l * packetsPerList, std::min(m_entries.size(), (l + 1) * packetsPerList), lists[l], depthProgram);
+    }
+  });
+}
+
+void RenderQueue::record(size_t begin, size_t end, CommandList & list, const Program * depthProgram) const
+{
+  // the redundant binds are skipped within a list, the replay skips the ones at the start of the next list
+  list.clear();
+  const Program * program = nullptr;
+  const VAO * vao = nullptr;
+  const Texture * textures[DrawPacket::maxTextures] = {};
+  const Sampler * samplers[DrawPacket::maxTextures] = {};
+  for (size_t e = begin; e < end; e++) {
+    const DrawPacket & packet = m_slots[m_entries[e].slot].packets[m_entries[e].packet];
+    if (depthProgram and m_entries[e].key >> passShift != uint64_t(RenderPass::Opaque)) {
+      continue; // the blended packets do not hide the others
+    }
+    const Program * packetProgram = depthProgram ? depthProgram : packet.program;
+    if (packetProgram != program) {
+      program = packetProgram;
+      list.bindProgram(*program);
+    }
+    for (unsigned int k = 0; k < DrawPacket::maxTextures and not depthProgram; k++) {
+      if (e == begin or packet.samplers[k] != samplers[k]) {
+        samplers[k] = packet.samplers[k];
+        list.bindSampler(k, samplers[k]);
+      }
+      // a texture unit unused by a packet keeps its texture, which the program does not sample
+      if (packet.textures[k] and packet.textures[k] != textures[k]) {
+        textures[k] = packet.textures[k];
+        list.bindTexture(k, *textures[k]);
+      }
+    }
+    if (packet.vao != vao) {
+      vao = packet.vao;
+      list.bindVAO(*vao);
+    }
+    if (packet.matrixName) {
+      list.setUniform(packet.matrixName, packet.matrix);
+    }
+    if (packet.offsets) {
+      list.draw(packet.mode, *packet.offsets, *packet.counts);
+    } else {
+      list.draw(packet.mode, packet.offset, packet.count);
+    }
+  }
+}
+
+void RenderQueue::replay()
+{
+  m_statistics = CommandList::execute(m_lists, m_nbLists);
+}
+
+void RenderQueue::replayDepth()
+{
+  m_depthStatistics = CommandList::execute(m_depthLists, m_nbDepthLists);
+}
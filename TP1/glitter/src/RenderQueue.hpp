@@ -0,0 +1,179 @@
+/** @file */
+#ifndef __RENDER_QUEUE_H__
+#define __RENDER_QUEUE_H__
+#include <cstdint>
+#include <vector>
+#include "CommandList.hpp"
+#include "ThreadPool.hpp"
+#include "glApi.hpp"
+
+/// Render passes, executed in this order
+enum class RenderPass
+{
+  Opaque,     ///< opaque geometry, drawn front to back within a state group
+  Transparent ///< blended geometry, drawn back to front
+};
+
+/**
+ * @brief A draw call, with the OpenGL state it needs
+ *
+ * The objects referenced by a packet must outlive the execution of its queue.
+ */
+struct DrawPacket {
+  static const unsigned int maxTextures = 3; ///< number of texture units used by a packet
+
+  const Program * program;               ///< program (its uniforms, except matrix, are set beforehand)
+  const VAO * vao;                       ///< VAO providing the geometry
+  const Texture * textures[maxTextures]; ///< texture bound to each texture unit (null if unused)
+  const Sampler * samplers[maxTextures]; ///< sampler bound to each texture unit (null if unused), samplers[k] must use the unit k
+  const char * matrixName;               ///< name of the per-draw matrix uniform (e.g. "M" or "MVP", null if none)
+  glm::mat4 matrix;                      ///< value of the per-draw matrix uniform
+  GLenum mode;                           ///< primitive type
+  uint offset;                           ///< index of the first IBO element to be drawn
+  uint count;                            ///< number of IBO elements to be drawn
+  const std::vector<uint> * offsets;     ///< IBO ranges drawn by a single multi-draw call instead of offset/count (null if none)
+  const std::vector<GLsizei> * counts;   ///< counts of the multi-draw ranges
+
+  DrawPacket() : program(nullptr), vao(nullptr), textures(), samplers(), matrixName(nullptr), mode(GL_TRIANGLES), offset(0), count(0), offsets(nullptr), counts(nullptr) {}
+};
+
+/**
+ * @brief Collects the draw calls of a frame, and executes them sorted by OpenGL state
+ *
+ * Each packet gets a 64 bits sort key holding, from the most to the least significant bits, its pass,
+ * program, material (its set of textures and samplers), VAO and quantized depth. The packets are radix
+ * sorted on these keys, so that the draws sharing a program, then a material, then a VAO are
+ * consecutive, and only the state which differs from the one of the previous packet is changed.
+ * If frontToBack is set, the depth of the opaque packets moves right after their pass: they are drawn
+ * front to back, so that the depth test discards most hidden fragments before shading, at the cost of
+ * more state changes.
+ *
+ * The opaque packets can also be drawn into the depth buffer only, by a trivial program (see
+ * executeDepth()). Drawing them again with the depth function GL_EQUAL then shades the visible
+ * fragments only, whatever the order of the draws.
+ *
+ * The packets are submitted into slots, which can be filled concurrently (each slot by one thread at a
+ * time). The sorted packets are then recorded into command lists by the threads of a pool, and the lists
+ * are replayed by the thread owning the OpenGL context.
+ *
+ * Usage, once per frame: clear(), submit() the visible draws, sort(), then execute() from the thread
+ * owning the OpenGL context.
+ */
+class RenderQueue {
+public:
+  typedef CommandList::Statistics Statistics; ///< OpenGL state changes made by an execution
+
+  RenderQueue();
+
+  /**
+   * @brief sets the range of the view depths given to submit()
+   * @param near the depth of the near plane
+   * @param far the depth of the far plane
+   */
+  void setDepthRange(float near, float far);
+
+  /**
+   * @brief removes all the packets
+   * @param nbSlots the number of slots receiving the next packets
+   */
+  void clear(unsigned int nbSlots = 1);
+
+  /**
+   * @brief adds a packet to the queue
+   * @param packet the draw call
+   * @param pass the pass of the draw call
+   * @param depth the distance between the camera and the geometry (in view space)
+   * @param slot the slot receiving the packet
+   *
+   * @note this method can be called concurrently with distinct slots
+   */
+  void submit(const DrawPacket & packet, RenderPass pass, float depth, unsigned int slot = 0);
+
+  /// merges the slots, and sorts the packets on their keys (keeps the submission order, slot after slot, if sorting is false)
+  void sort();
+
+  /**
+   * @brief records the sorted packets into command lists, on the threads of a pool
+   * @param pool the threads recording the lists (the calling one included)
+   */
+  void record(ThreadPool & pool = ThreadPool::global());
+
+  /// replays the recorded command lists, and restores the default state (no program, VAO or sampler bound)
+  void replay();
+
+  /// records then replays the sorted packets
+  void execute(ThreadPool & pool = ThreadPool::global())
+  {
+    record(pool);
+    replay();
+  }
+
+  /**
+   * @brief records the sorted opaque packets into command lists drawing with a single program, ignoring their textures
+   * @param program the depth-only program, which must declare the per-draw matrix uniforms of the packets
+   * @param pool the threads recording the lists (the calling one included)
+   */
+  void recordDepth(const Program & program, ThreadPool & pool = ThreadPool::global());
+
+  /// replays the command lists recorded by recordDepth()
+  void replayDepth();
+
+  /**
+   * @brief draws the sorted opaque packets with a depth-only program (the depth pre-pass)
+   * @param program the depth-only program, which must declare the per-draw matrix uniforms of the packets
+   * @param pool the threads recording the lists (the calling one included)
+   *
+   * @note the color writes should be disabled by the caller (see glColorMask)
+   */
+  void executeDepth(const Program & program, ThreadPool & pool = ThreadPool::global())
+  {
+    recordDepth(program, pool);
+    replayDepth();
+  }
+
+  /// number of sorted packets
+  size_t size() const { return m_entries.size(); }
+
+  /// state changes made by the last execution
+  const Statistics & statistics() const { return m_statistics; }
+
+  /// state changes made by the last execution of the depth pre-pass
+  const Statistics & depthStatistics() const { return m_depthStatistics; }
+
+  static bool sorting;                ///< denotes if the packets are sorted (the submission order is kept otherwise, e.g. for comparisons)
+  static bool frontToBack;            ///< denotes if the opaque packets are sorted on their depth before their state
+  static unsigned int packetsPerList; ///< number of packets recorded into each command list
+
+private:
+  /// a key, and the packet it belongs to
+  struct Entry {
+    uint64_t key;
+    uint32_t slot;   ///< slot of the packet
+    uint32_t packet; ///< index of the packet in its slot
+  };
+
+  /// the packets submitted by one thread
+  struct Slot {
+    std::vector<DrawPacket> packets;
+    std::vector<Entry> entries;
+  };
+
+  static uint64_t materialIdentifier(const DrawPacket & packet);
+  void radixSort();
+  void record(size_t begin, size_t end, CommandList & list, const Program * depthProgram) const;
+  void record(std::vector<CommandList> & lists, size_t & nbLists, const Program * depthProgram, ThreadPool & pool);
+
+  std::vector<Slot> m_slots;             ///< packets, in submission order
+  std::vector<Entry> m_entries;          ///< keys of the packets of all the slots, in execution order once sorted
+  std::vector<Entry> m_scratch;          ///< buffer of the radix sort
+  std::vector<CommandList> m_lists;      ///< command lists recorded from the sorted packets (kept from frame to frame)
+  size_t m_nbLists;                      ///< number of lists recorded
+  std::vector<CommandList> m_depthLists; ///< command lists of the depth pre-pass (kept from frame to frame)
+  size_t m_nbDepthLists;                 ///< number of lists of the depth pre-pass recorded
+  float m_near;                          ///< depth mapped to 0
+  float m_far;                           ///< depth mapped to the largest quantized depth
+  Statistics m_statistics;               ///< state changes of the last replay
+  Statistics m_depthStatistics;          ///< state changes of the last replay of the depth pre-pass
+};
+
+#endif // !defined(__RENDER_QUEUE_H__)
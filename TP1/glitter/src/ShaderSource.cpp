@@ -0,0 +1,76 @@
+#include "ShaderSource.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include "utils.hpp"
+
+namespace
+{
+/// directory of a file, with its trailing slash (empty for a file of the resource directory)
+std::string directory(const std::string & filename)
+{
+  size_t slash = filename.find_last_of('/');
+  return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+}
+
+/// reads the name of the file included by a line, returns false if the line is not an include directive
+bool includedFile(const std::string & line, std::string & name)
+{
+  size_t begin = line.find_first_not_of(" \t");
+  if (begin == std::string::npos or line.compare(begin, 8, "#include") != 0) {
+    return false;
+  }
+  size_t open = line.find('"', begin + 8), close = open == std::string::npos ? open : line.find('"', open + 1);
+  if (close == std::string::npos) {
+    std::cerr << "malformed include directive: " << line << std::endl;
+    return false;
+  }
+  name = line.substr(open + 1, close - open - 1);
+  return true;
+}
+
+/// denotes if a line is the #version directive
+bool versionLine(const std::string & line)
+{
+  size_t begin = line.find_first_not_of(" \t");
+  return begin != std::string::npos and line.compare(begin, 8, "#version") == 0;
+}
+
+/// appends the content of a file to the source, the defines being inserted after its #version directive
+void append(const std::string & filename, const std::vector<std::string> & defines, ShaderSource & source)
+{
+  if (std::find(source.files.begin(), source.files.end(), filename) != source.files.end()) {
+    return; // already included
+  }
+  if (not fileExists(absolutename(filename))) {
+    std::cerr << "shader file not found: " << filename << std::endl;
+    return;
+  }
+  const size_t number = source.files.size();
+  source.files.push_back(filename);
+  std::istringstream content(fileContent(filename));
+  std::string line, included;
+  for (size_t lineNumber = 1; std::getline(content, line); lineNumber++) {
+    if (includedFile(line, included)) {
+      source.code += "#line 1 " + std::to_string(source.files.size()) + "\n";
+      append(directory(filename) + included, std::vector<std::string>(), source);
+      source.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(number) + "\n";
+    } else if (versionLine(line) and not defines.empty()) {
+      source.code += line + "\n";
+      for (const auto & define : defines) {
+        source.code += "#define " + define + "\n";
+      }
+      source.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(number) + "\n";
+    } else {
+      source.code += line + "\n";
+    }
+  }
+}
+} // namespace
+
+ShaderSource preprocessShader(const std::string & filename, const std::vector<std::string> & defines)
+{
+  ShaderSource source;
+  append(filename, defines, source);
+  return source;
+}
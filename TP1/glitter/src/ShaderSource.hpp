@@ -0,0 +1,30 @@
+/** @file */
+#ifndef __SHADER_SOURCE_H__
+#define __SHADER_SOURCE_H__
+#include <string>
+#include <vector>
+
+/// The source of a shader, after the preprocessing of preprocessShader()
+struct ShaderSource {
+  std::string code;               ///< source code given to the GLSL compiler
+  std::vector<std::string> files; ///< files making the code, the k-th being the source string k of the #line directives
+};
+
+/**
+ * @brief reads a shader, resolving its includes and injecting preprocessor definitions
+ * @param filename the name of the shader file (relative to RESOURCE_DIR, see utils.hpp ::fileContent)
+ * @param defines the definitions injected after the #version directive, each one being either a name or a name followed by a value (e.g. "DEFORM", "NB_LIGHTS 3")
+ * @return the preprocessed source
+ *
+ * The lines
+ * @code
+ * #include "geometry.glsl"
+ * @endcode
+ * are replaced by the content of the named file, relative to the directory of the including file. Each file
+ * is included at most once. #line directives are inserted around the includes, so that the errors of the
+ * compiler refer to the lines of the original files (the number of the source string being the index of
+ * the file in ShaderSource::files).
+ */
+ShaderSource preprocessShader(const std::string & filename, const std::vector<std::string> & defines = std::vector<std::string>());
+
+#endif // !defined(__SHADER_SOURCE_H__)
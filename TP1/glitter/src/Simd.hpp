@@ -0,0 +1,238 @@
+/** @file */
+#ifndef __SIMD_H__
+#define __SIMD_H__
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+#else
+#define SIMD_WIDTH 1
+#endif
+#if defined(__AVX512VBMI__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/**
+ * @brief Thin wrappers over the SIMD registers of the target instruction set
+ *
+ * The instruction set is selected at compile time: AVX (8 lanes) when enabled (see the
+ * GLITTER_SIMD_AVX and GLITTER_NATIVE_SIMD CMake options), SSE2 (4 lanes) on any other
+ * x86-64 target, and plain floats otherwise. Code written with these types
+ * processes simd::Float::width elements at a time and is oblivious to the actual width.
+ */
+namespace simd
+{
+#if SIMD_WIDTH == 8
+typedef __m256 Register;
+#elif SIMD_WIDTH == 4
+typedef __m128 Register;
+#else
+typedef float Register;
+#endif
+
+/// A register of simd::Float::width lanes, each one being either true (all bits set) or false
+struct Mask {
+  Register v;
+  Mask() {}
+  Mask(Register v) : v(v) {}
+};
+
+/// A register of simd::Float::width floats
+struct Float {
+  static const int width = SIMD_WIDTH; ///< number of lanes
+  Register v;
+
+  Float() {}
+#if SIMD_WIDTH == 8
+  Float(Register v) : v(v) {}
+  Float(float x) : v(_mm256_set1_ps(x)) {}
+  /// loads width floats (no alignment required)
+  static Float load(const float * p) { return _mm256_loadu_ps(p); }
+  /// stores width floats (no alignment required)
+  void store(float * p) const { _mm256_storeu_ps(p, v); }
+  /// stores width floats bypassing the caches (aligned on sizeof(Float), see fence())
+  void stream(float * p) const { _mm256_stream_ps(p, v); }
+#elif SIMD_WIDTH == 4
+  Float(Register v) : v(v) {}
+  Float(float x) : v(_mm_set1_ps(x)) {}
+  static Float load(const float * p) { return _mm_loadu_ps(p); }
+  void store(float * p) const { _mm_storeu_ps(p, v); }
+  void stream(float * p) const { _mm_stream_ps(p, v); }
+#else
+  Float(float x) : v(x) {}
+  static Float load(const float * p) { return *p; }
+  void store(float * p) const { *p = v; }
+  void stream(float * p) const { *p = v; }
+#endif
+};
+
+/// orders the streamed stores (see Float::stream) before the following ones
+inline void fence()
+{
+#if SIMD_WIDTH > 1
+  _mm_sfence();
+#endif
+}
+
+#if SIMD_WIDTH == 8
+inline Float operator+(Float a, Float b) { return _mm256_add_ps(a.v, b.v); }
+inline Float operator-(Float a, Float b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float operator*(Float a, Float b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float operator/(Float a, Float b) { return _mm256_div_ps(a.v, b.v); }
+inline Float min(Float a, Float b) { return _mm256_min_ps(a.v, b.v); }
+inline Float max(Float a, Float b) { return _mm256_max_ps(a.v, b.v); }
+inline Float sqrt(Float a) { return _mm256_sqrt_ps(a.v); }
+inline Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+inline Mask operator<(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Mask operator<=(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline Mask operator>(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline Mask operator>=(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline Mask operator&(Mask a, Mask b) { return _mm256_and_ps(a.v, b.v); }
+inline Mask operator|(Mask a, Mask b) { return _mm256_or_ps(a.v, b.v); }
+/// lane-wise mask ? a : b
+inline Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+/// one bit per lane, set for the true lanes
+inline int bits(Mask mask) { return _mm256_movemask_ps(mask.v); }
+/// transposes the width x width matrix whose rows are the registers (rows[i] lane j becomes rows[j] lane i)
+inline void transpose(Float rows[8])
+{
+  __m256 t0 = _mm256_unpacklo_ps(rows[0].v, rows[1].v);
+  __m256 t1 = _mm256_unpackhi_ps(rows[0].v, rows[1].v);
+  __m256 t2 = _mm256_unpacklo_ps(rows[2].v, rows[3].v);
+  __m256 t3 = _mm256_unpackhi_ps(rows[2].v, rows[3].v);
+  __m256 t4 = _mm256_unpacklo_ps(rows[4].v, rows[5].v);
+  __m256 t5 = _mm256_unpackhi_ps(rows[4].v, rows[5].v);
+  __m256 t6 = _mm256_unpacklo_ps(rows[6].v, rows[7].v);
+  __m256 t7 = _mm256_unpackhi_ps(rows[6].v, rows[7].v);
+  __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+  rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+  rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+  rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+  rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+  rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+  rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+  rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+#elif SIMD_WIDTH == 4
+inline Float operator+(Float a, Float b) { return _mm_add_ps(a.v, b.v); }
+inline Float operator-(Float a, Float b) { return _mm_sub_ps(a.v, b.v); }
+inline Float operator*(Float a, Float b) { return _mm_mul_ps(a.v, b.v); }
+inline Float operator/(Float a, Float b) { return _mm_div_ps(a.v, b.v); }
+inline Float min(Float a, Float b) { return _mm_min_ps(a.v, b.v); }
+inline Float max(Float a, Float b) { return _mm_max_ps(a.v, b.v); }
+inline Float sqrt(Float a) { return _mm_sqrt_ps(a.v); }
+inline Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline Mask operator<(Float a, Float b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Mask operator<=(Float a, Float b) { return _mm_cmple_ps(a.v, b.v); }
+inline Mask operator>(Float a, Float b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Mask operator>=(Float a, Float b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Mask operator&(Mask a, Mask b) { return _mm_and_ps(a.v, b.v); }
+inline Mask operator|(Mask a, Mask b) { return _mm_or_ps(a.v, b.v); }
+inline Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int bits(Mask mask) { return _mm_movemask_ps(mask.v); }
+inline void transpose(Float rows[4]) { _MM_TRANSPOSE4_PS(rows[0].v, rows[1].v, rows[2].v, rows[3].v); }
+#else
+inline Register maskOf(bool b)
+{
+  unsigned int u = b ? ~0u : 0u;
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+inline bool isTrue(Mask m)
+{
+  unsigned int u;
+  std::memcpy(&u, &m.v, sizeof(u));
+  return u != 0;
+}
+inline Float operator+(Float a, Float b) { return a.v + b.v; }
+inline Float operator-(Float a, Float b) { return a.v - b.v; }
+inline Float operator*(Float a, Float b) { return a.v * b.v; }
+inline Float operator/(Float a, Float b) { return a.v / b.v; }
+inline Float min(Float a, Float b) { return a.v < b.v ? a.v : b.v; }
+inline Float max(Float a, Float b) { return a.v > b.v ? a.v : b.v; }
+inline Float sqrt(Float a) { return std::sqrt(a.v); }
+inline Float abs(Float a) { return std::fabs(a.v); }
+inline Mask operator<(Float a, Float b) { return maskOf(a.v < b.v); }
+inline Mask operator<=(Float a, Float b) { return maskOf(a.v <= b.v); }
+inline Mask operator>(Float a, Float b) { return maskOf(a.v > b.v); }
+inline Mask operator>=(Float a, Float b) { return maskOf(a.v >= b.v); }
+inline Mask operator&(Mask a, Mask b) { return maskOf(isTrue(a) and isTrue(b)); }
+inline Mask operator|(Mask a, Mask b) { return maskOf(isTrue(a) or isTrue(b)); }
+inline Float select(Mask mask, Float a, Float b) { return isTrue(mask) ? a : b; }
+inline int bits(Mask mask) { return isTrue(mask) ? 1 : 0; }
+inline void transpose(Float * /*rows*/) {}
+#endif
+
+/// lane-wise dot product of 3d vectors stored as three registers
+inline Float dot(Float ax, Float ay, Float az, Float bx, Float by, Float bz) { return ax * bx + ay * by + az * bz; }
+
+/**
+ * @brief lane-wise arc cosine
+ * @param x values in [-1, 1]
+ * @return approximations of acos(x), with an absolute error below 1e-4 (Abramowitz and Stegun 4.4.45)
+ */
+inline Float acos(Float x)
+{
+  Float a = abs(x);
+  Float p = ((Float(-0.0187293f) * a + Float(0.0742610f)) * a + Float(-0.2121144f)) * a + Float(1.5707288f);
+  Float r = sqrt(max(Float(1) - a, Float(0))) * p;
+  return select(x < Float(0), Float(3.14159265f) - r, r);
+}
+
+/**
+ * @brief permutes 64 bytes: result[i] = bytes[indices[i]]
+ * @param bytes the bytes to permute
+ * @param indices the index (below 64) of the source of each byte
+ * @param result the permuted bytes (which may be the bytes to permute)
+ *
+ * A single vpermb with AVX-512 VBMI. With SSSE3, each block of 16 bytes gathers the four source blocks with
+ * pshufb, the indices out of a source block being saturated so that pshufb zeroes their bytes.
+ */
+inline void permuteBytes(const uint8_t * bytes, const uint8_t * indices, uint8_t * result)
+{
+#if defined(__AVX512VBMI__)
+  // the zero masked form with all the lanes selected: GCC 12 implements the unmasked one on an uninitialized register
+  _mm512_storeu_si512(result, _mm512_maskz_permutexvar_epi8(~0ULL, _mm512_loadu_si512(indices), _mm512_loadu_si512(bytes)));
+#elif defined(__SSSE3__)
+  __m128i sources[4], permuted[4];
+  for (int block = 0; block < 4; block++) {
+    sources[block] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes) + block);
+  }
+  for (int block = 0; block < 4; block++) {
+    const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices) + block);
+    permuted[block] = _mm_setzero_si128();
+    for (int source = 0; source < 4; source++) {
+      const __m128i local = _mm_adds_epu8(_mm_sub_epi8(index, _mm_set1_epi8(16 * source)), _mm_set1_epi8(0x70));
+      permuted[block] = _mm_or_si128(permuted[block], _mm_shuffle_epi8(sources[source], local));
+    }
+  }
+  for (int block = 0; block < 4; block++) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(result) + block, permuted[block]);
+  }
+#else
+  uint8_t permuted[64];
+  for (int i = 0; i < 64; i++) {
+    permuted[i] = bytes[indices[i]];
+  }
+  std::memcpy(result, permuted, sizeof(permuted));
+#endif
+}
+} // namespace simd
+
+#endif // !defined(__SIMD_H__)
@@ -0,0 +1,138 @@
+#include "TextureStreamer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "ThreadPool.hpp"
+
+unsigned int TextureStreamer::maxReadsPerFrame = 4;
+
+TextureStreamer::TextureStreamer(size_t budget, int coarseSize)
+    : m_budget(budget), m_coarseSize(coarseSize), m_viewportHeight(1), m_residentBytes(0), m_pendingBytes(0), m_nbStreamedLevels(0), m_nbEvictedLevels(0)
+{
+}
+
+unsigned int TextureStreamer::add(const std::shared_ptr<Texture> & texture, const std::string & filename, bool srgb)
+{
+  StreamedTexture streamed;
+  streamed.texture = texture;
+  streamed.cache = std::shared_ptr<MipCache>(new MipCache(filename, srgb));
+  const MipCache & cache = *streamed.cache;
+  if (not cache.valid()) {
+    std::cerr << "Unable to stream texture: " << filename << std::endl;
+    exit(1);
+  }
+  const unsigned int coarsest = cache.nbLevels() - 1;
+  unsigned int coarse = 0;
+  while (coarse < coarsest and std::max(cache.width(coarse), cache.height(coarse)) > m_coarseSize) {
+    coarse++;
+  }
+  for (unsigned int k = coarse; k <= coarsest; k++) {
+    texture->setLevelData(k, cache.readLevel(k));
+    m_residentBytes += cache.levelSize(k);
+  }
+  streamed.coarse = coarse;
+  streamed.finest = 0;
+  streamed.wanted = coarsest;
+  streamed.requested = false;
+  m_textures.push_back(std::move(streamed));
+  setResident(m_textures.back(), coarse);
+  return m_textures.size() - 1;
+}
+
+void TextureStreamer::request(unsigned int id, float projectedSize)
+{
+  StreamedTexture & streamed = m_textures[id];
+  const MipCache & cache = *streamed.cache;
+  float diameter = std::max(projectedSize * m_viewportHeight, 1.f);
+  float texelsPerPixel = std::max(cache.width(0), cache.height(0)) / diameter;
+  unsigned int level = texelsPerPixel > 1 ? static_cast<unsigned int>(std::log2(texelsPerPixel)) : 0;
+  level = std::min(level, cache.nbLevels() - 1);
+  streamed.wanted = streamed.requested ? std::min(streamed.wanted, level) : level;
+  streamed.requested = true;
+}
+
+void TextureStreamer::update()
+{
+  for (auto & streamed : m_textures) {
+    if (not streamed.requested) {
+      streamed.wanted = streamed.cache->nbLevels() - 1; // only the coarse levels are needed
+    }
+    streamed.wanted = std::max(streamed.wanted, streamed.finest);
+    streamed.requested = false;
+  }
+
+  // upload the levels read since the last update
+  for (auto & streamed : m_textures) {
+    if (streamed.pendingLevel == streamed.resident or streamed.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      continue;
+    }
+    Image<> level = streamed.pending.get();
+    size_t bytes = streamed.cache->levelSize(streamed.pendingLevel);
+    m_pendingBytes -= bytes;
+    if (not level.data) {
+      streamed.finest = streamed.pendingLevel + 1;
+      streamed.pendingLevel = streamed.resident;
+      continue;
+    }
+    streamed.texture->setLevelData(streamed.pendingLevel, level);
+    m_residentBytes += bytes;
+    m_nbStreamedLevels++;
+    setResident(streamed, streamed.pendingLevel);
+  }
+
+  // the budget may have been exceeded by textures becoming less needed
+  makeRoom(0);
+
+  // start the reads of the next finer levels, the textures lacking the most detail first
+  std::vector<StreamedTexture *> candidates;
+  for (auto & streamed : m_textures) {
+    if (streamed.pendingLevel == streamed.resident and streamed.wanted < streamed.resident) {
+      candidates.push_back(&streamed);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture * a, const StreamedTexture * b) { return a->resident - a->wanted > b->resident - b->wanted; });
+  for (size_t k = 0; k < candidates.size() and k < maxReadsPerFrame; k++) {
+    StreamedTexture & streamed = *candidates[k];
+    unsigned int level = streamed.resident - 1;
+    size_t bytes = streamed.cache->levelSize(level);
+    if (not makeRoom(bytes)) {
+      break;
+    }
+    m_pendingBytes += bytes;
+    streamed.pendingLevel = level;
+    std::shared_ptr<MipCache> cache = streamed.cache;
+    streamed.pending = ThreadPool::global().submit([cache, level]() { return cache->readLevel(level); });
+  }
+}
+
+bool TextureStreamer::makeRoom(size_t bytes)
+{
+  while (m_residentBytes + m_pendingBytes + bytes > m_budget) {
+    // the texture having the most detail beyond its needs
+    StreamedTexture * victim = nullptr;
+    unsigned int surplus = 0;
+    for (auto & streamed : m_textures) {
+      unsigned int bound = std::min(streamed.wanted, streamed.coarse);
+      if (streamed.pendingLevel == streamed.resident and streamed.resident < bound and bound - streamed.resident > surplus) {
+        victim = &streamed;
+        surplus = bound - streamed.resident;
+      }
+    }
+    if (not victim) {
+      return false;
+    }
+    unsigned int level = victim->resident;
+    setResident(*victim, level + 1); // the level must not be sampled anymore before being released
+    victim->texture->releaseLevel(level);
+    m_residentBytes -= victim->cache->levelSize(level);
+    m_nbEvictedLevels++;
+  }
+  return true;
+}
+
+void TextureStreamer::setResident(StreamedTexture & streamed, unsigned int level)
+{
+  streamed.resident = level;
+  streamed.pendingLevel = level;
+  streamed.texture->setLevelRange(level, streamed.cache->nbLevels() - 1);
+}
@@ -0,0 +1,101 @@
+/** @file */
+#ifndef __TEXTURE_STREAMER_H__
+#define __TEXTURE_STREAMER_H__
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MipCache.hpp"
+#include "glApi.hpp"
+
+/**
+ * @brief Streams the levels of 2d textures according to their on-screen size
+ *
+ * A texture starts with its coarse levels only (read from its MipCache), the finer levels being read
+ * in the background and uploaded once the objects using the texture get close enough to need them.
+ * The levels present on the GPU are the ones from the finest resident level to the coarsest one, and
+ * the sampling is restricted to them (GL_TEXTURE_BASE_LEVEL). The memory used by the textures is
+ * bounded by a budget: when a level does not fit, the finest levels of the textures having more
+ * detail than needed (e.g. the ones of distant or hidden objects) are released.
+ *
+ * The renderer reports the on-screen size of the objects using each texture with request(), and calls
+ * update() once per frame (from the thread owning the OpenGL context).
+ */
+class TextureStreamer {
+public:
+  /**
+   * @brief Constructor
+   * @param budget the GPU memory available to the streamed textures (in bytes)
+   * @param coarseSize the size of the largest level loaded at registration (the coarse levels are always resident)
+   */
+  explicit TextureStreamer(size_t budget, int coarseSize = 64);
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer & operator=(const TextureStreamer &) = delete;
+
+  /**
+   * @brief registers a texture, and uploads its coarse levels
+   * @param texture the 2d texture receiving the levels
+   * @param filename the image of the texture
+   * @param srgb denotes if the color channels of the image are sRGB encoded
+   * @return the identifier of the texture in the streamer
+   */
+  unsigned int add(const std::shared_ptr<Texture> & texture, const std::string & filename, bool srgb);
+
+  /// sets the height of the viewport (in pixels)
+  void setViewportHeight(int height) { m_viewportHeight = height; }
+
+  /**
+   * @brief records the on-screen size of an object using a texture during the current frame
+   * @param id the identifier of the texture
+   * @param projectedSize the size of the object (see BoundingSphere::projectedSize)
+   *
+   * The texture is assumed to be mapped once over the object: its finest level needed is the one
+   * having about one texel per pixel over the diameter of the object.
+   */
+  void request(unsigned int id, float projectedSize);
+
+  /// uploads the levels read since the last call, starts the reads of the levels now needed, and evicts levels if needed
+  void update();
+
+  /// GPU memory used by the streamed textures (in bytes)
+  size_t residentBytes() const { return m_residentBytes; }
+
+  /// budget of GPU memory (in bytes)
+  size_t budget() const { return m_budget; }
+
+  /// number of levels uploaded since the construction
+  unsigned int nbStreamedLevels() const { return m_nbStreamedLevels; }
+
+  /// number of levels evicted since the construction
+  unsigned int nbEvictedLevels() const { return m_nbEvictedLevels; }
+
+  static unsigned int maxReadsPerFrame; ///< maximal number of level reads started by an update
+
+private:
+  struct StreamedTexture {
+    std::shared_ptr<Texture> texture;
+    std::shared_ptr<MipCache> cache;
+    unsigned int coarse;          ///< finest of the levels always resident
+    unsigned int finest;          ///< finest level available (above 0 if a level could not be read)
+    unsigned int resident;        ///< finest level on the GPU
+    unsigned int wanted;          ///< finest level needed by the objects drawn during the current frame
+    bool requested;               ///< denotes if some object drawn during the current frame uses the texture
+    unsigned int pendingLevel;    ///< level being read (equal to resident if none)
+    std::future<Image<>> pending; ///< the level being read
+  };
+
+  /// evicts the finest levels of the textures having more detail than needed, until @p bytes fit in the budget
+  bool makeRoom(size_t bytes);
+  void setResident(StreamedTexture & streamed, unsigned int level);
+
+  std::vector<StreamedTexture> m_textures;
+  size_t m_budget;                 ///< GPU memory available (in bytes)
+  int m_coarseSize;                ///< size of the largest level always resident
+  int m_viewportHeight;            ///< height of the viewport (in pixels)
+  size_t m_residentBytes;          ///< GPU memory used by the resident levels
+  size_t m_pendingBytes;           ///< GPU memory needed by the levels being read
+  unsigned int m_nbStreamedLevels; ///< number of levels uploaded
+  unsigned int m_nbEvictedLevels;  ///< number of levels evicted
+};
+
+#endif // !defined(__TEXTURE_STREAMER_H__)
@@ -0,0 +1,115 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int nbThreads) : m_stopping(false)
+{
+  m_threads.reserve(nbThreads);
+  for (unsigned int i = 0; i < nbThreads; i++) {
+    m_threads.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+  for (auto & thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::work()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stopping or not m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+namespace
+{
+/// The state of a parallelFor, shared with the helper tasks (which may start after its completion)
+struct ParallelRange {
+  std::function<void(size_t, size_t)> body;
+  size_t count;
+  size_t chunkSize;
+  size_t nbChunks;
+  std::atomic<size_t> nextChunk;
+  std::atomic<size_t> doneChunks;
+  std::mutex mutex;
+  std::condition_variable done;
+
+  /// processes chunks until there is none left
+  void run()
+  {
+    size_t chunk;
+    while ((chunk = nextChunk++) < nbChunks) {
+      size_t begin = chunk * chunkSize;
+      body(begin, std::min(count, begin + chunkSize));
+      if (++doneChunks == nbChunks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+    }
+  }
+};
+} // namespace
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> & body, size_t grain)
+{
+  if (count == 0) {
+    return;
+  }
+  // a few chunks per thread, to balance uneven workloads
+  size_t nbThreads = m_threads.size() + 1;
+  size_t chunkSize = std::max<size_t>(std::max<size_t>(grain, 1), (count + 4 * nbThreads - 1) / (4 * nbThreads));
+  size_t nbChunks = (count + chunkSize - 1) / chunkSize;
+  if (nbChunks == 1 or m_threads.empty()) {
+    body(0, count);
+    return;
+  }
+  std::shared_ptr<ParallelRange> range(new ParallelRange());
+  range->body = body;
+  range->count = count;
+  range->chunkSize = chunkSize;
+  range->nbChunks = nbChunks;
+  range->nextChunk = 0;
+  range->doneChunks = 0;
+  size_t nbHelpers = std::min(m_threads.size(), nbChunks - 1);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < nbHelpers; i++) {
+      m_tasks.push_back([range]() { range->run(); });
+    }
+  }
+  m_condition.notify_all();
+  range->run();
+  // the remaining chunks are being processed by the helpers
+  std::unique_lock<std::mutex> lock(range->mutex);
+  range->done.wait(lock, [&range]() { return range->doneChunks == range->nbChunks; });
+}
+
+ThreadPool & ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+unsigned int ThreadPool::defaultSize()
+{
+  unsigned int hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
@@ -0,0 +1,89 @@
+/** @file */
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads executing tasks in submission order
+ *
+ * Tasks are either submitted one by one (submit()), or as a range of indices split among
+ * the workers and the calling thread (parallelFor()).
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief Constructor
+   * @param nbThreads the number of worker threads (without worker, the tasks are executed by the calling thread)
+   */
+  explicit ThreadPool(unsigned int nbThreads = defaultSize());
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /// Destructor, waits for the completion of the submitted tasks
+  ~ThreadPool();
+
+  /// number of worker threads
+  unsigned int size() const { return m_threads.size(); }
+
+  /**
+   * @brief queues a task
+   * @param task a callable object without argument
+   * @return the future result of the task
+   *
+   * @note without worker thread, the task is executed before returning
+   */
+  template <typename F> std::future<typename std::result_of<F()>::type> submit(F task);
+
+  /**
+   * @brief executes a function on a range of indices, split into chunks processed concurrently
+   * @param count the size of the range [0, count)
+   * @param body the function, called with sub-ranges [begin, end) of the range
+   * @param grain the minimal size of a chunk
+   *
+   * The calling thread also processes chunks, and returns once all the chunks have been processed.
+   * The function may thus be called from a task of the pool itself.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> & body, size_t grain = 1);
+
+  /// the pool shared by the whole process
+  static ThreadPool & global();
+
+  /// one worker thread per hardware thread, the calling thread excepted
+  static unsigned int defaultSize();
+
+private:
+  void work();
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping;
+};
+
+template <typename F> std::future<typename std::result_of<F()>::type> ThreadPool::submit(F task)
+{
+  typedef typename std::result_of<F()>::type Result;
+  std::shared_ptr<std::packaged_task<Result()>> packaged(new std::packaged_task<Result()>(std::move(task)));
+  std::future<Result> result = packaged->get_future();
+  if (m_threads.empty()) {
+    (*packaged)();
+    return result;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back([packaged]() { (*packaged)(); });
+  }
+  m_condition.notify_one();
+  return result;
+}
+
+#endif // !defined(__THREAD_POOL_H__)
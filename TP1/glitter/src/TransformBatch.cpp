@@ -0,0 +1,206 @@
+#include "TransformBatch.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "Simd.hpp"
+
+size_t TransformBatch::grain = 4096;
+size_t TransformBatch::streamingSize = 8 << 20;
+
+namespace
+{
+using simd::Float;
+
+/// rounds @p count up to a multiple of the SIMD width
+size_t padded(size_t count)
+{
+  return (count + Float::width - 1) / Float::width * Float::width;
+}
+
+/**
+ * @brief writes the lanes of registers as consecutive records
+ * @param values the registers, values[j] holding the j-th float of the record of each lane
+ * @param nbValues the number of floats per record (at most 16)
+ * @param nbLanes the number of records written (the first lanes)
+ * @param out receives the record of lane i at out + i * nbValues
+ * @param stream denotes if the registers bypass the caches (out being aligned on sizeof(Float))
+ *
+ * If nbValues is a multiple of the width, tiles of width x width are transposed in registers, so that each
+ * record is written by whole registers. Otherwise, the records of all the lanes are regrouped on the stack,
+ * then written as nbValues whole registers (which stay aligned, unlike the records).
+ */
+void storeRecords(const Float * values, unsigned int nbValues, unsigned int nbLanes, float * out, bool stream)
+{
+  if (nbValues % Float::width == 0) {
+    for (unsigned int first = 0; first < nbValues; first += Float::width) {
+      Float tile[Float::width];
+      std::copy(values + first, values + first + Float::width, tile);
+      simd::transpose(tile);
+      for (unsigned int i = 0; i < nbLanes; i++) {
+        if (stream) {
+          tile[i].stream(out + i * nbValues + first);
+        } else {
+          tile[i].store(out + i * nbValues + first);
+        }
+      }
+    }
+    return;
+  }
+  alignas(32) float lanes[16 * Float::width], block[16 * Float::width];
+  for (unsigned int j = 0; j < nbValues; j++) {
+    values[j].store(lanes + j * Float::width);
+  }
+  for (unsigned int i = 0; i < Float::width; i++) {
+    for (unsigned int j = 0; j < nbValues; j++) {
+      block[i * nbValues + j] = lanes[j * Float::width + i];
+    }
+  }
+  if (stream and nbLanes == Float::width) {
+    for (unsigned int k = 0; k < nbValues; k++) {
+      Float::load(block + k * Float::width).stream(out + k * Float::width);
+    }
+  } else {
+    std::memcpy(out, block, nbLanes * nbValues * sizeof(float));
+  }
+}
+} // namespace
+
+TransformBatch::TransformBatch() : m_size(0) {}
+
+void TransformBatch::resize(size_t count)
+{
+  const size_t oldSize = m_size;
+  m_size = count;
+  for (auto & coefficients : m_coefficients) {
+    coefficients.resize(padded(count), 0.f);
+  }
+  // identity matrices, the padding included (which keeps its normal matrices finite)
+  for (size_t k = oldSize; k < padded(count); k++) {
+    for (unsigned int r = 0; r < 3; r++) {
+      for (unsigned int c = 0; c < 4; c++) {
+        m_coefficients[4 * r + c][k] = (r == c) ? 1.f : 0.f;
+      }
+    }
+  }
+}
+
+size_t TransformBatch::add(const glm::mat4 & modelWorld)
+{
+  resize(m_size + 1);
+  set(m_size - 1, modelWorld);
+  return m_size - 1;
+}
+
+void TransformBatch::set(size_t index, const glm::mat4 & modelWorld)
+{
+  assert(index < m_size);
+  for (unsigned int r = 0; r < 3; r++) {
+    for (unsigned int c = 0; c < 4; c++) {
+      m_coefficients[4 * r + c][index] = modelWorld[c][r];
+    }
+  }
+}
+
+glm::mat4 TransformBatch::get(size_t index) const
+{
+  assert(index < m_size);
+  glm::mat4 modelWorld(1);
+  for (unsigned int r = 0; r < 3; r++) {
+    for (unsigned int c = 0; c < 4; c++) {
+      modelWorld[c][r] = m_coefficients[4 * r + c][index];
+    }
+  }
+  return modelWorld;
+}
+
+void TransformBatch::compute(const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices, ThreadPool & pool) const
+{
+  const size_t size = m_size * (sizeof(glm::mat4) + (normalMatrices ? sizeof(glm::mat3) : 0));
+  compute(proj, view, mvps, normalMatrices, pool, size >= streamingSize);
+}
+
+void TransformBatch::compute(const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices, ThreadPool & pool, bool stream) const
+{
+  // chunks of whole registers
+  const size_t nbBlocks = padded(m_size) / Float::width;
+  auto aligned = [](const void * p) { return reinterpret_cast<uintptr_t>(p) % sizeof(Float) == 0; };
+  stream = stream and aligned(mvps) and (not normalMatrices or aligned(normalMatrices));
+  pool.parallelFor(nbBlocks, [&](size_t begin, size_t end) { compute(begin * Float::width, std::min(m_size, end * Float::width), proj, view, mvps, normalMatrices, stream); },
+                   std::max<size_t>(grain / Float::width, 1));
+}
+
+void TransformBatch::compute(size_t begin, size_t end, const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices, bool stream) const
+{
+  const glm::mat4 projView = proj * view;
+  Float pv[4][4], v[3][3];
+  for (unsigned int c = 0; c < 4; c++) {
+    for (unsigned int r = 0; r < 4; r++) {
+      pv[c][r] = Float(projView[c][r]);
+      if (c < 3 and r < 3) {
+        v[c][r] = Float(view[c][r]);
+      }
+    }
+  }
+  for (size_t first = begin; first < end; first += Float::width) {
+    Float w[nbCoefficients];
+    for (unsigned int k = 0; k < nbCoefficients; k++) {
+      w[k] = Float::load(m_coefficients[k].data() + first);
+    }
+    const unsigned int nbLanes = std::min<size_t>(Float::width, end - first);
+
+    // mvp = projView * w, the last row of w being 0 0 0 1 (records of 16 floats, column-major as glm)
+    Float mvp[16];
+    for (unsigned int c = 0; c < 4; c++) {
+      for (unsigned int r = 0; r < 4; r++) {
+        Float value = pv[0][r] * w[c] + pv[1][r] * w[4 + c] + pv[2][r] * w[8 + c];
+        mvp[4 * c + r] = (c == 3) ? value + pv[3][r] : value;
+      }
+    }
+    storeRecords(mvp, 16, nbLanes, &mvps[first][0][0], stream);
+
+    if (normalMatrices) {
+      // columns of the 3x3 block of view * w, whose inverse transpose has the columns a1 x a2, a2 x a0 and a0 x a1 over the determinant
+      Float a[3][3];
+      for (unsigned int c = 0; c < 3; c++) {
+        for (unsigned int r = 0; r < 3; r++) {
+          a[c][r] = v[0][r] * w[c] + v[1][r] * w[4 + c] + v[2][r] * w[8 + c];
+        }
+      }
+      Float normal[9];
+      for (unsigned int c = 0; c < 3; c++) {
+        const Float * u = a[(c + 1) % 3];
+        const Float * t = a[(c + 2) % 3];
+        normal[3 * c + 0] = u[1] * t[2] - u[2] * t[1];
+        normal[3 * c + 1] = u[2] * t[0] - u[0] * t[2];
+        normal[3 * c + 2] = u[0] * t[1] - u[1] * t[0];
+      }
+      Float inverseDeterminant = Float(1.f) / simd::dot(a[0][0], a[0][1], a[0][2], normal[0], normal[1], normal[2]);
+      for (auto & value : normal) {
+        value = value * inverseDeterminant;
+      }
+      storeRecords(normal, 9, nbLanes, &normalMatrices[first][0][0], stream);
+    }
+  }
+  if (stream) {
+    simd::fence();
+  }
+}
+
+void TransformBatch::upload(Buffer & instances, const glm::mat4 & proj, const glm::mat4 & view, bool normalMatrices, ThreadPool & pool) const
+{
+  if (m_size == 0) {
+    return;
+  }
+  instances.allocate(normalMatricesOffset() + (normalMatrices ? m_size * sizeof(glm::mat3) : 0));
+  unsigned char * data = static_cast<unsigned char *>(instances.map());
+  if (!data) {
+    std::cerr << __PRETTY_FUNCTION__ << ": could not map the instance buffer" << std::endl;
+    instances.unbind();
+    return;
+  }
+  // the mapped memory is usually write-combined, which expects whole aligned writes instead of cached ones
+  compute(proj, view, reinterpret_cast<glm::mat4 *>(data), normalMatrices ? reinterpret_cast<glm::mat3 *>(data + normalMatricesOffset()) : nullptr, pool, true);
+  if (not instances.unmap()) {
+    std::cerr << __PRETTY_FUNCTION__ << ": the instance buffer was lost while mapped" << std::endl;
+  }
+}
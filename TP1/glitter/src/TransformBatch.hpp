@@ -0,0 +1,80 @@
+/** @file */
+#ifndef __TRANSFORM_BATCH_H__
+#define __TRANSFORM_BATCH_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "ThreadPool.hpp"
+#include "glApi.hpp"
+
+/**
+ * @brief A set of affine modelWorld matrices, transformed all at once
+ *
+ * The matrices are stored as a structure of arrays: one array per coefficient of the first three rows
+ * (the last row being 0 0 0 1). The model-view-projection matrices, and optionally the normal matrices
+ * (inverse transpose of the model-view 3x3 block), are thus computed for simd::Float::width instances at a
+ * time, then transposed in registers and written as arrays of glm matrices, e.g. straight into a mapped
+ * instance buffer (see upload()). The results larger than streamingSize, and the ones written into mapped
+ * buffers, bypass the caches (non-temporal stores): they are not read back by the CPU.
+ */
+class TransformBatch {
+public:
+  TransformBatch();
+
+  /// number of matrices
+  size_t size() const { return m_size; }
+
+  /// changes the number of matrices, the new ones being the identity
+  void resize(size_t count);
+
+  /**
+   * @brief appends a matrix
+   * @param modelWorld the affine modelWorld matrix
+   * @return the index of the matrix
+   */
+  size_t add(const glm::mat4 & modelWorld);
+
+  /// replaces the matrix at @p index by @p modelWorld (an affine matrix)
+  void set(size_t index, const glm::mat4 & modelWorld);
+
+  /// the matrix at @p index
+  glm::mat4 get(size_t index) const;
+
+  /**
+   * @brief computes the transforms of all the matrices
+   * @param proj the projection matrix
+   * @param view the worldView matrix
+   * @param mvps receives the size() model-view-projection matrices
+   * @param normalMatrices if not null, receives the size() normal matrices
+   * @param pool the threads sharing the computation (the calling one included)
+   */
+  void compute(const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices = nullptr, ThreadPool & pool = ThreadPool::global()) const;
+
+  /**
+   * @brief computes the transforms of all the matrices into an instance buffer
+   * @param instances the buffer, reallocated then mapped to receive the size() model-view-projection matrices,
+   *        followed by the size() normal matrices (at normalMatricesOffset()) if requested
+   * @param proj the projection matrix
+   * @param view the worldView matrix
+   * @param normalMatrices denotes if the normal matrices are computed
+   * @param pool the threads sharing the computation (the calling one included)
+   *
+   * @see VAO::setInstanceMatrices
+   */
+  void upload(Buffer & instances, const glm::mat4 & proj, const glm::mat4 & view, bool normalMatrices = false, ThreadPool & pool = ThreadPool::global()) const;
+
+  /// position in bytes of the normal matrices in the buffer filled by upload()
+  size_t normalMatricesOffset() const { return m_size * sizeof(glm::mat4); }
+
+  static const unsigned int nbCoefficients = 12; ///< coefficients stored per matrix
+  static size_t grain;                           ///< minimal number of matrices computed by a thread
+  static size_t streamingSize;                   ///< minimal size in bytes of the results written bypassing the caches (larger than the caches)
+
+private:
+  void compute(const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices, ThreadPool & pool, bool stream) const;
+  void compute(size_t begin, size_t end, const glm::mat4 & proj, const glm::mat4 & view, glm::mat4 * mvps, glm::mat3 * normalMatrices, bool stream) const;
+
+  size_t m_size;                                     ///< number of matrices
+  std::vector<float> m_coefficients[nbCoefficients]; ///< coefficient (row r, column c) of the matrices in array 4 * r + c, padded to a multiple of simd::Float::width
+};
+
+#endif // !defined(__TRANSFORM_BATCH_H__)
@@ -0,0 +1,47 @@
+/** @file */
+#ifndef __VERSIONED_H__
+#define __VERSIONED_H__
+
+/**
+ * @brief A value with a version number, incremented whenever the value changes
+ *
+ * The data derived from the value (e.g. the uniform variables of a program) record the version they were
+ * computed from, and are only computed again when the version differs (see ProgramVariants::outdated).
+ * As the versions only increase, the sum of the versions of several values increases whenever one of them
+ * changes, hence is the version of the data derived from all of them.
+ */
+template <typename T> class Versioned {
+public:
+  /// Constructor (the version of the initial value is 1, so that 0 denotes data never computed)
+  explicit Versioned(const T & value = T()) : m_value(value), m_version(1) {}
+
+  /// the value
+  const T & get() const { return m_value; }
+
+  /// the version of the value
+  unsigned int version() const { return m_version; }
+
+  /**
+   * @brief sets the value
+   * @param value the new value
+   * @return true if the value changed, which incremented the version
+   */
+  bool set(const T & value)
+  {
+    if (value == m_value) {
+      return false;
+    }
+    m_value = value;
+    m_version++;
+    return true;
+  }
+
+  /// increments the version, for a change of the data derived from the value which is not visible in the value
+  void touch() { m_version++; }
+
+private:
+  T m_value;              ///< the value
+  unsigned int m_version; ///< number of changes of the value, plus one
+};
+
+#endif // !defined(__VERSIONED_H__)
@@ -1,12 +1,14 @@
+#include <algorithm>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 
+#include "ShaderSource.hpp"
 #include "glApi.hpp"
 #include "utils.hpp"
 
-Buffer::Buffer(GLenum target) : m_location(0), m_target(target), m_attributeSize(0)
+Buffer::Buffer(GLenum target) : m_location(0), m_target(target), m_attributeSize(0), m_size(0)
 {
   glGenBuffers( 1, &m_location);
 }
@@ -41,6 +43,69 @@ uint Buffer::attributeSize() const
   return m_attributeSize;
 }
 
+void Buffer::allocate(size_t size, GLenum usage)
+{
+  bind();
+  glBufferData(m_target, size, nullptr, usage);
+  unbind();
+  m_size = size;
+}
+
+size_t Buffer::size() const
+{
+  return m_size;
+}
+
+void * Buffer::map()
+{
+  bind();
+  return glMapBufferRange(m_target, 0, m_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+bool Buffer::unmap()
+{
+  bool valid = glUnmapBuffer(m_target) == GL_TRUE;
+  unbind();
+  return valid;
+}
+
+void Buffer::bindBase(uint index, GLenum target) const
+{
+  glBindBufferBase(target, index, m_location);
+}
+
+void Buffer::unbindBase(uint index, GLenum target)
+{
+  glBindBufferBase(target, index, 0);
+}
+
+void Buffer::read(void * data, size_t size, size_t offset) const
+{
+  bind();
+  glGetBufferSubData(m_target, offset, size, data);
+  unbind();
+}
+
+void Buffer::write(const void * data, size_t size, size_t offset)
+{
+  assert(offset + size <= m_size);
+  bind();
+  glBufferSubData(m_target, offset, size, data);
+  unbind();
+}
+
+void Buffer::clear()
+{
+  bind();
+  glClearBufferData(m_target, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  unbind();
+}
+
+uint Buffer::location() const
+{
+  return m_location;
+}
+
 VAO::VAO(uint nbVBO) : m_location(0), m_vbos(nbVBO), m_ibo(GL_ELEMENT_ARRAY_BUFFER)
 {
   assert(nbVBO <= GL_MAX_VERTEX_ATTRIBS); // You may want to replace 16 by the real hardware limitation
@@ -96,14 +161,122 @@ void VAO::draw(GLenum mode) const
     unbind();
 }
 
-Shader::Shader(GLenum type, const std::string & filename) : m_location(0)
+void VAO::draw(GLenum mode, uint offset, uint count) const
+{
+  bind();
+  drawBound(mode, offset, count);
+  unbind();
+}
+
+void VAO::draw(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts) const
+{
+  if (counts.empty()) {
+    return;
+  }
+  bind();
+  drawBound(mode, offsets, counts);
+  unbind();
+}
+
+uint VAO::nbIndices() const
+{
+  return m_ibo.attributeCount();
+}
+
+uint VAO::location() const
+{
+  return m_location;
+}
+
+void VAO::drawBound(GLenum mode, uint offset, uint count) const
+{
+  const size_t indexSize = (m_ibo.attributeType() == GL_UNSIGNED_BYTE) ? 1 : (m_ibo.attributeType() == GL_UNSIGNED_SHORT) ? 2 : 4;
+  glDrawElements(mode, count, m_ibo.attributeType(), reinterpret_cast<const void *>(offset * indexSize));
+}
+
+void VAO::drawBound(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts) const
+{
+  if (counts.empty()) {
+    return;
+  }
+  const size_t indexSize = (m_ibo.attributeType() == GL_UNSIGNED_BYTE) ? 1 : (m_ibo.attributeType() == GL_UNSIGNED_SHORT) ? 2 : 4;
+  std::vector<const void *> pointers(offsets.size());
+  for (size_t k = 0; k < offsets.size(); k++) {
+    pointers[k] = reinterpret_cast<const void *>(offsets[k] * indexSize);
+  }
+  glMultiDrawElements(mode, counts.data(), m_ibo.attributeType(), pointers.data(), counts.size());
+}
+
+void VAO::setInstanceMatrices(uint attributeIndex, const Buffer & buffer, uint nbColumns, uint nbRows, size_t offset) const
+{
+  assert(attributeIndex >= m_vbos.size());
+  const size_t columnSize = nbRows * sizeof(float);
+  bind();
+  buffer.bind();
+  for (uint column = 0; column < nbColumns; column++) {
+    glEnableVertexAttribArray(attributeIndex + column);
+    glVertexAttribPointer(attributeIndex + column, nbRows, GL_FLOAT, GL_FALSE, nbColumns * columnSize, reinterpret_cast<const void *>(offset + column * columnSize));
+    glVertexAttribDivisor(attributeIndex + column, 1);
+  }
+  buffer.unbind();
+  unbind();
+}
+
+void VAO::drawInstanced(GLenum mode, uint nbInstances) const
+{
+  bind();
+  glDrawElementsInstanced(mode, m_ibo.attributeCount(), m_ibo.attributeType(), 0, nbInstances);
+  unbind();
+}
+
+void VAO::setInstanceIndices(uint attributeIndex, const Buffer & buffer) const
+{
+  assert(attributeIndex >= m_vbos.size());
+  bind();
+  buffer.bind();
+  glEnableVertexAttribArray(attributeIndex);
+  glVertexAttribIPointer(attributeIndex, 1, GL_UNSIGNED_INT, 0, 0);
+  glVertexAttribDivisor(attributeIndex, 1);
+  buffer.unbind();
+  unbind();
+}
+
+void VAO::multiDrawIndirect(GLenum mode, const Buffer & commands, uint maxDrawCount, const Buffer * drawCount) const
+{
+  bind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.location());
+  if (drawCount) {
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCount->location());
+    glMultiDrawElementsIndirectCountARB(mode, m_ibo.attributeType(), 0, 0, maxDrawCount, 0);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+  } else {
+    glMultiDrawElementsIndirect(mode, m_ibo.attributeType(), 0, maxDrawCount, 0);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  unbind();
+}
+
+Shader::Shader(GLenum type, const std::string & filename, const std::vector<std::string> & defines) : m_location(0)
 {
     m_location = glCreateShader(type);
-    std::string content = fileContent(filename);
-    const char *c_str = content.c_str();
-    const int l_str { content.size() };
+    ShaderSource source = preprocessShader(filename, defines);
+    const char *c_str = source.code.c_str();
+    const int l_str = source.code.size();
     glShaderSource(m_location, 1, &c_str, &l_str);
     glCompileShader(m_location);
+    int compiled = GL_FALSE;
+    glGetShaderiv(m_location, GL_COMPILE_STATUS, &compiled);
+    if (compiled == GL_FALSE) {
+      int length = 0;
+      glGetShaderiv(m_location, GL_INFO_LOG_LENGTH, &length);
+      std::string log(std::max(length, 1), '\0');
+      glGetShaderInfoLog(m_location, log.size(), nullptr, &log[0]);
+      std::cerr << "failed to compile " << filename << " (source strings:";
+      for (size_t k = 0; k < source.files.size(); k++) {
+        std::cerr << " " << k << "=" << source.files[k];
+      }
+      std::cerr << ")" << std::endl << log.c_str() << std::endl;
+    }
 }
 
 Shader::~Shader()
@@ -116,19 +289,24 @@ uint Shader::location() const
   return m_location;
 }
 
-Program::Program(const std::string & vname, const std::string & fname) : m_location(0), m_vshader(GL_VERTEX_SHADER, vname), m_fshader(GL_FRAGMENT_SHADER, fname)
+Program::Program(const std::string & vname, const std::string & fname) : Program({{GL_VERTEX_SHADER, vname}, {GL_FRAGMENT_SHADER, fname}}) {}
+
+Program::Program(const std::vector<std::pair<GLenum, std::string>> & stages, const std::vector<std::string> & defines) : m_location(0)
 {
     //allocate the GPU memory for the program
     m_location = glCreateProgram();
 
-    //attach the fragment and vertex shaders
-    glAttachShader(m_location, m_vshader.location());
-    glAttachShader(m_location, m_fshader.location());
+    //attach the shaders of all the stages
+    for (const auto & stage : stages) {
+      m_shaders.emplace_back(new Shader(stage.first, stage.second, defines));
+      glAttachShader(m_location, m_shaders.back()->location());
+    }
     //link the program
     glLinkProgram(m_location);
-    //detach the fragment and vertex shaders (so they can be deleted)
-    glDetachShader(m_location, m_vshader.location());
-    glDetachShader(m_location, m_fshader.location());
+    //detach the shaders (so they can be deleted)
+    for (const auto & shader : m_shaders) {
+      glDetachShader(m_location, shader->location());
+    }
  }
 
 Program::~Program()
@@ -146,6 +324,11 @@ void Program::unbind() const
   glUseProgram(0);
 }
 
+uint Program::location() const
+{
+  return m_location;
+}
+
 bool Program::getUniformLocation(const std::string & name, int & location) const
 {
     location = glGetUniformLocation(m_location, name.c_str());
@@ -204,6 +387,139 @@ bool Program::bound() const
   return m_location == (GLuint)currentProgram;
 }
 
+ComputeProgram::ComputeProgram(const std::string & filename, const std::vector<std::string> & defines) : Program({{GL_COMPUTE_SHADER, filename}}, defines) {}
+
+glm::uvec3 ComputeProgram::workGroupSize() const
+{
+  int size[3] = {0, 0, 0};
+  glGetProgramiv(location(), GL_COMPUTE_WORK_GROUP_SIZE, size);
+  return glm::uvec3(size[0], size[1], size[2]);
+}
+
+void ComputeProgram::dispatch(uint x, uint y, uint z) const
+{
+  if (not bound()) {
+    std::cerr << __PRETTY_FUNCTION__ << ": the program is not bound" << std::endl;
+    return;
+  }
+  glDispatchCompute(x, y, z);
+}
+
+void ComputeProgram::dispatchIndirect(const Buffer & commands, size_t offset) const
+{
+  if (not bound()) {
+    std::cerr << __PRETTY_FUNCTION__ << ": the program is not bound" << std::endl;
+    return;
+  }
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, commands.location());
+  glDispatchComputeIndirect(offset);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+ProgramVariants::ProgramVariants(const std::vector<std::pair<GLenum, std::string>> & stages, const std::vector<std::string> & options, const Setup & setup)
+    : m_stages(stages), m_options(options), m_setup(setup), m_current(nullptr), m_currentKey(0)
+{
+  assert(options.size() <= 32);
+  select(0);
+}
+
+ProgramVariants::ProgramVariants(const std::string & vname, const std::string & fname, const std::vector<std::string> & options, const Setup & setup)
+    : ProgramVariants({{GL_VERTEX_SHADER, vname}, {GL_FRAGMENT_SHADER, fname}}, options, setup)
+{
+}
+
+uint ProgramVariants::option(const std::string & name) const
+{
+  auto found = std::find(m_options.begin(), m_options.end(), name);
+  if (found == m_options.end()) {
+    std::cerr << __PRETTY_FUNCTION__ << ": unknown option " << name << std::endl;
+    return 0;
+  }
+  return 1u << (found - m_options.begin());
+}
+
+Program & ProgramVariants::variant(uint key)
+{
+  auto found = m_variants.find(key);
+  if (found != m_variants.end()) {
+    return *found->second;
+  }
+  std::vector<std::string> defines;
+  for (size_t k = 0; k < m_options.size(); k++) {
+    if (key & (1u << k)) {
+      defines.push_back(m_options[k]);
+    }
+  }
+  std::unique_ptr<Program> & program = m_variants[key];
+  program.reset(new Program(m_stages, defines));
+  if (m_setup) {
+    program->bind();
+    m_setup(*program);
+    program->unbind();
+  }
+  return *program;
+}
+
+Program & ProgramVariants::select(uint key)
+{
+  m_current = &variant(key);
+  m_currentKey = key;
+  return *m_current;
+}
+
+bool ProgramVariants::outdated(uint version)
+{
+  uint & uploaded = m_versions[m_currentKey];
+  if (uploaded == version) {
+    return false;
+  }
+  uploaded = version;
+  return true;
+}
+
+namespace barrier
+{
+void storage()
+{
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void vertexAttributes()
+{
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void elementArray()
+{
+  glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT);
+}
+
+void indirectCommands()
+{
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void uniforms()
+{
+  glMemoryBarrier(GL_UNIFORM_BARRIER_BIT);
+}
+
+void bufferUpdate()
+{
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void textureFetch()
+{
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void imageAccess()
+{
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+} // namespace barrier
+
 Texture::Texture(GLenum target) : m_location(0), m_target(target)
 {
     //At construction the GPU memory must be allocated, and the target must be recorded.
@@ -224,10 +540,18 @@ void Texture::bind() const
 
 void Texture::unbind() const
 {
-  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindTexture(m_target, 0);
 }
 
-template <> void Texture::setData<GLubyte>(const Image<GLubyte> & image, bool mipmaps) const
+uint Texture::location() const
+{
+  return m_location;
+}
+
+bool Texture::cpuMipmaps = true;
+MipmapFilter Texture::mipmapFilter = MipmapFilter::Kaiser;
+
+template <> void Texture::setData<GLubyte>(const Image<GLubyte> & image, bool mipmaps, bool srgb) const
 {
     /* It should bind this texture, and send the data to it and then unbind the texture.
      * You should take care of calling the correct ::glTexImage function depending on
@@ -241,16 +565,163 @@ template <> void Texture::setData<GLubyte>(const Image<GLubyte> & image, bool mi
         case 3: color = GL_RGB; break;
         case 4: color = GL_RGBA; break;
     }
+    // the rows of the small levels (and of RGB images) are not 4 bytes aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     if(m_target == GL_TEXTURE_2D) {
         glTexImage2D(GL_TEXTURE_2D, 0, color, image.width, image.height, 0, color, GL_UNSIGNED_BYTE, image.data);
     } else {
         glTexImage3D(GL_TEXTURE_3D, 0, color, image.width, image.height, image.depth, 0, color, GL_UNSIGNED_BYTE, image.data);
     }
-    if(mipmaps)
+    if(mipmaps and cpuMipmaps and m_target == GL_TEXTURE_2D) {
+        std::vector<Image<GLubyte>> levels = generateMipmaps(image, srgb, mipmapFilter);
+        for(size_t k = 0; k < levels.size(); k++)
+            glTexImage2D(GL_TEXTURE_2D, k + 1, color, levels[k].width, levels[k].height, 0, color, GL_UNSIGNED_BYTE, levels[k].data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels.size());
+    } else if(mipmaps) {
         glGenerateMipmap(m_target);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     unbind();
 }
 
+void Texture::setLevelData(int level, const Image<GLubyte> & image) const
+{
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  GLenum format = formats[image.channels - 1];
+  bind();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, level, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  unbind();
+}
+
+void Texture::releaseLevel(int level) const
+{
+  // a 0x0 image has no storage
+  bind();
+  glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  unbind();
+}
+
+void Texture::setLevelRange(int baseLevel, int maxLevel) const
+{
+  bind();
+  glTexParameteri(m_target, GL_TEXTURE_BASE_LEVEL, baseLevel);
+  glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, maxLevel);
+  unbind();
+}
+
+void Texture::setBuffer(const Buffer & buffer, GLenum internalFormat) const
+{
+  assert(m_target == GL_TEXTURE_BUFFER);
+  bind();
+  glTexBuffer(m_target, internalFormat, buffer.location());
+  unbind();
+}
+
+void Texture::allocate(GLenum internalFormat, int width, int height) const
+{
+  assert(m_target == GL_TEXTURE_2D);
+  const bool depth = internalFormat == GL_DEPTH_COMPONENT16 or internalFormat == GL_DEPTH_COMPONENT24 or internalFormat == GL_DEPTH_COMPONENT32F;
+  bind();
+  glTexImage2D(m_target, 0, internalFormat, width, height, 0, depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(m_target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(m_target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, 0);
+  unbind();
+}
+
+Framebuffer::Framebuffer() : m_location(0)
+{
+  glGenFramebuffers(1, &m_location);
+}
+
+Framebuffer::~Framebuffer()
+{
+  glDeleteFramebuffers(1, &m_location);
+}
+
+void Framebuffer::bind() const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, m_location);
+}
+
+void Framebuffer::unbind() const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::attach(GLenum attachment, const Texture & texture) const
+{
+  bind();
+  glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture.location(), 0);
+  unbind();
+}
+
+void Framebuffer::setDrawBuffers(uint count) const
+{
+  std::vector<GLenum> buffers;
+  for (uint k = 0; k < count; k++) {
+    buffers.push_back(GL_COLOR_ATTACHMENT0 + k);
+  }
+  bind();
+  glDrawBuffers(count, buffers.data());
+  unbind();
+}
+
+bool Framebuffer::complete() const
+{
+  bind();
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  unbind();
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << __PRETTY_FUNCTION__ << ": incomplete framebuffer (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+  }
+  return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+uint Framebuffer::location() const
+{
+  return m_location;
+}
+
+Query::Query(GLenum target) : m_location(0), m_target(target), m_started(false)
+{
+  glGenQueries(1, &m_location);
+}
+
+Query::~Query()
+{
+  glDeleteQueries(1, &m_location);
+}
+
+void Query::begin()
+{
+  glBeginQuery(m_target, m_location);
+  m_started = true;
+}
+
+void Query::end() const
+{
+  glEndQuery(m_target);
+}
+
+bool Query::available() const
+{
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(m_location, GL_QUERY_RESULT_AVAILABLE, &available);
+  return available == GL_TRUE;
+}
+
+GLuint64 Query::result() const
+{
+  GLuint64 value = 0;
+  glGetQueryObjectui64v(m_location, GL_QUERY_RESULT, &value);
+  return value;
+}
+
 Sampler::Sampler(int texUnit) : m_location(0), m_texUnit(texUnit)
 {
   glGenSamplers(1, &m_location);
@@ -271,16 +742,26 @@ void Sampler::unbind() const
   glBindSampler(m_texUnit, 0);
 }
 
+uint Sampler::location() const
+{
+  return m_location;
+}
+
 void Sampler::attachToProgram(const Program & prog, const std::string & samplerName, BindOption bindOption) const
 {
-    if(bindOption != DoNotBind)
-        prog.setUniform(samplerName, m_texUnit);
+  if (bindOption == BindUnbind) {
+    prog.bind();
+  }
+  prog.setUniform(samplerName, m_texUnit);
+  if (bindOption == BindUnbind) {
+    prog.unbind();
+  }
 }
 
 void Sampler::attachTexture(const Texture & texture) const
 {
-    glActiveTexture(m_texUnit);
-    texture.bind();
+  glActiveTexture(GL_TEXTURE0 + m_texUnit);
+  texture.bind();
 }
 
 template <> void Sampler::setParameter<int>(GLenum paramName, const int & value) const
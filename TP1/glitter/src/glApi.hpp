@@ -2,14 +2,19 @@
 #define __GLAPI__HPP
 #include <GL/glew.h>
 #include <cassert>
+#include <functional>
+#include <glm/glm.hpp>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 typedef GLuint uint;
 
 #include "AttributeProperties.hpp"
 #include "Image.hpp"
+#include "MipmapGenerator.hpp"
 
 /**
  * @brief Tiny abstraction for OpenGL objects that can be bound to
@@ -105,12 +110,78 @@ public:
    */
   GLenum attributeSize() const;
 
+  /**
+   * @brief allocates the GPU memory of this Buffer, without initializing it
+   * @param size the size in bytes
+   * @param usage the expected usage (GL_STREAM_DRAW for data rewritten every frame)
+   *
+   * @note the previous storage is orphaned: the GPU may still read it while the new one is written
+   */
+  void allocate(size_t size, GLenum usage = GL_STREAM_DRAW);
+
+  /// size in bytes of the storage created by allocate()
+  size_t size() const;
+
+  /**
+   * @brief maps the whole storage for writing, its previous content being discarded
+   * @return the address of the mapping (null on failure), valid until unmap()
+   *
+   * @note this Buffer stays bound until unmap()
+   */
+  void * map();
+
+  /**
+   * @brief unmaps the storage mapped by map(), and unbinds this Buffer
+   * @return false if the content was lost while mapped (e.g. on a display mode change)
+   */
+  bool unmap();
+
+  /**
+   * @brief binds this Buffer to an indexed binding point (e.g. a shader storage block)
+   * @param index the binding point, as given by layout(binding = index) in the shaders
+   * @param target GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER or GL_ATOMIC_COUNTER_BUFFER
+   *
+   * @note the generic binding point of @p target is changed too
+   */
+  void bindBase(uint index, GLenum target = GL_SHADER_STORAGE_BUFFER) const;
+
+  /// unbinds the buffer of the indexed binding point @p index of @p target (see bindBase())
+  static void unbindBase(uint index, GLenum target = GL_SHADER_STORAGE_BUFFER);
+
+  /**
+   * @brief reads back a part of the storage (e.g. written by a compute shader)
+   * @param data receives the content
+   * @param size the size in bytes
+   * @param offset the position in bytes of the first byte read
+   *
+   * @note this call waits for the GPU, it is meant for checks and not for every frame
+   */
+  void read(void * data, size_t size, size_t offset = 0) const;
+
+  /**
+   * @brief replaces a part of the storage created by allocate()
+   * @param data the new content
+   * @param size the size in bytes
+   * @param offset the position in bytes of the first byte written
+   */
+  void write(const void * data, size_t size, size_t offset = 0);
+
+  /// fills the storage created by allocate() with zeros (e.g. the counters of a compute shader)
+  void clear();
+
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
 private:
   uint m_location;        ///< GPU location of the buffer
   GLenum m_target;        ///< Type of buffer (VBO or IBO)
   uint m_attributeCount;  ///< Buffer formatting : number of attributes
   GLenum m_attributeType; ///< Buffer formatting : type of attributes
   uint m_attributeSize;   ///< Buffer formatting : components per attribute
+  size_t m_size;          ///< size in bytes of the storage created by allocate()
 };
 
 /**
@@ -203,6 +274,88 @@ public:
    */
   void draw(GLenum mode = GL_TRIANGLES) const;
 
+  /**
+   * @brief Make the draw call to render a range of the IBO
+   * @param mode primitive type
+   * @param offset index of the first IBO element to be drawn
+   * @param count number of IBO elements to be drawn
+   */
+  void draw(GLenum mode, uint offset, uint count) const;
+
+  /**
+   * @brief Make a single multi-draw call to render several ranges of the IBO
+   * @param mode primitive type
+   * @param offsets index of the first IBO element of each range
+   * @param counts number of IBO elements of each range
+   */
+  void draw(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts) const;
+
+  /// number of elements of the IBO
+  uint nbIndices() const;
+
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
+  /**
+   * @brief Make the draw call to render a range of the IBO, this VAO being already bound
+   * @param mode primitive type
+   * @param offset index of the first IBO element to be drawn
+   * @param count number of IBO elements to be drawn
+   *
+   * @note unlike draw(), the VAO is neither bound nor unbound, so that consecutive draws of the same VAO (see RenderQueue) bind it once
+   */
+  void drawBound(GLenum mode, uint offset, uint count) const;
+
+  /**
+   * @brief Make a single multi-draw call to render several ranges of the IBO, this VAO being already bound
+   * @param mode primitive type
+   * @param offsets index of the first IBO element of each range
+   * @param counts number of IBO elements of each range
+   */
+  void drawBound(GLenum mode, const std::vector<uint> & offsets, const std::vector<GLsizei> & counts) const;
+
+  /**
+   * @brief sets up per-instance matrices, read from a buffer shared with other VAOs
+   * @param attributeIndex the anchor point of the first column, the @p nbColumns columns using consecutive anchor points
+   * @param buffer the buffer holding one matrix per instance (column-major floats, tightly packed as glm matrices)
+   * @param nbColumns the number of columns of the matrices
+   * @param nbRows the number of rows of the matrices
+   * @param offset the position in bytes of the matrix of the first instance drawn
+   *
+   * @note the anchor points must not be used by the VBOs. The buffer may be reallocated afterwards (see Buffer::allocate).
+   */
+  void setInstanceMatrices(uint attributeIndex, const Buffer & buffer, uint nbColumns, uint nbRows, size_t offset = 0) const;
+
+  /**
+   * @brief Make a single draw call rendering the whole IBO several times
+   * @param mode primitive type
+   * @param nbInstances the number of instances (each one reading its own per-instance matrices)
+   */
+  void drawInstanced(GLenum mode, uint nbInstances) const;
+
+  /**
+   * @brief sources an instanced integer attribute (one uint per instance) from a buffer
+   * @param attributeIndex the attribute location (must be greater than the VBOs of this VAO)
+   * @param buffer a GL_ARRAY_BUFFER holding one uint per instance
+   *
+   * @note the baseInstance of the indirect draw commands is the index of the value read by their first instance
+   */
+  void setInstanceIndices(uint attributeIndex, const Buffer & buffer) const;
+
+  /**
+   * @brief Makes the draw calls whose parameters (count, instanceCount, firstIndex, baseVertex, baseInstance) are read from a buffer
+   * @param mode primitive type
+   * @param commands a GL_DRAW_INDIRECT_BUFFER of tightly packed commands (five uint each)
+   * @param maxDrawCount the number of commands (the maximum number if @p drawCount is given)
+   * @param drawCount if not null, a buffer holding the number of commands as its first uint (requires ARB_indirect_parameters)
+   *
+   * @note the draw calls source the IBO of this VAO
+   */
+  void multiDrawIndirect(GLenum mode, const Buffer & commands, uint maxDrawCount, const Buffer * drawCount = nullptr) const;
+
 private:
   /**
    * @brief encapsulates the VBO in this VAO
@@ -236,14 +389,15 @@ public:
    * @brief Constructor from a filename
    * @param type Vertex or Fragment shader
    * @param filename the name of the source file
+   * @param defines the preprocessor definitions injected in the source (see ShaderSource.hpp ::preprocessShader)
    *
    * @note PA1: At construction, the following actions must take place:
    * 	- GPU memory allocation
-   * 	- reading the content of the file named @p filename (see utils.hpp ::fileContent)
+   * 	- reading the content of the file named @p filename, its includes being resolved (see ShaderSource.hpp ::preprocessShader)
    * 	- setting the source code of the shader
-   *    - compiling the shader
+   *    - compiling the shader (the compiler log is displayed on failure)
    */
-  Shader(GLenum type, const std::string & filename);
+  Shader(GLenum type, const std::string & filename, const std::vector<std::string> & defines = std::vector<std::string>());
   Shader(const Shader &) = delete;
   Shader & operator=(const Shader &) = delete;
 
@@ -267,7 +421,7 @@ private:
 /**
  * @brief The Program class.
  *
- * Encapsulates a vertex and a fragment shader.
+ * Encapsulates a vertex and a fragment shader, and possibly other stages (tessellation, geometry).
  * Copy constructor and assignment operator are disabled.
  */
 class Program : public OGLStateObject {
@@ -286,6 +440,16 @@ public:
    */
   Program(const std::string & vname, const std::string & fname);
 
+  /**
+   * @brief Constructs a program from an arbitrary set of shader stages
+   * @param stages the type (GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER,
+   * GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, ...) and the filename of each shader
+   * @param defines the preprocessor definitions injected in all the stages (see ShaderSource.hpp ::preprocessShader)
+   *
+   * @note a program with tessellation stages draws GL_PATCHES (see glPatchParameteri)
+   */
+  Program(const std::vector<std::pair<GLenum, std::string>> & stages, const std::vector<std::string> & defines = std::vector<std::string>());
+
   Program(const Program &) = delete;
   Program & operator=(const Program &) = delete;
 
@@ -319,6 +483,12 @@ public:
    */
   template <typename T> void setUniform(const std::string & name, const T & val) const;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
 private:
   /**
    * @brief a template wrapper for glUniform functions
@@ -339,6 +509,7 @@ private:
    */
   bool getUniformLocation(const std::string & name, int & location) const;
 
+protected:
   /**
    * @brief bound
    * @return true if this Program is already bound to the current openGL state
@@ -346,11 +517,151 @@ private:
   bool bound() const;
 
 private:
-  uint m_location;  ///< GPU location of the program
-  Shader m_vshader; ///< Vertex shader
-  Shader m_fshader; ///< Fragment shader
+  uint m_location;                                ///< GPU location of the program
+  std::vector<std::unique_ptr<Shader>> m_shaders; ///< Shaders of the stages (vertex, fragment, ...)
+};
+
+/**
+ * @brief A program made of a single compute shader
+ *
+ * The compute shader reads and writes buffers bound with Buffer::bindBase. Its writes are made visible to
+ * the following commands by the barriers of the namespace barrier, according to the way they read the data.
+ * Requires OpenGL 4.3.
+ */
+class ComputeProgram : public Program {
+public:
+  /**
+   * @brief Constructs a program from the filename of a compute shader
+   * @param filename filename of the compute shader
+   * @param defines the preprocessor definitions injected in the shader
+   */
+  ComputeProgram(const std::string & filename, const std::vector<std::string> & defines = std::vector<std::string>());
+
+  /// the local size (layout(local_size_x, local_size_y, local_size_z)) declared by the compute shader
+  glm::uvec3 workGroupSize() const;
+
+  /// the number of work groups of @p groupSize invocations covering @p count invocations
+  static uint groupCount(uint count, uint groupSize) { return (count + groupSize - 1) / groupSize; }
+
+  /**
+   * @brief launches work groups of the compute shader
+   * @param x the number of work groups in x
+   * @param y the number of work groups in y
+   * @param z the number of work groups in z
+   *
+   * @note this Program must be bound (as for setUniform)
+   */
+  void dispatch(uint x, uint y = 1, uint z = 1) const;
+
+  /**
+   * @brief launches work groups whose counts are read from a buffer, e.g. written by a previous compute pass
+   * @param commands the buffer holding the three uint (x, y, z) of the command
+   * @param offset the position in bytes of the command in @p commands (a multiple of 4)
+   *
+   * @note this Program must be bound. If @p commands is written by a shader, barrier::indirectCommands() must be issued before.
+   */
+  void dispatchIndirect(const Buffer & commands, size_t offset = 0) const;
 };
 
+/**
+ * @brief The permutations of a program, specialized by compile-time options
+ *
+ * Each option is a preprocessor definition tested by the shaders (e.g. #ifdef DISPLAY_NORMALS), instead of a
+ * uniform tested for each vertex or fragment. A variant is denoted by a key whose bit k enables the k-th option.
+ * The variant of key 0 (no option) is compiled at construction, the other ones on first use, then cached:
+ * select() must thus be called from the thread of the OpenGL context, while current() may be called from any
+ * thread.
+ *
+ * Usage:
+ * @code
+ * ProgramVariants programs("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl", {"DISPLAY_NORMALS"});
+ * programs.select(displayNormals ? programs.option("DISPLAY_NORMALS") : 0).bind();
+ * @endcode
+ */
+class ProgramVariants {
+public:
+  /// a function setting the uniforms shared by all the variants, called once on each compiled variant
+  typedef std::function<void(Program &)> Setup;
+
+  /**
+   * @brief Constructor, selecting the variant of key 0
+   * @param stages the type and the filename of each shader (see Program)
+   * @param options the names of the options, the k-th one being enabled by the bit k of the keys
+   * @param setup called on each variant after its compilation, with the variant bound (may be empty)
+   */
+  ProgramVariants(const std::vector<std::pair<GLenum, std::string>> & stages, const std::vector<std::string> & options, const Setup & setup = Setup());
+
+  /// Constructor of the variants of a vertex and a fragment shader
+  ProgramVariants(const std::string & vname, const std::string & fname, const std::vector<std::string> & options, const Setup & setup = Setup());
+
+  ProgramVariants(const ProgramVariants &) = delete;
+  ProgramVariants & operator=(const ProgramVariants &) = delete;
+
+  /// the bit of the keys enabling an option (0 for an unknown option)
+  uint option(const std::string & name) const;
+
+  /**
+   * @brief the variant of a key, compiled if it was never used
+   * @param key the enabled options
+   */
+  Program & variant(uint key);
+
+  /// makes the variant of @p key the current one (compiling it if needed), and returns it
+  Program & select(uint key);
+
+  /// the variant selected last
+  Program & current() const { return *m_current; }
+
+  /// key of the current variant
+  uint currentKey() const { return m_currentKey; }
+
+  /// number of variants compiled so far
+  size_t nbCompiled() const { return m_variants.size(); }
+
+  /**
+   * @brief tracks the uniforms that the caller derives from versioned data (e.g. the camera, see Versioned)
+   * @param version the version of the data
+   * @return true if the uniforms of the current variant were set from another version (or never set), in which
+   * case the caller must set them, @p version being recorded as the one of the current variant
+   */
+  bool outdated(uint version);
+
+private:
+  std::vector<std::pair<GLenum, std::string>> m_stages;          ///< the shader stages
+  std::vector<std::string> m_options;                            ///< names of the options
+  Setup m_setup;                                                 ///< setup of the new variants
+  std::unordered_map<uint, std::unique_ptr<Program>> m_variants; ///< compiled variants, by key
+  Program * m_current;                                           ///< the current variant
+  uint m_currentKey;                                             ///< key of the current variant
+  std::unordered_map<uint, uint> m_versions;                     ///< version of the data of the uniforms of each variant (see outdated())
+};
+
+/**
+ * @brief Typed wrappers of glMemoryBarrier
+ *
+ * Each barrier makes the writes of the previous shaders (into buffers bound with Buffer::bindBase, images, ...)
+ * visible to the following commands reading the data in a given way.
+ */
+namespace barrier
+{
+/// reads and writes of shader storage blocks in shaders
+void storage();
+/// vertex attributes sourced from buffers (VAO::setVBO, VAO::setInstanceMatrices)
+void vertexAttributes();
+/// indices sourced from element array buffers
+void elementArray();
+/// draw and dispatch parameters sourced from GL_DRAW_INDIRECT_BUFFER and GL_DISPATCH_INDIRECT_BUFFER
+void indirectCommands();
+/// uniform blocks sourced from buffers
+void uniforms();
+/// reads and writes of buffers by the CPU (Buffer::read, Buffer::map, glBufferSubData, ...)
+void bufferUpdate();
+/// texture fetches (samplers), including of texture buffers
+void textureFetch();
+/// image loads and stores in shaders
+void imageAccess();
+} // namespace barrier
+
 /**
  * @brief The Texture class.
  *
@@ -401,14 +712,165 @@ public:
    *
    *
    * @note PA4 (part 2): You should generate mipmaps if they are toggled by the @p mipmaps argument
+   *
+   * @param srgb denotes if the color channels of @p image are sRGB encoded (e.g. diffuse maps, unlike normal maps),
+   * so that the mipmaps built on the CPU are filtered in linear space
+   *
+   * The mipmaps of 2d textures are built on the CPU (see generateMipmaps() and mipmapFilter) and all the levels
+   * are uploaded, unless cpuMipmaps is false in which case glGenerateMipmap is used.
+   */
+  template <typename T> void setData(const Image<T> & image, bool mipmaps = false, bool srgb = false) const;
+
+  /**
+   * @brief sends one level of a 2d texture to the GPU
+   * @param level the level (0 being the finest one)
+   * @param image the data of the level
+   */
+  void setLevelData(int level, const Image<GLubyte> & image) const;
+
+  /**
+   * @brief releases the GPU memory of one level of a 2d texture
+   * @param level the level, which must lie out of the range set by setLevelRange()
+   */
+  void releaseLevel(int level) const;
+
+  /**
+   * @brief restricts the levels accessed by the sampling (GL_TEXTURE_BASE_LEVEL and GL_TEXTURE_MAX_LEVEL)
+   * @param baseLevel the finest level accessed
+   * @param maxLevel the coarsest level accessed
+   */
+  void setLevelRange(int baseLevel, int maxLevel) const;
+
+  /**
+   * @brief makes this Texture (of target GL_TEXTURE_BUFFER) read the content of a buffer, e.g. with texelFetch
+   * @param buffer the buffer (allocated, the texture following its reallocations)
+   * @param internalFormat the format of the texels (e.g. GL_RGBA32F or GL_R32UI)
    */
-  template <typename T> void setData(const Image<T> & image, bool mipmaps = false) const;
+  void setBuffer(const Buffer & buffer, GLenum internalFormat) const;
+
+  /**
+   * @brief allocates the single level of this Texture (of target GL_TEXTURE_2D), without initializing it, e.g. to be rendered into
+   * @param internalFormat the format of the texels (e.g. GL_RGBA8, GL_RGBA16F or GL_DEPTH_COMPONENT24)
+   * @param width the width of the texture
+   * @param height the height of the texture
+   *
+   * @note the texture is sampled with nearest filtering (it is meant to be read at the pixel it was rendered)
+   */
+  void allocate(GLenum internalFormat, int width, int height) const;
+
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
+  static bool cpuMipmaps;           ///< denotes if the mipmaps of 2d textures are built on the CPU rather than by the driver
+  static MipmapFilter mipmapFilter; ///< filter of the mipmaps built on the CPU
 
 private:
   uint m_location; ///< GPU location of the texture
   GLenum m_target; ///< Texture target type (e.g. GL_TEXTURE_2D)
 };
 
+/**
+ * @brief A framebuffer object, whose attachments are textures
+ *
+ * While it is bound, the draw calls render into its attachments instead of the window. The fragment shaders
+ * write their output of location k into the color attachment k (see setDrawBuffers).
+ * Copy constructor and assignment operator are disabled.
+ */
+class Framebuffer : public OGLStateObject {
+public:
+  Framebuffer();
+  Framebuffer(const Framebuffer &) = delete;
+  Framebuffer & operator=(const Framebuffer &) = delete;
+  ~Framebuffer();
+
+  /// binds this Framebuffer as the draw and read framebuffer
+  void bind() const override;
+
+  /// binds back the default framebuffer (the window)
+  void unbind() const override;
+
+  /**
+   * @brief attaches a texture (its level 0), replacing the previous texture of the attachment
+   * @param attachment GL_COLOR_ATTACHMENTk, GL_DEPTH_ATTACHMENT, ...
+   * @param texture the texture (see Texture::allocate), which must outlive its attachment
+   */
+  void attach(GLenum attachment, const Texture & texture) const;
+
+  /// routes the fragment outputs of locations 0 to @p count - 1 to the color attachments 0 to @p count - 1
+  void setDrawBuffers(uint count) const;
+
+  /// denotes if the attachments make a complete framebuffer (the reason is displayed otherwise)
+  bool complete() const;
+
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
+private:
+  uint m_location; ///< GPU location of the framebuffer
+};
+
+/**
+ * @brief A query measuring a sequence of commands on the GPU (e.g. GL_SAMPLES_PASSED or GL_TIME_ELAPSED)
+ *
+ * The result is available a few frames after end(): reading it earlier waits for the GPU.
+ * Copy constructor and assignment operator are disabled.
+ */
+class Query {
+public:
+  /**
+   * @brief Constructor
+   * @param target the measure (GL_SAMPLES_PASSED, GL_ANY_SAMPLES_PASSED, GL_PRIMITIVES_GENERATED or GL_TIME_ELAPSED)
+   */
+  Query(GLenum target);
+  Query(const Query &) = delete;
+  Query & operator=(const Query &) = delete;
+  ~Query();
+
+  /// starts measuring (a single query of each target may be active at once)
+  void begin();
+
+  /// stops measuring
+  void end() const;
+
+  /// denotes if a measure was started
+  bool started() const { return m_started; }
+
+  /// denotes if the result can be read without waiting for the GPU
+  bool available() const;
+
+  /// the result of the measure between begin() and end(), waiting for the GPU if needed
+  GLuint64 result() const;
+
+private:
+  uint m_location; ///< GPU location of the query
+  GLenum m_target; ///< the measure
+  bool m_started;  ///< begin() was called
+};
+
+/// Measures the GPU time of a sequence of commands (a GL_TIME_ELAPSED query)
+class TimerQuery : public Query {
+public:
+  TimerQuery() : Query(GL_TIME_ELAPSED) {}
+
+  /// the GPU time between begin() and end() (in ms), waiting for the GPU if needed
+  double milliseconds() const { return result() * 1e-6; }
+};
+
+/// Counts the samples passing the depth and stencil tests during a sequence of commands (a GL_SAMPLES_PASSED query)
+class SamplesQuery : public Query {
+public:
+  SamplesQuery() : Query(GL_SAMPLES_PASSED) {}
+
+  /// the number of samples which passed the tests between begin() and end(), waiting for the GPU if needed
+  GLuint64 samples() const { return result(); }
+};
+
 /**
  * @brief The Sampler class
  *
@@ -493,6 +955,12 @@ public:
    */
   void enableAnisotropicFiltering() const;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
 private:
   uint m_location; ///< GPU location of the sampler
   int m_texUnit;   ///< texture unit
@@ -1,7 +1,10 @@
 #include "utils.hpp"
 #include <GL/glew.h>
+#include <algorithm>
+#include <dirent.h>
 #include <fstream>
 #include <iostream>
+#include <sys/resource.h>
 
 /*
  * OpenGL Error checking
@@ -77,3 +80,41 @@ std::string basename(const std::string & filepath)
 #endif
   return basedir;
 }
+
+std::vector<std::string> listFiles(const std::string & directory, const std::string & extension)
+{
+  std::vector<std::string> files;
+  DIR * dir = opendir(absolutename(directory).c_str());
+  if (not dir) {
+    return files;
+  }
+  while (dirent * entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name == "." or name == "..") {
+      continue;
+    }
+    std::string path = directory + "/" + name;
+    if (entry->d_type == DT_DIR) {
+      std::vector<std::string> subFiles = listFiles(path, extension);
+      files.insert(files.end(), subFiles.begin(), subFiles.end());
+    } else if (name.size() >= extension.size() and name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+      files.push_back(path);
+    }
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+size_t peakResidentSetSize()
+{
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss; // bytes
+#else
+  return usage.ru_maxrss * size_t(1024); // kilobytes
+#endif
+}
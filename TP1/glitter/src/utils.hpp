@@ -7,6 +7,7 @@
 #endif
 
 #include <string>
+#include <vector>
 /**
  * @brief reads the content of the file
  * @param filename the name of the target file
@@ -25,6 +26,20 @@ std::string absolutename(const std::string & filename);
 /// @brief retrieves the basename of a file
 std::string basename(const std::string & filepath);
 
+/**
+ * @brief recursively lists the files of a directory having a given extension
+ * @param directory the directory to be explored (relative to RESOURCE_DIR)
+ * @param extension the extension of the wanted files (e.g. ".obj")
+ * @return the sorted list of file names (relative to RESOURCE_DIR)
+ */
+std::vector<std::string> listFiles(const std::string & directory, const std::string & extension);
+
+/**
+ * @brief provides the peak memory usage of the process
+ * @return the maximal resident set size reached so far (in bytes), 0 if it is not available
+ */
+size_t peakResidentSetSize();
+
 /// @brief pop the last open GL error and display it in human readable format
 void checkGLerror();
 